@@ -0,0 +1,230 @@
+// Compares the CRF engine of the caffe DenseCRF layer (caffe::DenseCRFEngine,
+// also used by refine_pascal_v4) with libDenseCRF on identical inputs: a
+// synthetic scene of discs of random labels, with a noisy color per label
+// and a noisy unary favouring the true label.
+//
+// For every configuration of the engine, it reports the time of setting up
+// the potentials plus the mean-field inference (fastest of the repeats), the
+// speedup over libDenseCRF, the agreement of the labels and the max abs
+// difference of the marginals with libDenseCRF, and the accuracy w.r.t. the
+// true labels.
+//
+// Usage:
+//   prog_benchmark_densecrf [-w width] [-h height] [-m labels] [-i iterations]
+//                           [-r repeat] [-s seed]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "../libDenseCRF/densecrf.h"
+#include "../util/Timer.h"
+#include "caffe/util/densecrf_engine.hpp"
+
+struct BenchmarkData {
+  int Width;
+  int Height;
+  int NumLabels;
+  int MaxIterations;
+  int Repeat;
+  int Seed;
+};
+
+// parameters of refine_pascal_v4
+const float kPosW = 3, kPosXYStd = 3;
+const float kBilateralW = 5, kBilateralXYStd = 70, kBilateralRGBStd = 5;
+
+int ParseInput(int argc, char** argv, BenchmarkData& OD) {
+  for (int k = 1; k < argc; ++k) {
+    if (::strcmp(argv[k], "-w") == 0 && k+1 != argc) {
+      OD.Width = atoi(argv[++k]);
+    } else if (::strcmp(argv[k], "-h") == 0 && k+1 != argc) {
+      OD.Height = atoi(argv[++k]);
+    } else if (::strcmp(argv[k], "-m") == 0 && k+1 != argc) {
+      OD.NumLabels = atoi(argv[++k]);
+    } else if (::strcmp(argv[k], "-i") == 0 && k+1 != argc) {
+      OD.MaxIterations = atoi(argv[++k]);
+    } else if (::strcmp(argv[k], "-r") == 0 && k+1 != argc) {
+      OD.Repeat = atoi(argv[++k]);
+    } else if (::strcmp(argv[k], "-s") == 0 && k+1 != argc) {
+      OD.Seed = atoi(argv[++k]);
+    } else {
+      std::cerr << "Unknown argument " << argv[k] << std::endl;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+float Uniform() {
+  return rand() / (RAND_MAX + 1.0f);
+}
+
+float Gaussian() {
+  // Box-Muller
+  const float u = 1.0f - Uniform();
+  return sqrtf(-2.0f * logf(u)) * cosf(2.0f * 3.14159265f * Uniform());
+}
+
+// True labels, interleaved RGB image and unary (x0y0l0 x0y0l1 ...).
+void MakeScene(const BenchmarkData& inp, std::vector<short>& labels,
+	       std::vector<unsigned char>& image, std::vector<float>& unary) {
+  const int W = inp.Width, H = inp.Height, M = inp.NumLabels;
+  srand(inp.Seed);
+  labels.assign(W * H, 0);
+  for (int d = 0; d < 2 * M; ++d) {
+    const float cy = Uniform() * H, cx = Uniform() * W;
+    const float r = (0.05f + 0.15f * Uniform()) * (W < H ? W : H);
+    const short label = 1 + static_cast<int>(Uniform() * (M - 1)) % (M - 1);
+    for (int h = 0; h < H; ++h) {
+      for (int w = 0; w < W; ++w) {
+	if ((h - cy) * (h - cy) + (w - cx) * (w - cx) <= r * r) {
+	  labels[h * W + w] = label;
+	}
+      }
+    }
+  }
+  std::vector<float> palette(3 * M);
+  for (size_t k = 0; k < palette.size(); ++k) {
+    palette[k] = 40 + 175 * Uniform();
+  }
+  image.resize(3 * W * H);
+  unary.resize(M * W * H);
+  for (int i = 0; i < W * H; ++i) {
+    for (int c = 0; c < 3; ++c) {
+      const float v = palette[3 * labels[i] + c] + 10 * Gaussian();
+      image[3 * i + c] = v < 0 ? 0 : (v > 255 ? 255 : static_cast<int>(v));
+    }
+    // noisy scores, softmax, and the unary is -log of the probabilities
+    float* u = &unary[i * M];
+    float sum = 0;
+    for (int j = 0; j < M; ++j) {
+      u[j] = expf(1.5f * Gaussian() + (j == labels[i] ? 2.0f : 0.0f));
+      sum += u[j];
+    }
+    for (int j = 0; j < M; ++j) {
+      u[j] = -logf(u[j] / sum);
+    }
+  }
+}
+
+void ArgMax(const float* prob, int N, int M, std::vector<short>& map) {
+  map.resize(N);
+  for (int i = 0; i < N; ++i) {
+    const float* p = prob + i * M;
+    short best = 0;
+    for (int j = 1; j < M; ++j) {
+      if (p[j] > p[best]) {
+	best = j;
+      }
+    }
+    map[i] = best;
+  }
+}
+
+float Agreement(const std::vector<short>& a, const std::vector<short>& b) {
+  int same = 0;
+  for (size_t i = 0; i < a.size(); ++i) {
+    same += a[i] == b[i];
+  }
+  return static_cast<float>(same) / a.size();
+}
+
+int main(int argc, char* argv[]) {
+  BenchmarkData inp;
+  // a PASCAL sized image by default
+  inp.Width = 500;
+  inp.Height = 375;
+  inp.NumLabels = 21;
+  inp.MaxIterations = 10;
+  inp.Repeat = 3;
+  inp.Seed = 1701;
+  if (ParseInput(argc, argv, inp) != 0 || inp.Width < 1 || inp.Height < 1 ||
+      inp.NumLabels < 2 || inp.Repeat < 1) {
+    std::cerr << "Usage: " << argv[0] << " [-w width] [-h height] "
+	      << "[-m labels] [-i iterations] [-r repeat] [-s seed]" << std::endl;
+    return 1;
+  }
+  const int W = inp.Width, H = inp.Height, M = inp.NumLabels, N = W * H;
+
+  std::vector<short> labels;
+  std::vector<unsigned char> image;
+  std::vector<float> unary;
+  MakeScene(inp, labels, image, unary);
+
+  const char* isa_names[] = { "default", "avx2", "avx512" };
+  std::cout << W << "x" << H << "x" << M << ", " << inp.MaxIterations
+	    << " iterations, best of " << inp.Repeat << " runs, lattice isa "
+	    << isa_names[caffe::Permutohedral::isa()] << std::endl;
+
+  // libDenseCRF, as refine_pascal_v4 used to run it
+  std::vector<float> reference(N * M);
+  double lib_time = 0;
+  for (int r = 0; r < inp.Repeat; ++r) {
+    CPrecisionTimer timer;
+    timer.Start();
+    DenseCRF2D crf(W, H, M);
+    crf.setUnaryEnergy(&unary[0]);
+    crf.addPairwiseGaussian(kPosXYStd, kPosXYStd, kPosW);
+    crf.addPairwiseBilateral(kBilateralXYStd, kBilateralXYStd,
+	kBilateralRGBStd, kBilateralRGBStd, kBilateralRGBStd, &image[0],
+	kBilateralW);
+    crf.inference(inp.MaxIterations, &reference[0]);
+    const double elapsed = timer.Stop();
+    if (r == 0 || elapsed < lib_time) {
+      lib_time = elapsed;
+    }
+  }
+  std::vector<short> reference_map;
+  ArgMax(&reference[0], N, M, reference_map);
+  printf("%-26s %9.1f ms  accuracy %.4f\n", "libDenseCRF",
+	 1000 * lib_time, Agreement(reference_map, labels));
+
+  // the engine, reused from run to run as by the layer and the refiner
+  struct Config {
+    const char* name;
+    caffe::ExpAccuracy accuracy;
+    int downsample;
+  };
+  const Config configs[] = {
+    { "engine legacy exp",       caffe::EXP_LEGACY,   1 },
+    { "engine fast exp",         caffe::EXP_FAST,     1 },
+    { "engine accurate exp",     caffe::EXP_ACCURATE, 1 },
+    { "engine legacy, 2x grid",  caffe::EXP_LEGACY,   2 },
+    { "engine legacy, 4x grid",  caffe::EXP_LEGACY,   4 },
+  };
+  for (size_t k = 0; k < sizeof(configs) / sizeof(configs[0]); ++k) {
+    caffe::DenseCRFEngine crf(configs[k].accuracy, configs[k].downsample);
+    double best_time = 0;
+    for (int r = 0; r < inp.Repeat; ++r) {
+      CPrecisionTimer timer;
+      timer.Start();
+      crf.Reset(W, H, M);
+      crf.SetUnaryEnergy(&unary[0]);
+      crf.AddPairwiseGaussian(kPosXYStd, kPosXYStd, kPosW);
+      crf.AddPairwiseBilateral(kBilateralXYStd, kBilateralXYStd,
+	  kBilateralRGBStd, kBilateralRGBStd, kBilateralRGBStd, &image[0],
+	  kBilateralW);
+      crf.Inference(inp.MaxIterations);
+      const double elapsed = timer.Stop();
+      if (r == 0 || elapsed < best_time) {
+	best_time = elapsed;
+      }
+    }
+    std::vector<short> map;
+    ArgMax(crf.current(), N, M, map);
+    float max_diff = 0;
+    for (int i = 0; i < N * M; ++i) {
+      max_diff = std::max(max_diff, std::fabs(crf.current()[i] - reference[i]));
+    }
+    printf("%-26s %9.1f ms  accuracy %.4f  %5.2fx libDenseCRF, "
+	   "agreement %.4f, max abs diff %.2g\n", configs[k].name,
+	   1000 * best_time, Agreement(map, labels), lib_time / best_time,
+	   Agreement(map, reference_map), max_diff);
+  }
+  return 0;
+}
@@ -42,12 +42,15 @@
 #include <fstream>
 #include <dirent.h>
 #include <fnmatch.h>
+#include <pthread.h>
+#include <deque>
+#include <string>
 
 #include "matio.h"
 
-#include "../libDenseCRF/densecrf.h"
 #include "../libDenseCRF/util.h"
 #include "../util/Timer.h"
+#include "caffe/util/densecrf_engine.hpp"
 
 template <typename Dtype> enum matio_classes matio_class_map();
 template <> enum matio_classes matio_class_map<float>() { return MAT_C_SINGLE; }
@@ -55,12 +58,16 @@ template <> enum matio_classes matio_class_map<double>() { return MAT_C_DOUBLE;
 template <> enum matio_classes matio_class_map<int>() { return MAT_C_INT32; }
 template <> enum matio_classes matio_class_map<unsigned int>() { return MAT_C_UINT32; }
 
+// file_data is a scratch buffer, data and file_data are resized as needed so
+// that they can be reused from file to file.
 template <typename T>
-void LoadMatFile(const std::string& fn, T*& data, const int row, const int col,
+void LoadMatFile(const std::string& fn, std::vector<T>& data,
+		 std::vector<T>& file_data, const int row, const int col,
 		 int* channel = NULL, bool do_ppm_format = false);
 
 template <typename T>
-void LoadMatFile(const std::string& fn, T*& data, const int row, const int col, 
+void LoadMatFile(const std::string& fn, std::vector<T>& data,
+		 std::vector<T>& file_data, const int row, const int col,
 		 int* channel, bool do_ppm_format) {
   mat_t *matfp;
   matfp = Mat_Open(fn.c_str(), MAT_ACC_RDONLY);
@@ -96,10 +103,10 @@ void LoadMatFile(const std::string& fn, T*& data, const int row, const int col,
 
   assert(data_size <= file_size);
 
-  T* file_data = new T[file_size];
-  data = new T[data_size];
+  file_data.resize(file_size);
+  data.resize(data_size);
   
-  int ret = Mat_VarReadDataLinear(matfp, matvar, file_data, 0, 1, file_size);
+  int ret = Mat_VarReadDataLinear(matfp, matvar, &file_data[0], 0, 1, file_size);
   if (ret != 0) {
     std::cerr << "Error reading array 'data' from MAT file " << fn << std::endl;
   }
@@ -148,8 +155,6 @@ void LoadMatFile(const std::string& fn, T*& data, const int row, const int col,
 
   Mat_VarFree(matvar);
   Mat_Close(matfp);
-
-  delete[] file_data;
 }
 
 
@@ -277,7 +282,11 @@ struct InputData {
   float BilateralGStd;
   float BilateralBStd;
   float BilateralW;
-
+  char* ListFile;
+  int NumThreads;
+  int ExpAccuracy;
+  int Downsample;
+  int VectorLattice;
 };
 
 int ParseInput(int argc, char** argv, struct InputData& OD) {
@@ -308,6 +317,16 @@ int ParseInput(int argc, char** argv, struct InputData& OD) {
       OD.BilateralGStd = atof(argv[++k]);
     } else if(::strcmp(argv[k], "-bb")==0 && k+1!=argc) {
       OD.BilateralBStd = atof(argv[++k]);
+    } else if(::strcmp(argv[k], "-l")==0 && k+1!=argc) {
+      OD.ListFile = argv[++k];
+    } else if(::strcmp(argv[k], "-t")==0 && k+1!=argc) {
+      OD.NumThreads = atoi(argv[++k]);
+    } else if(::strcmp(argv[k], "-a")==0 && k+1!=argc) {
+      OD.ExpAccuracy = atoi(argv[++k]);
+    } else if(::strcmp(argv[k], "-d")==0 && k+1!=argc) {
+      OD.Downsample = atoi(argv[++k]);
+    } else if(::strcmp(argv[k], "-vl")==0 && k+1!=argc) {
+      OD.VectorLattice = atoi(argv[++k]);
     } 
   }
   return 0;
@@ -342,13 +361,21 @@ void ComputeUnaryForCRF(float*& unary, float* feat, int feat_row, int feat_col,
   }
 }
 
-void GetImgNamesFromFeatFiles(std::vector<std::string>& out, const std::vector<std::string>& in, const std::string& strip_pattern) {
+// The image of each feature file, named <image><strip_pattern>*. The other
+// feature files are skipped with a warning, and dropped from in.
+void GetImgNamesFromFeatFiles(std::vector<std::string>& out, std::vector<std::string>& in, const std::string& strip_pattern) {
+  std::vector<std::string> kept;
   for (size_t k = 0; k < in.size(); ++k) {
     size_t pos = in[k].find(strip_pattern);
     if (pos != std::string::npos) {
       out.push_back(in[k].substr(0, pos));      
+      kept.push_back(in[k]);
+    } else {
+      std::cerr << "Skipping " << in[k] << ", which is not named <image>"
+		<< strip_pattern << "*" << std::endl;
     }
   }
+  in.swap(kept);
 }
 
 void OutputSetting(const InputData& inp) {
@@ -368,6 +395,150 @@ void OutputSetting(const InputData& inp) {
   std::cout << "Bi_R_Std:  " << inp.BilateralRStd << std::endl;
   std::cout << "Bi_G_Std:  " << inp.BilateralGStd << std::endl;
   std::cout << "Bi_B_Std:  " << inp.BilateralBStd << std::endl;  
+  std::cout << "ListFile:  " << (inp.ListFile ? inp.ListFile : "") << std::endl;
+  std::cout << "Threads:   " << inp.NumThreads << std::endl;
+  std::cout << "ExpAccuracy: " << inp.ExpAccuracy << std::endl;
+  std::cout << "Downsample:  " << inp.Downsample << std::endl;
+  std::cout << "VectorLattice: " << inp.VectorLattice << std::endl;
+}
+
+// An image on its way through the pipeline. The items are recycled, so that
+// their buffers are reused from image to image.
+struct RefineItem {
+  std::string feat_name;
+  std::string img_name;
+  int feat_row, feat_col, feat_channel;
+  unsigned char* img;
+  std::vector<float> feat;
+  std::vector<float> file_data;
+  std::vector<short> map;
+  std::vector<short> result;
+};
+
+// Blocking FIFO of items between the pipeline stages.
+class RefineQueue {
+ public:
+  RefineQueue() {
+    pthread_mutex_init(&mutex_, NULL);
+    pthread_cond_init(&cond_, NULL);
+  }
+  ~RefineQueue() {
+    pthread_cond_destroy(&cond_);
+    pthread_mutex_destroy(&mutex_);
+  }
+  void push(RefineItem* item) {
+    pthread_mutex_lock(&mutex_);
+    items_.push_back(item);
+    pthread_mutex_unlock(&mutex_);
+    pthread_cond_signal(&cond_);
+  }
+  RefineItem* pop() {
+    pthread_mutex_lock(&mutex_);
+    while (items_.empty()) {
+      pthread_cond_wait(&cond_, &mutex_);
+    }
+    RefineItem* item = items_.front();
+    items_.pop_front();
+    pthread_mutex_unlock(&mutex_);
+    return item;
+  }
+
+ private:
+  std::deque<RefineItem*> items_;
+  pthread_mutex_t mutex_;
+  pthread_cond_t cond_;
+};
+
+// The reader thread loads the images and features into free items, the
+// inference threads refine them, and the main thread saves the labels. A
+// NULL item marks the end of the images.
+struct RefinePipeline {
+  const InputData* inp;
+  const std::vector<std::string>* feat_file_names;
+  const std::vector<std::string>* img_file_names;
+  RefineQueue free_items;
+  RefineQueue loaded_items;
+  RefineQueue refined_items;
+};
+
+void* ReadFeatures(void* arg) {
+  RefinePipeline& pipe = *static_cast<RefinePipeline*>(arg);
+  const InputData& inp = *pipe.inp;
+  bool do_ppm_format = true;
+  std::string fn;
+  for (size_t i = 0; i < pipe.feat_file_names->size(); ++i) {
+    RefineItem* item = pipe.free_items.pop();
+    item->feat_name = (*pipe.feat_file_names)[i];
+    item->img_name = (*pipe.img_file_names)[i];
+
+    fn = std::string(inp.ImgDir) + "/" + item->img_name + ".ppm";
+    item->img = readPPM(fn.c_str(), item->feat_col, item->feat_row);
+
+    fn = std::string(inp.FeatureDir) + "/" + item->feat_name + ".mat";
+    LoadMatFile(fn, item->feat, item->file_data, item->feat_row,
+		item->feat_col, &item->feat_channel, do_ppm_format);
+    pipe.loaded_items.push(item);
+  }
+  for (int k = 0; k < inp.NumThreads; ++k) {
+    pipe.loaded_items.push(NULL);
+  }
+  return NULL;
+}
+
+// The CRF is the engine of the caffe DenseCRF layer; each inference thread
+// reuses its engine, and thus its buffers, from image to image.
+void RefineImage(const InputData& inp, caffe::DenseCRFEngine* crf,
+		 RefineItem* item) {
+  const int feat_row = item->feat_row;
+  const int feat_col = item->feat_col;
+
+  // Setup the CRF model
+  crf->Reset(feat_col, feat_row, item->feat_channel);
+  // Specify the unary potential as an array of size W*H*(#classes)
+  // packing order: x0y0l0 x0y0l1 x0y0l2 .. x1y0l0 x1y0l1 ... (row-order)
+  crf->SetUnaryEnergy(&item->feat[0]);
+  // add a color independent term (feature = pixel location 0..W-1, 0..H-1)
+  crf->AddPairwiseGaussian(inp.PosXStd, inp.PosYStd, inp.PosW);
+
+  // add a color dependent term (feature = xyrgb)
+  crf->AddPairwiseBilateral(inp.BilateralXStd, inp.BilateralYStd, inp.BilateralRStd, inp.BilateralGStd, inp.BilateralBStd, item->img, inp.BilateralW);
+
+  // Do map inference
+  item->map.resize(feat_row*feat_col);
+  short* map = &item->map[0];
+  crf->Map(inp.MaxIterations, map);
+
+  item->result.resize(feat_row*feat_col);
+  short* result = &item->result[0];
+  ReshapeToMatlabFormat(result, map, feat_row, feat_col);
+}
+
+void* RefineImages(void* arg) {
+  RefinePipeline& pipe = *static_cast<RefinePipeline*>(arg);
+  caffe::DenseCRFEngine crf(
+      static_cast<caffe::ExpAccuracy>(pipe.inp->ExpAccuracy),
+      pipe.inp->Downsample);
+  while (RefineItem* item = pipe.loaded_items.pop()) {
+    RefineImage(*pipe.inp, &crf, item);
+    pipe.refined_items.push(item);
+  }
+  pipe.refined_items.push(NULL);
+  return NULL;
+}
+
+void ReadFileList(const char* list_file, std::vector<std::string>& fileNames) {
+  std::ifstream ifs(list_file);
+  if (!ifs.is_open()) {
+    std::cerr << "Fail to open " << list_file << std::endl;
+  }
+  std::string name;
+  while (ifs >> name) {
+    // the names may be given with or without extension
+    if (name.size() > 4 && name.compare(name.size() - 4, 4, ".mat") == 0) {
+      name = name.substr(0, name.size() - 4);
+    }
+    fileNames.push_back(name);
+  }
 }
 
 int main( int argc, char* argv[]){
@@ -390,69 +561,100 @@ int main( int argc, char* argv[]){
   inp.PosXStd = 3;
   inp.PosYStd = 3;
 
+  inp.ListFile   = NULL;
+  inp.NumThreads = 1;
+  // the exponential of libDenseCRF, so that the labels do not change; the
+  // vectorized ones (-a 1, -a 2) are faster but change the marginals slightly
+  inp.ExpAccuracy = caffe::EXP_LEGACY;
+  inp.Downsample  = 1;
+  // the lattice of libDenseCRF too: the AVX2 / AVX-512 ones (-vl 1) are
+  // faster but round the blur differently
+  inp.VectorLattice = 0;
+
   ParseInput(argc, argv, inp);
+  if (inp.ImgDir == NULL || inp.FeatureDir == NULL || inp.SaveDir == NULL) {
+    std::cerr << "Usage: " << argv[0] << " -id IMGDIR -fd FEATDIR -sd SAVEDIR"
+	      << " [options]; see dense_inference.cpp" << std::endl;
+    return 1;
+  }
   OutputSetting(inp);
 
-  assert(inp.ImgDir != NULL && inp.FeatureDir != NULL && inp.SaveDir != NULL);
+  if (inp.NumThreads < 1) {
+    std::cerr << "The number of threads (-t) must be positive" << std::endl;
+    return 1;
+  }
+  if (inp.ExpAccuracy < caffe::EXP_LEGACY ||
+      inp.ExpAccuracy > caffe::EXP_ACCURATE) {
+    std::cerr << "The exponential (-a) must be 0, 1 or 2" << std::endl;
+    return 1;
+  }
+  if (inp.Downsample < 1) {
+    std::cerr << "The downsampling factor (-d) must be positive" << std::endl;
+    return 1;
+  }
+  if (!inp.VectorLattice) {
+    caffe::Permutohedral::set_max_isa(caffe::Permutohedral::ISA_DEFAULT);
+  }
   
-  std::string pattern = "*.mat";
   std::vector<std::string> feat_file_names;
-  std::string feat_folder(inp.FeatureDir);
+  if (inp.ListFile != NULL) {
+    ReadFileList(inp.ListFile, feat_file_names);
+  } else {
+    std::string pattern = "*.mat";
+    std::string feat_folder(inp.FeatureDir);
 
-  TraverseDirectory(feat_folder, pattern, false, feat_file_names);
+    TraverseDirectory(feat_folder, pattern, false, feat_file_names);
+  }
   
   std::string strip_pattern("_blob_0");
   std::vector<std::string> img_file_names;
   GetImgNamesFromFeatFiles(img_file_names, feat_file_names, strip_pattern);
 
-  float* feat;
-  unsigned char* img;
-  std::string fn;
-  int feat_row, feat_col, feat_channel;
-
-  bool do_ppm_format = true;
+  RefinePipeline pipe;
+  pipe.inp = &inp;
+  pipe.feat_file_names = &feat_file_names;
+  pipe.img_file_names = &img_file_names;
+  // enough items for every thread to have one waiting
+  std::vector<RefineItem> items(2 * inp.NumThreads + 2);
+  for (size_t k = 0; k < items.size(); ++k) {
+    pipe.free_items.push(&items[k]);
+  }
 
   CPrecisionTimer CTmr;
   CTmr.Start();
-  for (size_t i = 0; i < feat_file_names.size(); ++i) {
-    if ( (i+1) % 100 == 0) {
-      std::cout << "processing " << i << " (" << feat_file_names.size() << ")..." << std::endl;
-    }
+  pthread_t reader;
+  std::vector<pthread_t> workers(inp.NumThreads);
+  pthread_create(&reader, NULL, ReadFeatures, &pipe);
+  for (int k = 0; k < inp.NumThreads; ++k) {
+    pthread_create(&workers[k], NULL, RefineImages, &pipe);
+  }
 
-    fn = std::string(inp.ImgDir) + "/" + img_file_names[i] + ".ppm";
-    img = readPPM(fn.c_str(), feat_col, feat_row);
-
-    fn = std::string(inp.FeatureDir) + "/" + feat_file_names[i] + ".mat";
-    LoadMatFile(fn, feat, feat_row, feat_col, &feat_channel, do_ppm_format);
-
-    // Setup the CRF model
-    DenseCRF2D crf(feat_col, feat_row, feat_channel);
-    // Specify the unary potential as an array of size W*H*(#classes)
-    // packing order: x0y0l0 x0y0l1 x0y0l2 .. x1y0l0 x1y0l1 ... (row-order)
-    crf.setUnaryEnergy(feat);
-    // add a color independent term (feature = pixel location 0..W-1, 0..H-1)
-    crf.addPairwiseGaussian(inp.PosXStd, inp.PosYStd, inp.PosW);
-
-    // add a color dependent term (feature = xyrgb)
-    crf.addPairwiseBilateral(inp.BilateralXStd, inp.BilateralYStd, inp.BilateralRStd, inp.BilateralGStd, inp.BilateralBStd, img, inp.BilateralW);
-	
-    // Do map inference
-    short* map = new short[feat_row*feat_col];
-    crf.map(inp.MaxIterations, map);
-
-    short* result = new short[feat_row*feat_col];
-    ReshapeToMatlabFormat(result, map, feat_row, feat_col);
-
-    // save results
-    fn = std::string(inp.SaveDir) + "/" + img_file_names[i] + ".bin";
-    SaveBinFile(fn, result, feat_row, feat_col, 1);
-    
-    // delete
-    delete[] result;
-    delete[] feat;
-    delete[] img;
-    delete[] map;
+  // save results
+  std::string fn;
+  size_t num_saved = 0;
+  for (int num_done = 0; num_done < inp.NumThreads; ) {
+    RefineItem* item = pipe.refined_items.pop();
+    if (item == NULL) {
+      ++num_done;
+      continue;
+    }
+    fn = std::string(inp.SaveDir) + "/" + item->img_name + ".bin";
+    SaveBinFile(fn, &item->result[0], item->feat_row, item->feat_col, 1);
+    delete[] item->img;
+    item->img = NULL;
+    pipe.free_items.push(item);
+
+    if (++num_saved % 100 == 0) {
+      std::cout << "processing " << num_saved << " (" << feat_file_names.size() << ")..." << std::endl;
+    }
   }
-  std::cout << "Time for inference: " << CTmr.Stop() << std::endl;
 
+  pthread_join(reader, NULL);
+  for (int k = 0; k < inp.NumThreads; ++k) {
+    pthread_join(workers[k], NULL);
+  }
+  double elapsed = CTmr.Stop();
+  std::cout << "Time for inference: " << elapsed << std::endl;
+  std::cout << "Refined " << num_saved << " images with " << inp.NumThreads
+	    << " threads: " << num_saved / elapsed << " images/sec" << std::endl;
 }
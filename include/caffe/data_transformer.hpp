@@ -24,6 +24,11 @@ class DataTransformer {
    *    transformation.
    */
   void InitRand();
+  /**
+   * @brief Same as InitRand(), with a given seed, so that the transformation
+   *    of a sample can be reproduced independently of the other ones.
+   */
+  void InitRand(unsigned int seed);
 
   /**
    * @brief Applies the transformation defined in the data layer's
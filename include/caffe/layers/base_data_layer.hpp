@@ -10,6 +10,12 @@
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/blocking_queue.hpp"
 
+/**
+ Forward declare boost::mutex instead of including boost/thread.hpp
+ to avoid a boost/NVCC issues (#1009, #1010) on OSX.
+ */
+namespace boost { class mutex; }
+
 namespace caffe {
 
 /**
@@ -48,14 +54,21 @@ class BaseDataLayer : public Layer<Dtype> {
 template <typename Dtype>
 class Batch {
  public:
+  Batch() : wait_us_(0), load_us_(0) {}
   Blob<Dtype> data_, label_, dim_, pose_;
+  // time the prefetch thread waited for this batch to be free and then
+  // spent loading it, in us
+  double wait_us_, load_us_;
 };
 
 template <typename Dtype>
 class BasePrefetchingDataLayer :
     public BaseDataLayer<Dtype>, public InternalThread {
  public:
-  explicit BasePrefetchingDataLayer(const LayerParameter& param);
+  // prefetch_count batches are loaded ahead of the net, unless the depth is
+  // set by the prefetch_param of the layer.
+  explicit BasePrefetchingDataLayer(const LayerParameter& param,
+      int prefetch_count = PREFETCH_COUNT);
   // LayerSetUp: implements common data layer setup functionality, and calls
   // DataLayerSetUp to do special data layer setup for individual layer types.
   // This method may not be overridden.
@@ -67,16 +80,27 @@ class BasePrefetchingDataLayer :
   virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
 
-  // Prefetches batches (asynchronously if to GPU memory)
+  // Prefetches batches (asynchronously if to GPU memory); the default
+  // number of batches loaded ahead.
   static const int PREFETCH_COUNT = 5;
 
+  // Telemetry of the prefetch queue since the last reset.
+  PrefetchStats prefetch_stats() const;
+  void ResetPrefetchStats();
+
  protected:
   virtual void InternalThreadEntry();
   virtual void load_batch(Batch<Dtype>* batch) = 0;
+  // Takes the next loaded batch, waiting for it if needed, and records the
+  // telemetry of the queue.
+  Batch<Dtype>* PopFullBatch();
 
-  Batch<Dtype> prefetch_[PREFETCH_COUNT];
+  vector<shared_ptr<Batch<Dtype> > > prefetch_;
   BlockingQueue<Batch<Dtype>*> prefetch_free_;
   BlockingQueue<Batch<Dtype>*> prefetch_full_;
+  // guarded by stats_mutex_, as the layer may be shared by several nets
+  PrefetchStats prefetch_stats_;
+  shared_ptr<boost::mutex> stats_mutex_;
 
   Blob<Dtype> transformed_data_;
 };
@@ -84,8 +108,9 @@ class BasePrefetchingDataLayer :
 template <typename Dtype>
 class ImageDimPrefetchingDataLayer : public BasePrefetchingDataLayer<Dtype> {
  public:
-  explicit ImageDimPrefetchingDataLayer(const LayerParameter& param)
-      : BasePrefetchingDataLayer<Dtype>(param) {}
+  explicit ImageDimPrefetchingDataLayer(const LayerParameter& param,
+      int prefetch_count = BasePrefetchingDataLayer<Dtype>::PREFETCH_COUNT)
+      : BasePrefetchingDataLayer<Dtype>(param, prefetch_count) {}
   virtual ~ImageDimPrefetchingDataLayer() {}
   // LayerSetUp: implements common data layer setup functionality, and calls
   // DataLayerSetUp to do special data layer setup for individual layer types.
@@ -108,6 +133,11 @@ class ImageDimPrefetchingDataLayer : public BasePrefetchingDataLayer<Dtype> {
   bool output_data_dim_;
 };
 
+// Logs the prefetch telemetry of the data layers among layers and their total
+// consumer wait; with reset, the telemetry restarts from there.
+template <typename Dtype>
+void LogPrefetchStats(const vector<shared_ptr<Layer<Dtype> > >& layers,
+    bool reset);
 
 }  // namespace caffe
 
@@ -18,6 +18,7 @@
 #include "caffe/layer.hpp"
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/util/db.hpp"
+#include "caffe/util/thread_pool.hpp"
 namespace caffe
 {
 
@@ -29,7 +30,8 @@ class DataHeatmapLayer: public BasePrefetchingDataLayer<Dtype>
 public:
 
     explicit DataHeatmapLayer(const LayerParameter& param)
-        : BasePrefetchingDataLayer<Dtype>(param) {}
+        : BasePrefetchingDataLayer<Dtype>(param,
+              param.heatmap_data_param().prefetch()) {}
     virtual ~DataHeatmapLayer();
     virtual void DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
                                 const vector<Blob<Dtype>*>& top);
@@ -43,6 +45,9 @@ public:
 protected:
     virtual void load_batch(Batch<Dtype>* batch);
 
+    // Reads the image of item item_id of the batch and renders its heatmaps
+    void LoadSample(Batch<Dtype>* batch, int item_id);
+
     // Filename of current image
     inline void GetCurImg(string& img_name, std::vector<float>& img_class);
 
@@ -77,6 +82,12 @@ protected:
 
     // vector of (image, label) pairs
     vector< pair<string, vector<float> > > img_label_list_;    
+
+    // Batch items are loaded in parallel
+    shared_ptr<ThreadPool> decode_pool_;
+    vector<int> item_img_; // image index of each item of the batch
+    vector<cv::Size> item_size_; // decoded image size of each item
+    vector<cv::Size> img_size_cache_; // decoded image sizes, empty if unread
 };
 
 }
@@ -6,7 +6,11 @@
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
+#include "caffe/util/densecrf_engine.hpp"
 #include "caffe/util/densecrf_pairwise.hpp"
+#include "caffe/util/densecrf_util.hpp"
+#include "caffe/util/lattice_cache.hpp"
+#include "caffe/util/thread_pool.hpp"
 #include "caffe/proto/caffe.pb.h"
 
 namespace caffe {
@@ -34,26 +38,29 @@ class DenseCRFLayer : public Layer<Dtype> {
   virtual inline int ExactNumTopBlobs() const { return 1; }
 
  protected:
+  /// Mean-field state of one image. Each worker thread owns one context so
+  /// that the images of a batch can be processed concurrently.
+  struct InferenceContext {
+    shared_ptr<DenseCRFEngine> engine_;
+    // potentials added to the engine, possibly shared with lattice_cache_
+    std::vector<shared_ptr<PairwisePotential> > pairwise_;
+  };
+
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
-  virtual void SetupPairwiseFunctions(const vector<Blob<Dtype>*>& bottom);
-  virtual void ClearPairwiseFunctions();
-
-  virtual void SetupUnaryEnergy(const Dtype* bottom);
+  // runs inference on the images n = ctx_id, ctx_id + #contexts, ...
+  virtual void ForwardContext(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top, int ctx_id);
 
-  virtual void ComputeMap(Dtype* top_inf);
+  virtual void SetupPairwiseFunctions(const Dtype* im, InferenceContext* ctx);
+  virtual void ClearPairwiseFunctions(InferenceContext* ctx);
 
-  virtual void RunInference();
-  virtual void StartInference();
-  virtual void StepInference();
+  virtual void SetupUnaryEnergy(const Dtype* bottom, InferenceContext* ctx);
 
-  virtual void ExpAndNormalize(float* out, const float* in, float scale);
-
-  virtual void AllocateAllData();
-  virtual void DeAllocateAllData();
+  virtual void ComputeMap(Dtype* top_inf, InferenceContext* ctx);
 
   
   bool has_image;
@@ -63,9 +70,6 @@ class DenseCRFLayer : public Layer<Dtype> {
   int pad_width_;    // may have padded cols
 
   int M_;   // number of input feature (channel)
-  int W_;   // effective width   (<= pad_width_)
-  int H_;   // effective height  (<= pad_height_)
-  int N_;   // = W_ * H_
 
   int max_iter_;
 
@@ -78,15 +82,14 @@ class DenseCRFLayer : public Layer<Dtype> {
   std::vector<float> bi_xy_std_;
   std::vector<float> bi_rgb_std_;
 
-  std::vector<PairwisePotential*> pairwise_;
-
-  int unary_element_;  // size of unary energy
-  int map_element_;    // size of map result
+  // factor by which the grid of the pairwise filtering is downsampled
+  int downsample_;
 
-  float* unary_;     // unary energy
-  float* current_;   // current inference values, will copy to top[0]
-  float* next_;      // next inference values
-  float* tmp_;       // buffer
+  // one inference context per concurrently processed image
+  std::vector<InferenceContext> contexts_;
+  shared_ptr<ThreadPool> thread_pool_;
+  // lattices of recently seen images and kernel configurations (optional)
+  shared_ptr<LatticeCache> lattice_cache_;
 
   /// sum_multiplier is used to carry out sum using BLAS
   Blob<Dtype> sum_multiplier_;
@@ -97,6 +100,8 @@ class DenseCRFLayer : public Layer<Dtype> {
 
   // the output format is probability or score (score = log(probability))
   bool output_prob_;
+  // exponential used in the mean-field updates
+  ExpAccuracy exp_accuracy_;
 };
 
 }  // namespace caffe
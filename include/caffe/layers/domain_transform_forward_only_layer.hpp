@@ -6,6 +6,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
+#include "caffe/util/thread_pool.hpp"
 #include "caffe/proto/caffe.pb.h"
 
 namespace caffe {
@@ -68,6 +69,12 @@ class DomainTransformForwardOnlyLayer : public Layer<Dtype> {
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
+  // Computes the weight images of sample n for all iterations.
+  void SetUpWeightImages(const vector<Blob<Dtype>*>& bottom, int n);
+  // Filters channel index % channels_ of sample index / channels_.
+  void ForwardChannel(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top, int index);
+
   Dtype ComputeSigma(const int iter);
 
   void SetUpWeightImage(const int input_height, const int input_width,
@@ -114,7 +121,11 @@ class DomainTransformForwardOnlyLayer : public Layer<Dtype> {
   int num_passes_;
   // weight_image_ is the weighted reference gradient (to be filtered against),
   // which depends on current iteration value, spatial_sigma_, and range_sigma_.
+  // The CPU path keeps one image per (sample, iteration): num_ x num_iter_.
   Blob<Dtype> weight_image_;
+
+  // Splits the samples and channels across cores.
+  shared_ptr<ThreadPool> thread_pool_;
 };
 
 }  // namespace caffe
@@ -0,0 +1,56 @@
+#ifndef CAFFE_FEATURE_READ_LAYER_HPP_
+#define CAFFE_FEATURE_READ_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/feature_file.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Reads the records of the feature file feature_read_param.file(i)
+ *        into the i-th top, e.g. the score maps dumped by FeatureWrite.
+ *
+ * The files are memory mapped. With batch_size 1 and zero_copy the tops
+ * share the mapped records, otherwise the records of a batch (which must
+ * have the same shape) are copied. The pages of the next batch are
+ * requested from the kernel while the current one is used.
+ */
+template <typename Dtype>
+class FeatureReadLayer : public Layer<Dtype> {
+ public:
+  explicit FeatureReadLayer(const LayerParameter& param)
+      : Layer<Dtype>(param) {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  // Data layers should be shared by multiple solvers in parallel
+  virtual inline bool ShareInParallel() const { return true; }
+  // The tops are reshaped by Forward.
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {}
+
+  virtual inline const char* type() const { return "FeatureRead"; }
+  virtual inline int ExactNumBottomBlobs() const { return 0; }
+  virtual inline int MinTopBlobs() const { return 1; }
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {}
+  // Reads the batch starting at record into the tops.
+  void ReadBatch(int record, const vector<Blob<Dtype>*>& top);
+
+  int batch_size_;
+  int num_records_;
+  int record_;
+  bool zero_copy_;
+  vector<shared_ptr<FeatureFile> > files_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_FEATURE_READ_LAYER_HPP_
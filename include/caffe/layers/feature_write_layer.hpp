@@ -0,0 +1,57 @@
+#ifndef CAFFE_FEATURE_WRITE_LAYER_HPP_
+#define CAFFE_FEATURE_WRITE_LAYER_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/async_writer.hpp"
+#include "caffe/util/feature_file.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Appends the i-th bottom, every period iterations, as a record of
+ *        the feature file feature_write_param.file(i).
+ *
+ * The records are named as the files MatWrite would write. The index of
+ * the files is written by FlushOutput (e.g. at the end of a test) and when
+ * the layer is destroyed. With a positive queue_size, Forward only
+ * snapshots the bottoms and the records are written by a background thread.
+ */
+template <typename Dtype>
+class FeatureWriteLayer : public Layer<Dtype>, public AsyncOutput {
+ public:
+  explicit FeatureWriteLayer(const LayerParameter& param)
+      : Layer<Dtype>(param) {}
+  virtual ~FeatureWriteLayer();
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {}
+
+  virtual inline const char* type() const { return "FeatureWrite"; }
+  virtual inline int MinBottomBlobs() const { return 1; }
+  virtual inline int ExactNumTopBlobs() const { return 0; }
+
+  virtual void FlushOutput();
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {}
+  void WriteRecord(int i, const string& name, shared_ptr<Blob<Dtype> > blob);
+
+  int iter_;
+  int period_;
+  vector<string> fnames_;
+  vector<shared_ptr<FeatureFileWriter> > files_;
+  shared_ptr<AsyncWriter> writer_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_FEATURE_WRITE_LAYER_HPP_
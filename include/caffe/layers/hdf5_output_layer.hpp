@@ -9,6 +9,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/async_writer.hpp"
 
 namespace caffe {
 
@@ -18,10 +19,15 @@ namespace caffe {
 /**
  * @brief Write blobs to disk as HDF5 files.
  *
+ * The batches are stacked along the first axis of the data and label
+ * datasets, which are extended in place by every write. With a positive
+ * queue_size the writes are done by a background thread, and with
+ * accumulate the batches are gathered and only written by FlushOutput.
+ *
  * TODO(dox): thorough documentation for Forward and proto params.
  */
 template <typename Dtype>
-class HDF5OutputLayer : public Layer<Dtype> {
+class HDF5OutputLayer : public Layer<Dtype>, public AsyncOutput {
  public:
   explicit HDF5OutputLayer(const LayerParameter& param)
       : Layer<Dtype>(param), file_opened_(false) {}
@@ -41,6 +47,8 @@ class HDF5OutputLayer : public Layer<Dtype> {
 
   inline std::string file_name() const { return file_name_; }
 
+  virtual void FlushOutput();
+
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
@@ -50,13 +58,21 @@ class HDF5OutputLayer : public Layer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
-  virtual void SaveBlobs();
+  /// Takes a snapshot of the bottoms and writes it, or queues it.
+  virtual void SaveBlobs(const vector<Blob<Dtype>*>& bottom);
+  /// Queues the write of the batches saved so far.
+  void PushBatches();
+  /// Concatenates the batches and appends them to the datasets.
+  void WriteBlobs(const vector<shared_ptr<Blob<Dtype> > >& data,
+      const vector<shared_ptr<Blob<Dtype> > >& label);
 
   bool file_opened_;
+  bool accumulate_;
   std::string file_name_;
   hid_t file_id_;
-  Blob<Dtype> data_blob_;
-  Blob<Dtype> label_blob_;
+  vector<shared_ptr<Blob<Dtype> > > data_batches_;
+  vector<shared_ptr<Blob<Dtype> > > label_batches_;
+  shared_ptr<AsyncWriter> writer_;
 };
 
 }  // namespace caffe
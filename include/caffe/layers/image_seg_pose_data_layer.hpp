@@ -1,6 +1,8 @@
 #ifndef CAFFE_IMAGE_SEG_POSE_DATA_LAYER_HPP_
 #define CAFFE_IMAGE_SEG_POSE_DATA_LAYER_HPP_
 
+#include <opencv2/core/core.hpp>
+
 #include <string>
 #include <utility>
 #include <vector>
@@ -11,6 +13,7 @@
 #include "caffe/layer.hpp"
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/thread_pool.hpp"
 
 
 namespace caffe {
@@ -32,11 +35,39 @@ class ImageSegPoseDataLayer : public ImageDimPrefetchingDataLayer<Dtype> {
  protected:
   virtual void ShuffleImages();
   virtual void load_batch(Batch<Dtype>* batch);
+  // Shapes the tops, the prefetch batches and the per sample state after the
+  // first (resized) image of the dataset.
+  void ShapeTops(const cv::Mat& cv_img, const int batch_size,
+      const vector<Blob<Dtype>*>& top);
+  // Fills item_lines_[item_id] with the next sample of the dataset; called
+  // in order on the prefetch thread.
+  virtual void PickSample(int item_id);
+  // Reads the (resized) image and segmentation of item_lines_[item_id];
+  // called from the decode threads.
+  virtual void ReadSample(int item_id, std::vector<cv::Mat>* cv_img_seg,
+      int* img_row, int* img_col);
+  // Decodes and transforms the item_id-th sample of the batch; called from
+  // the decode threads.
+  void LoadSample(Batch<Dtype>* batch, int item_id);
 
   Blob<Dtype> transformed_label_;
   shared_ptr<Caffe::RNG> prefetch_rng_;
   vector<std::pair<std::pair<std::string, std::string>, vector<float> > > lines_;
   int lines_id_;
+
+  // The line and the transformation seed of every sample of the batch being
+  // loaded. They are drawn in order on the prefetch thread, so the batches
+  // are the same whatever the number of decode threads.
+  vector<std::pair<std::pair<std::string, std::string>, vector<float> > >
+      item_lines_;
+  vector<unsigned int> item_seeds_;
+  // One transformer and pair of output views per sample of the batch.
+  vector<shared_ptr<DataTransformer<Dtype> > > item_transformers_;
+  vector<shared_ptr<Blob<Dtype> > > item_data_;
+  vector<shared_ptr<Blob<Dtype> > > item_label_;
+  vector<double> item_read_time_;
+  vector<double> item_trans_time_;
+  shared_ptr<ThreadPool> decode_pool_;
 };
 
 }  // namespace caffe
@@ -0,0 +1,81 @@
+#ifndef CAFFE_INTERP_ARGMAX_LAYER_HPP_
+#define CAFFE_INTERP_ARGMAX_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/interp_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Fuses Interp -> Softmax -> ArgMax (axis 1) at inference: the label
+ *        map of the upsampled scores, without materializing the upsampled
+ *        (N x C x H x W) scores or probabilities.
+ *
+ * The output size is given by interp_param as for InterpLayer. The scores
+ * are interpolated a few output rows at a time into a buffer that stays in
+ * cache, and the argmax over the channels is taken from it. The softmax
+ * does not change the argmax; its probability of the label is the optional
+ * second top. Ties go to the larger label, as in ArgMaxLayer. The rows of
+ * the images are split across interp_param.num_threads threads.
+ *
+ * NOTE: does not implement Backwards operation.
+ */
+template <typename Dtype>
+class InterpArgMaxLayer : public InterpLayer<Dtype> {
+ public:
+  explicit InterpArgMaxLayer(const LayerParameter& param)
+      : InterpLayer<Dtype>(param) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  virtual inline const char* type() const { return "InterpArgMax"; }
+  virtual inline int ExactNumBottomBlobs() const { return 1; }
+  virtual inline int ExactNumTopBlobs() const { return -1; }
+  virtual inline int MinTopBlobs() const { return 1; }
+  virtual inline int MaxTopBlobs() const { return 2; }
+
+ protected:
+  /**
+   * @param bottom input Blob vector (length 1)
+   *   -# @f$ (N \times C \times H \times W) @f$
+   *      the scores @f$ x @f$
+   * @param top output Blob vector (length 1 or 2)
+   *   -# @f$ (N \times 1 \times H' \times W') @f$
+   *      the labels @f$ \arg\max\limits_c \hat{x}_c @f$ of the interpolated
+   *      scores @f$ \hat{x} @f$
+   *   -# @f$ (N \times 1 \times H' \times W') @f$, optional
+   *      their probabilities @f$ \max\limits_c softmax(\hat{x})_c @f$
+   */
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+    Forward_cpu(bottom, top);
+  }
+  /// @brief Not implemented (non-differentiable function)
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+    NOT_IMPLEMENTED;
+  }
+  virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+    NOT_IMPLEMENTED;
+  }
+
+  // Labels the rows of the t-th of num_tasks_ chunks of the batch.
+  void ForwardRows(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top, int t);
+
+  // chunks of rows per image, and output rows interpolated at once
+  int row_chunks_;
+  int block_rows_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_INTERP_ARGMAX_LAYER_HPP_
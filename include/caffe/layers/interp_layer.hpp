@@ -6,6 +6,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 /**
@@ -13,6 +14,9 @@ namespace caffe {
  *        The target size is specified in terms of pixels. 
  *        The start and end pixels of the input are mapped to the start
  *        and end pixels of the output.
+ *
+ * On CPU the channels of the batch are split across
+ * InterpParameter.num_threads threads.
  */
 template <typename Dtype>
 class InterpLayer : public Layer<Dtype> {
@@ -37,12 +41,23 @@ class InterpLayer : public Layer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
-  
+
+  // Sets the input and output sizes from the bottom and interp_param.
+  void SetUpOutputSize(const vector<Blob<Dtype>*>& bottom);
+  // Interpolate the channels of the t-th of num_tasks_ chunks of the batch.
+  void ForwardChunk(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top, int t);
+  void BackwardChunk(const vector<Blob<Dtype>*>& top,
+      const vector<Blob<Dtype>*>& bottom, int t);
+
   int num_, channels_;
   int height_in_, width_in_;
   int height_out_, width_out_;
   int pad_beg_, pad_end_;
   int height_in_eff_, width_in_eff_;
+
+  shared_ptr<ThreadPool> thread_pool_;
+  int num_tasks_;
 };
 
 }  // namespace caffe
@@ -1,39 +1,79 @@
 #ifndef CAFFE_MAT_READ_LAYER_HPP_
 #define CAFFE_MAT_READ_LAYER_HPP_
 
+#include <list>
+#include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
+#include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+/**
+ * @brief Reads the blobs "<prefix><fname>_blob_<i>.mat" of the i-th top, for
+ *        the files listed in mat_read_param.source (or fname = "iter_<k>"
+ *        without source, for k up to the first missing file).
+ *
+ * The samples are read in order, starting over at the end of the set.
+ * The batches are prefetched by a background thread, and the files of a
+ * batch are read by mat_read_param.num_threads parallel matio readers. Up
+ * to mat_read_param.cache_size decoded blobs are kept in memory, e.g. to
+ * serve the precomputed features of a small set over several epochs
+ * without reading them again.
+ */
 template <typename Dtype>
-class MatReadLayer : public Layer<Dtype> {
+class MatReadLayer : public BasePrefetchingDataLayer<Dtype> {
  public:
   explicit MatReadLayer(const LayerParameter& param)
-      : Layer<Dtype>(param) {}
-  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
-      const vector<Blob<Dtype>*>& top);
-  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      : BasePrefetchingDataLayer<Dtype>(param) {}
+  virtual ~MatReadLayer();
+  virtual void DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
+
   virtual inline const char* type() const { return "MatRead"; }
   virtual inline int ExactNumBottomBlobs() const { return 0; }
-  virtual inline int ExactNumTopBlobs() const { return 1; }
+  virtual inline int MinTopBlobs() const { return 1; }
+  virtual inline int MaxTopBlobs() const { return 2; }
+
+  /// @brief Number of blobs served from the cache and read from files.
+  int cache_hits() const;
+  int cache_misses() const;
 
  protected:
-  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
-      const vector<Blob<Dtype>*>& top);
-  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
-      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+  virtual void load_batch(Batch<Dtype>* batch);
+  // Reads the blobs of item n of the batch.
+  void LoadItem(Batch<Dtype>* batch, int n);
+  // The file of blob i of sample k.
+  string FileName(int k, int i) const;
+  // Whether the files of all the tops of sample k exist.
+  bool SampleExists(int k) const;
+  // The decoded file, from the cache or read (and cached).
+  shared_ptr<Blob<Dtype> > ReadBlob(const string& fname);
 
-  bool reshape_;
   int batch_size_;
   int iter_;
+  int num_samples_;
+  int num_tops_;
   string prefix_;
   vector<string> fnames_;
+
+  // Batch items are read in parallel
+  shared_ptr<ThreadPool> read_pool_;
+  vector<int> item_sample_;  // sample index of each item of the batch
+
+  // LRU cache of decoded blobs, the most recently used in front
+  typedef std::list<std::pair<string, shared_ptr<Blob<Dtype> > > > CacheList;
+  int cache_size_;
+  CacheList cache_;
+  std::map<string, typename CacheList::iterator> cache_index_;
+  shared_ptr<boost::mutex> cache_mutex_;
+  int cache_hits_, cache_misses_;
 };
 
 }  // namespace caffe
@@ -7,17 +7,22 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/async_writer.hpp"
 
 namespace caffe {
 
 /*
   MatWriteLayer
+
+  With a positive queue_size, Forward only snapshots the bottoms and the
+  MAT files are written by a background thread; FlushOutput waits for them.
 */
 template <typename Dtype>
-class MatWriteLayer : public Layer<Dtype> {
+class MatWriteLayer : public Layer<Dtype>, public AsyncOutput {
  public:
   explicit MatWriteLayer(const LayerParameter& param)
       : Layer<Dtype>(param) {}
+  virtual ~MatWriteLayer();
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
@@ -25,16 +30,21 @@ class MatWriteLayer : public Layer<Dtype> {
   virtual inline const char* type() const { return "MatWrite"; }
   virtual inline int ExactNumTopBlobs() const { return 0; }
 
+  virtual void FlushOutput();
+
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+  void WriteBlob(const string& fname, shared_ptr<Blob<Dtype> > blob);
 
   int iter_;
   int period_;
+  bool compression_;
   string prefix_;
   vector<string> fnames_;
+  shared_ptr<AsyncWriter> writer_;
 };
 
 }  // namespace caffe
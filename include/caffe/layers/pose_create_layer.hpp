@@ -10,6 +10,15 @@
 
 namespace caffe {
 
+/**
+ * @brief Renders a Gaussian heatmap at the (x, y) center of every joint.
+ *
+ * The bottoms are the (N x 1 x 1 x 2 num_joint) joint centers and a blob
+ * giving the (H x W) size of the maps; the joints at (0, 0) are missing and
+ * get an empty map. The Gaussian is separable: every map is the outer
+ * product of two 1-D Gaussians looked up in a table, restricted to the
+ * window of truncate * sigma pixels around the joint.
+ */
 template <typename Dtype>
 class PoseCreateLayer : public Layer<Dtype> {
  public:
@@ -20,6 +29,8 @@ class PoseCreateLayer : public Layer<Dtype> {
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
 
+  virtual inline const char* type() const { return "PoseCreate"; }
+
   virtual inline int ExactNumBottomBlobs() const { return 2; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
 
@@ -33,6 +44,12 @@ class PoseCreateLayer : public Layer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
   }
   int num_joint_, label_value_;
+  float sigma_;
+  // largest offset from the joint of a nonzero value, along each axis
+  int radius_;
+  // gaussian_[radius_ + d] = exp(-d^2 / (2 sigma^2)) for the offsets d in
+  // [-radius_, radius_], rebuilt when the radius changes with the map size
+  vector<Dtype> gaussian_;
 };
 
 }  // namespace caffe
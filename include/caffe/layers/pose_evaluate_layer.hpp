@@ -1,15 +1,31 @@
 #ifndef POSE_EVALUATE_LAYER_HPP_
 #define POSE_EVALUATE_LAYER_HPP_
 
+#include <stdint.h>
+
 #include <vector>
 
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+// Joint of the parsing class cls_ for the num_joint_ (9, 3 or 2) joints of a
+// parsing level, -1 for the classes of no joint.
+int selectJointFun(int num_joint_, int cls_);
+
+/**
+ * @brief Computes the center of every joint as the mean position of the
+ *        pixels of the parsing classes of that joint.
+ *
+ * The bottom is either a (N x 1 x H x W) label map, or (N x C x H x W) class
+ * scores whose argmax over the channels is taken on the fly. The top holds
+ * the (x, y) centers of the num_joint joints of every image, (0, 0) for the
+ * joints of no pixel.
+ */
 template <typename Dtype>
 class PoseEvaluateLayer : public Layer<Dtype> {
  public:
@@ -34,7 +50,21 @@ class PoseEvaluateLayer : public Layer<Dtype> {
   virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
   }
+
+  // Accumulates the pixel count and the sums of x and y of every joint of
+  // image n in a single pass, then writes its joint centers.
+  void EvaluateImage(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top, int n);
+
   int num_joint_;   
+  // joint of every class label, num_joint_ for the classes of no joint
+  vector<int> class_joint_;
+  shared_ptr<ThreadPool> thread_pool_;
+  // per image: count, sum of x and sum of y of the joints and the discarded
+  // pixels, and the row buffers of the argmax
+  vector<int64_t> moments_;
+  vector<vector<Dtype> > row_max_;
+  vector<vector<int> > row_argmax_;
 };
 
 }  // namespace caffe
@@ -1,12 +1,14 @@
 #ifndef CAFFE_SEG_ACCURACY_LAYER_HPP_
 #define CAFFE_SEG_ACCURACY_LAYER_HPP_
 
+#include <set>
 #include <vector>
 
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/util/confusion_matrix.hpp"
+#include "caffe/util/thread_pool.hpp"
 #include "caffe/proto/caffe.pb.h"
 
 namespace caffe {
@@ -61,11 +63,28 @@ class SegAccuracyLayer : public Layer<Dtype> {
       if (propagate_down[i]) { NOT_IMPLEMENTED; }
     }
   }
-      
+
+  // Counts the pixels of the task-th range of image rows into the task's
+  // histogram of (label, prediction) pairs.
+  void CountRows(const vector<Blob<Dtype>*>& bottom, int task);
+
   ConfusionMatrix confusion_matrix_;
 
   // set of ignore labels
   std::set<int> ignore_label_;
+  // whether each label in [0, channels) is ignored
+  vector<bool> ignored_class_;
+  int top_k_;
+
+  shared_ptr<ThreadPool> thread_pool_;
+  int num_tasks_;
+  // Per task: a shard of the counts and buffers of one image row (the
+  // running max score and its class, the score of the label and its rank).
+  ConfusionMatrixShards task_confusion_;
+  vector<vector<Dtype> > task_max_;
+  vector<vector<int> > task_argmax_;
+  vector<vector<Dtype> > task_label_score_;
+  vector<vector<int> > task_rank_;
 };
 
 }  // namespace caffe
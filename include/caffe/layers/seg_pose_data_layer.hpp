@@ -0,0 +1,53 @@
+#ifndef CAFFE_SEG_POSE_DATA_LAYER_HPP_
+#define CAFFE_SEG_POSE_DATA_LAYER_HPP_
+
+#include <opencv2/core/core.hpp>
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/layers/image_seg_pose_data_layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/db.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Same as ImageSegPoseDataLayer, reading the samples from a db of
+ *        SegPoseDatum written by tools/convert_imageseg_pose.cpp instead of
+ *        an image list and a posefile.
+ *
+ * The db is given by data_param (source, backend, batch_size, rand_skip);
+ * the decoding and the decode threads by image_data_param as for
+ * ImageSegPoseDataLayer. The samples are read in the db order. label_type
+ * must be PIXEL, or NONE to ignore the segmentations; the label top is
+ * ignore_label for the samples without segmentation.
+ */
+template <typename Dtype>
+class SegPoseDataLayer : public ImageSegPoseDataLayer<Dtype> {
+ public:
+  explicit SegPoseDataLayer(const LayerParameter& param)
+    : ImageSegPoseDataLayer<Dtype>(param) {}
+  virtual ~SegPoseDataLayer();
+  virtual void DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  virtual inline const char* type() const { return "SegPoseData"; }
+
+ protected:
+  virtual void PickSample(int item_id);
+  virtual void ReadSample(int item_id, std::vector<cv::Mat>* cv_img_seg,
+      int* img_row, int* img_col);
+  // Moves the cursor to the next record, restarting at the end of the db.
+  void Next();
+
+  shared_ptr<db::DB> db_;
+  shared_ptr<db::Cursor> cursor_;
+  // The records of the batch being loaded.
+  vector<SegPoseDatum> item_datums_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_SEG_POSE_DATA_LAYER_HPP_
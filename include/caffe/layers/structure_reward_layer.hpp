@@ -0,0 +1,79 @@
+#ifndef CAFFE_STRUCTURE_REWARD_LAYER_HPP_
+#define CAFFE_STRUCTURE_REWARD_LAYER_HPP_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/thread_pool.hpp"
+
+#include "caffe/layers/loss_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief The structure-sensitive reward of the self-supervised parsing loss,
+ *        fusing the MaskCreate -> PoseEvaluate -> PoseError -> RewardLoss
+ *        chain into a single pass over the score map.
+ *
+ * The bottoms are the (N x C x H x W) class scores and the (N x 1 x H x W)
+ * ground truth label map. For every image, the joint centers of the argmax
+ * of the scores and of the ground truth are accumulated in the same sweep,
+ * and the top (N x 1 x 1 x 1) holds the reward, i.e. the summed joint
+ * distances normalized as by PoseErrorLayer, times reward_scale.
+ *
+ * As the chain did, the backward pass routes the reward of every image to
+ * the argmax channel of each of its pixels (scaled by the top diff, the loss
+ * weight) and zeroes the other channels.
+ */
+template <typename Dtype>
+class StructureRewardLayer : public LossLayer<Dtype> {
+ public:
+  explicit StructureRewardLayer(const LayerParameter& param)
+      : LossLayer<Dtype>(param) {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  virtual inline const char* type() const { return "StructureReward"; }
+  virtual inline int ExactNumBottomBlobs() const { return 2; }
+  virtual inline int ExactNumTopBlobs() const { return 1; }
+  virtual inline bool AllowForceBackward(const int bottom_index) const {
+    return bottom_index != 1;
+  }
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  // Takes the argmax of the scores and accumulates the joint moments of the
+  // prediction and of the ground truth of image n, then writes its reward.
+  void ForwardImage(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top, int n);
+  void BackwardImage(const vector<Blob<Dtype>*>& top,
+      const vector<Blob<Dtype>*>& bottom, int n);
+
+  int num_joint_;
+  Dtype error_norm_;
+  Dtype reward_scale_;
+  // joint of every class label, num_joint_ for the classes of no joint
+  vector<int> class_joint_;
+  shared_ptr<ThreadPool> thread_pool_;
+  // argmax of the scores, kept for the backward pass
+  Blob<int> argmax_;
+  // per image: count, sum of x and sum of y of the joints and the discarded
+  // pixels, for the prediction then for the ground truth
+  vector<int64_t> moments_;
+  // per image row buffer of the max scores
+  vector<vector<Dtype> > row_max_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_STRUCTURE_REWARD_LAYER_HPP_
@@ -0,0 +1,86 @@
+#ifndef CAFFE_MULTI_SCALE_NET_HPP_
+#define CAFFE_MULTI_SCALE_NET_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Runs a segmentation net on a pyramid of scales of an image and
+ *        fuses the scores of the scales.
+ *
+ * The net takes the image in its single input blob. The image is resized to
+ * every scale, the scales 1/2^k with caffe_cpu_pyramid2 and the others with
+ * caffe_cpu_interp2. Scales of similar sizes are run in one batch, padded
+ * with zeros to the largest of them. The scores of every scale are cropped
+ * to the valid region, resized back to the image and fused by max or mean.
+ *
+ * A net is kept reshaped for each of the last max_cached_nets batch shapes,
+ * all of them sharing the weights of net().
+ */
+template <typename Dtype>
+class MultiScaleNet {
+ public:
+  MultiScaleNet(const NetParameter& param,
+      const MultiScaleParameter& multi_scale_param);
+
+  /// @brief The net holding the weights, e.g. to copy trained layers into.
+  inline const shared_ptr<Net<Dtype> >& net() const { return net_; }
+
+  /**
+   * @brief Computes the fused scores of an image.
+   *
+   * @param image (1 x C x H x W), as the input of the net
+   * @param scores (1 x K x H x W), the fused scores of the K classes
+   */
+  void Forward(const Blob<Dtype>& image, Blob<Dtype>* scores);
+
+  /// @brief Number of forward passes of the nets, one per batch of scales.
+  inline int num_forward() const { return num_forward_; }
+
+ protected:
+  // A batch of scales run by one forward pass.
+  struct ScaleGroup {
+    vector<int> scales;
+    int height, width;
+  };
+
+  // Groups the scales of an image of size (height x width).
+  void GroupScales(int height, int width, vector<ScaleGroup>* groups) const;
+  // Size of an image of size (height x width) at scale s, and its level in
+  // the image pyramid, 0 if the scale is not taken from the pyramid.
+  void ScaledSize(int height, int width, int s, int* scaled_height,
+      int* scaled_width, int* level) const;
+  // Resizes the image to scale s into the top left corner of the
+  // (height x width) input data.
+  void ResizeImage(const Blob<Dtype>& image, int s, int height, int width,
+      Dtype* data);
+  // A net reshaped to take num x channels x height x width inputs.
+  Net<Dtype>* GetNet(int num, int channels, int height, int width);
+
+  MultiScaleParameter param_;
+  NetParameter net_param_;
+  vector<float> scales_;
+  shared_ptr<Net<Dtype> > net_;
+  string score_blob_;
+  // the cached nets and the iteration they were last used
+  vector<shared_ptr<Net<Dtype> > > cached_nets_;
+  vector<int> cached_net_use_;
+  int num_forward_;
+  // the levels of the image pyramid, and the scores of a scale resized to
+  // the image
+  Blob<Dtype> pyramid_;
+  Blob<Dtype> scale_scores_;
+
+  DISABLE_COPY_AND_ASSIGN(MultiScaleNet);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_MULTI_SCALE_NET_HPP_
@@ -0,0 +1,22 @@
+#ifndef CAFFE_UTIL_ARGMAX_H_
+#define CAFFE_UTIL_ARGMAX_H_
+
+namespace caffe {
+
+// Argmax over the channels of count scores laid out as planes stride apart,
+// e.g. a row of a (channels, height, width) map, as ArgMaxLayer computes it
+// (ties go to the larger channel index). The map is swept one channel plane
+// at a time.
+// OUT: max_score[i] and argmax[i] for i in [0, count)
+template <typename Dtype>
+void caffe_cpu_channel_argmax(const int channels, const int count,
+    const int stride, const Dtype* score, Dtype* max_score, int* argmax);
+
+// Folds channel c, of scores score[0, count), into a running argmax.
+template <typename Dtype>
+void caffe_cpu_argmax_update(const int count, const Dtype* score,
+    const int c, Dtype* max_score, int* argmax);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_ARGMAX_H_
@@ -0,0 +1,78 @@
+#ifndef CAFFE_UTIL_ASYNC_WRITER_HPP_
+#define CAFFE_UTIL_ASYNC_WRITER_HPP_
+
+#include <boost/function.hpp>
+
+#include <deque>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/layer.hpp"
+
+/**
+ Forward declare boost::thread instead of including boost/thread.hpp
+ to avoid a boost/NVCC issues (#1009, #1010) on OSX.
+ */
+namespace boost { class thread; }
+
+namespace caffe {
+
+/**
+ * @brief Runs write tasks (e.g. saving a snapshot of a blob) in order on a
+ *        background thread, so that the net does not wait on the disk.
+ *
+ * At most max_pending tasks are queued; Push blocks beyond that, which
+ * bounds the memory of the snapshots. With max_pending == 0 the tasks run
+ * inline in Push.
+ */
+class AsyncWriter {
+ public:
+  explicit AsyncWriter(int max_pending);
+  /// Waits for the pending tasks.
+  ~AsyncWriter();
+
+  void Push(const boost::function<void()>& task);
+  /// Blocks until all the pushed tasks have run.
+  void Flush();
+
+  inline int max_pending() const { return max_pending_; }
+
+ protected:
+  void WriterEntry();
+
+  class sync;
+
+  int max_pending_;
+  std::deque<boost::function<void()> > tasks_;
+  bool busy_;
+  bool stop_;
+  shared_ptr<sync> sync_;
+  shared_ptr<boost::thread> thread_;
+
+DISABLE_COPY_AND_ASSIGN(AsyncWriter);
+};
+
+/**
+ * @brief Implemented by the layers writing their bottoms asynchronously,
+ *        to wait for their pending writes, e.g. at the end of a test.
+ */
+class AsyncOutput {
+ public:
+  virtual ~AsyncOutput() {}
+  virtual void FlushOutput() = 0;
+};
+
+// Flushes the AsyncOutput layers among layers.
+template <typename Dtype>
+void FlushAsyncOutputs(const vector<shared_ptr<Layer<Dtype> > >& layers) {
+  for (int i = 0; i < layers.size(); ++i) {
+    AsyncOutput* output = dynamic_cast<AsyncOutput*>(layers[i].get());
+    if (output) {
+      output->FlushOutput();
+    }
+  }
+}
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_ASYNC_WRITER_HPP_
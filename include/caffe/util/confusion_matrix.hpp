@@ -22,6 +22,8 @@
 #include <vector>
 #include <string>
 
+#include "caffe/proto/caffe.pb.h"
+
 class ConfusionMatrix {
  public:
   //create a m-by-m confusion matrix
@@ -31,6 +33,10 @@ class ConfusionMatrix {
 
   void accumulate(const int actual, const int predicted);
   void accumulate(const ConfusionMatrix& conf);
+
+  // (de)serialize the counts, e.g. to merge the matrices of several workers
+  void toProto(caffe::ConfusionMatrixProto* proto) const;
+  void fromProto(const caffe::ConfusionMatrixProto& proto);
  
   int numRows() const;
   int numCols() const;
@@ -53,11 +59,15 @@ class ConfusionMatrix {
   double accuracy() const;
   double avgPrecision() const;
   double avgRecall(const bool strict = true) const;
+  // mean intersection over union (mIoU)
   double avgJaccard() const;
+  double avgF1Score() const;
  
   double precision(int n) const;
   double recall(int n) const;
+  // intersection over union (IoU) of class n
   double jaccard(int n) const;
+  double f1Score(int n) const;
  
   const unsigned long& operator()(int x, int y) const;
   unsigned long& operator()(int x, int y);
@@ -73,5 +83,32 @@ class ConfusionMatrix {
 
 };
 
+// Partial counts of a confusion matrix, one shard per evaluation thread:
+// every thread fills its own shard without locking and the shards are
+// merged into a ConfusionMatrix once the threads are done.
+class ConfusionMatrixShards {
+ public:
+  ConfusionMatrixShards();
+  ConfusionMatrixShards(const int m, const int num_shards);
+
+  void resize(const int m, const int num_shards);
+  void clear();
+
+  inline void accumulate(const int shard, const int actual,
+                         const int predicted) {
+    ++_shards[shard][actual * _m + predicted];
+  }
+  // m-by-m row major counts of a shard
+  unsigned long* shard(const int shard) { return &_shards[shard][0]; }
+
+  int numShards() const { return (int) _shards.size(); }
+  // adds the counts of all the shards to conf
+  void mergeInto(ConfusionMatrix* conf) const;
+
+ protected:
+  int _m;
+  std::vector< std::vector<unsigned long> > _shards;
+};
+
 
 #endif
@@ -0,0 +1,114 @@
+#ifndef CAFFE_UTIL_DENSECRF_ENGINE_HPP_
+#define CAFFE_UTIL_DENSECRF_ENGINE_HPP_
+
+#include <vector>
+
+#include "caffe/util/densecrf_pairwise.hpp"
+#include "caffe/util/densecrf_util.hpp"
+#include "caffe/util/permutohedral.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Mean-field inference of a fully connected CRF with Gaussian Potts
+ *        potentials on a W x H grid with M labels.
+ *
+ * This is the CRF engine shared by DenseCRFLayer and the offline refiner
+ * (densecrf/refine_pascal_v4). Its interface follows DenseCRF2D of
+ * densecrf/libDenseCRF: the unary energy and the marginals are stored pixel
+ * major, label minor (x0y0l0 x0y0l1 ... x1y0l0 ...), and the potentials are
+ * w * exp(-0.5 * |f_i - f_j|^2) with per pixel normalization.
+ *
+ * The pairwise messages may be filtered on a grid downsampled by an integer
+ * factor and interpolated back. The buffers and the lattice scratch arena
+ * are kept from one Reset to the next, so that one engine processes a
+ * sequence of images without allocating. The engine only depends on the
+ * other DenseCRF utilities, so it builds without the rest of caffe. An
+ * engine must only be used by one thread at a time.
+ */
+class DenseCRFEngine {
+ public:
+  explicit DenseCRFEngine(ExpAccuracy accuracy = EXP_LEGACY,
+      int downsample = 1);
+  ~DenseCRFEngine();
+
+  /// Starts a W x H problem with M labels. Drops the potentials, keeps the
+  /// memory.
+  void Reset(int W, int H, int M);
+
+  /// The unary energy of the current problem, W * H * M values.
+  inline float* unary() { return unary_; }
+  void SetUnaryEnergy(const float* unary);
+
+  /// Positional kernel with standard deviations sx, sy (in pixels).
+  void AddPairwiseGaussian(float sx, float sy, float w);
+  /// Bilateral kernel on an interleaved 3 channel W x H image.
+  void AddPairwiseBilateral(float sx, float sy, float sr, float sg, float sb,
+      const unsigned char* im, float w);
+  /// Potts potential over the D dimensional features of the grid_size()
+  /// nodes of the filtering grid. The potential is owned by the engine.
+  void AddPairwiseEnergy(const float* features, int D, float w);
+  /// Adds a potential built on the filtering grid and owned by the caller
+  /// (e.g. shared through a LatticeCache). It is used until the next Reset.
+  void AddPairwise(const PairwisePotential* potential);
+
+  void StartInference();
+  void StepInference();
+  /// Runs n mean-field iterations and returns the marginals.
+  const float* Inference(int n);
+  /// Runs n mean-field iterations and writes the most likely labels.
+  void Map(int n, short* map);  // NOLINT(runtime/int)
+  void CurrentMap(short* map) const;  // NOLINT(runtime/int)
+
+  /// Marginals after the last step, in the order of the unary.
+  inline const float* current() const { return current_; }
+
+  inline int width() const { return W_; }
+  inline int height() const { return H_; }
+  inline int num_labels() const { return M_; }
+  inline int downsample() const { return downsample_; }
+  inline ExpAccuracy exp_accuracy() const { return accuracy_; }
+
+  /// Filtering grid: node (i, j) of the grid_width() x grid_height() nodes
+  /// is at pixel (i * grid_step_x(), j * grid_step_y()). The grid keeps the
+  /// corner pixels and is the pixel grid when downsample is 1.
+  inline int grid_width() const { return Ws_; }
+  inline int grid_height() const { return Hs_; }
+  inline int grid_size() const { return Ns_; }
+  float grid_step_x() const;
+  float grid_step_y() const;
+
+  /// Scratch memory of the lattices, reset by Reset.
+  inline LatticeArena* arena() { return &arena_; }
+
+ protected:
+  ExpAccuracy accuracy_;
+  int downsample_;
+
+  int W_, H_, N_, M_;
+  int Ws_, Hs_, Ns_;
+
+  std::vector<const PairwisePotential*> pairwise_;
+  std::vector<PairwisePotential*> owned_;
+
+  // capacity (in floats) of the full resolution and of the grid buffers
+  size_t capacity_;
+  size_t small_capacity_;
+  float* unary_;
+  float* current_;
+  float* next_;
+  float* tmp_;
+  float* small_current_;
+  float* small_next_;
+  float* small_tmp_;
+
+  LatticeArena arena_;
+
+ private:
+  DenseCRFEngine(const DenseCRFEngine&);
+  DenseCRFEngine& operator=(const DenseCRFEngine&);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_DENSECRF_ENGINE_HPP_
@@ -6,10 +6,13 @@
 
 #include "caffe/util/permutohedral.hpp"
 
+namespace caffe {
+
 class PairwisePotential {
  public:
   virtual ~PairwisePotential();
-  virtual void apply(float * out_values, const float * in_values, float * tmp, int value_size) const = 0;
+  // arena (optional) provides the scratch memory of the lattice filtering
+  virtual void apply(float * out_values, const float * in_values, float * tmp, int value_size, LatticeArena * arena = NULL) const = 0;
 };
 
 class SemiMetricFunction {
@@ -29,9 +32,9 @@ protected:
   float *norm_;
 public:
   virtual ~PottsPotential();
-  PottsPotential(const float* features, int D, int N, float w, bool per_pixel_normalization=true);
+  PottsPotential(const float* features, int D, int N, float w, bool per_pixel_normalization=true, LatticeArena* arena=NULL);
 
-  virtual void apply(float* out_values, const float* in_values, float* tmp, int value_size) const;
+  virtual void apply(float* out_values, const float* in_values, float* tmp, int value_size, LatticeArena* arena = NULL) const;
 };
 
 class SemiMetricPotential: public PottsPotential{
@@ -39,10 +42,10 @@ protected:
   const SemiMetricFunction * function_;
 public:
   virtual ~SemiMetricPotential();
-  virtual void apply(float* out_values, const float* in_values, float* tmp, int value_size) const;
-  SemiMetricPotential(const float* features, int D, int N, float w, const SemiMetricFunction* function, bool per_pixel_normalization=true);
+  virtual void apply(float* out_values, const float* in_values, float* tmp, int value_size, LatticeArena* arena = NULL) const;
+  SemiMetricPotential(const float* features, int D, int N, float w, const SemiMetricFunction* function, bool per_pixel_normalization=true, LatticeArena* arena=NULL);
 };
 
-
+}  // namespace caffe
 
 #endif
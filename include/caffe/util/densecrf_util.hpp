@@ -30,6 +30,16 @@
 #ifndef _DENSECRF_UTIL_H
 #define _DENSECRF_UTIL_H
 
+#include <cstddef>
+
+#ifdef __SSE__
+#define SSE_DENSE_CRF
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#endif
+
+namespace caffe {
+
 inline float fast_log2 (float val) {
   int * const  exp_ptr = reinterpret_cast <int *> (&val);
   int          x = *exp_ptr;
@@ -105,10 +115,7 @@ inline float fast_exp(float x) {
   }
 }
 
-#ifdef __SSE__
-#define SSE_DENSE_CRF
-#include <emmintrin.h>
-#include <xmmintrin.h>
+#ifdef SSE_DENSE_CRF
 inline __m128 very_fast_exp(__m128 x) {
   return _mm_set1_ps(1)
     -x*(_mm_set1_ps(0.9999999995)
@@ -158,6 +165,19 @@ inline __m128 fast_exp(__m128 x) {
 float* allocate ( size_t N ) ;
 void deallocate ( float *& ptr ) ;
 
+// Exponential used by expAndNormalize
+enum ExpAccuracy {
+  EXP_LEGACY   = 0,  // scalar fast_exp, one pass per step (original code)
+  EXP_FAST     = 1,  // vectorized polynomial, rel. error ~1e-3
+  EXP_ACCURATE = 2   // vectorized polynomial, rel. error ~1e-7
+};
+
+// out = softmax( scale*in ) for each of the N rows of M values.
+// If next is given, each row of next is set to -unary right after the row of
+// in has been consumed (next may alias in). This fuses the unary term of the
+// following mean-field step into the same pass over the data.
+void expAndNormalize ( float* out, const float* in, float scale, int N, int M, ExpAccuracy accuracy, float* next = NULL, const float* unary = NULL ) ;
 
+}  // namespace caffe
 
 #endif
@@ -0,0 +1,120 @@
+#ifndef CAFFE_UTIL_FEATURE_FILE_HPP_
+#define CAFFE_UTIL_FEATURE_FILE_HPP_
+
+#include <stdint.h>
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * A feature file stores a sequence of named blobs (e.g. the score maps of a
+ * test set, one record per image) in a single file:
+ *
+ *   header  : magic "CAFFEFT1", uint64 number of records, uint64 offset of
+ *             the index
+ *   data    : the raw blobs, each aligned to kFeatureFileAlignment bytes
+ *   index   : for each record, uint32 name length, name, uint32 type,
+ *             uint32 number of axes, int32 shape[axes], uint64 data offset
+ *
+ * All the values are in host byte order. The index is at the end so that
+ * the writer streams the data, and it is rewritten by every Flush. The file
+ * may be opened while it is written: it then holds the records of the last
+ * Flush, or none if records were appended since.
+ */
+enum FeatureFileType {
+  FEATURE_FILE_FLOAT = 0,
+  FEATURE_FILE_DOUBLE = 1
+};
+
+const int kFeatureFileAlignment = 64;
+
+class FeatureFileWriter {
+ public:
+  /// Creates (truncates) filename.
+  explicit FeatureFileWriter(const string& filename);
+  /// Flushes and closes the file.
+  ~FeatureFileWriter();
+
+  /// Appends a record, which is readable after the next Flush. The records
+  /// of the previous Flush are not readable in between.
+  template <typename Dtype>
+  void Append(const string& name, const Blob<Dtype>& blob);
+  /// Writes the index, making the records appended so far readable.
+  void Flush();
+
+  inline int num_records() const { return names_.size(); }
+  inline const string& filename() const { return filename_; }
+
+ protected:
+  void Write(const void* data, size_t size);
+
+  string filename_;
+  FILE* file_;
+  uint64_t data_end_;
+  // whether the header points at an index written at data_end_
+  bool index_written_;
+  vector<string> names_;
+  vector<uint32_t> types_;
+  vector<vector<int> > shapes_;
+  vector<uint64_t> offsets_;
+
+DISABLE_COPY_AND_ASSIGN(FeatureFileWriter);
+};
+
+/**
+ * @brief Memory maps a feature file for reading.
+ *
+ * Read can point a blob at the mapped record without copying it when the
+ * types match. The mapping is private, so writing to such a blob never
+ * modifies the file, but the change is seen by later reads of the record
+ * through the same FeatureFile. The blob must not be used after the
+ * FeatureFile is destroyed.
+ */
+class FeatureFile {
+ public:
+  explicit FeatureFile(const string& filename);
+  ~FeatureFile();
+
+  inline int num_records() const { return names_.size(); }
+  inline const string& name(int i) const { return names_[i]; }
+  inline const vector<int>& shape(int i) const { return shapes_[i]; }
+  inline const string& filename() const { return filename_; }
+  /// The index of the record called name, or -1.
+  int Find(const string& name) const;
+
+  /// Reshapes blob to record i and sets its data, without copying it if
+  /// zero_copy is set and the types match. A blob read without copy must
+  /// not be read with copy afterwards, which would write to the mapping.
+  template <typename Dtype>
+  void Read(int i, Blob<Dtype>* blob, bool zero_copy = false);
+  /// Copies record i to data, converting the type if needed.
+  template <typename Dtype>
+  void Copy(int i, Dtype* data) const;
+  /// Asks the kernel to start paging in record i.
+  void WillNeed(int i) const;
+
+ protected:
+  size_t RecordBytes(int i) const;
+
+  string filename_;
+  char* map_;
+  size_t size_;
+  vector<string> names_;
+  vector<uint32_t> types_;
+  vector<vector<int> > shapes_;
+  vector<uint64_t> offsets_;
+  std::map<string, int> index_;
+
+DISABLE_COPY_AND_ASSIGN(FeatureFile);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_FEATURE_FILE_HPP_
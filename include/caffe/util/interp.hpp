@@ -22,6 +22,15 @@ void caffe_gpu_interp2(const int channels,
     const Dtype *data1, const int x1, const int y1, const int height1, const int width1, const int Height1, const int Width1,
           Dtype *data2, const int x2, const int y2, const int height2, const int width2, const int Height2, const int Width2);
 
+// Rows [h2_begin, h2_end) of the planar caffe_cpu_interp2 output of size
+// [channels height2 width2], e.g. to consume the interpolation a few rows at
+// a time without materializing it.
+// OUT: [channels (h2_end - h2_begin) width2]
+template <typename Dtype>
+void caffe_cpu_interp2_rows(const int channels,
+    const Dtype *data1, const int x1, const int y1, const int height1, const int width1, const int Height1, const int Width1,
+          Dtype *data2, const int height2, const int width2, const int h2_begin, const int h2_end);
+
 // Backward (adjoint) operation
 template <typename Dtype, bool packed>
 void caffe_cpu_interp2_backward(const int channels,
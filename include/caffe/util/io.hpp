@@ -5,6 +5,7 @@
 #include <iomanip>
 #include <iostream>  // NOLINT(readability/streams)
 #include <string>
+#include <vector>
 
 #include "google/protobuf/message.h"
 
@@ -142,6 +143,16 @@ cv::Mat ReadImageToCVMat(const string& filename,
 
 cv::Mat ReadImageToCVMat(const string& filename);
 
+// Same as ReadImageToCVMat, from the content of an image file.
+cv::Mat DecodeImageToCVMat(const string& buffer,
+    const int height, const int width, const bool is_color,
+    int* img_height = NULL, int* img_width = NULL, const bool seg = false);
+
+// Packs an image file, its segmentation file (none if seg_file is empty) and
+// its pose into datum, still encoded, as read by the SegPoseData layer.
+bool ReadSegPoseToDatum(const string& image_file, const string& seg_file,
+    const vector<float>& pose, SegPoseDatum* datum);
+
 cv::Mat DecodeDatumToCVMatNative(const Datum& datum);
 cv::Mat DecodeDatumToCVMat(const Datum& datum, bool is_color);
 
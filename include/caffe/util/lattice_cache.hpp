@@ -0,0 +1,79 @@
+#ifndef CAFFE_UTIL_LATTICE_CACHE_HPP_
+#define CAFFE_UTIL_LATTICE_CACHE_HPP_
+
+#include <stdint.h>
+
+#include <map>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/densecrf_pairwise.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Keeps the most recently used Potts potentials (a permutohedral
+ *        lattice plus its normalization) so that a DenseCRF kernel is not
+ *        rebuilt for an image and feature configuration seen before.
+ *
+ * Building the lattice (Permutohedral::init) is dominated by hash table
+ * work and allocations, while a cached potential can be applied by any
+ * number of threads at once. An entry keeps a copy of the features its
+ * lattice was built from, and is only returned for the same features, so
+ * that a collision of the checksums never reuses the wrong lattice. Thread
+ * safe.
+ */
+class LatticeCache {
+ public:
+  /// Identifies the features a lattice was built from.
+  struct Key {
+    int dim;            // 2 for positional, 5 for bilateral kernels
+    int num_points;     // number of feature vectors
+    float weight;
+    uint64_t checksum;  // Hash of the dim * num_points features
+
+    bool operator<(const Key& other) const;
+  };
+
+  /// capacity is the max number of potentials kept alive by the cache.
+  explicit LatticeCache(int capacity);
+
+  /// Returns the potential cached for key and built from features, or an
+  /// empty pointer on a miss.
+  shared_ptr<PairwisePotential> Get(const Key& key, const float* features);
+  /// Adds a potential built from features, evicting the least recently used
+  /// one when full.
+  void Put(const Key& key, const float* features,
+      const shared_ptr<PairwisePotential>& potential);
+
+  /// FNV-1a hash of a byte range, used as the checksum of the features.
+  static uint64_t Hash(const void* data, size_t size,
+      uint64_t seed = 14695981039346656037ULL);
+
+  inline int capacity() const { return capacity_; }
+  int size() const;
+  int hits() const;
+  int misses() const;
+
+ protected:
+  struct Entry {
+    shared_ptr<PairwisePotential> potential;
+    vector<float> features;
+    uint64_t last_use;
+  };
+
+  class sync;
+
+  int capacity_;
+  std::map<Key, Entry> entries_;
+  uint64_t clock_;
+  int hits_;
+  int misses_;
+  shared_ptr<sync> sync_;
+
+DISABLE_COPY_AND_ASSIGN(LatticeCache);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_LATTICE_CACHE_HPP_
@@ -16,9 +16,10 @@ using ::google::protobuf::Message;
 template <typename Dtype>
 void ReadBlobFromMat(const char *fname, Blob<Dtype>* blob);
 
+// compress selects zlib compression of the saved variables.
 template <typename Dtype>
 void WriteBlobToMat(const char *fname, bool write_diff,
-   Blob<Dtype>* blob);
+   Blob<Dtype>* blob, bool compress = false);
 
 }  // namespace caffe
 
@@ -41,6 +41,7 @@
 #include <cassert>
 #include <cstdio>
 #include <cmath>
+#include <vector>
 
 #ifdef __SSE__
 // SSE Permutohedral lattice
@@ -55,7 +56,55 @@
 # endif
 #endif
 
+// Wider AVX2 / AVX-512 kernels are compiled with per-function target
+// attributes and selected at runtime, so the rest of the build does not
+// need -mavx2 / -mavx512f.
+#if defined(SSE_PERMUTOHEDRAL) && (defined(__x86_64__) || defined(__i386__)) \
+    && (defined(__clang__) || __GNUC__ > 4 || \
+        (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+# define DISPATCH_PERMUTOHEDRAL
+#endif
 
+namespace caffe {
+
+/************************************************/
+/***             Scratch Arena                ***/
+/************************************************/
+
+// Reusable scratch memory for the lattice hash table and the splat/blur
+// buffers. Requests are rounded up to power-of-two size classes and freed
+// blocks go to a per-class free list, so the hash table growing and the
+// buffers of consecutive compute() calls recycle the same memory. reset()
+// invalidates every allocation but keeps the memory: blocks are merged into
+// a single one sized for the largest image seen so far.
+// An arena must only be used by one thread at a time.
+class LatticeArena {
+ public:
+  LatticeArena();
+  ~LatticeArena();
+
+  void* allocate(size_t size);
+  void deallocate(void* ptr, size_t size);
+  void reset();
+
+  // Bytes currently reserved from the system
+  size_t capacity() const;
+
+ protected:
+  static const int NUM_CLASSES = 48;
+  static const int MIN_CLASS = 6;  // 64 bytes, keeps AVX-512 alignment
+  static int size_class(size_t size);
+
+  struct Block {
+    char* data;
+    size_t size, used;
+  };
+  std::vector<Block> blocks_;
+  void* free_[NUM_CLASSES];
+ private:
+  LatticeArena( const LatticeArena& );
+  LatticeArena& operator=( const LatticeArena& );
+};
 
 /************************************************/
 /***          Permutohedral Lattice           ***/
@@ -74,18 +123,32 @@ class Permutohedral {
   // Number of elements, size of sparse discretized space, dimension of features
   int N_, M_, d_;
  public:
+  // Instruction sets compute() can be dispatched to at runtime.
+  // ISA_DEFAULT is the path selected at compile time (SSE or scalar).
+  enum Isa { ISA_DEFAULT = 0, ISA_AVX2 = 1, ISA_AVX512 = 2 };
+
   Permutohedral();
   virtual ~Permutohedral();
 
-  void init(const float* feature, int feature_size, int N);
+  // Best instruction set supported by both the build and the running cpu.
+  static Isa supported_isa();
+  // Limits the instruction set used by compute() (e.g. for benchmarking).
+  static void set_max_isa(Isa isa);
+  // Instruction set compute() currently uses.
+  static Isa isa();
+
+  // The optional arena provides the temporary memory of init() and
+  // compute(); the lattice itself is always owned by this object.
+  void init(const float* feature, int feature_size, int N, LatticeArena* arena = NULL);
 
 #ifdef SSE_PERMUTOHEDRAL
   void compute(__m128* out, const __m128* in, int value_size, int in_offset = 0, int out_offset = 0, int in_size = -1, int out_size = -1) const;
  #endif
  
-  void compute(float* out, const float* in, int value_size, int in_offset = 0, int out_offset = 0, int in_size = -1, int out_size = -1) const;
+  void compute(float* out, const float* in, int value_size, int in_offset = 0, int out_offset = 0, int in_size = -1, int out_size = -1, LatticeArena* arena = NULL) const;
 
 };
 
+}  // namespace caffe
 
 #endif
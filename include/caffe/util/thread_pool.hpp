@@ -0,0 +1,60 @@
+#ifndef CAFFE_UTIL_THREAD_POOL_HPP_
+#define CAFFE_UTIL_THREAD_POOL_HPP_
+
+#include <boost/function.hpp>
+
+#include <vector>
+
+#include "caffe/common.hpp"
+
+/**
+ Forward declare boost::thread instead of including boost/thread.hpp
+ to avoid a boost/NVCC issues (#1009, #1010) on OSX.
+ */
+namespace boost { class thread; }
+
+namespace caffe {
+
+/**
+ * @brief A fixed-size pool of worker threads used to split CPU layer work
+ *        (e.g. the images of a batch) across cores.
+ *
+ * The calling thread takes part in the work, so a pool of size one runs
+ * every task inline and spawns no thread at all.
+ */
+class ThreadPool {
+ public:
+  /// num_threads <= 0 selects the number of hardware threads.
+  explicit ThreadPool(int num_threads);
+  ~ThreadPool();
+
+  /// Calls task(i) for every i in [0, num_tasks) and blocks until all of
+  /// them have returned. Tasks must not call Run on the same pool.
+  void Run(int num_tasks, const boost::function<void(int)>& task);
+
+  inline int num_threads() const { return num_threads_; }
+
+  /// Resolves a user supplied thread count (<= 0 meaning "all cores").
+  static int ResolveNumThreads(int num_threads);
+
+ protected:
+  void WorkerEntry();
+
+  class sync;
+
+  int num_threads_;
+  std::vector<shared_ptr<boost::thread> > workers_;
+  shared_ptr<sync> sync_;
+
+  const boost::function<void(int)>* task_;
+  int num_tasks_;
+  int next_task_;
+  int remaining_;
+  bool stop_;
+
+DISABLE_COPY_AND_ASSIGN(ThreadPool);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_THREAD_POOL_HPP_
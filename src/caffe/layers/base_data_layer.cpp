@@ -1,4 +1,6 @@
 #include <boost/thread.hpp>
+#include <algorithm>
+#include <sstream>
 #include <vector>
 
 #include "caffe/blob.hpp"
@@ -7,6 +9,7 @@
 #include "caffe/layer.hpp"
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
 #include "caffe/util/blocking_queue.hpp"
 
 namespace caffe {
@@ -34,12 +37,50 @@ void BaseDataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
 
 template <typename Dtype>
 BasePrefetchingDataLayer<Dtype>::BasePrefetchingDataLayer(
-    const LayerParameter& param)
+    const LayerParameter& param, int prefetch_count)
     : BaseDataLayer<Dtype>(param),
-      prefetch_free_(), prefetch_full_() {
-  for (int i = 0; i < PREFETCH_COUNT; ++i) {
-    prefetch_free_.push(&prefetch_[i]);
+      prefetch_(param.has_prefetch_param() ?
+                param.prefetch_param().depth() : prefetch_count),
+      prefetch_free_(), prefetch_full_(), stats_mutex_(new boost::mutex()) {
+  CHECK_GT(prefetch_.size(), 0) << "At least one batch should be prefetched.";
+  for (int i = 0; i < prefetch_.size(); ++i) {
+    prefetch_[i].reset(new Batch<Dtype>());
+    prefetch_free_.push(prefetch_[i].get());
   }
+  ResetPrefetchStats();
+}
+
+template <typename Dtype>
+PrefetchStats BasePrefetchingDataLayer<Dtype>::prefetch_stats() const {
+  boost::mutex::scoped_lock lock(*stats_mutex_);
+  return prefetch_stats_;
+}
+
+template <typename Dtype>
+void BasePrefetchingDataLayer<Dtype>::ResetPrefetchStats() {
+  boost::mutex::scoped_lock lock(*stats_mutex_);
+  prefetch_stats_.Clear();
+  for (int i = 0; i <= prefetch_.size(); ++i) {
+    prefetch_stats_.add_occupancy(0);
+  }
+}
+
+template <typename Dtype>
+Batch<Dtype>* BasePrefetchingDataLayer<Dtype>::PopFullBatch() {
+  const int queued = std::min<int>(prefetch_full_.size(), prefetch_.size());
+  CPUTimer timer;
+  timer.Start();
+  Batch<Dtype>* batch = prefetch_full_.pop("Data layer prefetch queue empty");
+  boost::mutex::scoped_lock lock(*stats_mutex_);
+  prefetch_stats_.set_consumer_wait_us(prefetch_stats_.consumer_wait_us() +
+                                       timer.MicroSeconds());
+  prefetch_stats_.set_batches(prefetch_stats_.batches() + 1);
+  prefetch_stats_.set_producer_wait_us(prefetch_stats_.producer_wait_us() +
+                                       batch->wait_us_);
+  prefetch_stats_.set_load_us(prefetch_stats_.load_us() + batch->load_us_);
+  prefetch_stats_.set_occupancy(queued,
+                                prefetch_stats_.occupancy(queued) + 1);
+  return batch;
 }
 
 template <typename Dtype>
@@ -50,18 +91,18 @@ void BasePrefetchingDataLayer<Dtype>::LayerSetUp(
   // calls so that the prefetch thread does not accidentally make simultaneous
   // cudaMalloc calls when the main thread is running. In some GPUs this
   // seems to cause failures if we do not so.
-  for (int i = 0; i < PREFETCH_COUNT; ++i) {
-    prefetch_[i].data_.mutable_cpu_data();
+  for (int i = 0; i < prefetch_.size(); ++i) {
+    prefetch_[i]->data_.mutable_cpu_data();
     if (this->output_labels_) {
-      prefetch_[i].label_.mutable_cpu_data();
+      prefetch_[i]->label_.mutable_cpu_data();
     }
   }
 #ifndef CPU_ONLY
   if (Caffe::mode() == Caffe::GPU) {
-    for (int i = 0; i < PREFETCH_COUNT; ++i) {
-      prefetch_[i].data_.mutable_gpu_data();
+    for (int i = 0; i < prefetch_.size(); ++i) {
+      prefetch_[i]->data_.mutable_gpu_data();
       if (this->output_labels_) {
-        prefetch_[i].label_.mutable_gpu_data();
+        prefetch_[i]->label_.mutable_gpu_data();
       }
     }
   }
@@ -82,9 +123,14 @@ void BasePrefetchingDataLayer<Dtype>::InternalThreadEntry() {
 #endif
 
   try {
+    CPUTimer timer;
     while (!must_stop()) {
+      timer.Start();
       Batch<Dtype>* batch = prefetch_free_.pop();
+      batch->wait_us_ = timer.MicroSeconds();
+      timer.Start();
       load_batch(batch);
+      batch->load_us_ = timer.MicroSeconds();
 #ifndef CPU_ONLY
       if (Caffe::mode() == Caffe::GPU) {
         batch->data_.data().get()->async_gpu_push(stream);
@@ -106,7 +152,7 @@ void BasePrefetchingDataLayer<Dtype>::InternalThreadEntry() {
 template <typename Dtype>
 void BasePrefetchingDataLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  Batch<Dtype>* batch = prefetch_full_.pop("Data layer prefetch queue empty");
+  Batch<Dtype>* batch = PopFullBatch();
   // Reshape to loaded data.
   top[0]->ReshapeLike(batch->data_);
   // Copy the data
@@ -133,24 +179,24 @@ void ImageDimPrefetchingDataLayer<Dtype>::LayerSetUp(
   } else {
     output_data_dim_ = false;
   }
-  for (int i = 0; i < BasePrefetchingDataLayer<Dtype>::PREFETCH_COUNT; ++i) {
-    this->prefetch_[i].data_.mutable_cpu_data();
+  for (int i = 0; i < this->prefetch_.size(); ++i) {
+    this->prefetch_[i]->data_.mutable_cpu_data();
     if (this->output_labels_) {
-      this->prefetch_[i].label_.mutable_cpu_data();
+      this->prefetch_[i]->label_.mutable_cpu_data();
     }
     if (output_data_dim_) {
-      this->prefetch_[i].dim_.mutable_cpu_data();
+      this->prefetch_[i]->dim_.mutable_cpu_data();
     }
   }
 #ifndef CPU_ONLY
   if (Caffe::mode() == Caffe::GPU) {
-    for (int i = 0; i < BasePrefetchingDataLayer<Dtype>::PREFETCH_COUNT; ++i) {
-      this->prefetch_[i].data_.mutable_gpu_data();
+    for (int i = 0; i < this->prefetch_.size(); ++i) {
+      this->prefetch_[i]->data_.mutable_gpu_data();
       if (this->output_labels_) {
-        this->prefetch_[i].label_.mutable_gpu_data();
+        this->prefetch_[i]->label_.mutable_gpu_data();
       }
       if (output_data_dim_) {
-	this->prefetch_[i].dim_.mutable_gpu_data();
+	this->prefetch_[i]->dim_.mutable_gpu_data();
       }
     }
   }
@@ -164,8 +210,7 @@ void ImageDimPrefetchingDataLayer<Dtype>::LayerSetUp(
 template <typename Dtype>
 void ImageDimPrefetchingDataLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  Batch<Dtype>* batch = 
-    this->prefetch_full_.pop("Data layer prefetch queue empty");
+  Batch<Dtype>* batch = this->PopFullBatch();
   // Reshape to loaded data.
   top[0]->ReshapeLike(batch->data_);
   // Copy the data
@@ -188,6 +233,45 @@ void ImageDimPrefetchingDataLayer<Dtype>::Forward_cpu(
   this->prefetch_free_.push(batch);
 }
 
+template <typename Dtype>
+void LogPrefetchStats(const vector<shared_ptr<Layer<Dtype> > >& layers,
+    bool reset) {
+  int num_data_layers = 0;
+  double consumer_wait_us = 0;
+  for (int i = 0; i < layers.size(); ++i) {
+    BasePrefetchingDataLayer<Dtype>* layer =
+        dynamic_cast<BasePrefetchingDataLayer<Dtype>*>(layers[i].get());
+    if (!layer) {
+      continue;
+    }
+    const PrefetchStats stats = layer->prefetch_stats();
+    if (stats.batches() == 0) {
+      continue;
+    }
+    const double batches = stats.batches();
+    std::ostringstream occupancy;
+    for (int k = 0; k < stats.occupancy_size(); ++k) {
+      occupancy << " " << k << ":" << stats.occupancy(k);
+    }
+    LOG(INFO) << "    Prefetch " << layer->layer_param().name() << ": "
+              << stats.batches() << " batches, net waited "
+              << stats.consumer_wait_us() / 1000 / batches
+              << " ms/batch, loading " << stats.load_us() / 1000 / batches
+              << " ms/batch, prefetch thread waited "
+              << stats.producer_wait_us() / 1000 / batches
+              << " ms/batch, queued batches" << occupancy.str();
+    ++num_data_layers;
+    consumer_wait_us += stats.consumer_wait_us();
+    if (reset) {
+      layer->ResetPrefetchStats();
+    }
+  }
+  if (num_data_layers > 1) {
+    LOG(INFO) << "    Prefetch total: net waited "
+              << consumer_wait_us / 1000 << " ms on " << num_data_layers
+              << " data layers";
+  }
+}
 
 #ifdef CPU_ONLY
 STUB_GPU_FORWARD(BasePrefetchingDataLayer, Forward);
@@ -197,4 +281,9 @@ STUB_GPU_FORWARD(ImageDimPrefetchingDataLayer, Forward);
 INSTANTIATE_CLASS(BaseDataLayer);
 INSTANTIATE_CLASS(BasePrefetchingDataLayer);
 INSTANTIATE_CLASS(ImageDimPrefetchingDataLayer);
+
+template void LogPrefetchStats<float>(
+    const vector<shared_ptr<Layer<float> > >& layers, bool reset);
+template void LogPrefetchStats<double>(
+    const vector<shared_ptr<Layer<double> > >& layers, bool reset);
 }  // namespace caffe
@@ -20,6 +20,8 @@
 #include <opencv2/highgui/highgui_c.h>
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include <boost/bind.hpp>
+
 #include "caffe/layers/data_heatmap.hpp"
 #include "caffe/util/benchmark.hpp"
 #include <unistd.h>
@@ -72,8 +74,8 @@ void DataHeatmapLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
     // init data
     this->transformed_data_.Reshape(batchsize, 1, 1, 1);
     top[0]->Reshape(batchsize, 1, 1, 1);
-    for (int i = 0; i < this->PREFETCH_COUNT; ++i)
-        this->prefetch_[i].data_.Reshape(batchsize, 1, 1, 1);
+    for (int i = 0; i < this->prefetch_.size(); ++i)
+        this->prefetch_[i]->data_.Reshape(batchsize, 1, 1, 1);
     this->datum_size_ = 1 * 1 * 1;
 
     // init label
@@ -82,13 +84,24 @@ void DataHeatmapLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
     label_num_channels = img_label_list_[0].second.size();
     label_num_channels /= 2;
     top[1]->Reshape(label_batchsize, label_num_channels, label_height, label_width);
-    for (int i = 0; i < this->PREFETCH_COUNT; ++i)
-        this->prefetch_[i].label_.Reshape(label_batchsize, label_num_channels, label_height, label_width);
+    for (int i = 0; i < this->prefetch_.size(); ++i)
+        this->prefetch_[i]->label_.Reshape(label_batchsize, label_num_channels, label_height, label_width);
 
     LOG(INFO) << "output data size: " << top[0]->num() << "," << top[0]->channels() << "," << top[0]->height() << "," << top[0]->width();
     LOG(INFO) << "output label size: " << top[1]->num() << "," << top[1]->channels() << "," << top[1]->height() << "," << top[1]->width();
     LOG(INFO) << "number of label channels: " << label_num_channels;
     LOG(INFO) << "datum channels: " << this->datum_channels_;
+
+    cur_img_ = 0;
+    item_img_.resize(batchsize);
+    item_size_.resize(batchsize);
+    if (heatmap_data_param.cache_images()) {
+        img_size_cache_.resize(img_label_list_.size());
+    }
+    decode_pool_.reset(new ThreadPool(heatmap_data_param.num_threads()));
+    LOG(INFO) << "Loading with " << decode_pool_->num_threads()
+              << " threads, " << this->prefetch_.size()
+              << " batches ahead";
 }
 
 template<typename Dtype>
@@ -97,81 +110,104 @@ void DataHeatmapLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
     CPUTimer batch_timer;
     batch_timer.Start();
     CHECK(batch->data_.count());
+
+    // Make sure the batch is on cpu before the decode threads access it.
+    batch->data_.mutable_cpu_data();
+    batch->label_.mutable_cpu_data();
+
+    // Pick the images in order, then load them in parallel.
+    const int batchsize = item_img_.size();
+    for (int idx_img = 0; idx_img < batchsize; idx_img++) {
+        item_img_[idx_img] = cur_img_;
+        this->AdvanceCurImg();
+    }
+    decode_pool_->Run(batchsize,
+        boost::bind(&DataHeatmapLayer<Dtype>::LoadSample, this, batch, _1));
+
+    if (!img_size_cache_.empty()) {
+        for (int idx_img = 0; idx_img < batchsize; idx_img++) {
+            img_size_cache_[item_img_[idx_img]] = item_size_[idx_img];
+        }
+    }
+
+    batch_timer.Stop();
+    DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
+}
+
+template<typename Dtype>
+void DataHeatmapLayer<Dtype>::LoadSample(Batch<Dtype>* batch, int idx_img) {
     HeatmapDataParameter heatmap_data_param = this->layer_param_.heatmap_data_param();
 
     // Pointers to blobs' float data
     Dtype* top_data = batch->data_.mutable_cpu_data();
     Dtype* top_label = batch->label_.mutable_cpu_data();
 
-    cv::Mat img;
     // Shortcuts to params
-
-    const int batchsize = heatmap_data_param.batchsize();
     const int label_height = heatmap_data_param.label_height();
     const int label_width = heatmap_data_param.label_width();
     const int outsize = heatmap_data_param.outsize();
-    
-    // collect "batchsize" images
-    std::vector<float> cur_label;
-    std::string img_name;
 
-    // loop over non-augmented images
-    for (int idx_img = 0; idx_img < batchsize; idx_img++) {
-        // get image name and class
-        this->GetCurImg(img_name, cur_label);
+    // get image name and class
+    const std::string& img_name = img_label_list_[item_img_[idx_img]].first;
+    std::vector<float> cur_label = img_label_list_[item_img_[idx_img]].second;
 
-        // get number of channels for image label
-        int label_num_channels = cur_label.size();
+    // get number of channels for image label
+    int label_num_channels = cur_label.size();
 
+    // only the size of the image is used
+    cv::Size img_size;
+    if (!img_size_cache_.empty()) {
+        img_size = img_size_cache_[item_img_[idx_img]];
+    }
+    if (img_size.area() == 0) {
         std::string img_path = this->root_img_dir_ + img_name;
         DLOG(INFO) << "img: " << img_path;
-        img = cv::imread(img_path, CV_LOAD_IMAGE_COLOR);
-        int width = img.cols;
-        int height = img.rows;
-        float resizeFact_x = (float)outsize / (float)width;
-        float resizeFact_y = (float)outsize / (float)height;
-        // LOG(INFO) << "width: " << width;
-        const int idx_img_aug = idx_img;
-        // resize to output image size
-
-        // "resize" annotations
-        for (int i = 0; i < label_num_channels; i += 2) {
-            cur_label[i] *= resizeFact_x;
-            cur_label[i + 1] *= resizeFact_y;
+        cv::Mat img = cv::imread(img_path, CV_LOAD_IMAGE_COLOR);
+        CHECK(img.data) << "Could not load " << img_path;
+        img_size = img.size();
+    }
+    item_size_[idx_img] = img_size;
+    int width = img_size.width;
+    int height = img_size.height;
+    float resizeFact_x = (float)outsize / (float)width;
+    float resizeFact_y = (float)outsize / (float)height;
+    const int idx_img_aug = idx_img;
+
+    // "resize" annotations
+    for (int i = 0; i < label_num_channels; i += 2) {
+        cur_label[i] *= resizeFact_x;
+        cur_label[i + 1] *= resizeFact_y;
+    }
+    // store image data
+    top_data[idx_img] = 1;
+
+    // store label as gaussian
+    const int label_channel_size = label_height * label_width;
+    const int label_img_size = label_channel_size * label_num_channels / 2;
+    float label_resize_fact = (float) label_height / (float) outsize;
+    float sigma = 1.5;
+    const float peak = 4 * ( 1 / ( sigma * sqrt(2 * M_PI) ) );
+
+    // The Gaussian is separable: the map is the outer product of the
+    // Gaussians of the rows and of the columns.
+    std::vector<float> gaussian_y(label_height), gaussian_x(label_width);
+    for (int idx_ch = 0; idx_ch < label_num_channels / 2; idx_ch++) {
+        float x = label_resize_fact * cur_label[2 * idx_ch];
+        float y = label_resize_fact * cur_label[2 * idx_ch + 1];
+        for (int i = 0; i < label_height; i++) {
+            gaussian_y[i] = peak * exp( -0.5 * pow(i - y, 2.0) * pow(1 / sigma, 2.0) );
+        }
+        for (int j = 0; j < label_width; j++) {
+            gaussian_x[j] = exp( -0.5 * pow(j - x, 2.0) * pow(1 / sigma, 2.0) );
         }
-        // store image data
-        DLOG(INFO) << "storing image";
-
-        top_data[idx_img] = 1;
-
-        // store label as gaussian
-        DLOG(INFO) << "storing labels";
-        const int label_channel_size = label_height * label_width;
-        const int label_img_size = label_channel_size * label_num_channels / 2;
-        cv::Mat dataMatrix = cv::Mat::zeros(label_height, label_width, CV_32FC1);
-        float label_resize_fact = (float) label_height / (float) outsize;
-        float sigma = 1.5;
-
-        for (int idx_ch = 0; idx_ch < label_num_channels / 2; idx_ch++) {
-            float x = label_resize_fact * cur_label[2 * idx_ch];
-            float y = label_resize_fact * cur_label[2 * idx_ch + 1];
-            for (int i = 0; i < label_height; i++) {
-                for (int j = 0; j < label_width; j++) {
-                    int label_idx = idx_img_aug * label_img_size + idx_ch * label_channel_size + i * label_height + j;
-                    float gaussian = ( 1 / ( sigma * sqrt(2 * M_PI) ) ) * exp( -0.5 * ( pow(i - y, 2.0) + pow(j - x, 2.0) ) * pow(1 / sigma, 2.0) );
-                    gaussian = 4 * gaussian;
-                    top_label[label_idx] = gaussian;
-                    if (idx_ch == 0)
-                        dataMatrix.at<float>((int)j, (int)i) = gaussian;
-                }
+        Dtype* label_map = top_label + idx_img_aug * label_img_size + idx_ch * label_channel_size;
+        for (int i = 0; i < label_height; i++) {
+            Dtype* label_row = label_map + i * label_width;
+            for (int j = 0; j < label_width; j++) {
+                label_row[j] = gaussian_y[i] * gaussian_x[j];
             }
         }
-        // move to the next image
-        this->AdvanceCurImg();
-    } // original image loop
-
-    batch_timer.Stop();
-    DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
+    }
 }
 
 template<typename Dtype>
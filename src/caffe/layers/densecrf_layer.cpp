@@ -1,3 +1,5 @@
+#include <boost/bind.hpp>
+
 #include <algorithm>
 #include <vector>
 #include <cfloat>
@@ -6,6 +8,7 @@
 #include "caffe/layers/densecrf_layer.hpp"
 #include "caffe/util/densecrf_util.hpp"
 #include "caffe/util/densecrf_pairwise.hpp"
+#include "caffe/util/interp.hpp"
 #include "caffe/util/math_functions.hpp"
 
 // TODO: Add SemiMetricFunction
@@ -41,6 +44,31 @@ void DenseCRFLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     << "bi_w and bi_xy_std should have the same size.";
   CHECK_EQ(bi_w_.size(), bi_rgb_std_.size())
     << "bi_w and bi_rgb_std should have the same size.";
+
+  // kernels with the same features share one lattice: sum their weights
+  for (size_t k = 0; k < pos_w_.size(); ++k) {
+    for (size_t l = k + 1; l < pos_w_.size(); ) {
+      if (pos_xy_std_[l] == pos_xy_std_[k]) {
+	pos_w_[k] += pos_w_[l];
+	pos_w_.erase(pos_w_.begin() + l);
+	pos_xy_std_.erase(pos_xy_std_.begin() + l);
+      } else {
+	++l;
+      }
+    }
+  }
+  for (size_t k = 0; k < bi_w_.size(); ++k) {
+    for (size_t l = k + 1; l < bi_w_.size(); ) {
+      if (bi_xy_std_[l] == bi_xy_std_[k] && bi_rgb_std_[l] == bi_rgb_std_[k]) {
+	bi_w_[k] += bi_w_[l];
+	bi_w_.erase(bi_w_.begin() + l);
+	bi_xy_std_.erase(bi_xy_std_.begin() + l);
+	bi_rgb_std_.erase(bi_rgb_std_.begin() + l);
+      } else {
+	++l;
+      }
+    }
+  }
   
   CHECK_GE(bottom.size(), 2) 
     << "bottom must have size larger than 2 (i.e., DCNN output and image dim).";
@@ -56,14 +84,18 @@ void DenseCRFLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       << "Can Only support color images for now.";
   }
   
-  unary_element_ = 0;
-  map_element_   = 0;
-  unary_   = NULL;
-  current_ = NULL;
-  next_    = NULL;
-  tmp_     = NULL;  
+  downsample_ = dense_crf_param.lattice_downsample();
+  CHECK_GE(downsample_, 1) << "lattice_downsample should be at least 1.";
 
   output_prob_ = dense_crf_param.output_probability();
+  exp_accuracy_ = static_cast<ExpAccuracy>(dense_crf_param.exp_accuracy());
+
+  thread_pool_.reset(new ThreadPool(dense_crf_param.num_threads()));
+
+  if (dense_crf_param.lattice_cache_size() > 0) {
+    lattice_cache_.reset(
+        new LatticeCache(dense_crf_param.lattice_cache_size()));
+  }
 }
 
 template <typename Dtype>
@@ -92,16 +124,17 @@ void DenseCRFLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       << "DCNN output after upsampling should have the same width as image.";
   }
 
-  int num_pixel  = pad_height_ * pad_width_;
-  int cur_unary_element = num_pixel * M_;
-
-  if (unary_element_ < cur_unary_element) {
-    unary_element_ = cur_unary_element;
-    map_element_   = num_pixel;
-    
-    // allocate largest possible size for data arrays
-    DeAllocateAllData();
-    AllocateAllData();
+  // one context per image that may be in flight at the same time; the
+  // engines grow their buffers to the largest image they see
+  int num_context = std::min(num_, thread_pool_->num_threads());
+  if (contexts_.size() != num_context) {
+    contexts_.resize(num_context);
+    for (size_t i = 0; i < contexts_.size(); ++i) {
+      if (!contexts_[i].engine_) {
+	contexts_[i].engine_.reset(
+	    new DenseCRFEngine(exp_accuracy_, downsample_));
+      }
+    }
   }
 
   // allocate largest possible size for top
@@ -125,8 +158,29 @@ void DenseCRFLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   //        top[0]   : inference values
   //
 
+  // make sure the data are on cpu before worker threads read them
+  bottom[0]->cpu_data();
+  bottom[1]->cpu_data();
+  if (has_image) {
+    bottom[2]->cpu_data();
+  }
+  top[0]->mutable_cpu_data();
+
+  thread_pool_->Run(contexts_.size(),
+      boost::bind(&DenseCRFLayer<Dtype>::ForwardContext, this,
+                  boost::cref(bottom), boost::cref(top), _1));
+}
+
+template <typename Dtype>
+void DenseCRFLayer<Dtype>::ForwardContext(const vector<Blob<Dtype>*>& bottom,
+					  const vector<Blob<Dtype>*>& top,
+					  int ctx_id) {
+  InferenceContext* ctx = &contexts_[ctx_id];
+  DenseCRFEngine* engine = ctx->engine_.get();
+
   const Dtype* bottom_data = bottom[0]->cpu_data();
   const Dtype* data_dims   = bottom[1]->cpu_data();
+  const Dtype* im = has_image ? bottom[2]->cpu_data() : NULL;
 
   Dtype* top_data = top[0]->mutable_cpu_data();
 
@@ -134,7 +188,7 @@ void DenseCRFLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   int data_dim_offset;
   int top_data_offset;
 
-  for (int n = 0; n < num_; ++n) {
+  for (int n = ctx_id; n < num_; n += contexts_.size()) {
     bottom_data_offset  = bottom[0]->offset(n);
     data_dim_offset     = bottom[1]->offset(n);
     top_data_offset     = top[0]->offset(n);
@@ -146,32 +200,16 @@ void DenseCRFLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     // Get N, W, H, M
     if (pad_height_ <= real_img_height && pad_width_ <= real_img_width) {
       // image may be cropped
-      H_ = pad_height_;
-      W_ = pad_width_;
+      engine->Reset(pad_width_, pad_height_, M_);
     } else {
       // image is padded with redundant values
-      H_ = real_img_height;
-      W_ = real_img_width;
-    }
-    N_ = W_ * H_;
-    
-    // check if the pre-allocated memory is not enough
-    CHECK_LE(N_, map_element_)
-      << "The pre-allocated memory is not enough!";
-
-    /*
-    if (N_ > map_element_) {
-      DeAllocateAllData();
-      map_element_   = N_;
-      unary_element_ = N_ * M_;
-      AllocateAllData();
+      engine->Reset(real_img_width, real_img_height, M_);
     }
-    */
 
-    SetupUnaryEnergy(bottom_data + bottom_data_offset);
-    SetupPairwiseFunctions(bottom);
-    ComputeMap(top_data + top_data_offset);
-    ClearPairwiseFunctions();
+    SetupUnaryEnergy(bottom_data + bottom_data_offset, ctx);
+    SetupPairwiseFunctions(has_image ? im + bottom[2]->offset(n) : NULL, ctx);
+    ComputeMap(top_data + top_data_offset, ctx);
+    ClearPairwiseFunctions(ctx);
   }
 }
 
@@ -184,106 +222,32 @@ void DenseCRFLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
 
 template <typename Dtype>
 DenseCRFLayer<Dtype>::~DenseCRFLayer() {
-  ClearPairwiseFunctions();
-  DeAllocateAllData();
-}
-
-template <typename Dtype>
-void DenseCRFLayer<Dtype>::DeAllocateAllData() {
-  deallocate(unary_);
-  deallocate(current_);
-  deallocate(next_);
-  deallocate(tmp_);
-}
-
-template <typename Dtype>
-void DenseCRFLayer<Dtype>::AllocateAllData() {
-  unary_   = allocate(unary_element_);
-  current_ = allocate(unary_element_);
-  next_    = allocate(unary_element_);
-  tmp_     = allocate(unary_element_);  
-}
-
-template <typename Dtype>
-void DenseCRFLayer<Dtype>::ExpAndNormalize(float* out, const float* in, float scale) {
-  float* V = new float[M_];
-
-  for (int i = 0; i < N_; ++i) {
-    const float* b = in + i*M_;
-    // Find the max and subtract it so that the exp doesn't explode
-    float mx = scale*b[0];
-    for (int j = 1; j < M_; ++j)
-      if( mx < scale*b[j] )
-	mx = scale*b[j];
-    float tt = 0;
-    for (int j = 0; j < M_; ++j) {
-      V[j] = fast_exp(scale*b[j]-mx);
-      tt += V[j];
-    }
-    // Make it a probability
-    for (int j=0; j < M_; ++j)
-      V[j] /= tt;
-    
-    float* a = out + i*M_;
-    for (int j = 0; j < M_; ++j)
-      a[j] = V[j];
+  if (lattice_cache_) {
+    LOG(INFO) << this->layer_param_.name() << " lattice cache: "
+	      << lattice_cache_->hits() << " hits, "
+	      << lattice_cache_->misses() << " misses";
   }
-  delete[] V;
-}
-
-template <typename Dtype>
-void DenseCRFLayer<Dtype>::StartInference() {
-  ExpAndNormalize(current_, unary_, -1.0);
-}
-
-template <typename Dtype>
-void DenseCRFLayer<Dtype>::StepInference() {
-#ifdef SSE_DENSE_CRF
-  __m128 * sse_next_ = (__m128*)next_;
-  __m128 * sse_unary_ = (__m128*)unary_;
-#endif
-  // Set the unary potential
-#ifdef SSE_DENSE_CRF
-  for (int i = 0; i < (N_*M_-1)/4+1; ++i)
-    sse_next_[i] = - sse_unary_[i];
-#else
-  for (int i = 0; i < N_*M_; ++i)
-    next_[i] = -unary_[i];
-#endif
-    
-  // Add up all pairwise potentials
-  for (size_t i=0; i < pairwise_.size(); ++i)
-    pairwise_[i]->apply(next_, current_, tmp_, M_);
-    
-  // Exponentiate and normalize
-  ExpAndNormalize(current_, next_, 1.0);
-}
-
-template <typename Dtype>
-void DenseCRFLayer<Dtype>::ClearPairwiseFunctions() {
-  for (size_t i = 0; i < pairwise_.size(); ++i) {
-    delete pairwise_[i];
+  for (size_t i = 0; i < contexts_.size(); ++i) {
+    ClearPairwiseFunctions(&contexts_[i]);
   }
-  pairwise_.clear();
 }
 
 template <typename Dtype>
-void DenseCRFLayer<Dtype>::RunInference() {
-  StartInference();
-  for (int i = 0; i < max_iter_; ++i) {
-    StepInference();
-  }
+void DenseCRFLayer<Dtype>::ClearPairwiseFunctions(InferenceContext* ctx) {
+  // the engine keeps raw pointers until its next Reset
+  ctx->pairwise_.clear();
 }
 
 template <typename Dtype>
-void DenseCRFLayer<Dtype>::ComputeMap(Dtype* top_inf) {
+void DenseCRFLayer<Dtype>::ComputeMap(Dtype* top_inf, InferenceContext* ctx) {
   // compute map 
   //
 
   memset(top_inf, 0, sizeof(Dtype)*M_*pad_height_*pad_width_);
 
-  // results are saved to current_ after call RunInference()
-  RunInference();
+  const float* current_ = ctx->engine_->Inference(max_iter_);
+  const int H_ = ctx->engine_->height();
+  const int W_ = ctx->engine_->width();
 
   int in_index;
   int out_index;
@@ -314,54 +278,128 @@ void DenseCRFLayer<Dtype>::ComputeMap(Dtype* top_inf) {
 }
 
 template <typename Dtype>
-void DenseCRFLayer<Dtype>::SetupPairwiseFunctions(const vector<Blob<Dtype>*>& bottom) {
-  ClearPairwiseFunctions();
+void DenseCRFLayer<Dtype>::SetupPairwiseFunctions(const Dtype* im,
+						  InferenceContext* ctx) {
+  ClearPairwiseFunctions(ctx);
+
+  DenseCRFEngine* engine = ctx->engine_.get();
+  LatticeArena* arena = engine->arena();
+  const int H_ = engine->height();
+  const int W_ = engine->width();
+  // the lattices are built on the (possibly downsampled) filtering grid,
+  // with positions still expressed in full resolution pixels
+  const int Hs = engine->grid_height();
+  const int Ws = engine->grid_width();
+  const int Ns = engine->grid_size();
+  const float ry = engine->grid_step_y();
+  const float rx = engine->grid_step_x();
+
+  // the features are cheap to compute: they are built for every image, and
+  // identify the lattice in the cache
+  LatticeCache::Key key;
+  key.num_points = Ns;
 
   // add pairwise Gaussian
   for (size_t k = 0; k < pos_w_.size(); ++k) {
-    float* features = new float[N_*2];
-    for (int j = 0; j < H_; ++j) {
-      for (int i = 0; i < W_; ++i) {
-	features[(j*W_+i)*2+0] = i / pos_xy_std_[k];
-	features[(j*W_+i)*2+1] = j / pos_xy_std_[k];
+    float* features = static_cast<float*>(
+        arena->allocate(Ns*2*sizeof(float)));
+    for (int j = 0; j < Hs; ++j) {
+      for (int i = 0; i < Ws; ++i) {
+	features[(j*Ws+i)*2+0] = i * rx / pos_xy_std_[k];
+	features[(j*Ws+i)*2+1] = j * ry / pos_xy_std_[k];
       }
     }
-    pairwise_.push_back(new PottsPotential(features, 2, N_, pos_w_[k]));
-    delete[] features;
+    key.dim    = 2;
+    key.weight = pos_w_[k];
+    shared_ptr<PairwisePotential> potential;
+    if (lattice_cache_) {
+      key.checksum = LatticeCache::Hash(features, Ns*2*sizeof(float));
+      potential = lattice_cache_->Get(key, features);
+    }
+    if (!potential) {
+      potential.reset(new PottsPotential(features, 2, Ns, pos_w_[k], true,
+					 arena));
+      if (lattice_cache_) {
+	lattice_cache_->Put(key, features, potential);
+      }
+    }
+    arena->deallocate(features, Ns*2*sizeof(float));
+    ctx->pairwise_.push_back(potential);
+    engine->AddPairwise(potential.get());
   }
 
   if (has_image) {
-    const Dtype* im = bottom[2]->cpu_data();
+    // im points to the image of the current instance
     int channel_offset = pad_height_ * pad_width_;
 
+    // colors at the nodes of the filtering grid
+    const Dtype* grid_im = im;
+    int grid_width = pad_width_;
+    int grid_channel_offset = channel_offset;
+    Dtype* small_im = NULL;
+    if (Ns != H_ * W_ && bi_w_.size() > 0) {
+      small_im = static_cast<Dtype*>(
+          arena->allocate(Ns*3*sizeof(Dtype)));
+      caffe_cpu_interp2<Dtype, false>(3,
+          im, 0, 0, H_, W_, pad_height_, pad_width_,
+          small_im, 0, 0, Hs, Ws, Hs, Ws);
+      grid_im = small_im;
+      grid_width = Ws;
+      grid_channel_offset = Ns;
+    }
+
     // add pairwise Bilateral
     for (size_t k = 0; k < bi_w_.size(); ++k) {
-      float* features = new float[N_*5];
+      float* features = static_cast<float*>(
+          arena->allocate(Ns*5*sizeof(float)));
       
       // Note H_ and W_ are the effective dimension of image (not padded dimensions)
-      for (int j = 0; j < H_; j++) {
-	for (int i = 0; i < W_; i++){
-	  features[(j*W_+i)*5+0] = i / bi_xy_std_[k];
-	  features[(j*W_+i)*5+1] = j / bi_xy_std_[k];
+      for (int j = 0; j < Hs; j++) {
+	for (int i = 0; i < Ws; i++){
+	  features[(j*Ws+i)*5+0] = i * rx / bi_xy_std_[k];
+	  features[(j*Ws+i)*5+1] = j * ry / bi_xy_std_[k];
 
-	  int img_index = j * pad_width_ + i;
+	  int img_index = j * grid_width + i;
 
 	  // im is BGR
 	  // Assume im is mean-centered (not affect gaussian blur)
 	  // and assume im is proprocessing by scale = 1 (may cause problem if not 1)
-	  features[(j*W_+i)*5+2] = im[img_index] / bi_rgb_std_[k];
-	  features[(j*W_+i)*5+3] = im[img_index + channel_offset] / bi_rgb_std_[k];
-	  features[(j*W_+i)*5+4] = im[img_index + 2*channel_offset] / bi_rgb_std_[k];
+	  features[(j*Ws+i)*5+2] = grid_im[img_index] / bi_rgb_std_[k];
+	  features[(j*Ws+i)*5+3] = grid_im[img_index + grid_channel_offset] / bi_rgb_std_[k];
+	  features[(j*Ws+i)*5+4] = grid_im[img_index + 2*grid_channel_offset] / bi_rgb_std_[k];
+	}
+      }
+      key.dim    = 5;
+      key.weight = bi_w_[k];
+      shared_ptr<PairwisePotential> potential;
+      if (lattice_cache_) {
+	key.checksum = LatticeCache::Hash(features, Ns*5*sizeof(float));
+	potential = lattice_cache_->Get(key, features);
+      }
+      if (!potential) {
+	potential.reset(new PottsPotential(features, 5, Ns, bi_w_[k], true,
+					   arena));
+	if (lattice_cache_) {
+	  lattice_cache_->Put(key, features, potential);
 	}
       }
-      pairwise_.push_back(new PottsPotential(features, 5, N_, bi_w_[k]));
-      delete[] features;
+      arena->deallocate(features, Ns*5*sizeof(float));
+      ctx->pairwise_.push_back(potential);
+      engine->AddPairwise(potential.get());
+    }
+    if (small_im) {
+      arena->deallocate(small_im, Ns*3*sizeof(Dtype));
     }
   }
 }
 
 template <typename Dtype>
-void DenseCRFLayer<Dtype>::SetupUnaryEnergy(const Dtype* bottom_data) {
+void DenseCRFLayer<Dtype>::SetupUnaryEnergy(const Dtype* bottom_data,
+					    InferenceContext* ctx) {
+  const int H_ = ctx->engine_->height();
+  const int W_ = ctx->engine_->width();
+  float* unary_ = ctx->engine_->unary();
+
   for (int c = 0; c < M_; ++c) {
     for (int h = 0; h < H_; ++h) {
       for (int w = 0; w < W_; ++w) {
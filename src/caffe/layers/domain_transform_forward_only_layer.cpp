@@ -1,3 +1,5 @@
+#include <boost/bind.hpp>
+
 #include <algorithm>
 #include <vector>
 
@@ -9,6 +11,10 @@ namespace caffe {
 using std::max;
 using std::min;
 
+// Number of rows filtered together by the horizontal passes. The recursion
+// is sequential along a row; interleaving independent rows hides its latency.
+static const int kRowBlock = 8;
+
 template <typename Dtype>
 void DomainTransformForwardOnlyLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
                                              const vector<Blob<Dtype>*>& top) {
@@ -24,6 +30,8 @@ void DomainTransformForwardOnlyLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>
   // Four passes:
   // (0) left->right (1) right->left (2) top->bottom (3) bottom->top.
   num_passes_ =  4;
+
+  thread_pool_.reset(new ThreadPool(param.num_threads()));
 }
 
 template <typename Dtype>
@@ -50,66 +58,75 @@ void DomainTransformForwardOnlyLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>&
 
   top[0]->Reshape(num_, channels_, height_, width_);
 
-  weight_image_.Reshape(1, 1, height_, width_);
+  weight_image_.Reshape(num_, num_iter_, height_, width_);
 }
 
 template <typename Dtype>
 void DomainTransformForwardOnlyLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
+  // Make sure the data are on cpu before worker threads access them.
+  for (int i = 0; i < bottom.size(); ++i) {
+    bottom[i]->cpu_data();
+  }
+  top[0]->mutable_cpu_data();
+  weight_image_.mutable_cpu_data();
+
+  thread_pool_->Run(num_,
+      boost::bind(&DomainTransformForwardOnlyLayer<Dtype>::SetUpWeightImages,
+                  this, boost::cref(bottom), _1));
+  // The channels are filtered independently of each other.
+  thread_pool_->Run(num_ * channels_,
+      boost::bind(&DomainTransformForwardOnlyLayer<Dtype>::ForwardChannel,
+                  this, boost::cref(bottom), boost::cref(top), _1));
+}
+
+template <typename Dtype>
+void DomainTransformForwardOnlyLayer<Dtype>::SetUpWeightImages(
+    const vector<Blob<Dtype>*>& bottom, int n) {
+  const Dtype* ref_grad_data = bottom[1]->cpu_data_at(n);
+  const int input_height = static_cast<int>(bottom[2]->cpu_data_at(n)[0]);
+  const int input_width  = static_cast<int>(bottom[2]->cpu_data_at(n)[1]);
+
+  CHECK_LE(input_height, height_) <<
+      "input_height should be less than or equal to height.";
+  CHECK_LE(input_width, width_) <<
+      "input_width should be less than or equal to width.";
+
+  for (int iter = 0; iter < num_iter_; ++iter) {
+    SetUpWeightImage(input_height, input_width, ref_grad_data,
+                     ComputeSigma(iter),
+                     weight_image_.mutable_cpu_data_at(n, iter));
+  }
+}
+
+template <typename Dtype>
+void DomainTransformForwardOnlyLayer<Dtype>::ForwardChannel(
+    const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top, int index) {
+  const int n = index / channels_;
+  const int c = index % channels_;
   const int spatial_dim = height_ * width_;
-  const int sample_dim  = channels_ * spatial_dim;
-
-  Dtype* weight = weight_image_.mutable_cpu_data_at();
-
-  for (int n = 0; n < num_; ++n) {
-    const Dtype* feat_data = bottom[0]->cpu_data_at(n);
-    Dtype* top_data        = top[0]->mutable_cpu_data_at(n);
-    caffe_copy<Dtype>(sample_dim, feat_data, top_data);
-
-    const Dtype* ref_grad_data = bottom[1]->cpu_data_at(n);
-    const int input_height = static_cast<int>(bottom[2]->cpu_data_at(n)[0]);
-    const int input_width  = static_cast<int>(bottom[2]->cpu_data_at(n)[1]);
-
-    CHECK_LE(input_height, height_) <<
-        "input_height should be less than or equal to height.";
-    CHECK_LE(input_width, width_) <<
-        "input_width should be less than or equal to width.";
-
-    for (int iter = 0; iter < num_iter_; ++iter) {
-      Dtype sigma_i = ComputeSigma(iter);
-
-      SetUpWeightImage(input_height, input_width, ref_grad_data,
-                       sigma_i, weight);
-
-      // Perform recursive filtering for each input channel.
-      for (int c = 0; c < channels_; ++c) {
-        Dtype* cur_top_data = top[0]->mutable_cpu_data_at(n, c);
-
-        // Filter the input four times in the following (forward) orders:
-        // (0) left->right (1) right->left (2) top->bottom (3) bottom->top.
-        for (int pass = 0; pass < num_passes_; ++pass) {
-          switch (pass) {
-            case 0:
-              HorizontalFilterLeftToRightForward(input_height, input_width,
-                                   weight, cur_top_data);
-              break;
-            case 1:
-              HorizontalFilterRightToLeftForward(input_height, input_width,
-                                   weight, cur_top_data);
-              break;
-            case 2:
-              VerticalFilterTopToBottomForward(input_height, input_width,
-                                 weight, cur_top_data);
-              break;
-            case 3:
-              VerticalFilterBottomToTopForward(input_height, input_width,
-                                 weight, cur_top_data);
-              break;
-          }
-        }
-      }
-    }
+
+  Dtype* cur_top_data = top[0]->mutable_cpu_data_at(n, c);
+  caffe_copy<Dtype>(spatial_dim, bottom[0]->cpu_data_at(n, c), cur_top_data);
+
+  const int input_height = static_cast<int>(bottom[2]->cpu_data_at(n)[0]);
+  const int input_width  = static_cast<int>(bottom[2]->cpu_data_at(n)[1]);
+
+  for (int iter = 0; iter < num_iter_; ++iter) {
+    const Dtype* weight = weight_image_.cpu_data_at(n, iter);
+
+    // Filter the input four times in the following (forward) orders:
+    // (0) left->right (1) right->left (2) top->bottom (3) bottom->top.
+    HorizontalFilterLeftToRightForward(input_height, input_width,
+                                       weight, cur_top_data);
+    HorizontalFilterRightToLeftForward(input_height, input_width,
+                                       weight, cur_top_data);
+    VerticalFilterTopToBottomForward(input_height, input_width,
+                                     weight, cur_top_data);
+    VerticalFilterBottomToTopForward(input_height, input_width,
+                                     weight, cur_top_data);
   }
 }
 
@@ -239,13 +256,16 @@ void DomainTransformForwardOnlyLayer<Dtype>::ComputeReferenceGradientDiff(
 
 template <typename Dtype>
 void DomainTransformForwardOnlyLayer<Dtype>::HorizontalFilterLeftToRightForward(
-    const int input_height, const int input_width, const Dtype* weight, Dtype* output) {
-  for (int h = 0; h < input_height; ++h) {
-    int ind = h * width_;
+    const int input_height, const int input_width, const Dtype* weight,
+    Dtype* output) {
+  for (int h0 = 0; h0 < input_height; h0 += kRowBlock) {
+    const int rows = min(kRowBlock, input_height - h0);
     for (int w = 1; w < input_width; ++w) {
-      int pos = ind + w;      
-      //intermediate_res[pos] = output[pos - 1] - output[pos];
-      output[pos] += weight[pos] * (output[pos - 1] - output[pos]);
+      for (int r = 0; r < rows; ++r) {
+        int pos = (h0 + r) * width_ + w;
+        const Dtype diff = output[pos - 1] - output[pos];
+        output[pos] = output[pos] + weight[pos] * diff;
+      }
     }
   }
 }
@@ -269,13 +289,16 @@ void DomainTransformForwardOnlyLayer<Dtype>::HorizontalFilterLeftToRightBackward
 
 template <typename Dtype>
 void DomainTransformForwardOnlyLayer<Dtype>::HorizontalFilterRightToLeftForward(
-    const int input_height, const int input_width, const Dtype* weight, Dtype* output) {
-  for (int h = 0; h < input_height; ++h) {
-    int ind = h * width_;
+    const int input_height, const int input_width, const Dtype* weight,
+    Dtype* output) {
+  for (int h0 = 0; h0 < input_height; h0 += kRowBlock) {
+    const int rows = min(kRowBlock, input_height - h0);
     for (int w = input_width - 2; w >= 0; --w) {
-      int pos = ind + w;
-      //intermediate_res[pos] = output[pos + 1] - output[pos];
-      output[pos] += weight[pos + 1] * (output[pos + 1] - output[pos]);
+      for (int r = 0; r < rows; ++r) {
+        int pos = (h0 + r) * width_ + w;
+        const Dtype diff = output[pos + 1] - output[pos];
+        output[pos] = output[pos] + weight[pos + 1] * diff;
+      }
     }
   }
 }
@@ -300,13 +323,17 @@ void DomainTransformForwardOnlyLayer<Dtype>::HorizontalFilterRightToLeftBackward
 
 template <typename Dtype>
 void DomainTransformForwardOnlyLayer<Dtype>::VerticalFilterTopToBottomForward(
-    const int input_height, const int input_width, const Dtype* weight, Dtype* output) {
-  for (int w = 0; w < input_width; ++w) {
-    for (int h = 1; h < input_height; ++h) {
-      int prv_pos  = (h - 1) * width_ + w;
-      int pos      = prv_pos + width_;
-      //intermediate_res[pos] = output[prv_pos] - output[pos];
-      output[pos] += weight[pos] * (output[prv_pos] - output[pos]);
+    const int input_height, const int input_width, const Dtype* weight,
+    Dtype* output) {
+  // Sweep whole rows so that the columns are filtered in parallel with
+  // contiguous (vectorizable) accesses.
+  for (int h = 1; h < input_height; ++h) {
+    const Dtype* prv = output + (h - 1) * width_;
+    Dtype* cur = output + h * width_;
+    const Dtype* wgt = weight + h * width_;
+    for (int w = 0; w < input_width; ++w) {
+      const Dtype diff = prv[w] - cur[w];
+      cur[w] = cur[w] + wgt[w] * diff;
     }
   }
 }
@@ -330,13 +357,15 @@ void DomainTransformForwardOnlyLayer<Dtype>::VerticalFilterTopToBottomBackward(
 
 template <typename Dtype>
 void DomainTransformForwardOnlyLayer<Dtype>::VerticalFilterBottomToTopForward(
-    const int input_height, const int input_width, const Dtype* weight, Dtype* output) {
-  for (int w = 0; w < input_width; ++w) {
-    for (int h = input_height - 2; h >= 0; --h) {
-      int pos     = h * width_ + w;
-      int nxt_pos = pos + width_;
-      //intermediate_res[pos] = output[nxt_pos] - output[pos];
-      output[pos] +=  weight[nxt_pos] * (output[nxt_pos] - output[pos]);
+    const int input_height, const int input_width, const Dtype* weight,
+    Dtype* output) {
+  for (int h = input_height - 2; h >= 0; --h) {
+    Dtype* cur = output + h * width_;
+    const Dtype* nxt = cur + width_;
+    const Dtype* wgt = weight + (h + 1) * width_;
+    for (int w = 0; w < input_width; ++w) {
+      const Dtype diff = nxt[w] - cur[w];
+      cur[w] = cur[w] + wgt[w] * diff;
     }
   }
 }
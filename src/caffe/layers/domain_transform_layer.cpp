@@ -1,3 +1,5 @@
+#include <boost/bind.hpp>
+
 #include <algorithm>
 #include <vector>
 
@@ -9,6 +11,10 @@ namespace caffe {
 using std::max;
 using std::min;
 
+// Number of rows filtered together by the horizontal passes. The recursion
+// is sequential along a row; interleaving independent rows hides its latency.
+static const int kRowBlock = 8;
+
 template <typename Dtype>
 void DomainTransformLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
                                              const vector<Blob<Dtype>*>& top) {
@@ -24,6 +30,8 @@ void DomainTransformLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   // Four passes:
   // (0) left->right (1) right->left (2) top->bottom (3) bottom->top.
   num_passes_ =  4;
+
+  thread_pool_.reset(new ThreadPool(param.num_threads()));
 }
 
 template <typename Dtype>
@@ -56,79 +64,104 @@ void DomainTransformLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       * width_ * sizeof(Dtype);
   */
 
-  int count = 0;
-  for (int iter = 0; iter < num_iter_; ++iter) {
-    for (int pass = 0; pass < num_passes_; ++pass) {
+  // Reuse the intermediate results of previous calls.
+  for (int count = 0; count < num_iter_ * num_passes_; ++count) {
+    if (count < intermediate_results_.size()) {
+      intermediate_results_[count]->Reshape(num_, channels_, height_, width_);
+    } else {
       intermediate_results_.push_back(
           new Blob<Dtype>(num_, channels_, height_, width_));
-      caffe_set(intermediate_results_[count]->count(), Dtype(0),
-		intermediate_results_[count]->mutable_cpu_data());
-      ++count;
     }
+    caffe_set(intermediate_results_[count]->count(), Dtype(0),
+	      intermediate_results_[count]->mutable_cpu_data());
   }
-  weight_image_.Reshape(1, 1, height_, width_);
-  blob_weight_diff_.Reshape(1, 1, height_, width_);
+  weight_image_.Reshape(num_, num_iter_, height_, width_);
+  blob_weight_diff_.Reshape(num_, 1, height_, width_);
 }
 
 template <typename Dtype>
 void DomainTransformLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
+  // Make sure the data are on cpu before worker threads access them.
+  for (int i = 0; i < bottom.size(); ++i) {
+    bottom[i]->cpu_data();
+  }
+  top[0]->mutable_cpu_data();
+  weight_image_.mutable_cpu_data();
+  for (int k = 0; k < intermediate_results_.size(); ++k) {
+    intermediate_results_[k]->mutable_cpu_data();
+  }
+
+  thread_pool_->Run(num_,
+      boost::bind(&DomainTransformLayer<Dtype>::SetUpWeightImages, this,
+                  boost::cref(bottom), _1));
+  // The channels are filtered independently of each other.
+  thread_pool_->Run(num_ * channels_,
+      boost::bind(&DomainTransformLayer<Dtype>::ForwardChannel, this,
+                  boost::cref(bottom), boost::cref(top), _1));
+}
+
+template <typename Dtype>
+void DomainTransformLayer<Dtype>::SetUpWeightImages(
+    const vector<Blob<Dtype>*>& bottom, int n) {
+  const Dtype* ref_grad_data = bottom[1]->cpu_data_at(n);
+  const int input_height = static_cast<int>(bottom[2]->cpu_data_at(n)[0]);
+  const int input_width  = static_cast<int>(bottom[2]->cpu_data_at(n)[1]);
+
+  CHECK_LE(input_height, height_) <<
+      "input_height should be less than or equal to height.";
+  CHECK_LE(input_width, width_) <<
+      "input_width should be less than or equal to width.";
+
+  for (int iter = 0; iter < num_iter_; ++iter) {
+    SetUpWeightImage(input_height, input_width, ref_grad_data,
+                     ComputeSigma(iter),
+                     weight_image_.mutable_cpu_data_at(n, iter));
+  }
+}
+
+template <typename Dtype>
+void DomainTransformLayer<Dtype>::ForwardChannel(
+    const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top, int index) {
+  const int n = index / channels_;
+  const int c = index % channels_;
   const int spatial_dim = height_ * width_;
-  const int sample_dim  = channels_ * spatial_dim;
 
-  Dtype* weight = weight_image_.mutable_cpu_data();
-
-  for (int n = 0; n < num_; ++n) {
-    const Dtype* feat_data = bottom[0]->cpu_data_at(n);
-    Dtype* top_data        = top[0]->mutable_cpu_data_at(n);
-    caffe_copy<Dtype>(sample_dim, feat_data, top_data);
-
-    const Dtype* ref_grad_data = bottom[1]->cpu_data_at(n);
-    const int input_height = static_cast<int>(bottom[2]->cpu_data_at(n)[0]);
-    const int input_width  = static_cast<int>(bottom[2]->cpu_data_at(n)[1]);
-
-    CHECK_LE(input_height, height_) <<
-        "input_height should be less than or equal to height.";
-    CHECK_LE(input_width, width_) <<
-        "input_width should be less than or equal to width.";
-
-    for (int iter = 0; iter < num_iter_; ++iter) {
-      Dtype sigma_i = ComputeSigma(iter);
-
-      SetUpWeightImage(input_height, input_width, ref_grad_data,
-                       sigma_i, weight);
-
-      // Perform recursive filtering for each input channel.
-      for (int c = 0; c < channels_; ++c) {
-        Dtype* cur_top_data = top[0]->mutable_cpu_data_at(n, c);
-
-        // Filter the input four times in the following (forward) orders:
-        // (0) left->right (1) right->left (2) top->bottom (3) bottom->top.
-        for (int pass = 0; pass < num_passes_; ++pass) {
-          int ind = iter * num_passes_ + pass;
-          Dtype* intermediate_res =
-              intermediate_results_[ind]->mutable_cpu_data_at(n, c);
-
-          switch (pass) {
-            case 0:
-              HorizontalFilterLeftToRightForward(input_height, input_width,
-                                   weight, intermediate_res, cur_top_data);
-              break;
-            case 1:
-              HorizontalFilterRightToLeftForward(input_height, input_width,
-                                   weight, intermediate_res, cur_top_data);
-              break;
-            case 2:
-              VerticalFilterTopToBottomForward(input_height, input_width,
-                                 weight, intermediate_res, cur_top_data);
-              break;
-            case 3:
-              VerticalFilterBottomToTopForward(input_height, input_width,
-                                 weight, intermediate_res, cur_top_data);
-              break;
-          }
-        }
+  Dtype* cur_top_data = top[0]->mutable_cpu_data_at(n, c);
+  caffe_copy<Dtype>(spatial_dim, bottom[0]->cpu_data_at(n, c), cur_top_data);
+
+  const int input_height = static_cast<int>(bottom[2]->cpu_data_at(n)[0]);
+  const int input_width  = static_cast<int>(bottom[2]->cpu_data_at(n)[1]);
+
+  for (int iter = 0; iter < num_iter_; ++iter) {
+    const Dtype* weight = weight_image_.cpu_data_at(n, iter);
+
+    // Filter the input four times in the following (forward) orders:
+    // (0) left->right (1) right->left (2) top->bottom (3) bottom->top.
+    for (int pass = 0; pass < num_passes_; ++pass) {
+      int ind = iter * num_passes_ + pass;
+      Dtype* intermediate_res =
+          intermediate_results_[ind]->mutable_cpu_data_at(n, c);
+
+      switch (pass) {
+        case 0:
+          HorizontalFilterLeftToRightForward(input_height, input_width,
+                               weight, intermediate_res, cur_top_data);
+          break;
+        case 1:
+          HorizontalFilterRightToLeftForward(input_height, input_width,
+                               weight, intermediate_res, cur_top_data);
+          break;
+        case 2:
+          VerticalFilterTopToBottomForward(input_height, input_width,
+                             weight, intermediate_res, cur_top_data);
+          break;
+        case 3:
+          VerticalFilterBottomToTopForward(input_height, input_width,
+                             weight, intermediate_res, cur_top_data);
+          break;
       }
     }
   }
@@ -143,72 +176,82 @@ void DomainTransformLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   }
 
   if (propagate_down[0] || propagate_down[1]) {
-    const int spatial_dim = height_ * width_;
-    const int sample_dim  = channels_ * spatial_dim;
-    // weight_diff is a temporary buffer shared for all samples.
-    Dtype* weight_diff = blob_weight_diff_.mutable_cpu_diff();
-    Dtype* weight = weight_image_.mutable_cpu_data();
-
-    for (int n = 0; n < num_; ++n) {
-      const Dtype* top_diff       = top[0]->cpu_diff_at(n);
-      Dtype* bottom_input_diff    = bottom[0]->mutable_cpu_diff_at(n);
-      Dtype* bottom_ref_grad_diff = bottom[1]->mutable_cpu_diff_at(n);
-
-      caffe_copy<Dtype>(sample_dim, top_diff, bottom_input_diff);
-      caffe_set<Dtype>(spatial_dim, Dtype(0), bottom_ref_grad_diff);
-
-      const Dtype* ref_grad_data = bottom[1]->cpu_data_at(n);
-      const int input_height = static_cast<int>(bottom[2]->cpu_data_at(n)[0]);
-      const int input_width  = static_cast<int>(bottom[2]->cpu_data_at(n)[1]);
-
-      CHECK_LE(input_height, height_) <<
-          "input_height should be less than or equal to height.";
-      CHECK_LE(input_width, width_) <<
-          "input_width should be less than or equal to width.";
-
-      for (int iter = num_iter_ - 1; iter >= 0; --iter) {
-        Dtype sigma_i = ComputeSigma(iter);
-
-        SetUpWeightImage(input_height, input_width, ref_grad_data,
-                         sigma_i, weight);
-
-        caffe_set<Dtype>(spatial_dim, Dtype(0), weight_diff);
-
-        // Perform backward recursive filtering for each input channel.
-        for (int c = 0; c < channels_; ++c) {
-          Dtype* input_diff = bottom[0]->mutable_cpu_diff_at(n, c);
-
-          // Filter the input four times in the following (backward) orders:
-          // (3) bottom->top (2) top->bottom (1) right->left (0) left->right.
-          for (int pass = num_passes_ - 1; pass >= 0; --pass) {
-            int ind = iter * num_passes_ + pass;
-            Dtype* intermediate_res =
-                intermediate_results_[ind]->mutable_cpu_data_at(n, c);
-
-            switch (pass) {
-              case 0:
-                HorizontalFilterLeftToRightBackward(input_height, input_width,
-                           weight, intermediate_res, input_diff, weight_diff);
-                break;
-              case 1:
-                HorizontalFilterRightToLeftBackward(input_height, input_width,
-                           weight, intermediate_res, input_diff, weight_diff);
-                break;
-              case 2:
-                VerticalFilterTopToBottomBackward(input_height, input_width,
-                         weight, intermediate_res, input_diff, weight_diff);
-                break;
-              case 3:
-                VerticalFilterBottomToTopBackward(input_height, input_width,
-                         weight, intermediate_res, input_diff, weight_diff);
-                break;
-            }
-          }
+    // Make sure the data are on cpu before worker threads access them.
+    top[0]->cpu_diff();
+    bottom[0]->mutable_cpu_diff();
+    bottom[1]->mutable_cpu_diff();
+    bottom[2]->cpu_data();
+    weight_image_.cpu_data();
+    blob_weight_diff_.mutable_cpu_diff();
+    for (int k = 0; k < intermediate_results_.size(); ++k) {
+      intermediate_results_[k]->mutable_cpu_data();
+    }
+
+    // The weight images of the forward pass are reused.
+    thread_pool_->Run(num_,
+        boost::bind(&DomainTransformLayer<Dtype>::BackwardSample, this,
+                    boost::cref(top), boost::cref(bottom), _1));
+  }
+}
+
+template <typename Dtype>
+void DomainTransformLayer<Dtype>::BackwardSample(
+    const vector<Blob<Dtype>*>& top, const vector<Blob<Dtype>*>& bottom,
+    int n) {
+  const int spatial_dim = height_ * width_;
+  const int sample_dim  = channels_ * spatial_dim;
+  // weight_diff is a temporary buffer of the sample.
+  Dtype* weight_diff = blob_weight_diff_.mutable_cpu_diff_at(n);
+
+  const Dtype* top_diff       = top[0]->cpu_diff_at(n);
+  Dtype* bottom_input_diff    = bottom[0]->mutable_cpu_diff_at(n);
+  Dtype* bottom_ref_grad_diff = bottom[1]->mutable_cpu_diff_at(n);
+
+  caffe_copy<Dtype>(sample_dim, top_diff, bottom_input_diff);
+  caffe_set<Dtype>(spatial_dim, Dtype(0), bottom_ref_grad_diff);
+
+  const int input_height = static_cast<int>(bottom[2]->cpu_data_at(n)[0]);
+  const int input_width  = static_cast<int>(bottom[2]->cpu_data_at(n)[1]);
+
+  for (int iter = num_iter_ - 1; iter >= 0; --iter) {
+    Dtype sigma_i = ComputeSigma(iter);
+    const Dtype* weight = weight_image_.cpu_data_at(n, iter);
+
+    caffe_set<Dtype>(spatial_dim, Dtype(0), weight_diff);
+
+    // Perform backward recursive filtering for each input channel.
+    for (int c = 0; c < channels_; ++c) {
+      Dtype* input_diff = bottom[0]->mutable_cpu_diff_at(n, c);
+
+      // Filter the input four times in the following (backward) orders:
+      // (3) bottom->top (2) top->bottom (1) right->left (0) left->right.
+      for (int pass = num_passes_ - 1; pass >= 0; --pass) {
+        int ind = iter * num_passes_ + pass;
+        Dtype* intermediate_res =
+            intermediate_results_[ind]->mutable_cpu_data_at(n, c);
+
+        switch (pass) {
+          case 0:
+            HorizontalFilterLeftToRightBackward(input_height, input_width,
+                       weight, intermediate_res, input_diff, weight_diff);
+            break;
+          case 1:
+            HorizontalFilterRightToLeftBackward(input_height, input_width,
+                       weight, intermediate_res, input_diff, weight_diff);
+            break;
+          case 2:
+            VerticalFilterTopToBottomBackward(input_height, input_width,
+                     weight, intermediate_res, input_diff, weight_diff);
+            break;
+          case 3:
+            VerticalFilterBottomToTopBackward(input_height, input_width,
+                     weight, intermediate_res, input_diff, weight_diff);
+            break;
         }
-        ComputeReferenceGradientDiff(input_height, input_width, sigma_i,
-                             weight, weight_diff, bottom_ref_grad_diff);
       }
     }
+    ComputeReferenceGradientDiff(input_height, input_width, sigma_i,
+                         weight, weight_diff, bottom_ref_grad_diff);
   }
 }
 
@@ -256,12 +299,15 @@ template <typename Dtype>
 void DomainTransformLayer<Dtype>::HorizontalFilterLeftToRightForward(
     const int input_height, const int input_width, const Dtype* weight,
     Dtype* intermediate_res, Dtype* output) {
-  for (int h = 0; h < input_height; ++h) {
-    int ind = h * width_;
+  for (int h0 = 0; h0 < input_height; h0 += kRowBlock) {
+    const int rows = min(kRowBlock, input_height - h0);
     for (int w = 1; w < input_width; ++w) {
-      int pos = ind + w;
-      intermediate_res[pos] = output[pos - 1] - output[pos];
-      output[pos] = output[pos] + weight[pos] * intermediate_res[pos];
+      for (int r = 0; r < rows; ++r) {
+        int pos = (h0 + r) * width_ + w;
+        const Dtype diff = output[pos - 1] - output[pos];
+        intermediate_res[pos] = diff;
+        output[pos] = output[pos] + weight[pos] * diff;
+      }
     }
   }
 }
@@ -270,13 +316,15 @@ template <typename Dtype>
 void DomainTransformLayer<Dtype>::HorizontalFilterLeftToRightBackward(
     const int input_height, const int input_width, const Dtype* weight,
     const Dtype* intermediate_res, Dtype* output, Dtype* weight_diff) {
-  for (int h = 0; h < input_height; ++h) {
-    int ind = h * width_;
+  for (int h0 = 0; h0 < input_height; h0 += kRowBlock) {
+    const int rows = min(kRowBlock, input_height - h0);
     for (int w = input_width - 1; w >= 1; --w) {
-      int pos    = ind + w;
-      weight_diff[pos] = weight_diff[pos] + output[pos] * intermediate_res[pos];
-      output[pos - 1]  = output[pos - 1] + weight[pos] * output[pos];
-      output[pos]      = (1 - weight[pos]) * output[pos];
+      for (int r = 0; r < rows; ++r) {
+        int pos    = (h0 + r) * width_ + w;
+        weight_diff[pos] = weight_diff[pos] + output[pos] * intermediate_res[pos];
+        output[pos - 1]  = output[pos - 1] + weight[pos] * output[pos];
+        output[pos]      = (1 - weight[pos]) * output[pos];
+      }
     }
   }
 }
@@ -285,12 +333,15 @@ template <typename Dtype>
 void DomainTransformLayer<Dtype>::HorizontalFilterRightToLeftForward(
     const int input_height, const int input_width, const Dtype* weight,
     Dtype* intermediate_res, Dtype* output) {
-  for (int h = 0; h < input_height; ++h) {
-    int ind = h * width_;
+  for (int h0 = 0; h0 < input_height; h0 += kRowBlock) {
+    const int rows = min(kRowBlock, input_height - h0);
     for (int w = input_width - 2; w >= 0; --w) {
-      int pos = ind + w;
-      intermediate_res[pos] = output[pos + 1] - output[pos];
-      output[pos] = output[pos] + weight[pos + 1] * intermediate_res[pos];
+      for (int r = 0; r < rows; ++r) {
+        int pos = (h0 + r) * width_ + w;
+        const Dtype diff = output[pos + 1] - output[pos];
+        intermediate_res[pos] = diff;
+        output[pos] = output[pos] + weight[pos + 1] * diff;
+      }
     }
   }
 }
@@ -299,14 +350,16 @@ template <typename Dtype>
 void DomainTransformLayer<Dtype>::HorizontalFilterRightToLeftBackward(
     const int input_height, const int input_width, const Dtype* weight,
     const Dtype* intermediate_res, Dtype* output, Dtype* weight_diff) {
-  for (int h = 0; h < input_height; ++h) {
-    int ind = h * width_;
+  for (int h0 = 0; h0 < input_height; h0 += kRowBlock) {
+    const int rows = min(kRowBlock, input_height - h0);
     for (int w = 0; w < input_width - 1; ++w) {
-      int pos     = ind + w;
-      weight_diff[pos + 1] = weight_diff[pos + 1] +
-          output[pos] * intermediate_res[pos];
-      output[pos + 1]  = output[pos + 1] + weight[pos + 1] * output[pos];
-      output[pos]      = (1 - weight[pos + 1]) * output[pos];
+      for (int r = 0; r < rows; ++r) {
+        int pos     = (h0 + r) * width_ + w;
+        weight_diff[pos + 1] = weight_diff[pos + 1] +
+            output[pos] * intermediate_res[pos];
+        output[pos + 1]  = output[pos + 1] + weight[pos + 1] * output[pos];
+        output[pos]      = (1 - weight[pos + 1]) * output[pos];
+      }
     }
   }
 }
@@ -315,12 +368,17 @@ template <typename Dtype>
 void DomainTransformLayer<Dtype>::VerticalFilterTopToBottomForward(
     const int input_height, const int input_width, const Dtype* weight,
     Dtype* intermediate_res, Dtype* output) {
-  for (int w = 0; w < input_width; ++w) {
-    for (int h = 1; h < input_height; ++h) {
-      int prv_pos  = (h - 1) * width_ + w;
-      int pos      = prv_pos + width_;
-      intermediate_res[pos] = output[prv_pos] - output[pos];
-      output[pos] = output[pos] + weight[pos] * intermediate_res[pos];
+  // Sweep whole rows so that the columns are filtered in parallel with
+  // contiguous (vectorizable) accesses.
+  for (int h = 1; h < input_height; ++h) {
+    const Dtype* prv = output + (h - 1) * width_;
+    Dtype* cur = output + h * width_;
+    const Dtype* wgt = weight + h * width_;
+    Dtype* inter = intermediate_res + h * width_;
+    for (int w = 0; w < input_width; ++w) {
+      const Dtype diff = prv[w] - cur[w];
+      inter[w] = diff;
+      cur[w] = cur[w] + wgt[w] * diff;
     }
   }
 }
@@ -329,13 +387,16 @@ template <typename Dtype>
 void DomainTransformLayer<Dtype>::VerticalFilterTopToBottomBackward(
     const int input_height, const int input_width, const Dtype* weight,
     const Dtype* intermediate_res, Dtype* output, Dtype* weight_diff) {
-  for (int w = 0; w < input_width; ++w) {
-    for (int h = input_height - 1; h >= 1; --h) {
-      int prv_pos = (h - 1) * width_ + w;
-      int pos     = prv_pos + width_;
-      weight_diff[pos] = weight_diff[pos] + output[pos] * intermediate_res[pos];
-      output[prv_pos]  = output[prv_pos] + weight[pos] * output[pos];
-      output[pos]      = (1 - weight[pos]) * output[pos];
+  for (int h = input_height - 1; h >= 1; --h) {
+    Dtype* prv = output + (h - 1) * width_;
+    Dtype* cur = output + h * width_;
+    const Dtype* wgt = weight + h * width_;
+    const Dtype* inter = intermediate_res + h * width_;
+    Dtype* wgt_diff = weight_diff + h * width_;
+    for (int w = 0; w < input_width; ++w) {
+      wgt_diff[w] = wgt_diff[w] + cur[w] * inter[w];
+      prv[w]      = prv[w] + wgt[w] * cur[w];
+      cur[w]      = (1 - wgt[w]) * cur[w];
     }
   }
 }
@@ -344,12 +405,15 @@ template <typename Dtype>
 void DomainTransformLayer<Dtype>::VerticalFilterBottomToTopForward(
     const int input_height, const int input_width, const Dtype* weight,
     Dtype* intermediate_res, Dtype* output) {
-  for (int w = 0; w < input_width; ++w) {
-    for (int h = input_height - 2; h >= 0; --h) {
-      int pos     = h * width_ + w;
-      int nxt_pos = pos + width_;
-      intermediate_res[pos] = output[nxt_pos] - output[pos];
-      output[pos] = output[pos] + weight[nxt_pos] * intermediate_res[pos];
+  for (int h = input_height - 2; h >= 0; --h) {
+    Dtype* cur = output + h * width_;
+    const Dtype* nxt = cur + width_;
+    const Dtype* wgt = weight + (h + 1) * width_;
+    Dtype* inter = intermediate_res + h * width_;
+    for (int w = 0; w < input_width; ++w) {
+      const Dtype diff = nxt[w] - cur[w];
+      inter[w] = diff;
+      cur[w] = cur[w] + wgt[w] * diff;
     }
   }
 }
@@ -358,18 +422,21 @@ template <typename Dtype>
 void DomainTransformLayer<Dtype>::VerticalFilterBottomToTopBackward(
     const int input_height, const int input_width, const Dtype* weight,
     const Dtype* intermediate_res, Dtype* output, Dtype* weight_diff) {
-  for (int w = 0; w < input_width; ++w) {
-    for (int h = 0; h < input_height - 1; ++h) {
-      int pos     = h * width_ + w;
-      int nxt_pos = pos + width_;
-      weight_diff[nxt_pos] = weight_diff[nxt_pos] +
-          output[pos] * intermediate_res[pos];
-      output[nxt_pos]  = output[nxt_pos] + weight[nxt_pos] * output[pos];
-      output[pos]      = (1 - weight[nxt_pos]) * output[pos];
+  for (int h = 0; h < input_height - 1; ++h) {
+    Dtype* cur = output + h * width_;
+    Dtype* nxt = cur + width_;
+    const Dtype* wgt = weight + (h + 1) * width_;
+    const Dtype* inter = intermediate_res + h * width_;
+    Dtype* wgt_diff = weight_diff + (h + 1) * width_;
+    for (int w = 0; w < input_width; ++w) {
+      wgt_diff[w] = wgt_diff[w] + cur[w] * inter[w];
+      nxt[w]      = nxt[w] + wgt[w] * cur[w];
+      cur[w]      = (1 - wgt[w]) * cur[w];
     }
   }
 }
 
+
 #ifdef CPU_ONLY
 STUB_GPU(DomainTransformLayer);
 #endif
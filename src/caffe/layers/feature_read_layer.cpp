@@ -0,0 +1,72 @@
+#include <vector>
+
+#include "caffe/layers/feature_read_layer.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void FeatureReadLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  const FeatureReadParameter& param = this->layer_param_.feature_read_param();
+  CHECK_EQ(param.file_size(), top.size())
+      << "FeatureRead needs one feature file per top";
+  batch_size_ = param.batch_size();
+  CHECK_GT(batch_size_, 0) << "batch_size must be positive";
+  zero_copy_ = param.zero_copy() && batch_size_ == 1;
+  for (int i = 0; i < top.size(); ++i) {
+    files_.push_back(shared_ptr<FeatureFile>(new FeatureFile(param.file(i))));
+    CHECK_EQ(files_[i]->num_records(), files_[0]->num_records())
+        << "The feature files must have the same number of records";
+  }
+  num_records_ = files_[0]->num_records();
+  CHECK_GT(num_records_, 0) << "Empty feature file " << param.file(0);
+  LOG(INFO) << "FeatureRead will load from a set of " << num_records_
+            << " records" << (zero_copy_ ? " without copy." : ".");
+  record_ = 0;
+  // Read the first batch, and use it to initialize the top blobs.
+  ReadBatch(record_, top);
+}
+
+template <typename Dtype>
+void FeatureReadLayer<Dtype>::ReadBatch(int record,
+    const vector<Blob<Dtype>*>& top) {
+  for (int i = 0; i < top.size(); ++i) {
+    FeatureFile* file = files_[i].get();
+    if (zero_copy_) {
+      file->Read(record, top[i]);
+      continue;
+    }
+    const vector<int>& record_shape = file->shape(record);
+    CHECK_GT(record_shape.size(), 0) << "Cannot batch scalar records";
+    vector<int> shape = record_shape;
+    shape[0] *= batch_size_;
+    top[i]->Reshape(shape);
+    const int record_count = top[i]->count() / batch_size_;
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    for (int n = 0; n < batch_size_; ++n) {
+      const int k = (record + n) % num_records_;
+      CHECK(file->shape(k) == record_shape)
+          << "The records of a batch must have the same shape, "
+          << file->name(k) << " differs from " << file->name(record);
+      file->Copy(k, top_data + n * record_count);
+    }
+  }
+}
+
+template <typename Dtype>
+void FeatureReadLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  ReadBatch(record_, top);
+  record_ = (record_ + batch_size_) % num_records_;
+  // Page in the next batch while the net runs on this one.
+  for (int i = 0; i < files_.size(); ++i) {
+    for (int n = 0; n < batch_size_; ++n) {
+      files_[i]->WillNeed((record_ + n) % num_records_);
+    }
+  }
+}
+
+INSTANTIATE_CLASS(FeatureReadLayer);
+REGISTER_LAYER_CLASS(FeatureRead);
+
+}  // namespace caffe
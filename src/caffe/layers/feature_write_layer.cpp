@@ -0,0 +1,99 @@
+#include <boost/bind.hpp>
+
+#include <fstream>  // NOLINT(readability/streams)
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "caffe/layers/feature_write_layer.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void FeatureWriteLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  const FeatureWriteParameter& param =
+      this->layer_param_.feature_write_param();
+  CHECK_EQ(param.file_size(), bottom.size())
+      << "FeatureWrite needs one feature file per bottom";
+  iter_ = 0;
+  period_ = param.period();
+  CHECK_GT(period_, 0) << "period must be positive";
+  if (param.has_source()) {
+    std::ifstream infile(param.source().c_str());
+    CHECK(infile.good()) << "Failed to open source file " << param.source();
+    const int strip = param.strip();
+    CHECK_GE(strip, 0) << "Strip cannot be negative";
+    string linestr;
+    while (std::getline(infile, linestr)) {
+      std::istringstream iss(linestr);
+      string filename;
+      iss >> filename;
+      CHECK_GT(filename.size(), strip) << "Too much stripping";
+      fnames_.push_back(filename.substr(0, filename.size() - strip));
+    }
+    LOG(INFO) << "FeatureWrite will save a maximum of " << fnames_.size()
+              << " records.";
+  }
+  for (int i = 0; i < bottom.size(); ++i) {
+    files_.push_back(shared_ptr<FeatureFileWriter>(
+        new FeatureFileWriter(param.file(i))));
+  }
+  const int queue_size = param.queue_size();
+  CHECK_GE(queue_size, 0) << "queue_size cannot be negative";
+  writer_.reset(new AsyncWriter(queue_size));
+}
+
+template <typename Dtype>
+FeatureWriteLayer<Dtype>::~FeatureWriteLayer() {
+  // The files write their index when destroyed.
+  if (writer_) {
+    writer_->Flush();
+  }
+}
+
+template <typename Dtype>
+void FeatureWriteLayer<Dtype>::FlushOutput() {
+  writer_->Flush();
+  for (int i = 0; i < files_.size(); ++i) {
+    files_[i]->Flush();
+  }
+}
+
+template <typename Dtype>
+void FeatureWriteLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  if (iter_ % period_ == 0) {
+    std::ostringstream oss;
+    if (fnames_.size() > 0) {
+      CHECK_LT(iter_, fnames_.size())
+          << "Test has run for more iterations than it was supposed to";
+      oss << fnames_[iter_];
+    } else {
+      oss << "iter_" << iter_;
+    }
+    for (int i = 0; i < bottom.size(); ++i) {
+      if (writer_->max_pending() == 0) {
+        files_[i]->Append(oss.str(), *bottom[i]);
+        continue;
+      }
+      // The bottom is overwritten by the next forward pass: write a copy.
+      shared_ptr<Blob<Dtype> > snapshot(new Blob<Dtype>());
+      snapshot->CopyFrom(*bottom[i], false, true);
+      writer_->Push(boost::bind(&FeatureWriteLayer<Dtype>::WriteRecord, this,
+          i, oss.str(), snapshot));
+    }
+  }
+  ++iter_;
+}
+
+template <typename Dtype>
+void FeatureWriteLayer<Dtype>::WriteRecord(int i, const string& name,
+    shared_ptr<Blob<Dtype> > blob) {
+  files_[i]->Append(name, *blob);
+}
+
+INSTANTIATE_CLASS(FeatureWriteLayer);
+REGISTER_LAYER_CLASS(FeatureWrite);
+
+}  // namespace caffe
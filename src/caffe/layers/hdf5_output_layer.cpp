@@ -1,3 +1,6 @@
+#include <boost/bind.hpp>
+
+#include <algorithm>
 #include <vector>
 
 #include "hdf5.h"
@@ -8,6 +11,95 @@
 
 namespace caffe {
 
+namespace {
+
+// Stacks the batches along the first axis.
+template <typename Dtype>
+void ConcatBatches(const vector<shared_ptr<Blob<Dtype> > >& batches,
+    Blob<Dtype>* blob) {
+  if (batches.size() == 1) {
+    blob->ReshapeLike(*batches[0]);
+    blob->ShareData(*batches[0]);
+    return;
+  }
+  vector<int> shape = batches[0]->shape();
+  shape[0] = 0;
+  for (int i = 0; i < batches.size(); ++i) {
+    CHECK_EQ(batches[i]->count(1), batches[0]->count(1))
+        << "All the batches must have the same shape";
+    shape[0] += batches[i]->num();
+  }
+  blob->Reshape(shape);
+  Dtype* dst = blob->mutable_cpu_data();
+  for (int i = 0; i < batches.size(); ++i) {
+    caffe_copy(batches[i]->count(), batches[i]->cpu_data(), dst);
+    dst += batches[i]->count();
+  }
+}
+
+template <typename Dtype> hid_t HDF5Type();
+template <> hid_t HDF5Type<float>() { return H5T_NATIVE_FLOAT; }
+template <> hid_t HDF5Type<double>() { return H5T_NATIVE_DOUBLE; }
+
+// Appends the blob to the dataset along the first axis, creating the
+// dataset, extendible along that axis, if the file does not have it yet.
+template <typename Dtype>
+void AppendDataset(hid_t file_id, const char* dataset_name,
+    const Blob<Dtype>& blob) {
+  const int num_axes = blob.num_axes();
+  CHECK_GT(num_axes, 0) << "Cannot append a scalar to " << dataset_name;
+  vector<hsize_t> dims(num_axes);
+  for (int i = 0; i < num_axes; ++i) {
+    dims[i] = blob.shape(i);
+  }
+  vector<hsize_t> start(num_axes, 0);
+  hid_t dataset_id;
+  if (H5Lexists(file_id, dataset_name, H5P_DEFAULT) > 0) {
+    dataset_id = H5Dopen2(file_id, dataset_name, H5P_DEFAULT);
+    CHECK_GE(dataset_id, 0) << "Failed to open dataset " << dataset_name;
+    hid_t space_id = H5Dget_space(dataset_id);
+    CHECK_EQ(H5Sget_simple_extent_ndims(space_id), num_axes)
+        << "All the batches must have the same shape";
+    vector<hsize_t> old_dims(num_axes);
+    H5Sget_simple_extent_dims(space_id, &old_dims[0], NULL);
+    H5Sclose(space_id);
+    for (int i = 1; i < num_axes; ++i) {
+      CHECK_EQ(old_dims[i], dims[i])
+          << "All the batches must have the same shape";
+    }
+    start[0] = old_dims[0];
+    old_dims[0] += dims[0];
+    CHECK_GE(H5Dset_extent(dataset_id, &old_dims[0]), 0)
+        << "Failed to extend dataset " << dataset_name;
+  } else {
+    vector<hsize_t> max_dims(dims);
+    max_dims[0] = H5S_UNLIMITED;
+    // a chunk per batch
+    vector<hsize_t> chunk_dims(dims);
+    chunk_dims[0] = std::max<hsize_t>(dims[0], 1);
+    hid_t space_id = H5Screate_simple(num_axes, &dims[0], &max_dims[0]);
+    hid_t plist_id = H5Pcreate(H5P_DATASET_CREATE);
+    CHECK_GE(H5Pset_chunk(plist_id, num_axes, &chunk_dims[0]), 0);
+    dataset_id = H5Dcreate2(file_id, dataset_name, HDF5Type<Dtype>(),
+        space_id, H5P_DEFAULT, plist_id, H5P_DEFAULT);
+    H5Pclose(plist_id);
+    H5Sclose(space_id);
+    CHECK_GE(dataset_id, 0) << "Failed to make dataset " << dataset_name;
+  }
+  hid_t file_space_id = H5Dget_space(dataset_id);
+  CHECK_GE(H5Sselect_hyperslab(file_space_id, H5S_SELECT_SET, &start[0],
+      NULL, &dims[0], NULL), 0);
+  hid_t mem_space_id = H5Screate_simple(num_axes, &dims[0], NULL);
+  herr_t status = H5Dwrite(dataset_id, HDF5Type<Dtype>(), mem_space_id,
+      file_space_id, H5P_DEFAULT, blob.cpu_data());
+  CHECK_GE(status, 0) << "Failed to write dataset " << dataset_name;
+  H5Sclose(mem_space_id);
+  H5Sclose(file_space_id);
+  H5Dclose(dataset_id);
+}
+
+}  // namespace
+
 template <typename Dtype>
 void HDF5OutputLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
@@ -16,46 +108,87 @@ void HDF5OutputLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
                        H5P_DEFAULT);
   CHECK_GE(file_id_, 0) << "Failed to open HDF5 file" << file_name_;
   file_opened_ = true;
+  accumulate_ = this->layer_param_.hdf5_output_param().accumulate();
+  int queue_size = this->layer_param_.hdf5_output_param().queue_size();
+  CHECK_GE(queue_size, 0) << "queue_size cannot be negative";
+#ifndef H5_HAVE_THREADSAFE
+  // Other layers may call into HDF5 from the net thread at the same time.
+  if (queue_size > 0) {
+    LOG(WARNING) << "HDF5 is not thread-safe, " << file_name_
+                 << " is written synchronously";
+    queue_size = 0;
+  }
+#endif
+  writer_.reset(new AsyncWriter(queue_size));
 }
 
 template <typename Dtype>
 HDF5OutputLayer<Dtype>::~HDF5OutputLayer<Dtype>() {
   if (file_opened_) {
+    FlushOutput();
+    writer_.reset();
     herr_t status = H5Fclose(file_id_);
     CHECK_GE(status, 0) << "Failed to close HDF5 file " << file_name_;
   }
 }
 
 template <typename Dtype>
-void HDF5OutputLayer<Dtype>::SaveBlobs() {
+void HDF5OutputLayer<Dtype>::PushBatches() {
+  if (!data_batches_.empty()) {
+    writer_->Push(boost::bind(&HDF5OutputLayer<Dtype>::WriteBlobs, this,
+        data_batches_, label_batches_));
+    data_batches_.clear();
+    label_batches_.clear();
+  }
+}
+
+template <typename Dtype>
+void HDF5OutputLayer<Dtype>::FlushOutput() {
+  PushBatches();
+  writer_->Flush();
+}
+
+template <typename Dtype>
+void HDF5OutputLayer<Dtype>::SaveBlobs(const vector<Blob<Dtype>*>& bottom) {
+  CHECK_GE(bottom.size(), 2);
+  CHECK_EQ(bottom[0]->num(), bottom[1]->num());
+  shared_ptr<Blob<Dtype> > data(new Blob<Dtype>(bottom[0]->num(),
+      bottom[0]->channels(), bottom[0]->height(), bottom[0]->width()));
+  shared_ptr<Blob<Dtype> > label(new Blob<Dtype>(bottom[1]->num(),
+      bottom[1]->channels(), bottom[1]->height(), bottom[1]->width()));
+  caffe_copy(data->count(), bottom[0]->cpu_data(), data->mutable_cpu_data());
+  caffe_copy(label->count(), bottom[1]->cpu_data(),
+      label->mutable_cpu_data());
+  data_batches_.push_back(data);
+  label_batches_.push_back(label);
+  // queued without waiting; only FlushOutput waits for the writes
+  if (!accumulate_) {
+    PushBatches();
+  }
+}
+
+template <typename Dtype>
+void HDF5OutputLayer<Dtype>::WriteBlobs(
+    const vector<shared_ptr<Blob<Dtype> > >& data,
+    const vector<shared_ptr<Blob<Dtype> > >& label) {
   // TODO: no limit on the number of blobs
   LOG(INFO) << "Saving HDF5 file " << file_name_;
-  CHECK_EQ(data_blob_.num(), label_blob_.num()) <<
+  CHECK_EQ(data.size(), label.size());
+  Blob<Dtype> data_blob;
+  Blob<Dtype> label_blob;
+  ConcatBatches(data, &data_blob);
+  ConcatBatches(label, &label_blob);
+  CHECK_EQ(data_blob.num(), label_blob.num()) <<
       "data blob and label blob must have the same batch size";
-  hdf5_save_nd_dataset(file_id_, HDF5_DATA_DATASET_NAME, data_blob_);
-  hdf5_save_nd_dataset(file_id_, HDF5_DATA_LABEL_NAME, label_blob_);
-  LOG(INFO) << "Successfully saved " << data_blob_.num() << " rows";
+  AppendDataset(file_id_, HDF5_DATA_DATASET_NAME, data_blob);
+  AppendDataset(file_id_, HDF5_DATA_LABEL_NAME, label_blob);
+  LOG(INFO) << "Successfully saved " << data_blob.num() << " rows";
 }
 
 template <typename Dtype>
 void HDF5OutputLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
-  CHECK_GE(bottom.size(), 2);
-  CHECK_EQ(bottom[0]->num(), bottom[1]->num());
-  data_blob_.Reshape(bottom[0]->num(), bottom[0]->channels(),
-                     bottom[0]->height(), bottom[0]->width());
-  label_blob_.Reshape(bottom[1]->num(), bottom[1]->channels(),
-                     bottom[1]->height(), bottom[1]->width());
-  const int data_datum_dim = bottom[0]->count() / bottom[0]->num();
-  const int label_datum_dim = bottom[1]->count() / bottom[1]->num();
-
-  for (int i = 0; i < bottom[0]->num(); ++i) {
-    caffe_copy(data_datum_dim, &bottom[0]->cpu_data()[i * data_datum_dim],
-        &data_blob_.mutable_cpu_data()[i * data_datum_dim]);
-    caffe_copy(label_datum_dim, &bottom[1]->cpu_data()[i * label_datum_dim],
-        &label_blob_.mutable_cpu_data()[i * label_datum_dim]);
-  }
-  SaveBlobs();
+  SaveBlobs(bottom);
 }
 
 template <typename Dtype>
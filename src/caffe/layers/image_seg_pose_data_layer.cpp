@@ -5,6 +5,7 @@
 #include <vector>
 #include <algorithm>
 
+#include <boost/bind.hpp>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/highgui/highgui_c.h>
@@ -34,12 +35,6 @@ void ImageSegPoseDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bo
   const int label_type = this->layer_param_.image_data_param().label_type();
   string root_folder = this->layer_param_.image_data_param().root_folder();
   string posefile_ = this->layer_param_.image_data_param().posefile();
-  const int num_pose_ = this->layer_param_.image_data_param().num_pose();
-  CHECK(num_pose_ == 9) << 
-     "number of pose gt should be 9";  
-  TransformationParameter transform_param = this->layer_param_.transform_param();
-  CHECK(transform_param.has_mean_file() == false) << 
-         "ImageSegPoseDataLayer does not support mean file";
   CHECK((new_height == 0 && new_width == 0) ||
       (new_height > 0 && new_width > 0)) << "Current implementation requires "
       "new_height and new_width to be set at the same time.";
@@ -98,6 +93,19 @@ void ImageSegPoseDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bo
   cv::Mat cv_img = ReadImageToCVMat(root_folder + lines_[lines_id_].first.first,
                                     new_height, new_width, is_color);
   CHECK(cv_img.data) << "Could not load " << lines_[lines_id_].first.first;
+  ShapeTops(cv_img, this->layer_param_.image_data_param().batch_size(), top);
+}
+
+template <typename Dtype>
+void ImageSegPoseDataLayer<Dtype>::ShapeTops(const cv::Mat& cv_img,
+    const int batch_size, const vector<Blob<Dtype>*>& top) {
+  const int num_pose_ = this->layer_param_.image_data_param().num_pose();
+  CHECK(num_pose_ == 9) << 
+     "number of pose gt should be 9";  
+  const TransformationParameter& transform_param =
+      this->layer_param_.transform_param();
+  CHECK(transform_param.has_mean_file() == false) << 
+         "ImageSegPoseDataLayer does not support mean file";
 
   const int channels = cv_img.channels();
   const int height = cv_img.rows;
@@ -118,42 +126,41 @@ void ImageSegPoseDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bo
     crop_height = transform_param.crop_height();
   }
 
-  const int batch_size = this->layer_param_.image_data_param().batch_size();
   if (crop_width > 0 && crop_height > 0) {
     top[0]->Reshape(batch_size, channels, crop_height, crop_width);
     this->transformed_data_.Reshape(batch_size, channels, crop_height, crop_width);
-    for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
-      this->prefetch_[i].data_.Reshape(batch_size, channels, crop_height, crop_width);
+    for (int i = 0; i < this->prefetch_.size(); ++i) {
+      this->prefetch_[i]->data_.Reshape(batch_size, channels, crop_height, crop_width);
     }
 
     //label
     top[1]->Reshape(batch_size, 1, crop_height, crop_width);
     this->transformed_label_.Reshape(batch_size, 1, crop_height, crop_width);
-    for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
-      this->prefetch_[i].label_.Reshape(batch_size, 1, crop_height, crop_width);
+    for (int i = 0; i < this->prefetch_.size(); ++i) {
+      this->prefetch_[i]->label_.Reshape(batch_size, 1, crop_height, crop_width);
     }
   } else {
     top[0]->Reshape(batch_size, channels, height, width);
     this->transformed_data_.Reshape(batch_size, channels, height, width);
-    for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
-      this->prefetch_[i].data_.Reshape(batch_size, channels, height, width);
+    for (int i = 0; i < this->prefetch_.size(); ++i) {
+      this->prefetch_[i]->data_.Reshape(batch_size, channels, height, width);
     }
 
     //label
     top[1]->Reshape(batch_size, 1, height, width);
     this->transformed_label_.Reshape(batch_size, 1, height, width);
-    for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
-      this->prefetch_[i].label_.Reshape(batch_size, 1, height, width);
+    for (int i = 0; i < this->prefetch_.size(); ++i) {
+      this->prefetch_[i]->label_.Reshape(batch_size, 1, height, width);
     }
   }
   // image dimensions, for each image, stores (img_height, img_width)
   top[2]->Reshape(batch_size, 1, 1, 2);
-  for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
-    this->prefetch_[i].dim_.Reshape(batch_size, 1, 1, 2);
+  for (int i = 0; i < this->prefetch_.size(); ++i) {
+    this->prefetch_[i]->dim_.Reshape(batch_size, 1, 1, 2);
   }
   top[3]->Reshape(batch_size, 1, 1, num_pose_ * 2);
-  for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
-    this->prefetch_[i].pose_.Reshape(batch_size, 1, 1, num_pose_ * 2);
+  for (int i = 0; i < this->prefetch_.size(); ++i) {
+    this->prefetch_[i]->pose_.Reshape(batch_size, 1, 1, num_pose_ * 2);
   }
   LOG(INFO) << "output data size: " << top[0]->num() << ","
 	    << top[0]->channels() << "," << top[0]->height() << ","
@@ -170,6 +177,27 @@ void ImageSegPoseDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bo
   LOG(INFO) << "output pose size: " << top[3]->num() << ","
       << top[3]->channels() << "," << top[3]->height() << ","
       << top[3]->width();
+
+  // per sample state of the decode threads
+  item_lines_.resize(batch_size);
+  item_seeds_.resize(batch_size);
+  item_read_time_.resize(batch_size);
+  item_trans_time_.resize(batch_size);
+  item_transformers_.resize(batch_size);
+  item_data_.resize(batch_size);
+  item_label_.resize(batch_size);
+  for (int item_id = 0; item_id < batch_size; ++item_id) {
+    item_transformers_[item_id].reset(
+        new DataTransformer<Dtype>(transform_param, this->phase_));
+    item_data_[item_id].reset(new Blob<Dtype>(1, top[0]->channels(),
+        top[0]->height(), top[0]->width()));
+    item_label_[item_id].reset(new Blob<Dtype>(1, 1,
+        top[1]->height(), top[1]->width()));
+  }
+  decode_pool_.reset(new ThreadPool(
+      this->layer_param_.image_data_param().num_decode_threads()));
+  LOG(INFO) << "Decoding with " << decode_pool_->num_threads()
+      << " thread(s)";
 }
 
 template <typename Dtype>
@@ -198,12 +226,96 @@ template <typename Dtype>
 void ImageSegPoseDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   CPUTimer batch_timer;
   batch_timer.Start();
-  double read_time = 0;
-  double trans_time = 0;
-  CPUTimer timer;
   CHECK(batch->data_.count());
   CHECK(this->transformed_data_.count());
 
+  // Make sure the batch is on cpu before the decode threads access it.
+  batch->data_.mutable_cpu_data();
+  batch->label_.mutable_cpu_data();
+  batch->dim_.mutable_cpu_data();
+  batch->pose_.mutable_cpu_data();
+
+  const int batch_size = item_lines_.size();
+  // Pick the samples and their seeds in order, then decode them in parallel.
+  for (int item_id = 0; item_id < batch_size; ++item_id) {
+    PickSample(item_id);
+    item_seeds_[item_id] = caffe_rng_rand();
+  }
+  decode_pool_->Run(batch_size,
+      boost::bind(&ImageSegPoseDataLayer<Dtype>::LoadSample, this, batch, _1));
+
+  double read_time = 0;
+  double trans_time = 0;
+  for (int item_id = 0; item_id < batch_size; ++item_id) {
+    read_time += item_read_time_[item_id];
+    trans_time += item_trans_time_[item_id];
+  }
+  batch_timer.Stop();
+  DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
+  DLOG(INFO) << "     Read time: " << read_time / 1000 << " ms.";
+  DLOG(INFO) << "Transform time: " << trans_time / 1000 << " ms.";
+}
+
+template <typename Dtype>
+void ImageSegPoseDataLayer<Dtype>::PickSample(int item_id) {
+  const int lines_size = lines_.size();
+  CHECK_GT(lines_size, lines_id_);
+  item_lines_[item_id] = lines_[lines_id_];
+
+  // go to the next std::vector<int>::iterator iter;
+  lines_id_++;
+  if (lines_id_ >= lines_size) {
+    // We have reached the end. Restart from the first.
+    DLOG(INFO) << "Restarting data prefetching from start.";
+    lines_id_ = 0;
+    if (this->layer_param_.image_data_param().shuffle()) {
+      ShuffleImages();
+    }
+  }
+}
+
+template <typename Dtype>
+void ImageSegPoseDataLayer<Dtype>::ReadSample(int item_id,
+    std::vector<cv::Mat>* cv_img_seg, int* img_row, int* img_col) {
+  const ImageDataParameter& image_data_param =
+      this->layer_param_.image_data_param();
+  const int new_height = image_data_param.new_height();
+  const int new_width  = image_data_param.new_width();
+  const int label_type = image_data_param.label_type();
+  const int ignore_label = image_data_param.ignore_label();
+  const bool is_color  = image_data_param.is_color();
+  const string& root_folder = image_data_param.root_folder();
+  const std::pair<string, string>& line = item_lines_[item_id].first;
+
+  cv_img_seg->push_back(ReadImageToCVMat(root_folder + line.first,
+	new_height, new_width, is_color, img_row, img_col));
+  if (!(*cv_img_seg)[0].data) {
+    DLOG(INFO) << "Fail to load img: " << root_folder + line.first;
+  }
+  if (label_type == ImageDataParameter_LabelType_PIXEL) {
+    cv_img_seg->push_back(ReadImageToCVMat(root_folder + line.second,
+					   new_height, new_width, false));
+    if (!(*cv_img_seg)[1].data) {
+      DLOG(INFO) << "Fail to load seg: " << root_folder + line.second;
+    }
+  }
+  else if (label_type == ImageDataParameter_LabelType_IMAGE) {
+    const int label = atoi(line.second.c_str());
+    cv::Mat seg((*cv_img_seg)[0].rows, (*cv_img_seg)[0].cols, 
+		CV_8UC1, cv::Scalar(label));
+    cv_img_seg->push_back(seg);      
+  }
+  else {
+    cv::Mat seg((*cv_img_seg)[0].rows, (*cv_img_seg)[0].cols, 
+		CV_8UC1, cv::Scalar(ignore_label));
+    cv_img_seg->push_back(seg);
+  }
+}
+
+template <typename Dtype>
+void ImageSegPoseDataLayer<Dtype>::LoadSample(Batch<Dtype>* batch,
+    int item_id) {
+  CPUTimer timer;
   Dtype* top_data     = batch->data_.mutable_cpu_data();
   Dtype* top_label    = batch->label_.mutable_cpu_data(); 
   Dtype* top_data_dim = batch->dim_.mutable_cpu_data();
@@ -212,116 +324,67 @@ void ImageSegPoseDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   const int max_height = batch->data_.height();
   const int max_width  = batch->data_.width();
 
-  ImageDataParameter image_data_param = this->layer_param_.image_data_param();
-  const int batch_size = image_data_param.batch_size();
-  const int new_height = image_data_param.new_height();
-  const int new_width  = image_data_param.new_width();
-  const int label_type = this->layer_param_.image_data_param().label_type();
-  const int ignore_label = image_data_param.ignore_label();
-  const bool is_color  = image_data_param.is_color();
-  string root_folder   = image_data_param.root_folder();
+  const int ignore_label = this->layer_param_.image_data_param().ignore_label();
   const int num_pose_ = this->layer_param_.image_data_param().num_pose();
-  const int lines_size = lines_.size();
-  int top_data_dim_offset;
-  int top_pose_offset;
-  for (int item_id = 0; item_id < batch_size; ++item_id) {
-    //set pose harding coding
-    // LOG(INFO) << lines_[lines_id_].first.first;
-    top_pose_offset = batch->pose_.offset(item_id);
-    std::vector< float> pose_label = lines_[lines_id_].second;
-    float transformed_pose[num_pose_*2];
-    transformed_pose[0] = pose_label[9*2];    // [0]head 
-    transformed_pose[1] = pose_label[9*2+1];  //10,heat
-    transformed_pose[2] = compute(pose_label[7*2], pose_label[8*2], 0);      //  [1]upperbody
-    transformed_pose[3] = compute(pose_label[7*2+1], pose_label[8*2+1], 0);  // 8,spine 9,neck
-    transformed_pose[4] = compute(pose_label[2*2], pose_label[3*2], pose_label[6*2]);        // [2]lowerbody
-    transformed_pose[5] = compute(pose_label[2*2+1], pose_label[3*2+1], pose_label[6*2+1]);  // 7,pelvis 3,rhip 4,lhip
-    transformed_pose[6] = compute(pose_label[13*2], pose_label[14*2], pose_label[15*2]);        // [3]leftarm
-    transformed_pose[7] = compute(pose_label[13*2+1], pose_label[14*2+1], pose_label[15*2+1]);  // 14,lshoulder 15,lelbow 16,lwrist
-    transformed_pose[8] = compute(pose_label[10*2], pose_label[11*2], pose_label[12*2]);        // [4]rightarm
-    transformed_pose[9] = compute(pose_label[10*2+1], pose_label[11*2+1], pose_label[12*2+1]);  // 11,rwrist 12,relbow 13,rshoulder
-    transformed_pose[10] = pose_label[4*2];    // [5]leftleg 
-    transformed_pose[11] = pose_label[4*2+1];  // 5,lknee
-    transformed_pose[12] = pose_label[1*2];    // [6]rightleg 
-    transformed_pose[13] = pose_label[1*2+1];  // 2,rknee
-    transformed_pose[14] = pose_label[5*2];    // [7]leftshoe 
-    transformed_pose[15] = pose_label[5*2+1];  // 6,lankle
-    transformed_pose[16] = pose_label[0*2];    // [8]rightshoe 
-    transformed_pose[17] = pose_label[0*2+1];  // 1,rankle
-    for (int p = 0; p < num_pose_*2; ++p) {
-      top_pose[top_pose_offset + p] = static_cast<Dtype>(transformed_pose[p] / 8.0);
-      // LOG(INFO) << p << " points: " << pose_label[p];
-    }
-    //
-    top_data_dim_offset = batch->dim_.offset(item_id);
 
-    std::vector<cv::Mat> cv_img_seg;
+  //set pose harding coding
+  const int top_pose_offset = batch->pose_.offset(item_id);
+  const std::vector<float>& pose_label = item_lines_[item_id].second;
+  float transformed_pose[num_pose_*2];
+  transformed_pose[0] = pose_label[9*2];    // [0]head 
+  transformed_pose[1] = pose_label[9*2+1];  //10,heat
+  transformed_pose[2] = compute(pose_label[7*2], pose_label[8*2], 0);      //  [1]upperbody
+  transformed_pose[3] = compute(pose_label[7*2+1], pose_label[8*2+1], 0);  // 8,spine 9,neck
+  transformed_pose[4] = compute(pose_label[2*2], pose_label[3*2], pose_label[6*2]);        // [2]lowerbody
+  transformed_pose[5] = compute(pose_label[2*2+1], pose_label[3*2+1], pose_label[6*2+1]);  // 7,pelvis 3,rhip 4,lhip
+  transformed_pose[6] = compute(pose_label[13*2], pose_label[14*2], pose_label[15*2]);        // [3]leftarm
+  transformed_pose[7] = compute(pose_label[13*2+1], pose_label[14*2+1], pose_label[15*2+1]);  // 14,lshoulder 15,lelbow 16,lwrist
+  transformed_pose[8] = compute(pose_label[10*2], pose_label[11*2], pose_label[12*2]);        // [4]rightarm
+  transformed_pose[9] = compute(pose_label[10*2+1], pose_label[11*2+1], pose_label[12*2+1]);  // 11,rwrist 12,relbow 13,rshoulder
+  transformed_pose[10] = pose_label[4*2];    // [5]leftleg 
+  transformed_pose[11] = pose_label[4*2+1];  // 5,lknee
+  transformed_pose[12] = pose_label[1*2];    // [6]rightleg 
+  transformed_pose[13] = pose_label[1*2+1];  // 2,rknee
+  transformed_pose[14] = pose_label[5*2];    // [7]leftshoe 
+  transformed_pose[15] = pose_label[5*2+1];  // 6,lankle
+  transformed_pose[16] = pose_label[0*2];    // [8]rightshoe 
+  transformed_pose[17] = pose_label[0*2+1];  // 1,rankle
+  for (int p = 0; p < num_pose_*2; ++p) {
+    top_pose[top_pose_offset + p] = static_cast<Dtype>(transformed_pose[p] / 8.0);
+    // LOG(INFO) << p << " points: " << pose_label[p];
+  }
+  //
+  const int top_data_dim_offset = batch->dim_.offset(item_id);
 
-    // get a blob
-    timer.Start();
-    CHECK_GT(lines_size, lines_id_);
+  std::vector<cv::Mat> cv_img_seg;
 
-    int img_row, img_col;
-    cv_img_seg.push_back(ReadImageToCVMat(root_folder + lines_[lines_id_].first.first,
-	  new_height, new_width, is_color, &img_row, &img_col));
+  // get a blob
+  timer.Start();
 
-    // TODO(jay): implement resize in ReadImageToCVMat
-    // NOTE data_dim may not work when min_scale and max_scale != 1
-    top_data_dim[top_data_dim_offset]     = static_cast<Dtype>(std::min(max_height, img_row));
-    top_data_dim[top_data_dim_offset + 1] = static_cast<Dtype>(std::min(max_width, img_col));
+  int img_row, img_col;
+  ReadSample(item_id, &cv_img_seg, &img_row, &img_col);
 
-    if (!cv_img_seg[0].data) {
-      DLOG(INFO) << "Fail to load img: " << root_folder + lines_[lines_id_].first.first;
-    }
-    if (label_type == ImageDataParameter_LabelType_PIXEL) {
-      cv_img_seg.push_back(ReadImageToCVMat(root_folder + lines_[lines_id_].first.second,
-					    new_height, new_width, false));
-      if (!cv_img_seg[1].data) {
-	DLOG(INFO) << "Fail to load seg: " << root_folder + lines_[lines_id_].first.second;
-      }
-    }
-    else if (label_type == ImageDataParameter_LabelType_IMAGE) {
-      const int label = atoi(lines_[lines_id_].first.second.c_str());
-      cv::Mat seg(cv_img_seg[0].rows, cv_img_seg[0].cols, 
-		  CV_8UC1, cv::Scalar(label));
-      cv_img_seg.push_back(seg);      
-    }
-    else {
-      cv::Mat seg(cv_img_seg[0].rows, cv_img_seg[0].cols, 
-		  CV_8UC1, cv::Scalar(ignore_label));
-      cv_img_seg.push_back(seg);
-    }
+  // TODO(jay): implement resize in ReadImageToCVMat
+  // NOTE data_dim may not work when min_scale and max_scale != 1
+  top_data_dim[top_data_dim_offset]     = static_cast<Dtype>(std::min(max_height, img_row));
+  top_data_dim[top_data_dim_offset + 1] = static_cast<Dtype>(std::min(max_width, img_col));
 
-    read_time += timer.MicroSeconds();
-    timer.Start();
-    // Apply transformations (mirror, crop...) to the image
-    int offset;
-    offset = batch->data_.offset(item_id);
-    this->transformed_data_.set_cpu_data(top_data + offset);
-
-    offset = batch->label_.offset(item_id);
-    this->transformed_label_.set_cpu_data(top_label + offset);
-
-    this->data_transformer_->TransformImgAndSeg(cv_img_seg, 
-	 &(this->transformed_data_), &(this->transformed_label_),
-	 ignore_label);
-    trans_time += timer.MicroSeconds();
-
-    // go to the next std::vector<int>::iterator iter;
-    lines_id_++;
-    if (lines_id_ >= lines_size) {
-      // We have reached the end. Restart from the first.
-      DLOG(INFO) << "Restarting data prefetching from start.";
-      lines_id_ = 0;
-      if (this->layer_param_.image_data_param().shuffle()) {
-	ShuffleImages();
-      }
-    }
-  }
-  batch_timer.Stop();
-  DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
-  DLOG(INFO) << "     Read time: " << read_time / 1000 << " ms.";
-  DLOG(INFO) << "Transform time: " << trans_time / 1000 << " ms.";
+
+  item_read_time_[item_id] = timer.MicroSeconds();
+  timer.Start();
+  // Apply transformations (mirror, crop...) to the image
+  int offset;
+  offset = batch->data_.offset(item_id);
+  item_data_[item_id]->set_cpu_data(top_data + offset);
+
+  offset = batch->label_.offset(item_id);
+  item_label_[item_id]->set_cpu_data(top_label + offset);
+
+  item_transformers_[item_id]->InitRand(item_seeds_[item_id]);
+  item_transformers_[item_id]->TransformImgAndSeg(cv_img_seg, 
+       item_data_[item_id].get(), item_label_[item_id].get(),
+       ignore_label);
+  item_trans_time_[item_id] = timer.MicroSeconds();
 }
 
 INSTANTIATE_CLASS(ImageSegPoseDataLayer);
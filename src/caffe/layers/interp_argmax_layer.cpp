@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "boost/bind.hpp"
+
+#include "caffe/layers/interp_argmax_layer.hpp"
+#include "caffe/util/argmax.hpp"
+#include "caffe/util/interp.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void InterpArgMaxLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  this->SetUpOutputSize(bottom);
+  for (int i = 0; i < top.size(); ++i) {
+    top[i]->Reshape(this->num_, 1, this->height_out_, this->width_out_);
+  }
+  // about 64K interpolated scores per block
+  block_rows_ = std::max(1, std::min(this->height_out_,
+      65536 / (this->channels_ * this->width_out_)));
+  // a few chunks per thread to even out the load
+  const int num_threads = this->thread_pool_->num_threads();
+  row_chunks_ = num_threads == 1 ? 1 : std::min(this->height_out_,
+      (4 * num_threads + this->num_ - 1) / this->num_);
+  this->num_tasks_ = this->num_ * row_chunks_;
+}
+
+template <typename Dtype>
+void InterpArgMaxLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  // Make sure the data are on cpu before worker threads access them.
+  bottom[0]->cpu_data();
+  for (int i = 0; i < top.size(); ++i) {
+    top[i]->mutable_cpu_data();
+  }
+  this->thread_pool_->Run(this->num_tasks_,
+      boost::bind(&InterpArgMaxLayer<Dtype>::ForwardRows, this,
+                  boost::cref(bottom), boost::cref(top), _1));
+}
+
+template <typename Dtype>
+void InterpArgMaxLayer<Dtype>::ForwardRows(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top, int t) {
+  const int n = t / row_chunks_;
+  const int chunk = t % row_chunks_;
+  const int height = this->height_out_;
+  const int width = this->width_out_;
+  const int channels = this->channels_;
+  const int row_begin = chunk * height / row_chunks_;
+  const int row_end = (chunk + 1) * height / row_chunks_;
+  const Dtype* bottom_data = bottom[0]->cpu_data() +
+      bottom[0]->offset(n);
+  Dtype* label = top[0]->mutable_cpu_data() + top[0]->offset(n);
+  Dtype* prob = top.size() > 1 ?
+      top[1]->mutable_cpu_data() + top[1]->offset(n) : NULL;
+
+  vector<Dtype> score(channels * block_rows_ * width);
+  vector<Dtype> max_score(block_rows_ * width);
+  vector<int> argmax(block_rows_ * width);
+  vector<Dtype> sum(prob ? block_rows_ * width : 0);
+  for (int h = row_begin; h < row_end; h += block_rows_) {
+    const int num_rows = std::min(block_rows_, row_end - h);
+    const int count = num_rows * width;
+    caffe_cpu_interp2_rows<Dtype>(channels, bottom_data,
+        -this->pad_beg_, -this->pad_beg_, this->height_in_eff_,
+        this->width_in_eff_, this->height_in_, this->width_in_,
+        &score[0], height, width, h, h + num_rows);
+    caffe_cpu_channel_argmax(channels, count, count, &score[0],
+                             &max_score[0], &argmax[0]);
+    for (int i = 0; i < count; ++i) {
+      label[h * width + i] = argmax[i];
+    }
+    if (prob) {
+      std::fill(sum.begin(), sum.begin() + count, Dtype(0));
+      for (int c = 0; c < channels; ++c) {
+        const Dtype* score_c = &score[c * count];
+        for (int i = 0; i < count; ++i) {
+          sum[i] += std::exp(score_c[i] - max_score[i]);
+        }
+      }
+      for (int i = 0; i < count; ++i) {
+        prob[h * width + i] = Dtype(1) / sum[i];
+      }
+    }
+  }
+}
+
+INSTANTIATE_CLASS(InterpArgMaxLayer);
+REGISTER_LAYER_CLASS(InterpArgMax);
+
+}  // namespace caffe
@@ -1,5 +1,8 @@
+#include <algorithm>
 #include <vector>
 
+#include "boost/bind.hpp"
+
 #include "caffe/layer.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/interp.hpp"
@@ -15,11 +18,21 @@ void InterpLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   pad_end_ = interp_param.pad_end();
   CHECK_LE(pad_beg_, 0) << "Only supports non-pos padding (cropping) for now";
   CHECK_LE(pad_end_, 0) << "Only supports non-pos padding (cropping) for now";
+  thread_pool_.reset(new ThreadPool(interp_param.num_threads()));
 }
 
 template <typename Dtype>
 void InterpLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+  SetUpOutputSize(bottom);
+  top[0]->Reshape(num_, channels_, height_out_, width_out_);
+  // a few chunks per thread to even out the load
+  num_tasks_ = thread_pool_->num_threads() == 1 ? 1 :
+      std::min(num_ * channels_, 4 * thread_pool_->num_threads());
+}
+
+template <typename Dtype>
+void InterpLayer<Dtype>::SetUpOutputSize(const vector<Blob<Dtype>*>& bottom) {
   num_ = bottom[0]->num();
   channels_ = bottom[0]->channels();
   height_in_ = bottom[0]->height();
@@ -59,25 +72,52 @@ void InterpLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   CHECK_GT(width_in_eff_, 0) << "width should be positive";
   CHECK_GT(height_out_, 0) << "height should be positive";
   CHECK_GT(width_out_, 0) << "width should be positive";
-  top[0]->Reshape(num_, channels_, height_out_, width_out_);
 }
 
 template <typename Dtype>
 void InterpLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
-  caffe_cpu_interp2<Dtype,false>(num_ * channels_,
-    bottom[0]->cpu_data(), - pad_beg_, - pad_beg_, height_in_eff_, width_in_eff_, height_in_, width_in_,
-    top[0]->mutable_cpu_data(), 0, 0, height_out_, width_out_, height_out_, width_out_);
+  // Make sure the data are on cpu before worker threads access them.
+  bottom[0]->cpu_data();
+  top[0]->mutable_cpu_data();
+  thread_pool_->Run(num_tasks_,
+      boost::bind(&InterpLayer<Dtype>::ForwardChunk, this,
+                  boost::cref(bottom), boost::cref(top), _1));
+}
+
+template <typename Dtype>
+void InterpLayer<Dtype>::ForwardChunk(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top, int t) {
+  const int begin = t * num_ * channels_ / num_tasks_;
+  const int end = (t + 1) * num_ * channels_ / num_tasks_;
+  if (begin == end) { return; }
+  caffe_cpu_interp2<Dtype,false>(end - begin,
+    bottom[0]->cpu_data() + begin * height_in_ * width_in_, - pad_beg_, - pad_beg_, height_in_eff_, width_in_eff_, height_in_, width_in_,
+    top[0]->mutable_cpu_data() + begin * height_out_ * width_out_, 0, 0, height_out_, width_out_, height_out_, width_out_);
 }
 
 template <typename Dtype>
 void InterpLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
   if (!propagate_down[0]) { return; }
-  caffe_set(bottom[0]->count(), Dtype(0), bottom[0]->mutable_cpu_diff());
-  caffe_cpu_interp2_backward<Dtype,false>(num_ * channels_,
-    bottom[0]->mutable_cpu_diff(), - pad_beg_, - pad_beg_, height_in_eff_, width_in_eff_, height_in_, width_in_,
-    top[0]->cpu_diff(), 0, 0, height_out_, width_out_, height_out_, width_out_);
+  top[0]->cpu_diff();
+  bottom[0]->mutable_cpu_diff();
+  thread_pool_->Run(num_tasks_,
+      boost::bind(&InterpLayer<Dtype>::BackwardChunk, this,
+                  boost::cref(top), boost::cref(bottom), _1));
+}
+
+template <typename Dtype>
+void InterpLayer<Dtype>::BackwardChunk(const vector<Blob<Dtype>*>& top,
+      const vector<Blob<Dtype>*>& bottom, int t) {
+  const int begin = t * num_ * channels_ / num_tasks_;
+  const int end = (t + 1) * num_ * channels_ / num_tasks_;
+  if (begin == end) { return; }
+  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff() + begin * height_in_ * width_in_;
+  caffe_set((end - begin) * height_in_ * width_in_, Dtype(0), bottom_diff);
+  caffe_cpu_interp2_backward<Dtype,false>(end - begin,
+    bottom_diff, - pad_beg_, - pad_beg_, height_in_eff_, width_in_eff_, height_in_, width_in_,
+    top[0]->cpu_diff() + begin * height_out_ * width_out_, 0, 0, height_out_, width_out_, height_out_, width_out_);
 }
 
 #ifndef CPU_ONLY
@@ -1,27 +1,39 @@
+#include <boost/thread.hpp>
+#include <fstream>  // NOLINT(readability/streams)
+#include <sstream>
+#include <string>
+#include <utility>
 #include <vector>
 
+#include "boost/bind.hpp"
+
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/layers/mat_read_layer.hpp"
-#include "caffe/syncedmem.hpp"
+#include "caffe/util/math_functions.hpp"
 #include "caffe/util/matio_io.hpp"
-#include <sstream>
 
 namespace caffe {
 
 template <typename Dtype>
-void MatReadLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+MatReadLayer<Dtype>::~MatReadLayer<Dtype>() {
+  this->StopInternalThread();
+}
+
+template <typename Dtype>
+void MatReadLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
 				      const vector<Blob<Dtype>*>& top) {
-  prefix_ = this->layer_param_.mat_read_param().prefix();
-  batch_size_ = this->layer_param_.mat_read_param().batch_size();
+  const MatReadParameter& mat_read_param = this->layer_param_.mat_read_param();
+  prefix_ = mat_read_param.prefix();
+  batch_size_ = mat_read_param.batch_size();
   CHECK_GT(batch_size_, 0) << "batch_size must be positive";
-  reshape_ = false;
   iter_ = 0;
-  if (this->layer_param_.mat_read_param().has_source()) {
-    std::ifstream infile(this->layer_param_.mat_read_param().source().c_str());
+  num_tops_ = top.size();
+  if (mat_read_param.has_source()) {
+    std::ifstream infile(mat_read_param.source().c_str());
     CHECK(infile.good()) << "Failed to open source file "
-			 << this->layer_param_.mat_read_param().source();
-    const int strip = this->layer_param_.mat_read_param().strip();
+			 << mat_read_param.source();
+    const int strip = mat_read_param.strip();
     CHECK_GE(strip, 0) << "Strip cannot be negative";
     string linestr;
     while (std::getline(infile, linestr)) {
@@ -33,71 +45,140 @@ void MatReadLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     }
     LOG(INFO) << "MatRead will load from a set of " << fnames_.size() << " files.";
     CHECK_GT(fnames_.size(), 0);
+    num_samples_ = fnames_.size();
+  } else {
+    // The files "iter_<k>" are read up to the first missing one, so that the
+    // prefetch thread never reads ahead past the end of the set.
+    num_samples_ = 0;
+    while (SampleExists(num_samples_)) {
+      ++num_samples_;
+    }
+    LOG(INFO) << "MatRead will load from a set of " << num_samples_
+              << " iterations.";
+    CHECK_GT(num_samples_, 0) << "Missing file " << FileName(0, 0);
   }
+  cache_size_ = mat_read_param.cache_size();
+  CHECK_GE(cache_size_, 0) << "cache_size cannot be negative";
+  cache_mutex_.reset(new boost::mutex());
+  cache_hits_ = cache_misses_ = 0;
+  read_pool_.reset(new ThreadPool(mat_read_param.num_threads()));
+  item_sample_.resize(batch_size_);
+  LOG(INFO) << "MatRead reading with " << read_pool_->num_threads()
+            << " threads, caching " << cache_size_ << " blobs.";
 
   // Read an input, and use it to initialize the top blob.
   for (int i = 0; i < top.size(); ++i) {
-    std::ostringstream oss;
-    oss << prefix_;
-    oss << fnames_[0];
-    oss << "_blob_" << i << ".mat";
-    Blob<Dtype> blob;
-    ReadBlobFromMat(oss.str().c_str(), &blob);
-    CHECK_EQ(blob.num(), 1);
-    LOG(INFO) << "Matread setup top info: " << batch_size_ << "," <<  blob.channels() << "," << blob.height() << "," << blob.width();
-    top[i]->Reshape(batch_size_, blob.channels(), blob.height(), blob.width());
-    
+    shared_ptr<Blob<Dtype> > blob = ReadBlob(FileName(0, i));
+    CHECK_EQ(blob->num(), 1);
+    LOG(INFO) << "Matread setup top info: " << batch_size_ << "," <<  blob->channels() << "," << blob->height() << "," << blob->width();
+    top[i]->Reshape(batch_size_, blob->channels(), blob->height(), blob->width());
+    for (int j = 0; j < this->prefetch_.size(); ++j) {
+      Blob<Dtype>& prefetch_blob = (i == 0) ?
+          this->prefetch_[j]->data_ : this->prefetch_[j]->label_;
+      prefetch_blob.ReshapeLike(*top[i]);
+    }
   }
 }
 
 template <typename Dtype>
-void MatReadLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
-      const vector<Blob<Dtype>*>& top) {
-  // reshape_ = true;  // iter_ = 0;
-  //Forward_cpu(bottom, top);
-  //reshape_ = false; // iter_ = 0;
+string MatReadLayer<Dtype>::FileName(int k, int i) const {
+  std::ostringstream oss;
+  oss << prefix_;
+  if (fnames_.size() > 0) {
+    oss << fnames_[k];
+  }
+  else {
+    oss << "iter_" << k;
+  }
+  oss << "_blob_" << i << ".mat";
+  return oss.str();
 }
 
 template <typename Dtype>
-void MatReadLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
-    const vector<Blob<Dtype>*>& top) {
-  for (int n = 0; n < batch_size_; ++n) {
-    for (int i = 0; i < top.size(); ++i) {
-      std::ostringstream oss;
-      oss << prefix_;
-      if (this->layer_param_.mat_read_param().has_source()) {
-	if (iter_ >= fnames_.size()) {
-	  iter_ = 0;
-	}
-	oss << fnames_[iter_];
-      }
-      else {
-	oss << "iter_" << iter_;
-      }
-      oss << "_blob_" << i << ".mat";
-      Blob<Dtype> blob;
-      ReadBlobFromMat(oss.str().c_str(), &blob);
-      CHECK_EQ(blob.num(), 1);
-      if (reshape_) {
-	top[i]->Reshape(batch_size_, blob.channels(), blob.height(), blob.width());
-      }
-      else {
-	CHECK(blob.channels()  == top[i]->channels()
-	      && blob.height() == top[i]->height() 
-	      && blob.width()  == top[i]->width());
+bool MatReadLayer<Dtype>::SampleExists(int k) const {
+  for (int i = 0; i < num_tops_; ++i) {
+    if (!std::ifstream(FileName(k, i).c_str()).good()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename Dtype>
+shared_ptr<Blob<Dtype> > MatReadLayer<Dtype>::ReadBlob(const string& fname) {
+  if (cache_size_ > 0) {
+    boost::mutex::scoped_lock lock(*cache_mutex_);
+    typename std::map<string, typename CacheList::iterator>::iterator it =
+        cache_index_.find(fname);
+    if (it != cache_index_.end()) {
+      cache_.splice(cache_.begin(), cache_, it->second);
+      ++cache_hits_;
+      return it->second->second;
+    }
+  }
+  // Read outside of the lock, so that the readers overlap.
+  shared_ptr<Blob<Dtype> > blob(new Blob<Dtype>());
+  ReadBlobFromMat(fname.c_str(), blob.get());
+  if (cache_size_ > 0) {
+    boost::mutex::scoped_lock lock(*cache_mutex_);
+    ++cache_misses_;
+    if (cache_index_.find(fname) == cache_index_.end()) {
+      cache_.push_front(std::make_pair(fname, blob));
+      cache_index_[fname] = cache_.begin();
+      if (cache_.size() > cache_size_) {
+        cache_index_.erase(cache_.back().first);
+        cache_.pop_back();
       }
-      caffe_copy(blob.count(), blob.cpu_data(),
-	  top[i]->mutable_cpu_data_at(n));
     }
-    ++iter_;
   }
+  return blob;
+}
+
+template <typename Dtype>
+int MatReadLayer<Dtype>::cache_hits() const {
+  boost::mutex::scoped_lock lock(*cache_mutex_);
+  return cache_hits_;
+}
+
+template <typename Dtype>
+int MatReadLayer<Dtype>::cache_misses() const {
+  boost::mutex::scoped_lock lock(*cache_mutex_);
+  return cache_misses_;
 }
 
+// This function is called on prefetch thread
 template <typename Dtype>
-void MatReadLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
-    const vector<bool>& propagate_down,
-    const vector<Blob<Dtype>*>& bottom) {
-  return;
+void MatReadLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
+  CHECK(batch->data_.count());
+  for (int n = 0; n < batch_size_; ++n) {
+    if (iter_ >= num_samples_) {
+      iter_ = 0;
+    }
+    item_sample_[n] = iter_++;
+  }
+  // Make sure the data are on cpu before worker threads access them.
+  batch->data_.mutable_cpu_data();
+  if (num_tops_ > 1) {
+    batch->label_.mutable_cpu_data();
+  }
+  read_pool_->Run(batch_size_,
+      boost::bind(&MatReadLayer<Dtype>::LoadItem, this, batch, _1));
+}
+
+template <typename Dtype>
+void MatReadLayer<Dtype>::LoadItem(Batch<Dtype>* batch, int n) {
+  for (int i = 0; i < num_tops_; ++i) {
+    const string fname = FileName(item_sample_[n], i);
+    shared_ptr<Blob<Dtype> > blob = ReadBlob(fname);
+    Blob<Dtype>& top = (i == 0) ? batch->data_ : batch->label_;
+    CHECK_EQ(blob->num(), 1) << fname;
+    CHECK(blob->channels()  == top.channels()
+	  && blob->height() == top.height()
+	  && blob->width()  == top.width())
+        << "The blobs of a top should have the same shape: " << fname;
+    caffe_copy(blob->count(), blob->cpu_data(),
+	top.mutable_cpu_data() + top.offset(n));
+  }
 }
 
 INSTANTIATE_CLASS(MatReadLayer);
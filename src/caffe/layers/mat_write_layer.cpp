@@ -1,3 +1,5 @@
+#include <boost/bind.hpp>
+
 #include <sstream>
 #include <vector>
 
@@ -13,6 +15,10 @@ void MatWriteLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   prefix_ = this->layer_param_.mat_write_param().prefix();
   period_ = this->layer_param_.mat_write_param().period();
   CHECK_GT(period_, 0) << "period must be positive";
+  compression_ = this->layer_param_.mat_write_param().compression();
+  const int queue_size = this->layer_param_.mat_write_param().queue_size();
+  CHECK_GE(queue_size, 0) << "queue_size cannot be negative";
+  writer_.reset(new AsyncWriter(queue_size));
   if (this->layer_param_.mat_write_param().has_source()) {
     std::ifstream infile(this->layer_param_.mat_write_param().source().c_str());
     CHECK(infile.good()) << "Failed to open source file "
@@ -31,6 +37,18 @@ void MatWriteLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+template <typename Dtype>
+MatWriteLayer<Dtype>::~MatWriteLayer() {
+  FlushOutput();
+}
+
+template <typename Dtype>
+void MatWriteLayer<Dtype>::FlushOutput() {
+  if (writer_) {
+    writer_->Flush();
+  }
+}
+
 template <typename Dtype>
 void MatWriteLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -51,12 +69,26 @@ void MatWriteLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
 	oss << "iter_" << iter_;
       }
       oss << "_blob_" << i << ".mat";
-      WriteBlobToMat(oss.str().c_str(), false, bottom[i]);
+      if (writer_->max_pending() == 0) {
+        WriteBlobToMat(oss.str().c_str(), false, bottom[i], compression_);
+        continue;
+      }
+      // The bottom is overwritten by the next forward pass: write a copy.
+      shared_ptr<Blob<Dtype> > snapshot(new Blob<Dtype>());
+      snapshot->CopyFrom(*bottom[i], false, true);
+      writer_->Push(boost::bind(&MatWriteLayer<Dtype>::WriteBlob, this,
+          oss.str(), snapshot));
     }
   }
   ++iter_;
 }
 
+template <typename Dtype>
+void MatWriteLayer<Dtype>::WriteBlob(const string& fname,
+    shared_ptr<Blob<Dtype> > blob) {
+  WriteBlobToMat(fname.c_str(), false, blob.get(), compression_);
+}
+
 template <typename Dtype>
 void MatWriteLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down,
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cmath>
 #include <functional>
 #include <utility>
 #include <vector>
@@ -13,7 +14,12 @@ namespace caffe {
 template <typename Dtype>
 void PoseCreateLayer<Dtype>::LayerSetUp(
   const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  	num_joint_ = this->layer_param_.pose_create_param().num_joint();
+  num_joint_ = this->layer_param_.pose_create_param().num_joint();
+  sigma_ = this->layer_param_.pose_create_param().sigma();
+  CHECK_GT(sigma_, 0) << "sigma should be positive.";
+  CHECK_GE(this->layer_param_.pose_create_param().truncate(), 0)
+      << "truncate should be non negative.";
+  radius_ = -1;
 }
 
 template <typename Dtype>
@@ -22,6 +28,20 @@ void PoseCreateLayer<Dtype>::Reshape(
   CHECK_EQ(bottom[0]->width(), num_joint_ * 2)
 		<< "The bottom width and num of joint should have the same number.";
   top[0]->Reshape(bottom[1]->num(), num_joint_, bottom[1]->height(), bottom[1]->width());
+
+  // Beyond the window of the joint the heatmap is zero; over the whole map
+  // no offset is larger than its size.
+  const int max_dim = std::max(bottom[1]->height(), bottom[1]->width());
+  const float truncate = this->layer_param_.pose_create_param().truncate();
+  const int radius = truncate > 0 ?
+      std::min(static_cast<int>(ceil(truncate * sigma_)), max_dim) : max_dim;
+  if (radius != radius_) {
+    radius_ = radius;
+    gaussian_.resize(2 * radius_ + 1);
+    for (int d = -radius_; d <= radius_; ++d) {
+      gaussian_[radius_ + d] = exp(-0.5 * d * d / (sigma_ * sigma_));
+    }
+  }
 }
 
 template <typename Dtype>
@@ -34,24 +54,30 @@ void PoseCreateLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   int num = bottom[1]->num();
   int height = bottom[1]->height();
   int width = bottom[1]->width();
-  float sigma = 1.0;  //////////// 1.0;
+  // 4 times the peak of the 1-D normal density
+  const Dtype peak = 4 / (sigma_ * sqrt(2 * M_PI));
+  const Dtype* gaussian = &gaussian_[radius_];
 
+  caffe_set(top[0]->count(), Dtype(0), top_data);
   for (int i = 0; i < num; ++i) {
     for (int n = 0; n < num_joint_; ++n) {
       int center_x = int(bottom_data[n * 2]);
       int center_y = int(bottom_data[n * 2 + 1]);
-      for (int yy = 0; yy < height; yy++) {
-        for (int xx = 0; xx < width; xx++) {
-          int index = (n * height + yy) * width + xx;
-          if (center_x == 0 && center_y == 0) {
-            top_data[index] = 0;
-          } else {
-            float gaussian = (1 / (sigma * sqrt(2 * M_PI))) *
-                  exp(-0.5 * (pow(yy-center_y, 2.0) + pow(xx-center_x, 2.0)) *
-                  pow(1/sigma, 2.0));
-            gaussian = 4 * gaussian;     ///4
-            top_data[index] = gaussian;
-          }
+      if (center_x == 0 && center_y == 0) {
+        continue;
+      }
+      // The map is the outer product of the 1-D Gaussians of the rows and
+      // of the columns, within the window of the joint.
+      const int y_begin = std::max(center_y - radius_, 0);
+      const int y_end = std::min(center_y + radius_ + 1, height);
+      const int x_begin = std::max(center_x - radius_, 0);
+      const int x_end = std::min(center_x + radius_ + 1, width);
+      const Dtype* column = gaussian - center_x;
+      for (int yy = y_begin; yy < y_end; ++yy) {
+        const Dtype row_scale = peak * gaussian[yy - center_y];
+        Dtype* row = top_data + (n * height + yy) * width;
+        for (int xx = x_begin; xx < x_end; ++xx) {
+          row[xx] = row_scale * column[xx];
         }
       }
     }
@@ -60,11 +86,6 @@ void PoseCreateLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
-
-#ifdef CPU_ONLY
-STUB_GPU(PoseCreateLayer);
-#endif
-
 INSTANTIATE_CLASS(PoseCreateLayer);
 REGISTER_LAYER_CLASS(PoseCreate);
 
@@ -2,28 +2,17 @@
 #include <functional>
 #include <utility>
 #include <vector>
-#include <numeric>
+
+#include <boost/bind.hpp>
 
 #include "caffe/layer.hpp"
+#include "caffe/util/argmax.hpp"
 #include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/layers/pose_evaluate_layer.hpp"
 
 namespace caffe {
 
-template <typename Dtype>
-void PoseEvaluateLayer<Dtype>::LayerSetUp(
-  const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-    num_joint_ = this->layer_param_.pose_evaluate_param().num_joint();
-}
-
-template <typename Dtype>
-void PoseEvaluateLayer<Dtype>::Reshape(
-  const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  CHECK_EQ(bottom[0]->channels(), 1)
-    << "The bottom channels should be 1.";
-  top[0]->Reshape(bottom[0]->num(), 1, 1, num_joint_ * 2);  
-}
 int clsToJointFirst(int cls_) {
   switch(cls_) {
     case 1:  return 0; break;
@@ -70,49 +59,103 @@ int selectJointFun(int num_joint_, int cls_) {
     LOG(FATAL) << "Unexpected num_joint " << num_joint_;
   }
 }
+// label maps hold 8 bit labels
+static const int kNumLabels = 256;
+
+template <typename Dtype>
+void PoseEvaluateLayer<Dtype>::LayerSetUp(
+  const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  num_joint_ = this->layer_param_.pose_evaluate_param().num_joint();
+  const int num_labels = std::max(kNumLabels, bottom[0]->channels());
+  class_joint_.resize(num_labels);
+  for (int cls = 0; cls < num_labels; ++cls) {
+    const int joint_id = selectJointFun(num_joint_, cls);
+    class_joint_[cls] = (joint_id >= 0 && joint_id < num_joint_) ?
+        joint_id : num_joint_;
+  }
+  thread_pool_.reset(new ThreadPool(
+      this->layer_param_.pose_evaluate_param().num_threads()));
+}
+
+template <typename Dtype>
+void PoseEvaluateLayer<Dtype>::Reshape(
+  const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  CHECK_LE(bottom[0]->channels(), class_joint_.size())
+    << "Too many classes.";
+  top[0]->Reshape(bottom[0]->num(), 1, 1, num_joint_ * 2);  
+  moments_.resize(bottom[0]->num() * 3 * (num_joint_ + 1));
+  if (bottom[0]->channels() > 1) {
+    row_max_.resize(bottom[0]->num());
+    row_argmax_.resize(bottom[0]->num());
+    for (int n = 0; n < bottom[0]->num(); ++n) {
+      row_max_[n].resize(bottom[0]->width());
+      row_argmax_[n].resize(bottom[0]->width());
+    }
+  }
+}
+
 template <typename Dtype>
 void PoseEvaluateLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
+  // Make sure the data are on cpu before worker threads access them.
+  bottom[0]->cpu_data();
+  top[0]->mutable_cpu_data();
+  thread_pool_->Run(bottom[0]->num(),
+      boost::bind(&PoseEvaluateLayer<Dtype>::EvaluateImage, this,
+                  boost::cref(bottom), boost::cref(top), _1));
+}
 
-  const Dtype* bottom_data = bottom[0]->cpu_data();
-  Dtype* top_data = top[0]->mutable_cpu_data();
-  int num = bottom[0]->num();
-  int height = bottom[0]->height();
-  int width = bottom[0]->width();
-  // LOG(INFO) << "pose_len: " << pose_len;
+template <typename Dtype>
+void PoseEvaluateLayer<Dtype>::EvaluateImage(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top,
+    int n) {
+  const Dtype* bottom_data = bottom[0]->cpu_data_at(n);
+  Dtype* top_data = top[0]->mutable_cpu_data_at(n);
+  const int channels = bottom[0]->channels();
+  const int height = bottom[0]->height();
+  const int width = bottom[0]->width();
+  const int num_labels = class_joint_.size();
+  const int* class_joint = &class_joint_[0];
 
-  std::vector<int > x_sum_vector[num_joint_];
-  std::vector<int > y_sum_vector[num_joint_];
-  int cls_, joint_id;
+  int64_t* count = &moments_[n * 3 * (num_joint_ + 1)];
+  int64_t* x_sum = count + num_joint_ + 1;
+  int64_t* y_sum = x_sum + num_joint_ + 1;
+  std::fill(count, count + 3 * (num_joint_ + 1), 0);
 
-  for (int i = 0; i < num; ++i) {
-    for (int h = 0; h < height; ++h) {
+  for (int h = 0; h < height; ++h) {
+    const Dtype* row = bottom_data + h * width;
+    if (channels == 1) {
       for (int w = 0; w < width; ++w) {
-        cls_ =  bottom_data[h * width + w];
-        joint_id = selectJointFun(num_joint_, cls_);
-        if (joint_id >= 0 && joint_id < num_joint_) {
-          x_sum_vector[joint_id].push_back(w);
-          y_sum_vector[joint_id].push_back(h);
-        }
+        const int cls_ = static_cast<int>(row[w]);
+        const int joint_id = (cls_ >= 0 && cls_ < num_labels) ?
+            class_joint[cls_] : num_joint_;
+        ++count[joint_id];
+        x_sum[joint_id] += w;
+        y_sum[joint_id] += h;
+      }
+    } else {
+      int* argmax = &row_argmax_[n][0];
+      caffe_cpu_channel_argmax(channels, width, height * width, row,
+                               &row_max_[n][0], argmax);
+      for (int w = 0; w < width; ++w) {
+        const int joint_id = class_joint[argmax[w]];
+        ++count[joint_id];
+        x_sum[joint_id] += w;
+        y_sum[joint_id] += h;
       }
     }
-    for (int w = 0; w < num_joint_ * 2; ++w) {
-      top_data[w] = 0;
-    }
-    for (int n = 0; n < num_joint_; n++) {
-      if (x_sum_vector[n].size() > 0 && y_sum_vector[n].size() > 0) {
-        double ave_x = std::accumulate(x_sum_vector[n].begin(), x_sum_vector[n].end(), 0.0)
-                                      / x_sum_vector[n].size();
-        double ave_y = std::accumulate(y_sum_vector[n].begin(), y_sum_vector[n].end(), 0.0)
-                                      / y_sum_vector[n].size();
-        // LOG(INFO) << "ave_x: " << ave_x << "  ave_y:" << ave_y;
-        top_data[n*2] = int(ave_x);
-        top_data[n*2+1] = int(ave_y);
-        // LOG(INFO) << "cls: " << n << "  x: " << int(ave_x) << "  y: " << int(ave_y);
-      } 
+  }
+
+  for (int j = 0; j < num_joint_; ++j) {
+    if (count[j] > 0) {
+      const double ave_x = static_cast<double>(x_sum[j]) / count[j];
+      const double ave_y = static_cast<double>(y_sum[j]) / count[j];
+      top_data[j*2] = int(ave_x);
+      top_data[j*2+1] = int(ave_y);
+    } else {
+      top_data[j*2] = 0;
+      top_data[j*2+1] = 0;
     }
-    bottom_data += bottom[0]->offset(1);
-    top_data += top[0]->offset(1);
   }
 }
 
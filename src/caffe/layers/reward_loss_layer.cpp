@@ -57,10 +57,6 @@ void RewardLossLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   
 }
 
-#ifdef CPU_ONLY
-STUB_GPU(RewardLossLayer);
-#endif
-
 INSTANTIATE_CLASS(RewardLossLayer);
 REGISTER_LAYER_CLASS(RewardLoss);
 
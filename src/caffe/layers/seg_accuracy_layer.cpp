@@ -3,7 +3,10 @@
 #include <utility>
 #include <vector>
 
+#include <boost/bind.hpp>
+
 #include "caffe/layer.hpp"
+#include "caffe/util/argmax.hpp"
 #include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/layers/seg_accuracy_layer.hpp"
@@ -20,12 +23,14 @@ void SegAccuracyLayer<Dtype>::LayerSetUp(
   for (int c = 0; c < seg_accuracy_param.ignore_label_size(); ++c){
     ignore_label_.insert(seg_accuracy_param.ignore_label(c));
   }
+  top_k_ = seg_accuracy_param.top_k();
+  thread_pool_.reset(new ThreadPool(seg_accuracy_param.num_threads()));
 }
 
 template <typename Dtype>
 void SegAccuracyLayer<Dtype>::Reshape(
   const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  CHECK_LE(1, bottom[0]->channels())
+  CHECK_LE(top_k_, bottom[0]->channels())
       << "top_k must be less than or equal to the number of channels (classes).";
   CHECK_EQ(bottom[0]->num(), bottom[1]->num())
     << "The data and label should have the same number.";
@@ -37,61 +42,47 @@ void SegAccuracyLayer<Dtype>::Reshape(
     << "The data should have the same width as label.";
   //confusion_matrix_.clear(); 
   top[0]->Reshape(1, 1, 1, 3);
+
+  const int channels = bottom[0]->channels();
+  const int width = bottom[0]->width();
+  ignored_class_.resize(channels);
+  for (int c = 0; c < channels; ++c) {
+    ignored_class_[c] = ignore_label_.count(c) != 0;
+  }
+  // a few row ranges per thread to balance the load
+  const int num_rows = bottom[0]->num() * bottom[0]->height();
+  num_tasks_ = std::max(1, std::min(num_rows,
+      thread_pool_->num_threads() > 1 ? 4 * thread_pool_->num_threads() : 1));
+  task_confusion_.resize(channels, num_tasks_);
+  task_max_.resize(num_tasks_);
+  task_argmax_.resize(num_tasks_);
+  task_label_score_.resize(num_tasks_);
+  task_rank_.resize(num_tasks_);
+  for (int t = 0; t < num_tasks_; ++t) {
+    task_max_[t].resize(width);
+    task_argmax_[t].resize(width);
+    if (top_k_ > 1) {
+      task_label_score_[t].resize(width);
+      task_rank_[t].resize(width);
+    }
+  }
 }
 
 template <typename Dtype>
 void SegAccuracyLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
-  const Dtype* bottom_data = bottom[0]->cpu_data();
-  const Dtype* bottom_label = bottom[1]->cpu_data();
-  int num = bottom[0]->num();
-  int channels = bottom[0]->channels();
-  int height = bottom[0]->height();
-  int width = bottom[0]->width();
-
-  int data_index, label_index;
-
-  int top_k = 1;  // only support for top_k = 1
-
   // remove old predictions if reset() flag is true
   if (this->layer_param_.seg_accuracy_param().reset()) {
     confusion_matrix_.clear();
   }
 
-  for (int i = 0; i < num; ++i) {
-    for (int h = 0; h < height; ++h) {
-      for (int w = 0; w < width; ++w) {
-	// Top-k accuracy
-	std::vector<std::pair<Dtype, int> > bottom_data_vector;
-
-	for (int c = 0; c < channels; ++c) {
-	  data_index = (c * height + h) * width + w;
-	  bottom_data_vector.push_back(std::make_pair(bottom_data[data_index], c));
-	}
-
-	std::partial_sort(
-	  bottom_data_vector.begin(), bottom_data_vector.begin() + top_k,
-	  bottom_data_vector.end(), std::greater<std::pair<Dtype, int> >());
-
-	// check if true label is in top k predictions
-	label_index = h * width + w;
-	const int gt_label = static_cast<int>(bottom_label[label_index]);
-
-	if (ignore_label_.count(gt_label) != 0) {
-	  // ignore the pixel with this gt_label
-	  continue;
-	} else if (gt_label >= 0 && gt_label < channels) {
-	  // current position is not "255", indicating ambiguous position
-	  confusion_matrix_.accumulate(gt_label, bottom_data_vector[0].second);
-	} else {
-	  LOG(FATAL) << "Unexpected label " << gt_label << ". num: " << i 
-              << ". row: " << h << ". col: " << w;
-      }
-      }
-    }
-    bottom_data  += bottom[0]->offset(1);
-    bottom_label += bottom[1]->offset(1);
-  }
+  // Make sure the data are on cpu before worker threads access them.
+  bottom[0]->cpu_data();
+  bottom[1]->cpu_data();
+  thread_pool_->Run(num_tasks_,
+      boost::bind(&SegAccuracyLayer<Dtype>::CountRows, this,
+                  boost::cref(bottom), _1));
+  task_confusion_.mergeInto(&confusion_matrix_);
 
   /* for debug
   LOG(INFO) << "confusion matrix info:" << confusion_matrix_.numRows() << "," << confusion_matrix_.numCols();
@@ -104,6 +95,70 @@ void SegAccuracyLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   top[0]->mutable_cpu_data()[2] = (Dtype)confusion_matrix_.avgJaccard();
 }
 
+template <typename Dtype>
+void SegAccuracyLayer<Dtype>::CountRows(const vector<Blob<Dtype>*>& bottom,
+    int task) {
+  const int channels = bottom[0]->channels();
+  const int height = bottom[0]->height();
+  const int width = bottom[0]->width();
+  const int num_rows = bottom[0]->num() * height;
+  const int row_begin = static_cast<int64_t>(num_rows) * task / num_tasks_;
+  const int row_end = static_cast<int64_t>(num_rows) * (task + 1) / num_tasks_;
+
+  unsigned long* counts = task_confusion_.shard(task);  // NOLINT(runtime/int)
+  Dtype* max_score = &task_max_[task][0];
+  int* argmax = &task_argmax_[task][0];
+  Dtype* label_score = top_k_ > 1 ? &task_label_score_[task][0] : NULL;
+  int* rank = top_k_ > 1 ? &task_rank_[task][0] : NULL;
+  std::fill(counts, counts + channels * channels, 0);
+
+  for (int row = row_begin; row < row_end; ++row) {
+    const int i = row / height;
+    const int h = row % height;
+    const Dtype* bottom_label = bottom[1]->cpu_data_at(i) + h * width;
+    // scores of class c at (i, c, h, :) are at data + c * stride
+    const Dtype* data = bottom[0]->cpu_data_at(i) + h * width;
+    const int stride = height * width;
+
+    caffe_cpu_channel_argmax(channels, width, stride, data, max_score,
+                             argmax);
+
+    if (top_k_ > 1) {
+      // rank of the label = number of classes sorted before it, that is of
+      // higher score or of equal score and larger index
+      for (int w = 0; w < width; ++w) {
+        const int gt_label = static_cast<int>(bottom_label[w]);
+        label_score[w] = (gt_label >= 0 && gt_label < channels) ?
+            data[gt_label * stride + w] : Dtype(0);
+      }
+      std::fill(rank, rank + width, 0);
+      for (int c = 0; c < channels; ++c) {
+        const Dtype* score = data + c * stride;
+        for (int w = 0; w < width; ++w) {
+          rank[w] += (score[w] > label_score[w]) |
+              ((score[w] == label_score[w]) &
+               (c > static_cast<int>(bottom_label[w])));
+        }
+      }
+    }
+
+    for (int w = 0; w < width; ++w) {
+      const int gt_label = static_cast<int>(bottom_label[w]);
+      if (gt_label >= 0 && gt_label < channels) {
+        if (ignored_class_[gt_label]) {
+          continue;
+        }
+        const int prediction =
+            (top_k_ > 1 && rank[w] < top_k_) ? gt_label : argmax[w];
+        ++counts[gt_label * channels + prediction];
+      } else if (ignore_label_.count(gt_label) == 0) {
+        LOG(FATAL) << "Unexpected label " << gt_label << ". num: " << i 
+            << ". row: " << h << ". col: " << w;
+      }
+    }
+  }
+}
+
 INSTANTIATE_CLASS(SegAccuracyLayer);
 REGISTER_LAYER_CLASS(SegAccuracy);
 
@@ -0,0 +1,100 @@
+#include <opencv2/core/core.hpp>
+
+#include <vector>
+
+#include "caffe/layers/seg_pose_data_layer.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+SegPoseDataLayer<Dtype>::~SegPoseDataLayer() {
+  this->StopInternalThread();
+}
+
+template <typename Dtype>
+void SegPoseDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  const DataParameter& data_param = this->layer_param_.data_param();
+  const ImageDataParameter& image_data_param =
+      this->layer_param_.image_data_param();
+  const int new_height = image_data_param.new_height();
+  const int new_width  = image_data_param.new_width();
+  CHECK((new_height == 0 && new_width == 0) ||
+      (new_height > 0 && new_width > 0)) << "Current implementation requires "
+      "new_height and new_width to be set at the same time.";
+  // The db holds segmentation files, not the image labels of an image list.
+  CHECK_NE(image_data_param.label_type(), ImageDataParameter_LabelType_IMAGE)
+      << "SegPoseData reads PIXEL labels, or NONE";
+
+  db_.reset(db::GetDB(data_param.backend()));
+  db_->Open(data_param.source(), db::READ);
+  cursor_.reset(db_->NewCursor());
+  CHECK(cursor_->valid()) << "Empty db " << data_param.source();
+
+  // Check if we would need to randomly skip a few data points
+  if (data_param.rand_skip()) {
+    unsigned int skip = caffe_rng_rand() % data_param.rand_skip();
+    LOG(INFO) << "Skipping first " << skip << " data points.";
+    while (skip-- > 0) {
+      Next();
+    }
+  }
+  // Decode a record, and use it to initialize the top blob.
+  SegPoseDatum datum;
+  CHECK(datum.ParseFromString(cursor_->value()));
+  cv::Mat cv_img = DecodeImageToCVMat(datum.image(), new_height, new_width,
+                                      image_data_param.is_color());
+  CHECK(cv_img.data) << "Could not decode " << cursor_->key();
+  this->ShapeTops(cv_img, data_param.batch_size(), top);
+  item_datums_.resize(data_param.batch_size());
+}
+
+template <typename Dtype>
+void SegPoseDataLayer<Dtype>::Next() {
+  cursor_->Next();
+  if (!cursor_->valid()) {
+    DLOG(INFO) << "Restarting data prefetching from start.";
+    cursor_->SeekToFirst();
+  }
+}
+
+// This function is called on prefetch thread
+template <typename Dtype>
+void SegPoseDataLayer<Dtype>::PickSample(int item_id) {
+  SegPoseDatum& datum = item_datums_[item_id];
+  CHECK(datum.ParseFromString(cursor_->value()))
+      << "Invalid record " << cursor_->key();
+  CHECK_EQ(datum.pose_size(), 32) << "number of pose gt should be 32";
+  this->item_lines_[item_id].second.assign(datum.pose().begin(),
+                                           datum.pose().end());
+  Next();
+}
+
+template <typename Dtype>
+void SegPoseDataLayer<Dtype>::ReadSample(int item_id,
+    std::vector<cv::Mat>* cv_img_seg, int* img_row, int* img_col) {
+  const ImageDataParameter& image_data_param =
+      this->layer_param_.image_data_param();
+  const int new_height = image_data_param.new_height();
+  const int new_width  = image_data_param.new_width();
+  const SegPoseDatum& datum = item_datums_[item_id];
+
+  cv_img_seg->push_back(DecodeImageToCVMat(datum.image(), new_height,
+      new_width, image_data_param.is_color(), img_row, img_col));
+  if (image_data_param.label_type() == ImageDataParameter_LabelType_PIXEL &&
+      datum.label().size()) {
+    cv_img_seg->push_back(DecodeImageToCVMat(datum.label(), new_height,
+        new_width, false));
+  } else {
+    cv::Mat seg((*cv_img_seg)[0].rows, (*cv_img_seg)[0].cols, CV_8UC1,
+                cv::Scalar(image_data_param.ignore_label()));
+    cv_img_seg->push_back(seg);
+  }
+}
+
+INSTANTIATE_CLASS(SegPoseDataLayer);
+REGISTER_LAYER_CLASS(SegPoseData);
+
+}  // namespace caffe
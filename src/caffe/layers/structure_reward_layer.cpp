@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <boost/bind.hpp>
+
+#include "caffe/layers/pose_evaluate_layer.hpp"
+#include "caffe/layers/structure_reward_layer.hpp"
+#include "caffe/util/argmax.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+// label maps hold 8 bit labels
+static const int kNumLabels = 256;
+
+template <typename Dtype>
+void StructureRewardLayer<Dtype>::LayerSetUp(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  LossLayer<Dtype>::LayerSetUp(bottom, top);
+  const StructureRewardParameter& param =
+      this->layer_param_.structure_reward_param();
+  num_joint_ = param.num_joint();
+  reward_scale_ = param.reward_scale();
+  switch (param.error_order()) {
+    case 1: error_norm_ = 10; break;
+    case 3: error_norm_ = 5; break;
+    default:
+      LOG(FATAL) << "Unsupported error_order: " << param.error_order();
+  }
+  const int num_labels = std::max(kNumLabels, bottom[0]->channels());
+  class_joint_.resize(num_labels);
+  for (int cls = 0; cls < num_labels; ++cls) {
+    const int joint_id = selectJointFun(num_joint_, cls);
+    class_joint_[cls] = (joint_id >= 0 && joint_id < num_joint_) ?
+        joint_id : num_joint_;
+  }
+  thread_pool_.reset(new ThreadPool(param.num_threads()));
+}
+
+template <typename Dtype>
+void StructureRewardLayer<Dtype>::Reshape(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  CHECK_LE(bottom[0]->channels(), class_joint_.size())
+      << "Too many classes.";
+  CHECK_EQ(bottom[1]->channels(), 1)
+      << "The ground truth should be a label map.";
+  CHECK_EQ(bottom[0]->num(), bottom[1]->num())
+      << "The scores and the ground truth should have the same number.";
+  CHECK_EQ(bottom[0]->height(), bottom[1]->height())
+      << "The scores and the ground truth should have the same height.";
+  CHECK_EQ(bottom[0]->width(), bottom[1]->width())
+      << "The scores and the ground truth should have the same width.";
+  const int num = bottom[0]->num();
+  top[0]->Reshape(num, 1, 1, 1);
+  argmax_.Reshape(num, 1, bottom[0]->height(), bottom[0]->width());
+  moments_.resize(num * 6 * (num_joint_ + 1));
+  row_max_.resize(num);
+  for (int n = 0; n < num; ++n) {
+    row_max_[n].resize(bottom[0]->width());
+  }
+}
+
+template <typename Dtype>
+void StructureRewardLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  // Make sure the data are on cpu before worker threads access them.
+  bottom[0]->cpu_data();
+  bottom[1]->cpu_data();
+  top[0]->mutable_cpu_data();
+  argmax_.mutable_cpu_data();
+  thread_pool_->Run(bottom[0]->num(),
+      boost::bind(&StructureRewardLayer<Dtype>::ForwardImage, this,
+                  boost::cref(bottom), boost::cref(top), _1));
+}
+
+template <typename Dtype>
+void StructureRewardLayer<Dtype>::ForwardImage(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top,
+    int n) {
+  const Dtype* score = bottom[0]->cpu_data_at(n);
+  const Dtype* label = bottom[1]->cpu_data_at(n);
+  int* argmax = argmax_.mutable_cpu_data_at(n);
+  const int channels = bottom[0]->channels();
+  const int height = bottom[0]->height();
+  const int width = bottom[0]->width();
+  const int num_labels = class_joint_.size();
+  const int* class_joint = &class_joint_[0];
+  const int num_slots = num_joint_ + 1;
+
+  // count, x_sum and y_sum of the prediction, then of the ground truth
+  int64_t* moments = &moments_[n * 6 * num_slots];
+  std::fill(moments, moments + 6 * num_slots, 0);
+  int64_t* count = moments;
+  int64_t* x_sum = count + num_slots;
+  int64_t* y_sum = x_sum + num_slots;
+  int64_t* gt_count = y_sum + num_slots;
+  int64_t* gt_x_sum = gt_count + num_slots;
+  int64_t* gt_y_sum = gt_x_sum + num_slots;
+
+  for (int h = 0; h < height; ++h) {
+    int* row_argmax = argmax + h * width;
+    caffe_cpu_channel_argmax(channels, width, height * width,
+                             score + h * width, &row_max_[n][0], row_argmax);
+    const Dtype* row_label = label + h * width;
+    for (int w = 0; w < width; ++w) {
+      const int joint_id = class_joint[row_argmax[w]];
+      ++count[joint_id];
+      x_sum[joint_id] += w;
+      y_sum[joint_id] += h;
+      const int cls_ = static_cast<int>(row_label[w]);
+      const int gt_joint_id = (cls_ >= 0 && cls_ < num_labels) ?
+          class_joint[cls_] : num_joint_;
+      ++gt_count[gt_joint_id];
+      gt_x_sum[gt_joint_id] += w;
+      gt_y_sum[gt_joint_id] += h;
+    }
+  }
+
+  // Joint centers are truncated to pixels, (0, 0) for the joints of no
+  // pixel, as PoseEvaluateLayer writes them.
+  double total_distance = 0;
+  for (int j = 0; j < num_joint_; ++j) {
+    int x1 = 0, y1 = 0, x2 = 0, y2 = 0;
+    if (count[j] > 0) {
+      x1 = static_cast<double>(x_sum[j]) / count[j];
+      y1 = static_cast<double>(y_sum[j]) / count[j];
+    }
+    if (gt_count[j] > 0) {
+      x2 = static_cast<double>(gt_x_sum[j]) / gt_count[j];
+      y2 = static_cast<double>(gt_y_sum[j]) / gt_count[j];
+    }
+    total_distance += sqrt((x1-x2)*(x1-x2) + (y1-y2)*(y1-y2));
+  }
+  total_distance /= error_norm_;
+  top[0]->mutable_cpu_data()[n] = total_distance * reward_scale_;
+}
+
+template <typename Dtype>
+void StructureRewardLayer<Dtype>::Backward_cpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  if (propagate_down[1]) {
+    LOG(FATAL) << this->type()
+               << " Layer cannot backpropagate to label inputs.";
+  }
+  if (propagate_down[0]) {
+    // Make sure the data are on cpu before worker threads access them.
+    top[0]->cpu_data();
+    top[0]->cpu_diff();
+    argmax_.cpu_data();
+    bottom[0]->mutable_cpu_diff();
+    thread_pool_->Run(bottom[0]->num(),
+        boost::bind(&StructureRewardLayer<Dtype>::BackwardImage, this,
+                    boost::cref(top), boost::cref(bottom), _1));
+  }
+}
+
+template <typename Dtype>
+void StructureRewardLayer<Dtype>::BackwardImage(
+    const vector<Blob<Dtype>*>& top, const vector<Blob<Dtype>*>& bottom,
+    int n) {
+  const int spatial_dim = bottom[0]->height() * bottom[0]->width();
+  const int* argmax = argmax_.cpu_data_at(n);
+  const Dtype diff = top[0]->cpu_data()[n] * top[0]->cpu_diff()[n];
+  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff_at(n);
+  caffe_set(bottom[0]->channels() * spatial_dim, Dtype(0), bottom_diff);
+  for (int i = 0; i < spatial_dim; ++i) {
+    bottom_diff[argmax[i] * spatial_dim + i] = diff;
+  }
+}
+
+INSTANTIATE_CLASS(StructureRewardLayer);
+REGISTER_LAYER_CLASS(StructureReward);
+
+}  // namespace caffe
@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "caffe/multi_scale_net.hpp"
+#include "caffe/util/interp.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+MultiScaleNet<Dtype>::MultiScaleNet(const NetParameter& param,
+    const MultiScaleParameter& multi_scale_param)
+    : param_(multi_scale_param), net_param_(param), num_forward_(0) {
+  net_param_.mutable_state()->set_phase(TEST);
+  net_.reset(new Net<Dtype>(net_param_));
+  CHECK_EQ(net_->num_inputs(), 1) << "The net should take the image as "
+      "its single input.";
+  for (int s = 0; s < param_.scale_size(); ++s) {
+    CHECK_GT(param_.scale(s), 0) << "Scales should be positive.";
+    scales_.push_back(param_.scale(s));
+  }
+  if (scales_.empty()) {
+    scales_.push_back(1);
+  }
+  CHECK_GE(param_.batch_pad_ratio(), 1) << "batch_pad_ratio should be >= 1.";
+  CHECK_GT(param_.max_cached_nets(), 0) << "max_cached_nets should be > 0.";
+  score_blob_ = param_.score_blob();
+  if (score_blob_.empty()) {
+    CHECK_GT(net_->output_blob_indices().size(), 0) << "The net has no output.";
+    score_blob_ = net_->blob_names()[net_->output_blob_indices().back()];
+  }
+  CHECK(net_->has_blob(score_blob_)) << "Unknown blob " << score_blob_;
+  LOG(INFO) << "Fusing the " << score_blob_ << " scores of "
+            << scales_.size() << " scales by "
+            << MultiScaleParameter_Fusion_Name(param_.fusion());
+}
+
+template <typename Dtype>
+void MultiScaleNet<Dtype>::ScaledSize(int height, int width, int s,
+    int* scaled_height, int* scaled_width, int* level) const {
+  // The scales 1/2^k are the levels of the pyramid, as long as they are not
+  // empty.
+  int k = 0;
+  while (scales_[s] * (1 << k) < 1 && k < 30) {
+    ++k;
+  }
+  if (k > 0 && scales_[s] * (1 << k) == 1 &&
+      (height >> k) > 0 && (width >> k) > 0) {
+    *scaled_height = height >> k;
+    *scaled_width = width >> k;
+    *level = k;
+  } else {
+    *scaled_height = std::max(1, static_cast<int>(height * scales_[s] + 0.5f));
+    *scaled_width = std::max(1, static_cast<int>(width * scales_[s] + 0.5f));
+    *level = 0;
+  }
+}
+
+template <typename Dtype>
+void MultiScaleNet<Dtype>::GroupScales(int height, int width,
+    vector<ScaleGroup>* groups) const {
+  // From the largest scale down, a scale joins the batch of the previous
+  // ones while the padding to their size stays within batch_pad_ratio.
+  vector<std::pair<float, int> > order;
+  for (int s = 0; s < scales_.size(); ++s) {
+    order.push_back(std::make_pair(scales_[s], s));
+  }
+  std::sort(order.begin(), order.end(),
+            std::greater<std::pair<float, int> >());
+  groups->clear();
+  for (int i = 0; i < order.size(); ++i) {
+    const int s = order[i].second;
+    int scaled_height, scaled_width, level;
+    ScaledSize(height, width, s, &scaled_height, &scaled_width, &level);
+    if (groups->empty() ||
+        static_cast<float>(groups->back().height) * groups->back().width >
+        param_.batch_pad_ratio() * scaled_height * scaled_width) {
+      ScaleGroup group;
+      group.height = scaled_height;
+      group.width = scaled_width;
+      groups->push_back(group);
+    }
+    groups->back().scales.push_back(s);
+  }
+}
+
+template <typename Dtype>
+void MultiScaleNet<Dtype>::ResizeImage(const Blob<Dtype>& image, int s,
+    int height, int width, Dtype* data) {
+  const int channels = image.channels();
+  int scaled_height, scaled_width, level;
+  ScaledSize(image.height(), image.width(), s, &scaled_height, &scaled_width,
+             &level);
+  if (level == 0) {
+    caffe_cpu_interp2<Dtype, false>(channels,
+        image.cpu_data(), 0, 0, image.height(), image.width(),
+        image.height(), image.width(),
+        data, 0, 0, scaled_height, scaled_width, height, width);
+    return;
+  }
+  // level l of the pyramid follows the levels 1 to l - 1
+  const Dtype* level_data = pyramid_.cpu_data();
+  for (int l = 1; l < level; ++l) {
+    level_data += channels * (image.height() >> l) * (image.width() >> l);
+  }
+  caffe_cpu_interp2<Dtype, false>(channels,
+      level_data, 0, 0, scaled_height, scaled_width,
+      scaled_height, scaled_width,
+      data, 0, 0, scaled_height, scaled_width, height, width);
+}
+
+template <typename Dtype>
+Net<Dtype>* MultiScaleNet<Dtype>::GetNet(int num, int channels, int height,
+    int width) {
+  int oldest = 0;
+  for (int i = 0; i < cached_nets_.size(); ++i) {
+    const Blob<Dtype>* input = cached_nets_[i]->input_blobs()[0];
+    if (input->num() == num && input->channels() == channels &&
+        input->height() == height && input->width() == width) {
+      cached_net_use_[i] = num_forward_;
+      return cached_nets_[i].get();
+    }
+    if (cached_net_use_[i] < cached_net_use_[oldest]) {
+      oldest = i;
+    }
+  }
+  shared_ptr<Net<Dtype> > net(new Net<Dtype>(net_param_));
+  net->ShareTrainedLayersWith(net_.get());
+  net->input_blobs()[0]->Reshape(num, channels, height, width);
+  net->Reshape();
+  if (cached_nets_.size() < param_.max_cached_nets()) {
+    cached_nets_.push_back(net);
+    cached_net_use_.push_back(num_forward_);
+    return net.get();
+  }
+  DLOG(INFO) << "Evicting the net of input "
+             << cached_nets_[oldest]->input_blobs()[0]->shape_string();
+  cached_nets_[oldest] = net;
+  cached_net_use_[oldest] = num_forward_;
+  return net.get();
+}
+
+template <typename Dtype>
+void MultiScaleNet<Dtype>::Forward(const Blob<Dtype>& image,
+    Blob<Dtype>* scores) {
+  CHECK_EQ(image.num(), 1) << "One image at a time.";
+  const int channels = image.channels();
+  const int height = image.height();
+  const int width = image.width();
+
+  // The levels of the pyramid the scales are taken from.
+  int num_levels = 0;
+  for (int s = 0; s < scales_.size(); ++s) {
+    int scaled_height, scaled_width, level;
+    ScaledSize(height, width, s, &scaled_height, &scaled_width, &level);
+    num_levels = std::max(num_levels, level);
+  }
+  if (num_levels > 0) {
+    int pyramid_count = 0;
+    for (int l = 1; l <= num_levels; ++l) {
+      pyramid_count += channels * (height >> l) * (width >> l);
+    }
+    pyramid_.Reshape(1, 1, 1, pyramid_count);
+    caffe_cpu_pyramid2<Dtype, false>(channels, image.cpu_data(), height,
+        width, pyramid_.mutable_cpu_data(), num_levels);
+  }
+
+  vector<ScaleGroup> groups;
+  GroupScales(height, width, &groups);
+  bool first_scale = true;
+  for (int g = 0; g < groups.size(); ++g) {
+    const ScaleGroup& group = groups[g];
+    const int num = group.scales.size();
+    Net<Dtype>* net = GetNet(num, channels, group.height, group.width);
+    ++num_forward_;
+    Blob<Dtype>* input = net->input_blobs()[0];
+    caffe_set(input->count(), Dtype(0), input->mutable_cpu_data());
+    for (int n = 0; n < num; ++n) {
+      ResizeImage(image, group.scales[n], group.height, group.width,
+                  input->mutable_cpu_data() + input->offset(n));
+    }
+    net->ForwardPrefilled();
+
+    const Blob<Dtype>* score = net->blob_by_name(score_blob_).get();
+    const int num_classes = score->channels();
+    if (first_scale) {
+      scores->Reshape(1, num_classes, height, width);
+      scale_scores_.Reshape(1, num_classes, height, width);
+    }
+    CHECK_EQ(score->num(), num) << "The scores should have the batch size.";
+    CHECK_EQ(num_classes, scores->channels())
+        << "The scales should have the same number of classes.";
+    for (int n = 0; n < num; ++n) {
+      // The valid scores cover the part of the input holding the image.
+      int scaled_height, scaled_width, level;
+      ScaledSize(height, width, group.scales[n], &scaled_height,
+                 &scaled_width, &level);
+      const int valid_height = std::min(score->height(), std::max(1,
+          static_cast<int>(static_cast<float>(scaled_height) *
+                           score->height() / group.height + 0.5f)));
+      const int valid_width = std::min(score->width(), std::max(1,
+          static_cast<int>(static_cast<float>(scaled_width) *
+                           score->width() / group.width + 0.5f)));
+      Dtype* fused = scores->mutable_cpu_data();
+      Dtype* resized = first_scale ? fused :
+          scale_scores_.mutable_cpu_data();
+      caffe_cpu_interp2<Dtype, false>(num_classes,
+          score->cpu_data() + score->offset(n), 0, 0,
+          valid_height, valid_width, score->height(), score->width(),
+          resized, 0, 0, height, width, height, width);
+      if (!first_scale) {
+        if (param_.fusion() == MultiScaleParameter_Fusion_MAX) {
+          for (int i = 0; i < scores->count(); ++i) {
+            fused[i] = std::max(fused[i], resized[i]);
+          }
+        } else {
+          caffe_add(scores->count(), fused, resized, fused);
+        }
+      }
+      first_scale = false;
+    }
+  }
+  if (param_.fusion() == MultiScaleParameter_Fusion_MEAN) {
+    caffe_scal(scores->count(), Dtype(1) / scales_.size(),
+               scores->mutable_cpu_data());
+  }
+}
+
+INSTANTIATE_CLASS(MultiScaleNet);
+
+}  // namespace caffe
@@ -3,7 +3,9 @@
 #include <string>
 #include <vector>
 
+#include "caffe/layers/base_data_layer.hpp"
 #include "caffe/solver.hpp"
+#include "caffe/util/async_writer.hpp"
 #include "caffe/util/format.hpp"
 #include "caffe/util/hdf5.hpp"
 #include "caffe/util/io.hpp"
@@ -247,6 +249,9 @@ void Solver<Dtype>::Step(int iters) {
               << result_vec[k] << loss_msg_stream.str();
         }
       }
+      if (Caffe::root_solver()) {
+        LogPrefetchStats(net_->layers(), true);
+      }
     }
     for (int i = 0; i < callbacks_.size(); ++i) {
       callbacks_[i]->on_gradients_ready();
@@ -384,6 +389,8 @@ void Solver<Dtype>::Test(const int test_net_id) {
       }
     }
   }
+  // Wait for the output layers writing in the background.
+  FlushAsyncOutputs(test_net->layers());
   if (requested_early_exit_) {
     LOG(INFO)     << "Test interrupted.";
     return;
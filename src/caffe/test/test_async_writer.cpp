@@ -0,0 +1,62 @@
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/util/async_writer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+static void Append(std::vector<int>* order, int i) {
+  // Slow enough for the queue to fill up.
+  boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+  order->push_back(i);
+}
+
+class AsyncWriterTest : public ::testing::Test {
+ protected:
+  std::vector<int> order_;
+};
+
+TEST_F(AsyncWriterTest, TestSynchronous) {
+  AsyncWriter writer(0);
+  for (int i = 0; i < 5; ++i) {
+    writer.Push(boost::bind(&Append, &order_, i));
+    EXPECT_EQ(i + 1, order_.size());
+  }
+}
+
+TEST_F(AsyncWriterTest, TestRunsInOrder) {
+  for (int max_pending = 1; max_pending <= 4; ++max_pending) {
+    order_.clear();
+    AsyncWriter writer(max_pending);
+    EXPECT_EQ(max_pending, writer.max_pending());
+    // flush several times to check that the writer thread is reused
+    for (int round = 0; round < 3; ++round) {
+      for (int i = 0; i < 10; ++i) {
+        writer.Push(boost::bind(&Append, &order_, round * 10 + i));
+      }
+      writer.Flush();
+      ASSERT_EQ((round + 1) * 10, order_.size());
+    }
+    for (int i = 0; i < order_.size(); ++i) {
+      EXPECT_EQ(i, order_[i]);
+    }
+  }
+}
+
+TEST_F(AsyncWriterTest, TestDestructorDrains) {
+  {
+    AsyncWriter writer(2);
+    for (int i = 0; i < 6; ++i) {
+      writer.Push(boost::bind(&Append, &order_, i));
+    }
+  }
+  EXPECT_EQ(6, order_.size());
+}
+
+}  // namespace caffe
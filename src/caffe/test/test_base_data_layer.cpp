@@ -0,0 +1,107 @@
+#include <vector>
+
+#include "boost/thread.hpp"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layers/base_data_layer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+// Numbers the batches it loads, taking load_ms to load each one.
+template <typename Dtype>
+class CountingDataLayer : public BasePrefetchingDataLayer<Dtype> {
+ public:
+  CountingDataLayer(const LayerParameter& param, int load_ms)
+      : BasePrefetchingDataLayer<Dtype>(param, 2), load_ms_(load_ms),
+        count_(0) {}
+  virtual ~CountingDataLayer() { this->StopInternalThread(); }
+  virtual void DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+    top[0]->Reshape(1, 1, 1, 1);
+    for (int i = 0; i < this->prefetch_.size(); ++i) {
+      this->prefetch_[i]->data_.Reshape(1, 1, 1, 1);
+    }
+  }
+  virtual inline const char* type() const { return "CountingData"; }
+  int depth() const { return this->prefetch_.size(); }
+
+ protected:
+  virtual void load_batch(Batch<Dtype>* batch) {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(load_ms_));
+    batch->data_.mutable_cpu_data()[0] = count_++;
+  }
+
+  int load_ms_;
+  int count_;
+};
+
+template <typename Dtype>
+class BasePrefetchingDataLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  BasePrefetchingDataLayerTest() : blob_top_data_(new Blob<Dtype>()) {
+    blob_top_vec_.push_back(blob_top_data_);
+  }
+  virtual ~BasePrefetchingDataLayerTest() { delete blob_top_data_; }
+
+  Blob<Dtype>* const blob_top_data_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(BasePrefetchingDataLayerTest, TestDtypes);
+
+TYPED_TEST(BasePrefetchingDataLayerTest, TestDepth) {
+  LayerParameter param;
+  CountingDataLayer<TypeParam> default_layer(param, 0);
+  EXPECT_EQ(2, default_layer.depth());
+  param.mutable_prefetch_param()->set_depth(7);
+  CountingDataLayer<TypeParam> layer(param, 0);
+  EXPECT_EQ(7, layer.depth());
+  EXPECT_EQ(8, layer.prefetch_stats().occupancy_size());
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int i = 0; i < 20; ++i) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    EXPECT_EQ(i, this->blob_top_data_->cpu_data()[0]);
+  }
+}
+
+TYPED_TEST(BasePrefetchingDataLayerTest, TestStats) {
+  LayerParameter param;
+  param.mutable_prefetch_param()->set_depth(3);
+  CountingDataLayer<TypeParam> layer(param, 10);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  // the queue fills up while the net is idle
+  boost::this_thread::sleep(boost::posix_time::milliseconds(200));
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  PrefetchStats stats = layer.prefetch_stats();
+  EXPECT_EQ(1, stats.batches());
+  EXPECT_EQ(1, stats.occupancy(3));
+  EXPECT_GE(stats.load_us(), 10000);
+
+  // then the net drains it faster than it is loaded
+  for (int i = 0; i < 6; ++i) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  }
+  stats = layer.prefetch_stats();
+  EXPECT_EQ(7, stats.batches());
+  EXPECT_GT(stats.occupancy(0), 0);
+  uint64_t total = 0;
+  for (int k = 0; k < stats.occupancy_size(); ++k) {
+    total += stats.occupancy(k);
+  }
+  EXPECT_EQ(7, total);
+  EXPECT_GT(stats.consumer_wait_us(), 0);
+  EXPECT_GE(stats.load_us(), 7 * 10000);
+
+  layer.ResetPrefetchStats();
+  stats = layer.prefetch_stats();
+  EXPECT_EQ(0, stats.batches());
+  EXPECT_EQ(4, stats.occupancy_size());
+  EXPECT_EQ(0, stats.occupancy(0));
+}
+
+}  // namespace caffe
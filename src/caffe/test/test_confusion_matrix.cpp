@@ -0,0 +1,115 @@
+#include <boost/bind.hpp>
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/confusion_matrix.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class ConfusionMatrixTest : public ::testing::Test {
+ protected:
+  ConfusionMatrixTest() : confusion_(3) {
+    // actual 0: 3 right, 1 as 1; actual 1: 2 right, 2 as 2; actual 2: none
+    for (int i = 0; i < 3; ++i) {
+      confusion_.accumulate(0, 0);
+    }
+    confusion_.accumulate(0, 1);
+    confusion_.accumulate(1, 1);
+    confusion_.accumulate(1, 1);
+    confusion_.accumulate(1, 2);
+    confusion_.accumulate(1, 2);
+  }
+
+  // Pixel i of the synthetic labelings used by the sharded tests.
+  static void Accumulate(ConfusionMatrixShards* shards, int num_pixels,
+                         int shard) {
+    for (int i = shard; i < num_pixels; i += shards->numShards()) {
+      shards->accumulate(shard, i % 3, (i / 3) % 3);
+    }
+  }
+
+  ConfusionMatrix confusion_;
+};
+
+TEST_F(ConfusionMatrixTest, TestScores) {
+  // IoU: 3 / 4, 2 / 5 and 0 / 2
+  EXPECT_NEAR(0.75, confusion_.jaccard(0), 1e-9);
+  EXPECT_NEAR(0.4, confusion_.jaccard(1), 1e-9);
+  EXPECT_NEAR(0., confusion_.jaccard(2), 1e-9);
+  EXPECT_NEAR((0.75 + 0.4) / 3, confusion_.avgJaccard(), 1e-9);
+  // F1: 2 * 3 / (4 + 3), 2 * 2 / (4 + 3) and 0
+  EXPECT_NEAR(6. / 7, confusion_.f1Score(0), 1e-9);
+  EXPECT_NEAR(4. / 7, confusion_.f1Score(1), 1e-9);
+  EXPECT_NEAR(0., confusion_.f1Score(2), 1e-9);
+  EXPECT_NEAR(10. / 21, confusion_.avgF1Score(), 1e-9);
+}
+
+TEST_F(ConfusionMatrixTest, TestProtoRoundTrip) {
+  ConfusionMatrixProto proto;
+  confusion_.toProto(&proto);
+  EXPECT_EQ(3, proto.num_classes());
+  ConfusionMatrix restored;
+  restored.fromProto(proto);
+  ASSERT_EQ(3, restored.numRows());
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      EXPECT_EQ(confusion_(i, j), restored(i, j));
+    }
+  }
+  // merging the matrices of two workers
+  restored.accumulate(confusion_);
+  EXPECT_EQ(6, restored(0, 0));
+  EXPECT_EQ(4, restored(1, 2));
+}
+
+TEST_F(ConfusionMatrixTest, TestShards) {
+  const int num_pixels = 1000;
+  ConfusionMatrix expected(3);
+  for (int i = 0; i < num_pixels; ++i) {
+    expected.accumulate(i % 3, (i / 3) % 3);
+  }
+  ThreadPool pool(4);
+  ConfusionMatrixShards shards(3, 7);
+  pool.Run(shards.numShards(), boost::bind(&Accumulate, &shards,
+                                           num_pixels, _1));
+  ConfusionMatrix merged(3);
+  shards.mergeInto(&merged);
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      EXPECT_EQ(expected(i, j), merged(i, j));
+    }
+  }
+}
+
+TEST_F(ConfusionMatrixTest, TestShardsResize) {
+  ConfusionMatrixShards shards(3, 2);
+  Accumulate(&shards, 90, 0);
+  Accumulate(&shards, 90, 1);
+  // more shards of the same size keep the counts
+  shards.resize(3, 3);
+  ConfusionMatrix merged(3);
+  shards.mergeInto(&merged);
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      EXPECT_EQ(10, merged(i, j));
+    }
+  }
+  // a new number of classes drops them
+  shards.resize(2, 2);
+  shards.accumulate(0, 1, 0);
+  shards.accumulate(1, 1, 1);
+  ConfusionMatrix resized(2);
+  shards.mergeInto(&resized);
+  EXPECT_EQ(0, resized(0, 0));
+  EXPECT_EQ(0, resized(0, 1));
+  EXPECT_EQ(1, resized(1, 0));
+  EXPECT_EQ(1, resized(1, 1));
+}
+
+}  // namespace caffe
@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/densecrf_engine.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class DenseCRFEngineTest : public ::testing::Test {
+ protected:
+  DenseCRFEngineTest() : width_(19), height_(14), labels_(4) {}
+
+  virtual void SetUp() {
+    const int num = width_ * height_;
+    unary_.resize(num * labels_);
+    caffe_rng_gaussian<float>(unary_.size(), 0., 2., &unary_[0]);
+    std::vector<float> color(num * 3);
+    caffe_rng_uniform<float>(color.size(), 0., 255., &color[0]);
+    image_.assign(color.begin(), color.end());
+  }
+
+  // Sets up the engine for the test problem.
+  void SetUpEngine(DenseCRFEngine* engine) {
+    engine->Reset(width_, height_, labels_);
+    engine->SetUnaryEnergy(&unary_[0]);
+    engine->AddPairwiseGaussian(3, 3, 3);
+    engine->AddPairwiseBilateral(20, 20, 10, 10, 10, &image_[0], 5);
+  }
+
+  int width_;
+  int height_;
+  int labels_;
+  std::vector<float> unary_;
+  std::vector<unsigned char> image_;
+};
+
+TEST_F(DenseCRFEngineTest, TestMarginals) {
+  DenseCRFEngine engine;
+  SetUpEngine(&engine);
+  const float* current = engine.Inference(5);
+  std::vector<short> map(width_ * height_);  // NOLINT(runtime/int)
+  engine.CurrentMap(&map[0]);
+  for (int i = 0; i < width_ * height_; ++i) {
+    float sum = 0;
+    for (int j = 0; j < labels_; ++j) {
+      sum += current[i * labels_ + j];
+      EXPECT_LE(current[i * labels_ + j], current[i * labels_ + map[i]]);
+    }
+    EXPECT_NEAR(1, sum, 1e-5);
+  }
+}
+
+TEST_F(DenseCRFEngineTest, TestResetReusesEngine) {
+  DenseCRFEngine reference;
+  SetUpEngine(&reference);
+  std::vector<short> expected(width_ * height_);  // NOLINT(runtime/int)
+  reference.Map(5, &expected[0]);
+
+  // a larger problem first, then the test problem in the same buffers
+  DenseCRFEngine engine;
+  engine.Reset(2 * width_, 2 * height_, 2 * labels_);
+  engine.AddPairwiseGaussian(3, 3, 3);
+  engine.Inference(2);
+  SetUpEngine(&engine);
+  std::vector<short> map(width_ * height_);  // NOLINT(runtime/int)
+  engine.Map(5, &map[0]);
+  for (int i = 0; i < width_ * height_; ++i) {
+    EXPECT_EQ(expected[i], map[i]);
+  }
+  for (int i = 0; i < width_ * height_ * labels_; ++i) {
+    EXPECT_EQ(reference.current()[i], engine.current()[i]);
+  }
+}
+
+TEST_F(DenseCRFEngineTest, TestDownsample) {
+  // a smooth kernel, which the downsampled grid approximates well
+  DenseCRFEngine reference;
+  reference.Reset(width_, height_, labels_);
+  reference.SetUnaryEnergy(&unary_[0]);
+  reference.AddPairwiseGaussian(5, 5, 3);
+  reference.Inference(5);
+
+  DenseCRFEngine engine(EXP_LEGACY, 2);
+  engine.Reset(width_, height_, labels_);
+  EXPECT_EQ((width_ - 1) / 2 + 1, engine.grid_width());
+  EXPECT_EQ((height_ - 1) / 2 + 1, engine.grid_height());
+  EXPECT_FLOAT_EQ(width_ - 1,
+      engine.grid_step_x() * (engine.grid_width() - 1));
+  engine.SetUnaryEnergy(&unary_[0]);
+  engine.AddPairwiseGaussian(5, 5, 3);
+  const float* current = engine.Inference(5);
+  float max_diff = 0;
+  for (int i = 0; i < width_ * height_ * labels_; ++i) {
+    max_diff = std::max(max_diff,
+        std::fabs(current[i] - reference.current()[i]));
+  }
+  EXPECT_LT(max_diff, 0.2);
+}
+
+}  // namespace caffe
@@ -220,4 +220,51 @@ TYPED_TEST(DomainTransformLayerTest, TestGradient) {
            this->blob_top_vec_, 1);
 }
 
+TYPED_TEST(DomainTransformLayerTest, TestForwardMultiThread) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  DomainTransformParameter* dt_param =
+      layer_param.mutable_domain_transform_param();
+  dt_param->set_spatial_sigma(8);
+  dt_param->set_range_sigma(120);
+  dt_param->set_num_iter(3);
+
+  this->TestGradientSetUp();
+  DomainTransformLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype> expected;
+  expected.CopyFrom(*this->blob_top_, false, true);
+
+  // The samples and channels are filtered independently, so the result
+  // does not depend on the number of threads.
+  dt_param->set_num_threads(3);
+  DomainTransformLayer<Dtype> threaded_layer(layer_param);
+  threaded_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  threaded_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int i = 0; i < expected.count(); ++i) {
+    EXPECT_EQ(expected.cpu_data()[i], this->blob_top_->cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(DomainTransformLayerTest, TestGradientMultiThread) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  DomainTransformParameter* dt_param =
+      layer_param.mutable_domain_transform_param();
+  dt_param->set_spatial_sigma(8);
+  dt_param->set_range_sigma(120);
+  dt_param->set_num_iter(3);
+  dt_param->set_num_threads(2);
+
+  DomainTransformLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+
+  this->TestGradientSetUp();
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+           this->blob_top_vec_, 0);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+           this->blob_top_vec_, 1);
+}
+
 }  // namespace caffe
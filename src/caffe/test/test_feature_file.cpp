@@ -0,0 +1,134 @@
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/util/feature_file.hpp"
+#include "caffe/util/format.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class FeatureFileTest : public CPUDeviceTest<Dtype> {
+ protected:
+  FeatureFileTest() {
+    MakeTempFilename(&filename_);
+    // records of varying shapes, as the score maps of a test set
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    for (int k = 0; k < 4; ++k) {
+      vector<int> shape(4);
+      shape[0] = 1;
+      shape[1] = 3;
+      shape[2] = 5 + k;
+      shape[3] = 7 - k;
+      blobs_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>(shape)));
+      filler.Fill(blobs_.back().get());
+    }
+  }
+
+  void CheckRecord(const Blob<Dtype>& blob, int k) {
+    ASSERT_TRUE(blob.shape() == blobs_[k]->shape());
+    for (int i = 0; i < blob.count(); ++i) {
+      EXPECT_EQ(blobs_[k]->cpu_data()[i], blob.cpu_data()[i]);
+    }
+  }
+
+  string filename_;
+  vector<shared_ptr<Blob<Dtype> > > blobs_;
+};
+
+TYPED_TEST_CASE(FeatureFileTest, TestDtypes);
+
+TYPED_TEST(FeatureFileTest, TestReadWrite) {
+  {
+    FeatureFileWriter writer(this->filename_);
+    for (int k = 0; k < this->blobs_.size(); ++k) {
+      writer.Append(format_int(k), *this->blobs_[k]);
+    }
+    EXPECT_EQ(this->blobs_.size(), writer.num_records());
+  }
+  FeatureFile file(this->filename_);
+  ASSERT_EQ(this->blobs_.size(), file.num_records());
+  for (int k = 0; k < this->blobs_.size(); ++k) {
+    EXPECT_EQ(format_int(k), file.name(k));
+    EXPECT_EQ(k, file.Find(format_int(k)));
+    // with and without copy
+    Blob<TypeParam> blob;
+    file.Read(k, &blob, true);
+    this->CheckRecord(blob, k);
+    Blob<TypeParam> copy;
+    file.Read(k, &copy);
+    this->CheckRecord(copy, k);
+    EXPECT_NE(blob.cpu_data(), copy.cpu_data());
+  }
+  EXPECT_EQ(-1, file.Find("missing"));
+}
+
+TYPED_TEST(FeatureFileTest, TestZeroCopyIsPrivate) {
+  {
+    FeatureFileWriter writer(this->filename_);
+    writer.Append("0", *this->blobs_[0]);
+  }
+  {
+    FeatureFile file(this->filename_);
+    Blob<TypeParam> blob;
+    file.Read(0, &blob, true);
+    blob.mutable_cpu_data()[0] += 1;
+  }
+  // the change is not written back to the file
+  FeatureFile file(this->filename_);
+  Blob<TypeParam> blob;
+  file.Read(0, &blob);
+  this->CheckRecord(blob, 0);
+}
+
+TYPED_TEST(FeatureFileTest, TestFlush) {
+  FeatureFileWriter writer(this->filename_);
+  writer.Append("0", *this->blobs_[0]);
+  writer.Flush();
+  {
+    FeatureFile file(this->filename_);
+    EXPECT_EQ(1, file.num_records());
+  }
+  // appending after a flush overwrites the index: until the next flush, the
+  // file is readable and has no record
+  for (int k = 1; k < this->blobs_.size(); ++k) {
+    writer.Append(format_int(k), *this->blobs_[k]);
+    FeatureFile file(this->filename_);
+    EXPECT_EQ(0, file.num_records());
+  }
+  writer.Flush();
+  FeatureFile file(this->filename_);
+  ASSERT_EQ(this->blobs_.size(), file.num_records());
+  for (int k = 0; k < this->blobs_.size(); ++k) {
+    Blob<TypeParam> blob;
+    file.Read(k, &blob);
+    this->CheckRecord(blob, k);
+  }
+}
+
+TYPED_TEST(FeatureFileTest, TestConvert) {
+  {
+    FeatureFileWriter writer(this->filename_);
+    writer.Append("0", *this->blobs_[0]);
+  }
+  // read as the other type: always a copy
+  FeatureFile file(this->filename_);
+  Blob<float> blob_float;
+  file.Read(0, &blob_float);
+  Blob<double> blob_double;
+  file.Read(0, &blob_double);
+  for (int i = 0; i < this->blobs_[0]->count(); ++i) {
+    EXPECT_FLOAT_EQ(this->blobs_[0]->cpu_data()[i], blob_float.cpu_data()[i]);
+    EXPECT_FLOAT_EQ(this->blobs_[0]->cpu_data()[i], blob_double.cpu_data()[i]);
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,138 @@
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/feature_read_layer.hpp"
+#include "caffe/layers/feature_write_layer.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class FeatureReadLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  FeatureReadLayerTest()
+      : num_samples_(5), blob_data_(new Blob<Dtype>(1, 2, 3, 4)),
+        blob_label_(new Blob<Dtype>(1, 1, 3, 4)) {
+    MakeTempDir(&prefix_);
+    prefix_ += "/";
+    std::ofstream source((prefix_ + "list.txt").c_str());
+    for (int k = 0; k < num_samples_; ++k) {
+      source << "sample" << k << ".png" << std::endl;
+    }
+    blob_vec_.push_back(blob_data_);
+    blob_vec_.push_back(blob_label_);
+  }
+  virtual ~FeatureReadLayerTest() {
+    delete blob_data_;
+    delete blob_label_;
+  }
+
+  // Writes num_samples_ random samples with FeatureWrite.
+  void Write(int queue_size) {
+    LayerParameter param;
+    FeatureWriteParameter* feature_write_param =
+        param.mutable_feature_write_param();
+    feature_write_param->add_file(prefix_ + "data.feat");
+    feature_write_param->add_file(prefix_ + "label.feat");
+    feature_write_param->set_source(prefix_ + "list.txt");
+    feature_write_param->set_strip(4);
+    feature_write_param->set_queue_size(queue_size);
+    FeatureWriteLayer<Dtype> layer(param);
+    vector<Blob<Dtype>*> top_vec;
+    layer.SetUp(blob_vec_, top_vec);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    for (int k = 0; k < num_samples_; ++k) {
+      for (int i = 0; i < 2; ++i) {
+        filler.Fill(blob_vec_[i]);
+        shared_ptr<Blob<Dtype> > blob(new Blob<Dtype>());
+        blob->CopyFrom(*blob_vec_[i], false, true);
+        blobs_[i].push_back(blob);
+      }
+      layer.Forward(blob_vec_, top_vec);
+    }
+    layer.FlushOutput();
+    FeatureFile file(prefix_ + "data.feat");
+    ASSERT_EQ(num_samples_, file.num_records());
+    EXPECT_EQ("sample3", file.name(3));
+  }
+
+  // Reads num_samples_ + 1 batches and checks them against the written
+  // blobs. Without zero_copy the tops are also modified in place, as an
+  // in-place layer would, which must not change the records read next.
+  void Read(int batch_size, bool zero_copy = false) {
+    LayerParameter param;
+    FeatureReadParameter* feature_read_param =
+        param.mutable_feature_read_param();
+    feature_read_param->add_file(prefix_ + "data.feat");
+    feature_read_param->add_file(prefix_ + "label.feat");
+    feature_read_param->set_batch_size(batch_size);
+    feature_read_param->set_zero_copy(zero_copy);
+    FeatureReadLayer<Dtype> layer(param);
+    vector<Blob<Dtype>*> bottom_vec;
+    layer.SetUp(bottom_vec, blob_vec_);
+    EXPECT_EQ(batch_size, blob_data_->num());
+    EXPECT_EQ(2, blob_data_->channels());
+    EXPECT_EQ(1, blob_label_->channels());
+    for (int iter = 0; iter <= num_samples_; ++iter) {
+      layer.Forward(bottom_vec, blob_vec_);
+      for (int n = 0; n < batch_size; ++n) {
+        // the records wrap around
+        const int k = (iter * batch_size + n) % num_samples_;
+        for (int i = 0; i < 2; ++i) {
+          const int count = blobs_[i][k]->count();
+          for (int j = 0; j < count; ++j) {
+            EXPECT_EQ(blobs_[i][k]->cpu_data()[j],
+                      blob_vec_[i]->cpu_data()[n * count + j]);
+          }
+        }
+      }
+      if (!zero_copy) {
+        for (int i = 0; i < 2; ++i) {
+          caffe_add_scalar(blob_vec_[i]->count(), Dtype(1),
+                           blob_vec_[i]->mutable_cpu_data());
+        }
+      }
+    }
+  }
+
+  int num_samples_;
+  string prefix_;
+  Blob<Dtype>* const blob_data_;
+  Blob<Dtype>* const blob_label_;
+  vector<Blob<Dtype>*> blob_vec_;
+  vector<shared_ptr<Blob<Dtype> > > blobs_[2];
+};
+
+TYPED_TEST_CASE(FeatureReadLayerTest, TestDtypes);
+
+TYPED_TEST(FeatureReadLayerTest, TestRead) {
+  this->Write(0);
+  this->Read(1);
+}
+
+TYPED_TEST(FeatureReadLayerTest, TestZeroCopy) {
+  this->Write(0);
+  this->Read(1, true);
+}
+
+TYPED_TEST(FeatureReadLayerTest, TestBatch) {
+  this->Write(0);
+  this->Read(2);
+}
+
+TYPED_TEST(FeatureReadLayerTest, TestAsyncWrite) {
+  this->Write(2);
+  this->Read(2);
+}
+
+}  // namespace caffe
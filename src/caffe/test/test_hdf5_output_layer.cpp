@@ -38,6 +38,46 @@ class HDF5OutputLayerTest : public MultiDeviceTest<TypeParam> {
 
   void CheckBlobEqual(const Blob<Dtype>& b1, const Blob<Dtype>& b2);
 
+  // Writes the bottoms five times, through the background writer if HDF5
+  // is thread-safe, flushing after the third batch as Solver::Test does:
+  // the output holds the five batches stacked.
+  void TestWriteBatches(bool accumulate) {
+    const int num_batches = 5;
+    LayerParameter param;
+    param.mutable_hdf5_output_param()->set_file_name(output_file_name_);
+    param.mutable_hdf5_output_param()->set_queue_size(2);
+    param.mutable_hdf5_output_param()->set_accumulate(accumulate);
+    {
+      HDF5OutputLayer<Dtype> layer(param);
+      layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+      for (int i = 0; i < num_batches; ++i) {
+        layer.Forward(blob_bottom_vec_, blob_top_vec_);
+        if (i == 2) {
+          layer.FlushOutput();
+        }
+      }
+    }
+    hid_t file_id = H5Fopen(output_file_name_.c_str(), H5F_ACC_RDONLY,
+                            H5P_DEFAULT);
+    ASSERT_GE(file_id, 0)<< "Failed to open HDF5 file" << output_file_name_;
+    Blob<Dtype> blob_data;
+    hdf5_load_nd_dataset(file_id, HDF5_DATA_DATASET_NAME, 0, 4, &blob_data);
+    Blob<Dtype> blob_label;
+    hdf5_load_nd_dataset(file_id, HDF5_DATA_LABEL_NAME, 0, 4, &blob_label);
+    EXPECT_GE(H5Fclose(file_id), 0);
+
+    const Blob<Dtype>* expected[2] = { blob_data_, blob_label_ };
+    const Blob<Dtype>* saved[2] = { &blob_data, &blob_label };
+    for (int k = 0; k < 2; ++k) {
+      ASSERT_EQ(num_batches * expected[k]->num(), saved[k]->num());
+      ASSERT_EQ(num_batches * expected[k]->count(), saved[k]->count());
+      for (int i = 0; i < saved[k]->count(); ++i) {
+        EXPECT_EQ(expected[k]->cpu_data()[i % expected[k]->count()],
+                  saved[k]->cpu_data()[i]);
+      }
+    }
+  }
+
   string output_file_name_;
   string input_file_name_;
   Blob<Dtype>* const blob_data_;
@@ -118,4 +158,36 @@ TYPED_TEST(HDF5OutputLayerTest, TestForward) {
       this->output_file_name_;
 }
 
+TYPED_TEST(HDF5OutputLayerTest, TestForwardAccumulate) {
+  typedef typename TypeParam::Dtype Dtype;
+  hid_t file_id = H5Fopen(this->input_file_name_.c_str(), H5F_ACC_RDONLY,
+                          H5P_DEFAULT);
+  ASSERT_GE(file_id, 0)<< "Failed to open HDF5 file" <<
+      this->input_file_name_;
+  hdf5_load_nd_dataset(file_id, HDF5_DATA_DATASET_NAME, 0, 4,
+                       this->blob_data_);
+  hdf5_load_nd_dataset(file_id, HDF5_DATA_LABEL_NAME, 0, 4,
+                       this->blob_label_);
+  EXPECT_GE(H5Fclose(file_id), 0);
+  this->blob_bottom_vec_.push_back(this->blob_data_);
+  this->blob_bottom_vec_.push_back(this->blob_label_);
+  this->TestWriteBatches(true);
+}
+
+TYPED_TEST(HDF5OutputLayerTest, TestForwardBatches) {
+  typedef typename TypeParam::Dtype Dtype;
+  hid_t file_id = H5Fopen(this->input_file_name_.c_str(), H5F_ACC_RDONLY,
+                          H5P_DEFAULT);
+  ASSERT_GE(file_id, 0)<< "Failed to open HDF5 file" <<
+      this->input_file_name_;
+  hdf5_load_nd_dataset(file_id, HDF5_DATA_DATASET_NAME, 0, 4,
+                       this->blob_data_);
+  hdf5_load_nd_dataset(file_id, HDF5_DATA_LABEL_NAME, 0, 4,
+                       this->blob_label_);
+  EXPECT_GE(H5Fclose(file_id), 0);
+  this->blob_bottom_vec_.push_back(this->blob_data_);
+  this->blob_bottom_vec_.push_back(this->blob_label_);
+  this->TestWriteBatches(false);
+}
+
 }  // namespace caffe
@@ -0,0 +1,147 @@
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layers/image_seg_pose_data_layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/format.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class ImageSegPoseDataLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  ImageSegPoseDataLayerTest()
+      : seed_(1701), num_(5), height_(20), width_(24) {}
+  virtual void SetUp() {
+    // num_ images and segmentations whose pixels all differ, so that every
+    // crop and mirror gives a different batch, listed with their poses.
+    MakeTempDir(&dirname_);
+    std::ofstream source((dirname_ + "/list.txt").c_str());
+    std::ofstream posefile((dirname_ + "/pose.txt").c_str());
+    for (int i = 0; i < num_; ++i) {
+      cv::Mat image(height_, width_, CV_8UC3);
+      cv::Mat seg(height_, width_, CV_8UC1);
+      for (int h = 0; h < height_; ++h) {
+        for (int w = 0; w < width_; ++w) {
+          for (int c = 0; c < 3; ++c) {
+            image.at<cv::Vec3b>(h, w)[c] = (i * 37 + c * 11 + h * 7 + w * 3)
+                % 256;
+          }
+          seg.at<uchar>(h, w) = (h * width_ + w + i) % 21;
+        }
+      }
+      const string image_file = dirname_ + "/" + format_int(i) + ".png";
+      const string seg_file = dirname_ + "/" + format_int(i) + "_seg.png";
+      ASSERT_TRUE(cv::imwrite(image_file, image));
+      ASSERT_TRUE(cv::imwrite(seg_file, seg));
+      source << image_file << " " << seg_file << std::endl;
+      for (int k = 0; k < 32; ++k) {
+        posefile << (k == 0 ? "" : ",") << 8 * (k + 1 + i);
+      }
+      posefile << std::endl;
+    }
+  }
+
+  // Reads 3 batches of 4 cropped and mirrored samples, decoded by
+  // num_decode_threads threads, into blobs.
+  void Read(int num_decode_threads, int seed,
+      vector<shared_ptr<Blob<Dtype> > >* blobs) {
+    Caffe::set_random_seed(seed);
+    LayerParameter param;
+    param.set_phase(TRAIN);
+    ImageDataParameter* image_data_param = param.mutable_image_data_param();
+    image_data_param->set_batch_size(4);
+    image_data_param->set_source(dirname_ + "/list.txt");
+    image_data_param->set_posefile(dirname_ + "/pose.txt");
+    image_data_param->set_label_type(ImageDataParameter_LabelType_PIXEL);
+    image_data_param->set_num_decode_threads(num_decode_threads);
+    TransformationParameter* transform_param =
+        param.mutable_transform_param();
+    transform_param->set_mirror(true);
+    transform_param->set_crop_size(16);
+    vector<Blob<Dtype>*> blob_bottom_vec;
+    vector<Blob<Dtype>*> blob_top_vec;
+    for (int i = 0; i < 4; ++i) {
+      blob_top_vec.push_back(new Blob<Dtype>());
+    }
+    {
+      ImageSegPoseDataLayer<Dtype> layer(param);
+      layer.SetUp(blob_bottom_vec, blob_top_vec);
+      EXPECT_EQ(4, blob_top_vec[0]->num());
+      EXPECT_EQ(16, blob_top_vec[0]->height());
+      EXPECT_EQ(16, blob_top_vec[1]->width());
+      for (int iter = 0; iter < 3; ++iter) {
+        layer.Forward(blob_bottom_vec, blob_top_vec);
+        for (int i = 0; i < 4; ++i) {
+          shared_ptr<Blob<Dtype> > blob(new Blob<Dtype>());
+          blob->CopyFrom(*blob_top_vec[i], false, true);
+          blobs->push_back(blob);
+        }
+      }
+    }
+    for (int i = 0; i < 4; ++i) {
+      delete blob_top_vec[i];
+    }
+  }
+
+  static bool BlobsEqual(const vector<shared_ptr<Blob<Dtype> > >& a,
+      const vector<shared_ptr<Blob<Dtype> > >& b) {
+    if (a.size() != b.size()) {
+      return false;
+    }
+    for (int k = 0; k < a.size(); ++k) {
+      if (a[k]->shape() != b[k]->shape()) {
+        return false;
+      }
+      for (int j = 0; j < a[k]->count(); ++j) {
+        if (a[k]->cpu_data()[j] != b[k]->cpu_data()[j]) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  const int seed_;
+  const int num_;
+  const int height_;
+  const int width_;
+  string dirname_;
+};
+
+TYPED_TEST_CASE(ImageSegPoseDataLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(ImageSegPoseDataLayerTest, TestDecodeThreadsDeterministic) {
+  typedef typename TypeParam::Dtype Dtype;
+  vector<shared_ptr<Blob<Dtype> > > serial;
+  this->Read(1, this->seed_, &serial);
+  // the crops and mirrors depend on the seed...
+  vector<shared_ptr<Blob<Dtype> > > reseeded;
+  this->Read(1, this->seed_ + 1, &reseeded);
+  EXPECT_FALSE(this->BlobsEqual(serial, reseeded));
+  // ...but not on the number of decode threads
+  for (int num_decode_threads = 2; num_decode_threads <= 4;
+       ++num_decode_threads) {
+    vector<shared_ptr<Blob<Dtype> > > parallel;
+    this->Read(num_decode_threads, this->seed_, &parallel);
+    EXPECT_TRUE(this->BlobsEqual(serial, parallel))
+        << "with " << num_decode_threads << " decode threads";
+  }
+}
+
+}  // namespace caffe
+#endif  // USE_OPENCV
@@ -0,0 +1,120 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/argmax_layer.hpp"
+#include "caffe/layers/interp_argmax_layer.hpp"
+#include "caffe/layers/interp_layer.hpp"
+#include "caffe/layers/softmax_layer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class InterpArgMaxLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  InterpArgMaxLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 5, 6, 7)),
+        blob_top_label_(new Blob<Dtype>()),
+        blob_top_prob_(new Blob<Dtype>()) {
+    FillerParameter filler_param;
+    filler_param.set_std(3);
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_label_);
+    blob_top_vec_.push_back(blob_top_prob_);
+  }
+  virtual ~InterpArgMaxLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_label_;
+    delete blob_top_prob_;
+  }
+
+  // Runs the Interp -> Softmax -> ArgMax chain the layer replaces and checks
+  // the layer against it.
+  void TestAgainstChain(const LayerParameter& layer_param) {
+    InterpArgMaxLayer<Dtype> layer(layer_param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    layer.Forward(blob_bottom_vec_, blob_top_vec_);
+
+    Blob<Dtype> interp, prob, label;
+    vector<Blob<Dtype>*> interp_vec(1, &interp);
+    vector<Blob<Dtype>*> prob_vec(1, &prob);
+    vector<Blob<Dtype>*> label_vec(1, &label);
+    InterpLayer<Dtype> interp_layer(layer_param);
+    interp_layer.SetUp(blob_bottom_vec_, interp_vec);
+    interp_layer.Forward(blob_bottom_vec_, interp_vec);
+    LayerParameter softmax_param;
+    SoftmaxLayer<Dtype> softmax_layer(softmax_param);
+    softmax_layer.SetUp(interp_vec, prob_vec);
+    softmax_layer.Forward(interp_vec, prob_vec);
+    LayerParameter argmax_param;
+    argmax_param.mutable_argmax_param()->set_axis(1);
+    ArgMaxLayer<Dtype> argmax_layer(argmax_param);
+    argmax_layer.SetUp(prob_vec, label_vec);
+    argmax_layer.Forward(prob_vec, label_vec);
+
+    ASSERT_EQ(blob_top_label_->shape(), label.shape());
+    ASSERT_EQ(blob_top_prob_->shape(), label.shape());
+    const int spatial_dim = label.height() * label.width();
+    for (int n = 0; n < label.num(); ++n) {
+      for (int i = 0; i < spatial_dim; ++i) {
+        const int index = n * spatial_dim + i;
+        const int c = static_cast<int>(label.cpu_data()[index]);
+        EXPECT_EQ(blob_top_label_->cpu_data()[index], c);
+        EXPECT_NEAR(blob_top_prob_->cpu_data()[index],
+            prob.cpu_data()[(n * prob.channels() + c) * spatial_dim + i],
+            1e-5);
+      }
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_label_;
+  Blob<Dtype>* const blob_top_prob_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(InterpArgMaxLayerTest, TestDtypes);
+
+TYPED_TEST(InterpArgMaxLayerTest, TestSetup) {
+  LayerParameter layer_param;
+  layer_param.mutable_interp_param()->set_zoom_factor(4);
+  InterpArgMaxLayer<TypeParam> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(this->blob_top_label_->num(), 2);
+  EXPECT_EQ(this->blob_top_label_->channels(), 1);
+  EXPECT_EQ(this->blob_top_label_->height(), 21);
+  EXPECT_EQ(this->blob_top_label_->width(), 25);
+}
+
+TYPED_TEST(InterpArgMaxLayerTest, TestZoom) {
+  LayerParameter layer_param;
+  layer_param.mutable_interp_param()->set_zoom_factor(8);
+  this->TestAgainstChain(layer_param);
+}
+
+TYPED_TEST(InterpArgMaxLayerTest, TestSizeAndCrop) {
+  LayerParameter layer_param;
+  InterpParameter* interp_param = layer_param.mutable_interp_param();
+  interp_param->set_height(17);
+  interp_param->set_width(9);
+  interp_param->set_pad_beg(-1);
+  interp_param->set_pad_end(-1);
+  this->TestAgainstChain(layer_param);
+}
+
+TYPED_TEST(InterpArgMaxLayerTest, TestThreads) {
+  LayerParameter layer_param;
+  layer_param.mutable_interp_param()->set_zoom_factor(8);
+  layer_param.mutable_interp_param()->set_num_threads(3);
+  this->TestAgainstChain(layer_param);
+}
+
+}  // namespace caffe
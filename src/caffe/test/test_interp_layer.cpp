@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstring>
 #include <vector>
 
@@ -7,6 +8,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/interp_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -64,4 +66,74 @@ TYPED_TEST(InterpLayerTest, TestGradient) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(InterpLayerTest, TestForwardReference) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  InterpParameter* interp_param =
+      layer_param.mutable_interp_param();
+  interp_param->set_height(11);
+  interp_param->set_width(13);
+  InterpLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // The start and end pixels are aligned: output pixel (h, w) samples the
+  // input at (h * 5 / 10, w * 4 / 12).
+  const Blob<Dtype>& bottom = *this->blob_bottom_;
+  for (int n = 0; n < 2; ++n) {
+    for (int c = 0; c < 3; ++c) {
+      for (int h = 0; h < 11; ++h) {
+        for (int w = 0; w < 13; ++w) {
+          const Dtype y = h * Dtype(5) / 10;
+          const Dtype x = w * Dtype(4) / 12;
+          const int y0 = std::min(static_cast<int>(y), 4);
+          const int x0 = std::min(static_cast<int>(x), 3);
+          const Dtype dy = y - y0, dx = x - x0;
+          const Dtype expected =
+              (1 - dy) * ((1 - dx) * bottom.data_at(n, c, y0, x0) +
+                          dx * bottom.data_at(n, c, y0, x0 + 1)) +
+              dy * ((1 - dx) * bottom.data_at(n, c, y0 + 1, x0) +
+                    dx * bottom.data_at(n, c, y0 + 1, x0 + 1));
+          EXPECT_NEAR(this->blob_top_->data_at(n, c, h, w), expected, 1e-4);
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(InterpLayerTest, TestThreads) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  InterpParameter* interp_param =
+      layer_param.mutable_interp_param();
+  interp_param->set_zoom_factor(3);
+  interp_param->set_pad_beg(-1);
+  interp_param->set_pad_end(-1);
+  Blob<Dtype> top_diff;
+  Blob<Dtype> top[2], bottom_diff[2];
+  for (int k = 0; k < 2; ++k) {
+    interp_param->set_num_threads(k == 0 ? 1 : 4);
+    InterpLayer<Dtype> layer(layer_param);
+    vector<Blob<Dtype>*> top_vec(1, &top[k]);
+    layer.SetUp(this->blob_bottom_vec_, top_vec);
+    layer.Forward(this->blob_bottom_vec_, top_vec);
+    if (k == 0) {
+      top_diff.ReshapeLike(top[k]);
+      FillerParameter filler_param;
+      GaussianFiller<Dtype> filler(filler_param);
+      filler.Fill(&top_diff);
+    }
+    caffe_copy(top_diff.count(), top_diff.cpu_data(),
+               top[k].mutable_cpu_diff());
+    layer.Backward(top_vec, vector<bool>(1, true), this->blob_bottom_vec_);
+    bottom_diff[k].CopyFrom(*this->blob_bottom_, true, true);
+  }
+  ASSERT_EQ(top[0].count(), top[1].count());
+  for (int i = 0; i < top[0].count(); ++i) {
+    EXPECT_EQ(top[0].cpu_data()[i], top[1].cpu_data()[i]);
+  }
+  for (int i = 0; i < bottom_diff[0].count(); ++i) {
+    EXPECT_EQ(bottom_diff[0].cpu_diff()[i], bottom_diff[1].cpu_diff()[i]);
+  }
+}
+
 }  // namespace caffe
@@ -0,0 +1,93 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/lattice_cache.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class LatticeCacheTest : public ::testing::Test {
+ protected:
+  LatticeCacheTest() {
+    // a tiny 2 x 2 positional lattice
+    for (int j = 0; j < 2; ++j) {
+      for (int i = 0; i < 2; ++i) {
+        features_.push_back(i);
+        features_.push_back(j);
+      }
+    }
+  }
+
+  LatticeCache::Key MakeKey(uint64_t checksum) {
+    LatticeCache::Key key;
+    key.dim = 2;
+    key.num_points = 4;
+    key.weight = 1;
+    key.checksum = checksum;
+    return key;
+  }
+
+  shared_ptr<PairwisePotential> MakePotential() {
+    return shared_ptr<PairwisePotential>(
+        new PottsPotential(&features_[0], 2, 4, 1));
+  }
+
+  std::vector<float> features_;
+};
+
+TEST_F(LatticeCacheTest, TestHitAndMiss) {
+  LatticeCache cache(2);
+  EXPECT_FALSE(cache.Get(MakeKey(1), &features_[0]).get());
+  shared_ptr<PairwisePotential> potential = MakePotential();
+  cache.Put(MakeKey(1), &features_[0], potential);
+  EXPECT_EQ(potential, cache.Get(MakeKey(1), &features_[0]));
+  LatticeCache::Key other = MakeKey(1);
+  other.weight = 5;
+  EXPECT_FALSE(cache.Get(other, &features_[0]).get());
+  EXPECT_EQ(1, cache.hits());
+  EXPECT_EQ(2, cache.misses());
+  EXPECT_EQ(1, cache.size());
+}
+
+TEST_F(LatticeCacheTest, TestChecksumCollision) {
+  LatticeCache cache(2);
+  shared_ptr<PairwisePotential> potential = MakePotential();
+  cache.Put(MakeKey(1), &features_[0], potential);
+  // other features with the same checksum miss, and replace the entry
+  std::vector<float> other(features_);
+  other[3] = 2;
+  EXPECT_FALSE(cache.Get(MakeKey(1), &other[0]).get());
+  shared_ptr<PairwisePotential> other_potential = MakePotential();
+  cache.Put(MakeKey(1), &other[0], other_potential);
+  EXPECT_EQ(other_potential, cache.Get(MakeKey(1), &other[0]));
+  EXPECT_FALSE(cache.Get(MakeKey(1), &features_[0]).get());
+  EXPECT_EQ(1, cache.size());
+}
+
+TEST_F(LatticeCacheTest, TestEvictLeastRecentlyUsed) {
+  LatticeCache cache(2);
+  cache.Put(MakeKey(1), &features_[0], MakePotential());
+  cache.Put(MakeKey(2), &features_[0], MakePotential());
+  EXPECT_TRUE(cache.Get(MakeKey(1), &features_[0]).get());
+  cache.Put(MakeKey(3), &features_[0], MakePotential());
+  EXPECT_EQ(2, cache.size());
+  EXPECT_TRUE(cache.Get(MakeKey(1), &features_[0]).get());
+  EXPECT_FALSE(cache.Get(MakeKey(2), &features_[0]).get());
+  EXPECT_TRUE(cache.Get(MakeKey(3), &features_[0]).get());
+}
+
+TEST_F(LatticeCacheTest, TestHash) {
+  const float a[] = {1, 2, 3};
+  const float b[] = {1, 2, 4};
+  EXPECT_EQ(LatticeCache::Hash(a, sizeof(a)), LatticeCache::Hash(a, sizeof(a)));
+  EXPECT_NE(LatticeCache::Hash(a, sizeof(a)), LatticeCache::Hash(b, sizeof(b)));
+  // hashing in pieces equals hashing at once
+  EXPECT_EQ(LatticeCache::Hash(a, sizeof(a)),
+      LatticeCache::Hash(a + 1, 2 * sizeof(float),
+          LatticeCache::Hash(a, sizeof(float))));
+}
+
+}  // namespace caffe
@@ -0,0 +1,124 @@
+#include <fstream>  // NOLINT(readability/streams)
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/mat_read_layer.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/matio_io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class MatReadLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  MatReadLayerTest()
+      : num_files_(5), blob_top_data_(new Blob<Dtype>()),
+        blob_top_label_(new Blob<Dtype>()) {
+    MakeTempDir(&prefix_);
+    prefix_ += "/";
+    // sample k: blob 0 of shape 1x2x3x4 and blob 1 of shape 1x1x3x4, named
+    // after the source list and "iter_<k>"
+    std::ofstream source((prefix_ + "list.txt").c_str());
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    for (int k = 0; k < num_files_; ++k) {
+      std::ostringstream name;
+      name << "sample" << k;
+      source << name.str() << ".png" << std::endl;
+      for (int i = 0; i < 2; ++i) {
+        shared_ptr<Blob<Dtype> > blob(new Blob<Dtype>(1, 2 - i, 3, 4));
+        filler.Fill(blob.get());
+        std::ostringstream fname;
+        fname << prefix_ << name.str() << "_blob_" << i << ".mat";
+        WriteBlobToMat(fname.str().c_str(), false, blob.get());
+        std::ostringstream iter_fname;
+        iter_fname << prefix_ << "iter_" << k << "_blob_" << i << ".mat";
+        WriteBlobToMat(iter_fname.str().c_str(), false, blob.get());
+        blobs_[i].push_back(blob);
+      }
+    }
+    blob_top_vec_.push_back(blob_top_data_);
+    blob_top_vec_.push_back(blob_top_label_);
+  }
+  virtual ~MatReadLayerTest() {
+    delete blob_top_data_;
+    delete blob_top_label_;
+  }
+
+  // Reads 3 batches of 2 and checks them against the written blobs.
+  void TestRead(int num_threads, int cache_size, bool use_source = true) {
+    LayerParameter param;
+    MatReadParameter* mat_read_param = param.mutable_mat_read_param();
+    mat_read_param->set_prefix(prefix_);
+    if (use_source) {
+      mat_read_param->set_source(prefix_ + "list.txt");
+      mat_read_param->set_strip(4);
+    }
+    mat_read_param->set_batch_size(2);
+    mat_read_param->set_num_threads(num_threads);
+    mat_read_param->set_cache_size(cache_size);
+    MatReadLayer<Dtype> layer(param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    EXPECT_EQ(blob_top_data_->num(), 2);
+    EXPECT_EQ(blob_top_data_->channels(), 2);
+    EXPECT_EQ(blob_top_label_->channels(), 1);
+    EXPECT_EQ(blob_top_label_->width(), 4);
+    int k = 0;
+    for (int iter = 0; iter < 3; ++iter) {
+      layer.Forward(blob_bottom_vec_, blob_top_vec_);
+      for (int n = 0; n < 2; ++n, k = (k + 1) % num_files_) {
+        for (int i = 0; i < 2; ++i) {
+          const Blob<Dtype>& expected = *blobs_[i][k];
+          const Blob<Dtype>& top = *blob_top_vec_[i];
+          for (int j = 0; j < expected.count(); ++j) {
+            EXPECT_EQ(top.cpu_data()[top.offset(n) + j],
+                      expected.cpu_data()[j]);
+          }
+        }
+      }
+    }
+    if (cache_size > 0) {
+      // every file is read once, then served from the cache
+      EXPECT_EQ(layer.cache_misses(), 2 * num_files_);
+      EXPECT_GT(layer.cache_hits(), 0);
+    }
+  }
+
+  const int num_files_;
+  string prefix_;
+  vector<shared_ptr<Blob<Dtype> > > blobs_[2];
+  Blob<Dtype>* const blob_top_data_;
+  Blob<Dtype>* const blob_top_label_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(MatReadLayerTest, TestDtypes);
+
+TYPED_TEST(MatReadLayerTest, TestRead) {
+  this->TestRead(1, 0);
+}
+
+TYPED_TEST(MatReadLayerTest, TestReadThreads) {
+  this->TestRead(3, 0);
+}
+
+TYPED_TEST(MatReadLayerTest, TestReadCache) {
+  this->TestRead(2, 20);
+}
+
+TYPED_TEST(MatReadLayerTest, TestReadIterations) {
+  // the prefetch thread reads ahead past the last "iter_<k>" file: it must
+  // start over instead of failing on the missing file
+  this->TestRead(1, 0, false);
+}
+
+}  // namespace caffe
@@ -0,0 +1,99 @@
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/mat_write_layer.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/matio_io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class MatWriteLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  MatWriteLayerTest()
+      : num_iters_(6), blob_bottom_data_(new Blob<Dtype>(2, 3, 4, 5)),
+        blob_bottom_label_(new Blob<Dtype>(2, 1, 4, 5)) {
+    MakeTempDir(&prefix_);
+    prefix_ += "/";
+    blob_bottom_vec_.push_back(blob_bottom_data_);
+    blob_bottom_vec_.push_back(blob_bottom_label_);
+  }
+  virtual ~MatWriteLayerTest() {
+    delete blob_bottom_data_;
+    delete blob_bottom_label_;
+  }
+
+  // Runs num_iters_ forward passes with new bottoms every time, which must
+  // not change the blobs still waiting to be written, then reads the files
+  // back.
+  void TestWrite(int queue_size, bool compression, int period) {
+    LayerParameter param;
+    MatWriteParameter* mat_write_param = param.mutable_mat_write_param();
+    mat_write_param->set_prefix(prefix_);
+    mat_write_param->set_queue_size(queue_size);
+    mat_write_param->set_compression(compression);
+    mat_write_param->set_period(period);
+    MatWriteLayer<Dtype> layer(param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    vector<shared_ptr<Blob<Dtype> > > expected[2];
+    for (int iter = 0; iter < num_iters_; ++iter) {
+      for (int i = 0; i < 2; ++i) {
+        filler.Fill(blob_bottom_vec_[i]);
+        shared_ptr<Blob<Dtype> > blob(new Blob<Dtype>());
+        blob->CopyFrom(*blob_bottom_vec_[i], false, true);
+        expected[i].push_back(blob);
+      }
+      layer.Forward(blob_bottom_vec_, blob_top_vec_);
+    }
+    layer.FlushOutput();
+    for (int iter = 0; iter < num_iters_; iter += period) {
+      for (int i = 0; i < 2; ++i) {
+        std::ostringstream fname;
+        fname << prefix_ << "iter_" << iter << "_blob_" << i << ".mat";
+        Blob<Dtype> saved;
+        ReadBlobFromMat(fname.str().c_str(), &saved);
+        ASSERT_EQ(expected[i][iter]->shape(), saved.shape());
+        for (int j = 0; j < saved.count(); ++j) {
+          EXPECT_EQ(expected[i][iter]->cpu_data()[j], saved.cpu_data()[j]);
+        }
+      }
+    }
+  }
+
+  const int num_iters_;
+  string prefix_;
+  Blob<Dtype>* const blob_bottom_data_;
+  Blob<Dtype>* const blob_bottom_label_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(MatWriteLayerTest, TestDtypes);
+
+TYPED_TEST(MatWriteLayerTest, TestWrite) {
+  this->TestWrite(0, false, 1);
+}
+
+TYPED_TEST(MatWriteLayerTest, TestWriteQueue) {
+  this->TestWrite(2, false, 1);
+}
+
+TYPED_TEST(MatWriteLayerTest, TestWriteCompression) {
+  this->TestWrite(0, true, 1);
+}
+
+TYPED_TEST(MatWriteLayerTest, TestWriteQueueCompressionPeriod) {
+  this->TestWrite(3, true, 2);
+}
+
+}  // namespace caffe
@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/multi_scale_net.hpp"
+#include "caffe/util/interp.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class MultiScaleNetTest : public CPUDeviceTest<Dtype> {
+ protected:
+  MultiScaleNetTest() : image_(1, 2, 13, 17) {
+    Caffe::set_random_seed(1701);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(&image_);
+    // A per-pixel classifier, so that the zero padding of the batches does
+    // not leak into the valid scores.
+    const string proto =
+        "name: 'TinyNet' "
+        "input: 'data' "
+        "input_dim: 1 "
+        "input_dim: 2 "
+        "input_dim: 13 "
+        "input_dim: 17 "
+        "layer { "
+        "  name: 'score' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'score' "
+        "  convolution_param { "
+        "    num_output: 3 "
+        "    kernel_size: 1 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 1 "
+        "    } "
+        "    bias_filler { "
+        "      type: 'gaussian' "
+        "      std: 1 "
+        "    } "
+        "  } "
+        "} ";
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &net_param_));
+  }
+
+  // The scores of the net at one scale, resized back to the image.
+  void ForwardScale(Net<Dtype>* net, float scale, Blob<Dtype>* scores) {
+    const int height = std::max(1,
+        static_cast<int>(image_.height() * scale + 0.5f));
+    const int width = std::max(1,
+        static_cast<int>(image_.width() * scale + 0.5f));
+    Blob<Dtype>* input = net->input_blobs()[0];
+    input->Reshape(1, image_.channels(), height, width);
+    net->Reshape();
+    caffe_cpu_interp2<Dtype, false>(image_.channels(),
+        image_.cpu_data(), 0, 0, image_.height(), image_.width(),
+        image_.height(), image_.width(),
+        input->mutable_cpu_data(), 0, 0, height, width, height, width);
+    const Blob<Dtype>* score = net->ForwardPrefilled()[0];
+    scores->Reshape(1, score->channels(), image_.height(), image_.width());
+    caffe_cpu_interp2<Dtype, false>(score->channels(),
+        score->cpu_data(), 0, 0, height, width, height, width,
+        scores->mutable_cpu_data(), 0, 0, image_.height(), image_.width(),
+        image_.height(), image_.width());
+  }
+
+  Blob<Dtype> image_;
+  NetParameter net_param_;
+};
+
+TYPED_TEST_CASE(MultiScaleNetTest, TestDtypes);
+
+TYPED_TEST(MultiScaleNetTest, TestSingleScale) {
+  MultiScaleParameter param;
+  param.add_scale(1);
+  MultiScaleNet<TypeParam> multi_scale_net(this->net_param_, param);
+  Blob<TypeParam> scores, expected;
+  multi_scale_net.Forward(this->image_, &scores);
+  this->ForwardScale(multi_scale_net.net().get(), 1, &expected);
+  ASSERT_EQ(scores.shape(), expected.shape());
+  for (int i = 0; i < scores.count(); ++i) {
+    EXPECT_NEAR(scores.cpu_data()[i], expected.cpu_data()[i], 1e-4);
+  }
+}
+
+TYPED_TEST(MultiScaleNetTest, TestFusion) {
+  const float scales[] = {1, 0.75, 1.5};
+  for (int fusion = 0; fusion < 2; ++fusion) {
+    MultiScaleParameter param;
+    for (int s = 0; s < 3; ++s) {
+      param.add_scale(scales[s]);
+    }
+    param.set_fusion(static_cast<MultiScaleParameter_Fusion>(fusion));
+    param.set_batch_pad_ratio(1);
+    MultiScaleNet<TypeParam> multi_scale_net(this->net_param_, param);
+    Blob<TypeParam> scores;
+    multi_scale_net.Forward(this->image_, &scores);
+    EXPECT_EQ(multi_scale_net.num_forward(), 3);
+
+    Blob<TypeParam> expected, scale_scores;
+    for (int s = 0; s < 3; ++s) {
+      this->ForwardScale(multi_scale_net.net().get(), scales[s],
+                         &scale_scores);
+      if (s == 0) {
+        expected.CopyFrom(scale_scores, false, true);
+        continue;
+      }
+      TypeParam* fused = expected.mutable_cpu_data();
+      for (int i = 0; i < expected.count(); ++i) {
+        fused[i] = fusion == MultiScaleParameter_Fusion_MAX ?
+            std::max(fused[i], scale_scores.cpu_data()[i]) :
+            fused[i] + scale_scores.cpu_data()[i];
+      }
+    }
+    for (int i = 0; i < scores.count(); ++i) {
+      const TypeParam value = fusion == MultiScaleParameter_Fusion_MAX ?
+          expected.cpu_data()[i] : expected.cpu_data()[i] / 3;
+      EXPECT_NEAR(scores.cpu_data()[i], value, 1e-4);
+    }
+  }
+}
+
+TYPED_TEST(MultiScaleNetTest, TestBatchedScales) {
+  // Batching the scales pads them to a common size, which should not change
+  // the scores of a per-pixel net. The scale 0.5 is a pyramid level.
+  const float scales[] = {0.5, 0.75, 1};
+  Blob<TypeParam> scores[2];
+  int num_forward[2];
+  for (int batched = 0; batched < 2; ++batched) {
+    MultiScaleParameter param;
+    for (int s = 0; s < 3; ++s) {
+      param.add_scale(scales[s]);
+    }
+    param.set_batch_pad_ratio(batched ? 10 : 1);
+    // the same weights for both nets
+    Caffe::set_random_seed(1701);
+    MultiScaleNet<TypeParam> multi_scale_net(this->net_param_, param);
+    multi_scale_net.Forward(this->image_, &scores[batched]);
+    num_forward[batched] = multi_scale_net.num_forward();
+  }
+  EXPECT_EQ(num_forward[0], 3);
+  EXPECT_EQ(num_forward[1], 1);
+  ASSERT_EQ(scores[0].shape(), scores[1].shape());
+  for (int i = 0; i < scores[0].count(); ++i) {
+    EXPECT_NEAR(scores[0].cpu_data()[i], scores[1].cpu_data()[i], 1e-4);
+  }
+}
+
+TYPED_TEST(MultiScaleNetTest, TestCachedNets) {
+  MultiScaleParameter param;
+  param.add_scale(1);
+  param.add_scale(0.5);
+  param.set_batch_pad_ratio(1);
+  param.set_max_cached_nets(1);
+  MultiScaleNet<TypeParam> multi_scale_net(this->net_param_, param);
+  Blob<TypeParam> scores, repeated;
+  multi_scale_net.Forward(this->image_, &scores);
+  multi_scale_net.Forward(this->image_, &repeated);
+  EXPECT_EQ(multi_scale_net.num_forward(), 4);
+  for (int i = 0; i < scores.count(); ++i) {
+    EXPECT_EQ(scores.cpu_data()[i], repeated.cpu_data()[i]);
+  }
+}
+
+}  // namespace caffe
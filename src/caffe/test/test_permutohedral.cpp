@@ -0,0 +1,92 @@
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/permutohedral.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class PermutohedralTest : public ::testing::Test {
+ protected:
+  PermutohedralTest() : width_(23), height_(17), dim_(5) {}
+
+  virtual void SetUp() {
+    // bilateral features: position and a random color
+    const int num = width_ * height_;
+    features_.resize(num * dim_);
+    caffe_rng_uniform<float>(num * dim_, 0., 10., &features_[0]);
+    for (int h = 0; h < height_; ++h) {
+      for (int w = 0; w < width_; ++w) {
+        features_[(h * width_ + w) * dim_ + 0] = w / 3.f;
+        features_[(h * width_ + w) * dim_ + 1] = h / 3.f;
+      }
+    }
+    lattice_.init(&features_[0], dim_, num);
+  }
+
+  virtual void TearDown() {
+    Permutohedral::set_max_isa(Permutohedral::ISA_AVX512);
+  }
+
+  int width_;
+  int height_;
+  int dim_;
+  std::vector<float> features_;
+  Permutohedral lattice_;
+};
+
+TEST_F(PermutohedralTest, TestDispatchMatchesDefault) {
+  const int num = width_ * height_;
+  // sizes below, at and above the AVX2 / AVX-512 vector widths
+  const int value_sizes[] = {1, 3, 5, 8, 16, 20, 21};
+  for (int s = 0; s < sizeof(value_sizes) / sizeof(int); ++s) {
+    const int value_size = value_sizes[s];
+    std::vector<float> in(num * value_size);
+    caffe_rng_uniform<float>(in.size(), 0., 1., &in[0]);
+    Permutohedral::set_max_isa(Permutohedral::ISA_DEFAULT);
+    std::vector<float> expected(in.size());
+    lattice_.compute(&expected[0], &in[0], value_size);
+    for (int isa = Permutohedral::ISA_AVX2;
+         isa <= Permutohedral::supported_isa(); ++isa) {
+      Permutohedral::set_max_isa(static_cast<Permutohedral::Isa>(isa));
+      EXPECT_EQ(isa, Permutohedral::isa());
+      // poison the output to catch lanes that are never written
+      std::vector<float> out(in.size(), -1.f);
+      lattice_.compute(&out[0], &in[0], value_size);
+      for (int i = 0; i < out.size(); ++i) {
+        EXPECT_NEAR(expected[i], out[i], 1e-5 * (1 + std::fabs(expected[i])))
+            << "isa " << isa << " value_size " << value_size;
+      }
+    }
+  }
+}
+
+TEST_F(PermutohedralTest, TestArena) {
+  const int num = width_ * height_;
+  const int value_size = 20;
+  std::vector<float> in(num * value_size);
+  caffe_rng_uniform<float>(in.size(), 0., 1., &in[0]);
+  std::vector<float> expected(in.size());
+  lattice_.compute(&expected[0], &in[0], value_size);
+  LatticeArena arena;
+  for (int iter = 0; iter < 3; ++iter) {
+    // the memory of the previous iteration is recycled after a reset
+    Permutohedral lattice;
+    lattice.init(&features_[0], dim_, num, &arena);
+    std::vector<float> out(in.size());
+    lattice.compute(&out[0], &in[0], value_size, 0, 0, -1, -1, &arena);
+    for (int i = 0; i < out.size(); ++i) {
+      EXPECT_EQ(expected[i], out[i]);
+    }
+    const size_t capacity = arena.capacity();
+    arena.reset();
+    EXPECT_EQ(capacity, arena.capacity());
+  }
+}
+
+}  // namespace caffe
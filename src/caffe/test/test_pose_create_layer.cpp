@@ -0,0 +1,122 @@
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layers/pose_create_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class PoseCreateLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  PoseCreateLayerTest()
+      : blob_bottom_pose_(new Blob<Dtype>(2, 1, 1, 6)),
+        blob_bottom_size_(new Blob<Dtype>(2, 1, 23, 19)),
+        blob_top_(new Blob<Dtype>()) {
+    // image 0: a joint inside, one near the border and a missing one
+    // image 1: a joint off the map and two inside
+    const Dtype pose[] = {7, 11, 1, 21, 0, 0,
+                          25, 3, 18, 0, 9, 9};
+    caffe_copy(12, pose, blob_bottom_pose_->mutable_cpu_data());
+    blob_bottom_vec_.push_back(blob_bottom_pose_);
+    blob_bottom_vec_.push_back(blob_bottom_size_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~PoseCreateLayerTest() {
+    delete blob_bottom_pose_;
+    delete blob_bottom_size_;
+    delete blob_top_;
+  }
+
+  // The full 2-D Gaussian, as the layer used to evaluate it at every pixel.
+  Dtype Reference(int n, int j, int yy, int xx, float sigma) {
+    const int center_x = blob_bottom_pose_->data_at(n, 0, 0, 2 * j);
+    const int center_y = blob_bottom_pose_->data_at(n, 0, 0, 2 * j + 1);
+    if (center_x == 0 && center_y == 0) {
+      return 0;
+    }
+    return 4 * (1 / (sigma * sqrt(2 * M_PI))) *
+        exp(-0.5 * (pow(yy - center_y, 2.0) + pow(xx - center_x, 2.0)) *
+        pow(1 / sigma, 2.0));
+  }
+
+  // Checks the maps against the reference, within radius of the joints
+  // when radius is positive and zero beyond.
+  void CheckMaps(float sigma, int radius) {
+    EXPECT_EQ(blob_top_->num(), 2);
+    EXPECT_EQ(blob_top_->channels(), 3);
+    EXPECT_EQ(blob_top_->height(), 23);
+    EXPECT_EQ(blob_top_->width(), 19);
+    for (int n = 0; n < 2; ++n) {
+      for (int j = 0; j < 3; ++j) {
+        const int center_x = blob_bottom_pose_->data_at(n, 0, 0, 2 * j);
+        const int center_y = blob_bottom_pose_->data_at(n, 0, 0, 2 * j + 1);
+        for (int yy = 0; yy < 23; ++yy) {
+          for (int xx = 0; xx < 19; ++xx) {
+            Dtype expected = Reference(n, j, yy, xx, sigma);
+            if (radius > 0 && (std::abs(yy - center_y) > radius ||
+                               std::abs(xx - center_x) > radius)) {
+              expected = 0;
+            }
+            EXPECT_NEAR(expected, blob_top_->data_at(n, j, yy, xx),
+                        1e-6 + 1e-5 * expected)
+                << n << ", " << j << ", " << yy << ", " << xx;
+          }
+        }
+      }
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_pose_;
+  Blob<Dtype>* const blob_bottom_size_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(PoseCreateLayerTest, TestDtypes);
+
+TYPED_TEST(PoseCreateLayerTest, TestForward) {
+  LayerParameter layer_param;
+  layer_param.mutable_pose_create_param()->set_num_joint(3);
+  PoseCreateLayer<TypeParam> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  this->CheckMaps(1, 3);
+}
+
+TYPED_TEST(PoseCreateLayerTest, TestForwardWholeMap) {
+  LayerParameter layer_param;
+  layer_param.mutable_pose_create_param()->set_num_joint(3);
+  layer_param.mutable_pose_create_param()->set_sigma(2.5);
+  layer_param.mutable_pose_create_param()->set_truncate(0);
+  PoseCreateLayer<TypeParam> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  this->CheckMaps(2.5, 0);
+}
+
+TYPED_TEST(PoseCreateLayerTest, TestForwardReshape) {
+  LayerParameter layer_param;
+  layer_param.mutable_pose_create_param()->set_num_joint(3);
+  layer_param.mutable_pose_create_param()->set_sigma(2);
+  layer_param.mutable_pose_create_param()->set_truncate(0);
+  PoseCreateLayer<TypeParam> layer(layer_param);
+  Blob<TypeParam> small_size(2, 1, 5, 5);
+  this->blob_bottom_vec_[1] = &small_size;
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // the table grows with the maps
+  this->blob_bottom_vec_[1] = this->blob_bottom_size_;
+  layer.Reshape(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  this->CheckMaps(2, 0);
+}
+
+}  // namespace caffe
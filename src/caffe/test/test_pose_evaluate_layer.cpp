@@ -0,0 +1,96 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layers/pose_evaluate_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class PoseEvaluateLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  PoseEvaluateLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 1, 5, 6)),
+        blob_top_(new Blob<Dtype>()) {
+    // image 0: class 1 (joint 0) at (1, 1), (3, 1) and (3, 4),
+    //          class 19 (joint 8) at (5, 0)
+    // image 1: class 14 (joint 3) at (2, 2); class 3 belongs to no joint
+    caffe_set(blob_bottom_->count(), Dtype(0),
+              blob_bottom_->mutable_cpu_data());
+    SetLabel(0, 1, 1, 1);
+    SetLabel(0, 1, 3, 1);
+    SetLabel(0, 4, 3, 1);
+    SetLabel(0, 0, 5, 19);
+    SetLabel(1, 2, 2, 14);
+    SetLabel(1, 3, 3, 3);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~PoseEvaluateLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+  }
+
+  void SetLabel(int n, int h, int w, int label) {
+    blob_bottom_->mutable_cpu_data()[blob_bottom_->offset(n, 0, h, w)] =
+        label;
+  }
+
+  void CheckCenters() {
+    const Dtype* top = this->blob_top_->cpu_data();
+    EXPECT_EQ(this->blob_top_->count(), 2 * 18);
+    for (int i = 0; i < 18; ++i) {
+      Dtype expected = 0;
+      if (i == 0) { expected = 2; }   // x of joint 0: (1 + 3 + 3) / 3
+      if (i == 1) { expected = 2; }   // y of joint 0: (1 + 1 + 4) / 3
+      if (i == 16) { expected = 5; }
+      EXPECT_EQ(expected, top[i]) << "image 0, " << i;
+      // the pixels of image 0 do not leak into image 1
+      expected = (i == 6 || i == 7) ? 2 : 0;
+      EXPECT_EQ(expected, top[18 + i]) << "image 1, " << i;
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(PoseEvaluateLayerTest, TestDtypes);
+
+TYPED_TEST(PoseEvaluateLayerTest, TestForward) {
+  LayerParameter layer_param;
+  PoseEvaluateLayer<TypeParam> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  this->CheckCenters();
+}
+
+TYPED_TEST(PoseEvaluateLayerTest, TestForwardScores) {
+  // one hot scores of the labels, over 20 classes
+  Blob<TypeParam> scores(2, 20, 5, 6);
+  caffe_set(scores.count(), TypeParam(0), scores.mutable_cpu_data());
+  for (int n = 0; n < 2; ++n) {
+    for (int h = 0; h < 5; ++h) {
+      for (int w = 0; w < 6; ++w) {
+        const int label = this->blob_bottom_->data_at(n, 0, h, w);
+        scores.mutable_cpu_data()[scores.offset(n, label, h, w)] = 1;
+      }
+    }
+  }
+  this->blob_bottom_vec_[0] = &scores;
+  LayerParameter layer_param;
+  layer_param.mutable_pose_evaluate_param()->set_num_threads(2);
+  PoseEvaluateLayer<TypeParam> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  this->CheckCenters();
+}
+
+}  // namespace caffe
@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layers/seg_accuracy_layer.hpp"
+#include "caffe/util/confusion_matrix.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class SegAccuracyLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  SegAccuracyLayerTest()
+      : blob_bottom_data_(new Blob<Dtype>(2, 5, 6, 7)),
+        blob_bottom_label_(new Blob<Dtype>(2, 1, 6, 7)),
+        blob_top_(new Blob<Dtype>()) {
+    Caffe::set_random_seed(1701);
+    // integer scores, so that some pixels have tied classes
+    Dtype* data = blob_bottom_data_->mutable_cpu_data();
+    caffe_rng_uniform<Dtype>(blob_bottom_data_->count(), 0, 4, data);
+    for (int i = 0; i < blob_bottom_data_->count(); ++i) {
+      data[i] = floor(data[i]);
+    }
+    Dtype* label = blob_bottom_label_->mutable_cpu_data();
+    caffe_rng_uniform<Dtype>(blob_bottom_label_->count(), 0, 6, label);
+    for (int i = 0; i < blob_bottom_label_->count(); ++i) {
+      label[i] = floor(label[i]);
+      if (label[i] == 5) {
+        label[i] = 255;
+      }
+    }
+    blob_bottom_vec_.push_back(blob_bottom_data_);
+    blob_bottom_vec_.push_back(blob_bottom_label_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~SegAccuracyLayerTest() {
+    delete blob_bottom_data_;
+    delete blob_bottom_label_;
+    delete blob_top_;
+  }
+
+  // Reference confusion matrix, sorting the scores of every pixel.
+  void ReferenceConfusion(int top_k, ConfusionMatrix* confusion) {
+    const int channels = blob_bottom_data_->channels();
+    const int height = blob_bottom_data_->height();
+    const int width = blob_bottom_data_->width();
+    confusion->resize(channels);
+    for (int n = 0; n < blob_bottom_data_->num(); ++n) {
+      for (int h = 0; h < height; ++h) {
+        for (int w = 0; w < width; ++w) {
+          const int label = static_cast<int>(
+              blob_bottom_label_->data_at(n, 0, h, w));
+          if (label == 255 || label == 0) {
+            continue;
+          }
+          std::vector<std::pair<Dtype, int> > scores;
+          for (int c = 0; c < channels; ++c) {
+            scores.push_back(
+                std::make_pair(blob_bottom_data_->data_at(n, c, h, w), c));
+          }
+          std::sort(scores.begin(), scores.end(),
+                    std::greater<std::pair<Dtype, int> >());
+          int prediction = scores[0].second;
+          for (int k = 0; k < top_k; ++k) {
+            if (scores[k].second == label) {
+              prediction = label;
+            }
+          }
+          confusion->accumulate(label, prediction);
+        }
+      }
+    }
+  }
+
+  void TestForward(int top_k, int num_threads) {
+    LayerParameter layer_param;
+    SegAccuracyParameter* param = layer_param.mutable_seg_accuracy_param();
+    param->add_ignore_label(0);
+    param->add_ignore_label(255);
+    param->set_top_k(top_k);
+    param->set_num_threads(num_threads);
+    SegAccuracyLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+
+    ConfusionMatrix confusion;
+    ReferenceConfusion(top_k, &confusion);
+    EXPECT_NEAR(this->blob_top_->data_at(0, 0, 0, 0),
+                confusion.accuracy(), 1e-4);
+    EXPECT_NEAR(this->blob_top_->data_at(0, 0, 0, 1),
+                confusion.avgRecall(false), 1e-4);
+    EXPECT_NEAR(this->blob_top_->data_at(0, 0, 0, 2),
+                confusion.avgJaccard(), 1e-4);
+  }
+
+  Blob<Dtype>* const blob_bottom_data_;
+  Blob<Dtype>* const blob_bottom_label_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(SegAccuracyLayerTest, TestDtypes);
+
+TYPED_TEST(SegAccuracyLayerTest, TestForward) {
+  this->TestForward(1, 1);
+}
+
+TYPED_TEST(SegAccuracyLayerTest, TestForwardTopK) {
+  this->TestForward(3, 1);
+}
+
+TYPED_TEST(SegAccuracyLayerTest, TestForwardMultiThread) {
+  this->TestForward(1, 3);
+  this->TestForward(2, 3);
+}
+
+}  // namespace caffe
@@ -0,0 +1,195 @@
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include <string>
+#include <vector>
+
+#include "boost/scoped_ptr.hpp"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layers/seg_pose_data_layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/db.hpp"
+#include "caffe/util/format.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+using boost::scoped_ptr;
+
+template <typename TypeParam>
+class SegPoseDataLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  SegPoseDataLayerTest()
+      : num_(3), height_(4), width_(5),
+        blob_top_data_(new Blob<Dtype>()),
+        blob_top_label_(new Blob<Dtype>()),
+        blob_top_dim_(new Blob<Dtype>()),
+        blob_top_pose_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    MakeTempDir(&dirname_);
+    blob_top_vec_.push_back(blob_top_data_);
+    blob_top_vec_.push_back(blob_top_label_);
+    blob_top_vec_.push_back(blob_top_dim_);
+    blob_top_vec_.push_back(blob_top_pose_);
+  }
+
+  virtual ~SegPoseDataLayerTest() {
+    delete blob_top_data_;
+    delete blob_top_label_;
+    delete blob_top_dim_;
+    delete blob_top_pose_;
+  }
+
+  // The pixels of image i, and of its segmentation.
+  int Pixel(int i, int c, int h, int w) const {
+    return i * 60 + c * 20 + h * width_ + w;
+  }
+  int Seg(int i, int h, int w) const {
+    return (h * width_ + w) % 3 + i;
+  }
+
+  // Packs num_ samples into a db, as tools/convert_imageseg_pose does: the
+  // images and segmentations are PNG files, and the last image has no
+  // segmentation.
+  void Fill(DataParameter_DB backend) {
+    backend_ = backend;
+    scoped_ptr<db::DB> db(db::GetDB(backend));
+    db->Open(dirname_ + "/db", db::NEW);
+    scoped_ptr<db::Transaction> txn(db->NewTransaction());
+    for (int i = 0; i < num_; ++i) {
+      cv::Mat image(height_, width_, CV_8UC3);
+      cv::Mat seg(height_, width_, CV_8UC1);
+      for (int h = 0; h < height_; ++h) {
+        for (int w = 0; w < width_; ++w) {
+          for (int c = 0; c < 3; ++c) {
+            image.at<cv::Vec3b>(h, w)[c] = Pixel(i, c, h, w);
+          }
+          seg.at<uchar>(h, w) = Seg(i, h, w);
+        }
+      }
+      const string image_file = dirname_ + "/" + format_int(i) + ".png";
+      const string seg_file = dirname_ + "/" + format_int(i) + "_seg.png";
+      ASSERT_TRUE(cv::imwrite(image_file, image));
+      ASSERT_TRUE(cv::imwrite(seg_file, seg));
+      vector<float> pose(32);
+      for (int k = 0; k < pose.size(); ++k) {
+        pose[k] = 8 * (k + 1 + i);
+      }
+      SegPoseDatum datum;
+      ASSERT_TRUE(ReadSegPoseToDatum(image_file,
+          i < num_ - 1 ? seg_file : "", pose, &datum));
+      EXPECT_EQ(height_, datum.height());
+      EXPECT_EQ(width_, datum.width());
+      string out;
+      CHECK(datum.SerializeToString(&out));
+      txn->Put(format_int(i, 8), out);
+    }
+    txn->Commit();
+  }
+
+  void TestRead(ImageDataParameter_LabelType label_type) {
+    LayerParameter param;
+    DataParameter* data_param = param.mutable_data_param();
+    data_param->set_batch_size(num_);
+    data_param->set_source(dirname_ + "/db");
+    data_param->set_backend(backend_);
+    param.mutable_image_data_param()->set_label_type(label_type);
+    SegPoseDataLayer<Dtype> layer(param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    EXPECT_EQ(num_, blob_top_data_->num());
+    EXPECT_EQ(3, blob_top_data_->channels());
+    EXPECT_EQ(height_, blob_top_data_->height());
+    EXPECT_EQ(width_, blob_top_data_->width());
+    EXPECT_EQ(num_, blob_top_label_->num());
+    EXPECT_EQ(1, blob_top_label_->channels());
+    EXPECT_EQ(height_, blob_top_label_->height());
+    EXPECT_EQ(width_, blob_top_label_->width());
+    EXPECT_EQ(2, blob_top_dim_->count() / num_);
+    EXPECT_EQ(18, blob_top_pose_->count() / num_);
+
+    // Go through the data twice
+    for (int iter = 0; iter < 2; ++iter) {
+      layer.Forward(blob_bottom_vec_, blob_top_vec_);
+      for (int i = 0; i < num_; ++i) {
+        for (int c = 0; c < 3; ++c) {
+          for (int h = 0; h < height_; ++h) {
+            for (int w = 0; w < width_; ++w) {
+              EXPECT_EQ(Pixel(i, c, h, w),
+                  blob_top_data_->data_at(i, c, h, w));
+            }
+          }
+        }
+        for (int h = 0; h < height_; ++h) {
+          for (int w = 0; w < width_; ++w) {
+            const bool labeled = label_type ==
+                ImageDataParameter_LabelType_PIXEL && i < num_ - 1;
+            EXPECT_EQ(labeled ? Seg(i, h, w) : 255,
+                blob_top_label_->data_at(i, 0, h, w));
+          }
+        }
+        const Dtype* dim = blob_top_dim_->cpu_data() + blob_top_dim_->offset(i);
+        EXPECT_EQ(height_, dim[0]);
+        EXPECT_EQ(width_, dim[1]);
+        // head (joint 10), upper body (mean of joints 8 and 9) and right
+        // shoe (joint 1), in units of 8 pixels
+        const Dtype* pose =
+            blob_top_pose_->cpu_data() + blob_top_pose_->offset(i);
+        EXPECT_FLOAT_EQ(19 + i, pose[0]);
+        EXPECT_FLOAT_EQ(20 + i, pose[1]);
+        EXPECT_FLOAT_EQ(16 + i, pose[2]);
+        EXPECT_FLOAT_EQ(17 + i, pose[3]);
+        EXPECT_FLOAT_EQ(1 + i, pose[16]);
+        EXPECT_FLOAT_EQ(2 + i, pose[17]);
+      }
+    }
+  }
+
+  const int num_;
+  const int height_;
+  const int width_;
+  DataParameter_DB backend_;
+  string dirname_;
+  Blob<Dtype>* const blob_top_data_;
+  Blob<Dtype>* const blob_top_label_;
+  Blob<Dtype>* const blob_top_dim_;
+  Blob<Dtype>* const blob_top_pose_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(SegPoseDataLayerTest, TestDtypesAndDevices);
+
+#ifdef USE_LEVELDB
+TYPED_TEST(SegPoseDataLayerTest, TestReadLevelDB) {
+  this->Fill(DataParameter_DB_LEVELDB);
+  this->TestRead(ImageDataParameter_LabelType_PIXEL);
+}
+
+TYPED_TEST(SegPoseDataLayerTest, TestReadNoLabelLevelDB) {
+  this->Fill(DataParameter_DB_LEVELDB);
+  this->TestRead(ImageDataParameter_LabelType_NONE);
+}
+#endif  // USE_LEVELDB
+
+#ifdef USE_LMDB
+TYPED_TEST(SegPoseDataLayerTest, TestReadLMDB) {
+  this->Fill(DataParameter_DB_LMDB);
+  this->TestRead(ImageDataParameter_LabelType_PIXEL);
+}
+
+TYPED_TEST(SegPoseDataLayerTest, TestReadNoLabelLMDB) {
+  this->Fill(DataParameter_DB_LMDB);
+  this->TestRead(ImageDataParameter_LabelType_NONE);
+}
+#endif  // USE_LMDB
+
+}  // namespace caffe
+#endif  // USE_OPENCV
@@ -0,0 +1,179 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/mask_create_layer.hpp"
+#include "caffe/layers/pose_error_layer.hpp"
+#include "caffe/layers/pose_evaluate_layer.hpp"
+#include "caffe/layers/reward_loss_layer.hpp"
+#include "caffe/layers/structure_reward_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class StructureRewardLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  StructureRewardLayerTest()
+      : blob_bottom_score_(new Blob<Dtype>(3, 20, 7, 9)),
+        blob_bottom_label_(new Blob<Dtype>(3, 1, 7, 9)),
+        blob_top_(new Blob<Dtype>()) {
+    Caffe::set_random_seed(1701);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_score_);
+    // Labels of classes 0 to 18 and some ignored pixels, so that the
+    // last joint is missing in the ground truth.
+    Dtype* label = blob_bottom_label_->mutable_cpu_data();
+    for (int i = 0; i < blob_bottom_label_->count(); ++i) {
+      label[i] = caffe_rng_rand() % 19;
+      if (i % 11 == 0) {
+        label[i] = 255;
+      }
+    }
+    blob_bottom_vec_.push_back(blob_bottom_score_);
+    blob_bottom_vec_.push_back(blob_bottom_label_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~StructureRewardLayerTest() {
+    delete blob_bottom_score_;
+    delete blob_bottom_label_;
+    delete blob_top_;
+  }
+
+  // Runs the MaskCreate -> PoseEvaluate -> PoseError -> RewardLoss chain
+  // on image n; RewardLoss reads the error of the first image of its batch.
+  void RunChain(int n, Dtype* reward, Blob<Dtype>* score_diff) {
+    Blob<Dtype> score(1, 20, 7, 9), label(1, 1, 7, 9);
+    caffe_copy(score.count(), blob_bottom_score_->cpu_data_at(n),
+               score.mutable_cpu_data());
+    caffe_copy(label.count(), blob_bottom_label_->cpu_data_at(n),
+               label.mutable_cpu_data());
+    Blob<Dtype> mask, pose, gt_pose, error, loss;
+    vector<Blob<Dtype>*> bottom(1, &score), top(1, &mask);
+
+    LayerParameter mask_param;
+    mask_param.mutable_mask_create_param()->set_num_cls(20);
+    MaskCreateLayer<Dtype> mask_layer(mask_param);
+    mask_layer.SetUp(bottom, top);
+    mask_layer.Forward(bottom, top);
+
+    LayerParameter pose_param;
+    PoseEvaluateLayer<Dtype> pose_layer(pose_param);
+    PoseEvaluateLayer<Dtype> gt_pose_layer(pose_param);
+    bottom[0] = &mask;
+    top[0] = &pose;
+    pose_layer.SetUp(bottom, top);
+    pose_layer.Forward(bottom, top);
+    bottom[0] = &label;
+    top[0] = &gt_pose;
+    gt_pose_layer.SetUp(bottom, top);
+    gt_pose_layer.Forward(bottom, top);
+
+    LayerParameter error_param;
+    error_param.mutable_pose_error_param()->set_error_order(1);
+    PoseErrorLayer<Dtype> error_layer(error_param);
+    bottom[0] = &pose;
+    bottom.push_back(&gt_pose);
+    top[0] = &error;
+    error_layer.SetUp(bottom, top);
+    error_layer.Forward(bottom, top);
+
+    LayerParameter loss_param;
+    RewardLossLayer<Dtype> loss_layer(loss_param);
+    bottom[0] = &error;
+    bottom[1] = &mask;
+    top[0] = &loss;
+    loss_layer.SetUp(bottom, top);
+    loss_layer.Forward(bottom, top);
+    *reward = loss.cpu_data()[0];
+
+    vector<bool> propagate_down(2, true);
+    propagate_down[0] = false;
+    loss_layer.Backward(top, propagate_down, bottom);
+    caffe_set(score.count(), Dtype(0), score.mutable_cpu_diff());
+    bottom.resize(1);
+    bottom[0] = &score;
+    top[0] = &mask;
+    mask_layer.Backward(top, vector<bool>(1, true), bottom);
+    score_diff->CopyFrom(score, true, true);
+  }
+
+  void TestAgainstChain(int num_threads) {
+    LayerParameter layer_param;
+    layer_param.mutable_structure_reward_param()->set_num_threads(
+        num_threads);
+    StructureRewardLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    EXPECT_EQ(this->blob_top_->count(), 3);
+    caffe_set(this->blob_top_->count(), Dtype(1),
+              this->blob_top_->mutable_cpu_diff());
+    vector<bool> propagate_down(2, true);
+    propagate_down[1] = false;
+    layer.Backward(this->blob_top_vec_, propagate_down,
+                   this->blob_bottom_vec_);
+
+    for (int n = 0; n < 3; ++n) {
+      Dtype reward;
+      Blob<Dtype> score_diff;
+      RunChain(n, &reward, &score_diff);
+      EXPECT_GT(reward, 0);
+      EXPECT_NEAR(reward, this->blob_top_->cpu_data()[n], 1e-4 * reward);
+      const Dtype* diff = this->blob_bottom_score_->cpu_diff_at(n);
+      for (int i = 0; i < score_diff.count(); ++i) {
+        EXPECT_NEAR(score_diff.cpu_diff()[i], diff[i], 1e-4 * reward)
+            << "image " << n << ", " << i;
+      }
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_score_;
+  Blob<Dtype>* const blob_bottom_label_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(StructureRewardLayerTest, TestDtypes);
+
+TYPED_TEST(StructureRewardLayerTest, TestGradient) {
+  this->TestAgainstChain(1);
+}
+
+TYPED_TEST(StructureRewardLayerTest, TestGradientMultiThread) {
+  this->TestAgainstChain(2);
+}
+
+TYPED_TEST(StructureRewardLayerTest, TestLossWeight) {
+  LayerParameter layer_param;
+  layer_param.add_loss_weight(2);
+  StructureRewardLayer<TypeParam> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  const TypeParam loss =
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const TypeParam* reward = this->blob_top_->cpu_data();
+  EXPECT_NEAR(2 * (reward[0] + reward[1] + reward[2]), loss, 1e-6);
+  vector<bool> propagate_down(2, true);
+  propagate_down[1] = false;
+  layer.Backward(this->blob_top_vec_, propagate_down, this->blob_bottom_vec_);
+  // the diff of every pixel is the reward of its image times the weight
+  const int spatial_dim = 7 * 9;
+  for (int n = 0; n < 3; ++n) {
+    const TypeParam* diff = this->blob_bottom_score_->cpu_diff_at(n);
+    for (int i = 0; i < spatial_dim; ++i) {
+      TypeParam sum = 0;
+      for (int c = 0; c < 20; ++c) {
+        sum += diff[c * spatial_dim + i];
+      }
+      EXPECT_NEAR(2 * reward[n], sum, 1e-6);
+    }
+  }
+}
+
+}  // namespace caffe
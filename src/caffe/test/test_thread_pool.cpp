@@ -0,0 +1,42 @@
+#include <boost/bind.hpp>
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/util/thread_pool.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+static void Increment(std::vector<int>* counts, int i) {
+  ++(*counts)[i];
+}
+
+class ThreadPoolTest : public ::testing::Test {
+ protected:
+  std::vector<int> counts_;
+};
+
+TEST_F(ThreadPoolTest, TestResolveNumThreads) {
+  EXPECT_EQ(3, ThreadPool::ResolveNumThreads(3));
+  EXPECT_GE(ThreadPool::ResolveNumThreads(0), 1);
+}
+
+TEST_F(ThreadPoolTest, TestRunsEachTaskOnce) {
+  for (int num_threads = 1; num_threads <= 4; ++num_threads) {
+    ThreadPool pool(num_threads);
+    EXPECT_EQ(num_threads, pool.num_threads());
+    // run several jobs on the same pool to check that workers are reused
+    for (int num_tasks = 0; num_tasks < 20; num_tasks += 3) {
+      counts_.assign(num_tasks, 0);
+      pool.Run(num_tasks, boost::bind(&Increment, &counts_, _1));
+      for (int i = 0; i < num_tasks; ++i) {
+        EXPECT_EQ(1, counts_[i]);
+      }
+    }
+  }
+}
+
+}  // namespace caffe
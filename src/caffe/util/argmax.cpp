@@ -0,0 +1,69 @@
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+
+#include "caffe/util/argmax.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void caffe_cpu_argmax_update(const int count, const Dtype* score,
+    const int c, Dtype* max_score, int* argmax) {
+  for (int i = 0; i < count; ++i) {
+    const bool ge = score[i] >= max_score[i];
+    max_score[i] = ge ? score[i] : max_score[i];
+    argmax[i] = ge ? c : argmax[i];
+  }
+}
+
+#ifdef __SSE2__
+template <>
+void caffe_cpu_argmax_update<float>(const int count, const float* score,
+    const int c, float* max_score, int* argmax) {
+  const __m128i vc = _mm_set1_epi32(c);
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const __m128 s = _mm_loadu_ps(score + i);
+    const __m128 m = _mm_loadu_ps(max_score + i);
+    const __m128 ge = _mm_cmpge_ps(s, m);
+    _mm_storeu_ps(max_score + i,
+        _mm_or_ps(_mm_and_ps(ge, s), _mm_andnot_ps(ge, m)));
+    const __m128i gei = _mm_castps_si128(ge);
+    __m128i* a = reinterpret_cast<__m128i*>(argmax + i);
+    _mm_storeu_si128(a, _mm_or_si128(_mm_and_si128(gei, vc),
+        _mm_andnot_si128(gei, _mm_loadu_si128(a))));
+  }
+  for (; i < count; ++i) {
+    const bool ge = score[i] >= max_score[i];
+    max_score[i] = ge ? score[i] : max_score[i];
+    argmax[i] = ge ? c : argmax[i];
+  }
+}
+#else
+template void caffe_cpu_argmax_update<float>(const int count,
+    const float* score, const int c, float* max_score, int* argmax);
+#endif
+template void caffe_cpu_argmax_update<double>(const int count,
+    const double* score, const int c, double* max_score, int* argmax);
+
+template <typename Dtype>
+void caffe_cpu_channel_argmax(const int channels, const int count,
+    const int stride, const Dtype* score, Dtype* max_score, int* argmax) {
+  caffe_copy(count, score, max_score);
+  std::fill(argmax, argmax + count, 0);
+  for (int c = 1; c < channels; ++c) {
+    caffe_cpu_argmax_update(count, score + c * stride, c, max_score, argmax);
+  }
+}
+
+template void caffe_cpu_channel_argmax<float>(const int channels,
+    const int count, const int stride, const float* score, float* max_score,
+    int* argmax);
+template void caffe_cpu_channel_argmax<double>(const int channels,
+    const int count, const int stride, const double* score,
+    double* max_score, int* argmax);
+
+}  // namespace caffe
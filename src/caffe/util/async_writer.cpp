@@ -0,0 +1,88 @@
+#include <boost/thread.hpp>
+
+#include <exception>
+
+#include "caffe/util/async_writer.hpp"
+
+namespace caffe {
+
+class AsyncWriter::sync {
+ public:
+  boost::mutex mutex_;
+  boost::condition_variable pushed_;
+  boost::condition_variable popped_;
+};
+
+AsyncWriter::AsyncWriter(int max_pending)
+    : max_pending_(max_pending), busy_(false), stop_(false),
+      sync_(new sync()) {
+  CHECK_GE(max_pending_, 0);
+  if (max_pending_ == 0) {
+    return;
+  }
+  try {
+    thread_.reset(new boost::thread(&AsyncWriter::WriterEntry, this));
+  } catch (std::exception& e) {
+    LOG(FATAL) << "Thread exception: " << e.what();
+  }
+}
+
+AsyncWriter::~AsyncWriter() {
+  if (!thread_) {
+    return;
+  }
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    stop_ = true;
+  }
+  sync_->pushed_.notify_all();
+  thread_->join();
+}
+
+void AsyncWriter::Push(const boost::function<void()>& task) {
+  if (!thread_) {
+    task();
+    return;
+  }
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    while (tasks_.size() >= max_pending_) {
+      sync_->popped_.wait(lock);
+    }
+    tasks_.push_back(task);
+  }
+  sync_->pushed_.notify_one();
+}
+
+void AsyncWriter::Flush() {
+  if (!thread_) {
+    return;
+  }
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  while (busy_ || !tasks_.empty()) {
+    sync_->popped_.wait(lock);
+  }
+}
+
+void AsyncWriter::WriterEntry() {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  while (true) {
+    while (!stop_ && tasks_.empty()) {
+      sync_->pushed_.wait(lock);
+    }
+    // Drain the queue before stopping, so that no write is lost.
+    if (tasks_.empty()) {
+      return;
+    }
+    boost::function<void()> task = tasks_.front();
+    tasks_.pop_front();
+    busy_ = true;
+    lock.unlock();
+    task();
+    lock.lock();
+    busy_ = false;
+    sync_->popped_.notify_all();
+  }
+}
+
+}  // namespace caffe
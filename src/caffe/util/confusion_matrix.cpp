@@ -66,6 +66,28 @@ void ConfusionMatrix::accumulate(const ConfusionMatrix& confusion) {
 
 }
 
+void ConfusionMatrix::toProto(caffe::ConfusionMatrixProto* proto) const {
+  proto->Clear();
+  proto->set_num_classes(numRows());
+  for (size_t i = 0; i < _matrix.size(); ++i) {
+    for (size_t j = 0; j < _matrix[i].size(); ++j) {
+      proto->add_count(_matrix[i][j]);
+    }
+  }
+}
+
+void ConfusionMatrix::fromProto(const caffe::ConfusionMatrixProto& proto) {
+  const int m = proto.num_classes();
+  CHECK_EQ(proto.count_size(), m * m) << "Invalid confusion matrix counts.";
+  _matrix.clear();
+  resize(m);
+  for (int i = 0; i < m; ++i) {
+    for (int j = 0; j < m; ++j) {
+      _matrix[i][j] = proto.count(i * m + j);
+    }
+  }
+}
+
 void ConfusionMatrix::printCounts(const char *header) const {
   if (header == NULL) {
     LOG(INFO) << "--- confusion matrix: (actual, predicted) ---";
@@ -319,6 +341,15 @@ double ConfusionMatrix::avgJaccard() const {
   return totalJaccard / (double)_matrix.size();
 }
 
+double ConfusionMatrix::avgF1Score() const {
+  double totalF1 = 0.0;
+  for (size_t i = 0; i < _matrix.size(); i++) {
+    totalF1 += f1Score(i);
+  }
+
+  return totalF1 / (double)_matrix.size();
+}
+
 double ConfusionMatrix::precision(int n) const {
   CHECK(_matrix.size() > (size_t)n);
   return (_matrix[n].size() > (size_t)n) ?
@@ -339,6 +370,14 @@ double ConfusionMatrix::jaccard(int n) const {
     intersectionSize / unionSize;
 }
 
+double ConfusionMatrix::f1Score(int n) const {
+  CHECK((_matrix.size() > (size_t)n) && (_matrix[n].size() > (size_t)n));
+  // 2 * precision * recall / (precision + recall)
+  const double truePositives = (double)_matrix[n][n];
+  const double sizes = rowSum(n) + colSum(n);
+  return (sizes == 0.0) ? 1.0 : 2.0 * truePositives / sizes;
+}
+
 const unsigned long& ConfusionMatrix::operator()(int i, int j) const {
   return _matrix[i][j];
 }
@@ -346,3 +385,39 @@ const unsigned long& ConfusionMatrix::operator()(int i, int j) const {
 unsigned long& ConfusionMatrix::operator()(int i, int j) {
   return _matrix[i][j];
 }
+
+ConfusionMatrixShards::ConfusionMatrixShards() : _m(0) {}
+
+ConfusionMatrixShards::ConfusionMatrixShards(const int m,
+                                             const int num_shards) : _m(0) {
+  resize(m, num_shards);
+}
+
+void ConfusionMatrixShards::resize(const int m, const int num_shards) {
+  // the counts are laid out m-by-m, so they are meaningless once m changes
+  if (m != _m) {
+    _shards.clear();
+  }
+  _m = m;
+  _shards.resize(num_shards);
+  for (int s = 0; s < num_shards; ++s) {
+    _shards[s].resize(m * m, 0);
+  }
+}
+
+void ConfusionMatrixShards::clear() {
+  for (size_t s = 0; s < _shards.size(); ++s) {
+    std::fill(_shards[s].begin(), _shards[s].end(), 0);
+  }
+}
+
+void ConfusionMatrixShards::mergeInto(ConfusionMatrix* conf) const {
+  CHECK_EQ(conf->numRows(), _m);
+  for (size_t s = 0; s < _shards.size(); ++s) {
+    for (int i = 0; i < _m; ++i) {
+      for (int j = 0; j < _m; ++j) {
+        (*conf)(i, j) += _shards[s][i * _m + j];
+      }
+    }
+  }
+}
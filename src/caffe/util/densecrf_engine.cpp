@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/util/densecrf_engine.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Bi-linear resampling of a packed [height1 width1 channels] array to
+// [height2 width2 channels], aligning the corners. Same weights and order
+// of the sums as caffe_cpu_interp2<float, true>, which the engine cannot
+// use without depending on the rest of caffe.
+template <typename T>
+void ResamplePacked(int channels, const T* in, int height1, int width1,
+    float* out, int height2, int width2) {
+  const float rh = height2 > 1 ?
+      static_cast<float>(height1 - 1) / (height2 - 1) : 0.f;
+  const float rw = width2 > 1 ?
+      static_cast<float>(width1 - 1) / (width2 - 1) : 0.f;
+  for (int h2 = 0; h2 < height2; ++h2) {
+    const float h1r = rh * h2;
+    const int h1 = h1r;
+    const int h1p = (h1 < height1 - 1) ? 1 : 0;
+    const float h1lambda = h1r - h1;
+    const float h0lambda = 1.f - h1lambda;
+    for (int w2 = 0; w2 < width2; ++w2) {
+      const float w1r = rw * w2;
+      const int w1 = w1r;
+      const int w1p = (w1 < width1 - 1) ? 1 : 0;
+      const float w1lambda = w1r - w1;
+      const float w0lambda = 1.f - w1lambda;
+      const T* pos1 = in + channels * (h1 * width1 + w1);
+      const T* pos1w = pos1 + channels * w1p;
+      const T* pos1h = pos1 + channels * h1p * width1;
+      const T* pos1hw = pos1h + channels * w1p;
+      float* pos2 = out + channels * (h2 * width2 + w2);
+      for (int c = 0; c < channels; ++c) {
+        pos2[c] =
+            h0lambda * (w0lambda * pos1[c]  + w1lambda * pos1w[c]) +
+            h1lambda * (w0lambda * pos1h[c] + w1lambda * pos1hw[c]);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+DenseCRFEngine::DenseCRFEngine(ExpAccuracy accuracy, int downsample)
+    : accuracy_(accuracy), downsample_(std::max(downsample, 1)),
+      W_(0), H_(0), N_(0), M_(0), Ws_(0), Hs_(0), Ns_(0),
+      capacity_(0), small_capacity_(0),
+      unary_(NULL), current_(NULL), next_(NULL), tmp_(NULL),
+      small_current_(NULL), small_next_(NULL), small_tmp_(NULL) {
+}
+
+DenseCRFEngine::~DenseCRFEngine() {
+  Reset(0, 0, 0);
+  deallocate(unary_);
+  deallocate(current_);
+  deallocate(next_);
+  deallocate(tmp_);
+  deallocate(small_current_);
+  deallocate(small_next_);
+  deallocate(small_tmp_);
+}
+
+void DenseCRFEngine::Reset(int W, int H, int M) {
+  for (size_t i = 0; i < owned_.size(); ++i) {
+    delete owned_[i];
+  }
+  owned_.clear();
+  pairwise_.clear();
+  arena_.reset();
+
+  W_ = W;
+  H_ = H;
+  N_ = W * H;
+  M_ = M;
+  Hs_ = H > 0 ? (H - 1) / downsample_ + 1 : 0;
+  Ws_ = W > 0 ? (W - 1) / downsample_ + 1 : 0;
+  Ns_ = Hs_ * Ws_;
+
+  const size_t count = static_cast<size_t>(N_) * M_;
+  if (count > capacity_) {
+    deallocate(unary_);
+    deallocate(current_);
+    deallocate(next_);
+    deallocate(tmp_);
+    unary_   = allocate(count);
+    current_ = allocate(count);
+    next_    = allocate(count);
+    tmp_     = allocate(count);
+    capacity_ = count;
+  }
+  // the grid buffers are only used when the grid is smaller
+  const size_t small_count = Ns_ < N_ ? static_cast<size_t>(Ns_) * M_ : 0;
+  if (small_count > small_capacity_) {
+    deallocate(small_current_);
+    deallocate(small_next_);
+    deallocate(small_tmp_);
+    small_current_ = allocate(small_count);
+    small_next_    = allocate(small_count);
+    small_tmp_     = allocate(small_count);
+    small_capacity_ = small_count;
+  }
+}
+
+void DenseCRFEngine::SetUnaryEnergy(const float* unary) {
+  std::copy(unary, unary + N_ * M_, unary_);
+}
+
+float DenseCRFEngine::grid_step_x() const {
+  return Ws_ > 1 ? static_cast<float>(W_ - 1) / (Ws_ - 1) : 0.f;
+}
+
+float DenseCRFEngine::grid_step_y() const {
+  return Hs_ > 1 ? static_cast<float>(H_ - 1) / (Hs_ - 1) : 0.f;
+}
+
+void DenseCRFEngine::AddPairwiseGaussian(float sx, float sy, float w) {
+  const float rx = grid_step_x();
+  const float ry = grid_step_y();
+  float* features = static_cast<float*>(
+      arena_.allocate(Ns_ * 2 * sizeof(float)));
+  for (int j = 0; j < Hs_; ++j) {
+    for (int i = 0; i < Ws_; ++i) {
+      features[(j * Ws_ + i) * 2 + 0] = i * rx / sx;
+      features[(j * Ws_ + i) * 2 + 1] = j * ry / sy;
+    }
+  }
+  AddPairwiseEnergy(features, 2, w);
+  arena_.deallocate(features, Ns_ * 2 * sizeof(float));
+}
+
+void DenseCRFEngine::AddPairwiseBilateral(float sx, float sy, float sr,
+    float sg, float sb, const unsigned char* im, float w) {
+  const float rx = grid_step_x();
+  const float ry = grid_step_y();
+  // colors at the nodes of the filtering grid
+  float* grid_im = static_cast<float*>(
+      arena_.allocate(Ns_ * 3 * sizeof(float)));
+  ResamplePacked(3, im, H_, W_, grid_im, Hs_, Ws_);
+  float* features = static_cast<float*>(
+      arena_.allocate(Ns_ * 5 * sizeof(float)));
+  for (int j = 0; j < Hs_; ++j) {
+    for (int i = 0; i < Ws_; ++i) {
+      const int k = j * Ws_ + i;
+      features[k * 5 + 0] = i * rx / sx;
+      features[k * 5 + 1] = j * ry / sy;
+      features[k * 5 + 2] = grid_im[k * 3 + 0] / sr;
+      features[k * 5 + 3] = grid_im[k * 3 + 1] / sg;
+      features[k * 5 + 4] = grid_im[k * 3 + 2] / sb;
+    }
+  }
+  AddPairwiseEnergy(features, 5, w);
+  arena_.deallocate(features, Ns_ * 5 * sizeof(float));
+  arena_.deallocate(grid_im, Ns_ * 3 * sizeof(float));
+}
+
+void DenseCRFEngine::AddPairwiseEnergy(const float* features, int D,
+    float w) {
+  PottsPotential* potential =
+      new PottsPotential(features, D, Ns_, w, true, &arena_);
+  owned_.push_back(potential);
+  pairwise_.push_back(potential);
+}
+
+void DenseCRFEngine::AddPairwise(const PairwisePotential* potential) {
+  pairwise_.push_back(potential);
+}
+
+void DenseCRFEngine::StartInference() {
+  // also sets next_ to the unary potential for the first step
+  expAndNormalize(current_, unary_, -1.0, N_, M_, accuracy_, next_, unary_);
+}
+
+void DenseCRFEngine::StepInference() {
+  // next_ already holds the unary potential, written by the previous
+  // expAndNormalize pass
+  if (Ns_ == N_) {
+    for (size_t i = 0; i < pairwise_.size(); ++i) {
+      pairwise_[i]->apply(next_, current_, tmp_, M_, &arena_);
+    }
+  } else {
+    // filter on the downsampled grid and upsample the messages back
+    ResamplePacked(M_, current_, H_, W_, small_current_, Hs_, Ws_);
+    std::fill(small_next_, small_next_ + Ns_ * M_, 0.f);
+    for (size_t i = 0; i < pairwise_.size(); ++i) {
+      pairwise_[i]->apply(small_next_, small_current_, small_tmp_, M_,
+                          &arena_);
+    }
+    ResamplePacked(M_, small_next_, Hs_, Ws_, tmp_, H_, W_);
+    for (int i = 0; i < N_ * M_; ++i) {
+      next_[i] += tmp_[i];
+    }
+  }
+  // Exponentiate and normalize, and reset next_ for the following step
+  expAndNormalize(current_, next_, 1.0, N_, M_, accuracy_, next_, unary_);
+}
+
+const float* DenseCRFEngine::Inference(int n) {
+  StartInference();
+  for (int i = 0; i < n; ++i) {
+    StepInference();
+  }
+  return current_;
+}
+
+void DenseCRFEngine::Map(int n, short* map) {  // NOLINT(runtime/int)
+  Inference(n);
+  CurrentMap(map);
+}
+
+void DenseCRFEngine::CurrentMap(short* map) const {  // NOLINT(runtime/int)
+  for (int i = 0; i < N_; ++i) {
+    const float* p = current_ + i * M_;
+    short best = 0;  // NOLINT(runtime/int)
+    for (int j = 1; j < M_; ++j) {
+      if (p[j] > p[best]) {
+        best = j;
+      }
+    }
+    map[i] = best;
+  }
+}
+
+}  // namespace caffe
@@ -7,6 +7,8 @@
 #include "caffe/util/densecrf_util.hpp"
 #include "caffe/util/permutohedral.hpp"
 
+namespace caffe {
+
 PairwisePotential::~PairwisePotential() {
 }
 
@@ -21,14 +23,14 @@ PottsPotential::~PottsPotential() {
 }
 
 PottsPotential::PottsPotential(const float* features, int D, int N, 
-		  float w, bool per_pixel_normalization) 
+		  float w, bool per_pixel_normalization, LatticeArena* arena) 
   : N_(N), w_(w) {
-  lattice_.init( features, D, N );
+  lattice_.init( features, D, N, arena );
   norm_ = allocate( N );
   for ( int i=0; i<N; i++ )
     norm_[i] = 1;
   // Compute the normalization factor
-  lattice_.compute( norm_, norm_, 1 );
+  lattice_.compute( norm_, norm_, 1, 0, 0, -1, -1, arena );
   if ( per_pixel_normalization ) {
     // use a per pixel normalization
     for ( int i=0; i<N; i++ )
@@ -45,21 +47,21 @@ PottsPotential::PottsPotential(const float* features, int D, int N,
   }
 }
 
-void PottsPotential::apply(float* out_values, const float* in_values, float* tmp, int value_size) const {
-  lattice_.compute( tmp, in_values, value_size );
+void PottsPotential::apply(float* out_values, const float* in_values, float* tmp, int value_size, LatticeArena* arena) const {
+  lattice_.compute( tmp, in_values, value_size, 0, 0, -1, -1, arena );
   for ( int i=0,k=0; i<N_; i++ )
     for ( int j=0; j<value_size; j++, k++ )
       out_values[k] += w_*norm_[i]*tmp[k];
 }
 
 SemiMetricPotential::SemiMetricPotential(const float* features, int D, int N, 
-      float w, const SemiMetricFunction* function, bool per_pixel_normalization) 
-  : PottsPotential(features, D, N, w, per_pixel_normalization), function_(function) {
+      float w, const SemiMetricFunction* function, bool per_pixel_normalization, LatticeArena* arena) 
+  : PottsPotential(features, D, N, w, per_pixel_normalization, arena), function_(function) {
 }
 
 void SemiMetricPotential::apply(float* out_values, const float* in_values, 
-                     float* tmp, int value_size) const {
-  lattice_.compute( tmp, in_values, value_size );
+                     float* tmp, int value_size, LatticeArena* arena) const {
+  lattice_.compute( tmp, in_values, value_size, 0, 0, -1, -1, arena );
 
   // To the metric transform
   float * tmp2 = new float[value_size];
@@ -72,3 +74,5 @@ void SemiMetricPotential::apply(float* out_values, const float* in_values,
   }
   delete[] tmp2;
 }
+
+}  // namespace caffe
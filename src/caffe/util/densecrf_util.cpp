@@ -1,7 +1,12 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
 #include <cstring>
 
 #include "caffe/util/densecrf_util.hpp"
 
+namespace caffe {
+
 float* allocate(size_t N) {
   float * r = NULL;
   if (N>0) {
@@ -26,3 +31,145 @@ void deallocate(float*& ptr) {
   ptr = NULL;
 }
 
+
+// Original implementation: separate max, exp, sum and divide passes
+static void expAndNormalizeLegacy(float* out, const float* in, float scale, int N, int M) {
+  float* V = new float[M];
+  for (int i = 0; i < N; ++i) {
+    const float* b = in + i*M;
+    // Find the max and subtract it so that the exp doesn't explode
+    float mx = scale*b[0];
+    for (int j = 1; j < M; ++j)
+      if( mx < scale*b[j] )
+	mx = scale*b[j];
+    float tt = 0;
+    for (int j = 0; j < M; ++j) {
+      V[j] = fast_exp(scale*b[j]-mx);
+      tt += V[j];
+    }
+    // Make it a probability
+    for (int j=0; j < M; ++j)
+      V[j] /= tt;
+
+    float* a = out + i*M;
+    for (int j = 0; j < M; ++j)
+      a[j] = V[j];
+  }
+  delete[] V;
+}
+
+#ifdef SSE_DENSE_CRF
+// exp(x) for x <= 0 by range reduction x = n*ln(2) + r, |r| <= ln(2)/2, and a
+// polynomial for exp(r) (Cephes expf coefficients). Lanes below the float
+// range return exactly 0 so that padding lanes drop out of the sums.
+static inline __m128 poly_exp(__m128 x, bool accurate) {
+  const __m128 underflow = _mm_cmpgt_ps( x, _mm_set1_ps(-87.0f) );
+  x = _mm_max_ps( x, _mm_set1_ps(-87.0f) );
+  // n = floor( x/ln(2) + 0.5 )
+  __m128 fx = _mm_add_ps( _mm_mul_ps( x, _mm_set1_ps(1.44269504088896341f) ), _mm_set1_ps(0.5f) );
+  __m128 n = _mm_cvtepi32_ps( _mm_cvttps_epi32( fx ) );
+  n = _mm_sub_ps( n, _mm_and_ps( _mm_cmpgt_ps( n, fx ), _mm_set1_ps(1.0f) ) );
+  // r = x - n*ln(2), with ln(2) split in two for precision
+  x = _mm_sub_ps( x, _mm_mul_ps( n, _mm_set1_ps(0.693359375f) ) );
+  x = _mm_sub_ps( x, _mm_mul_ps( n, _mm_set1_ps(-2.12194440e-4f) ) );
+  __m128 y;
+  if (accurate) {
+    y = _mm_set1_ps(1.9875691500e-4f);
+    y = _mm_add_ps( _mm_mul_ps( y, x ), _mm_set1_ps(1.3981999507e-3f) );
+    y = _mm_add_ps( _mm_mul_ps( y, x ), _mm_set1_ps(8.3334519073e-3f) );
+    y = _mm_add_ps( _mm_mul_ps( y, x ), _mm_set1_ps(4.1665795894e-2f) );
+    y = _mm_add_ps( _mm_mul_ps( y, x ), _mm_set1_ps(1.6666665459e-1f) );
+    y = _mm_add_ps( _mm_mul_ps( y, x ), _mm_set1_ps(5.0000001201e-1f) );
+  } else {
+    y = _mm_set1_ps(1.6666665459e-1f);
+    y = _mm_add_ps( _mm_mul_ps( y, x ), _mm_set1_ps(5.0000001201e-1f) );
+  }
+  y = _mm_add_ps( _mm_mul_ps( y, _mm_mul_ps( x, x ) ), _mm_add_ps( x, _mm_set1_ps(1.0f) ) );
+  // scale by 2^n
+  __m128i e = _mm_slli_epi32( _mm_add_epi32( _mm_cvttps_epi32( n ), _mm_set1_epi32(127) ), 23 );
+  return _mm_and_ps( _mm_mul_ps( y, _mm_castsi128_ps( e ) ), underflow );
+}
+
+static inline float hmax(__m128 v) {
+  v = _mm_max_ps( v, _mm_shuffle_ps( v, v, _MM_SHUFFLE(1, 0, 3, 2) ) );
+  v = _mm_max_ps( v, _mm_shuffle_ps( v, v, _MM_SHUFFLE(2, 3, 0, 1) ) );
+  return _mm_cvtss_f32( v );
+}
+
+static inline float hsum(__m128 v) {
+  v = _mm_add_ps( v, _mm_shuffle_ps( v, v, _MM_SHUFFLE(1, 0, 3, 2) ) );
+  v = _mm_add_ps( v, _mm_shuffle_ps( v, v, _MM_SHUFFLE(2, 3, 0, 1) ) );
+  return _mm_cvtss_f32( v );
+}
+#endif
+
+void expAndNormalize(float* out, const float* in, float scale, int N, int M, ExpAccuracy accuracy, float* next, const float* unary) {
+  if (accuracy == EXP_LEGACY) {
+    expAndNormalizeLegacy( out, in, scale, N, M );
+    if (next)
+      for (int i = 0; i < N*M; ++i)
+	next[i] = -unary[i];
+    return;
+  }
+#ifdef SSE_DENSE_CRF
+  // One pass per pixel: the row is scaled into a padded buffer, and max,
+  // exp, sum and normalization all run on it while it sits in L1.
+  const bool accurate = accuracy == EXP_ACCURATE;
+  const int nv = (M-1)/4 + 1;
+  __m128 * row = (__m128*)_mm_malloc( 2*nv*sizeof(__m128), 16 );
+  __m128 * e = row + nv;
+  float * frow = (float*)row;
+  float * fe = (float*)e;
+  // pad the last vector with a value whose exp is exactly 0
+  for (int j = M; j < nv*4; ++j)
+    frow[j] = -FLT_MAX;
+  for (int i = 0; i < N; ++i) {
+    const float* b = in + i*M;
+    float* a = out + i*M;
+    for (int j = 0; j < M; ++j)
+      frow[j] = scale*b[j];
+    __m128 mx = row[0];
+    for (int k = 1; k < nv; ++k)
+      mx = _mm_max_ps( mx, row[k] );
+    const __m128 m = _mm_set1_ps( hmax( mx ) );
+    __m128 tt = _mm_setzero_ps();
+    for (int k = 0; k < nv; ++k) {
+      e[k] = poly_exp( _mm_sub_ps( row[k], m ), accurate );
+      tt = _mm_add_ps( tt, e[k] );
+    }
+    // Make it a probability
+    const float inv = 1.0f / hsum( tt );
+    for (int j = 0; j < M; ++j)
+      a[j] = fe[j] * inv;
+    if (next) {
+      // the row of in is consumed, start the next step from -unary
+      float* nx = next + i*M;
+      const float* u = unary + i*M;
+      for (int j = 0; j < M; ++j)
+	nx[j] = -u[j];
+    }
+  }
+  _mm_free( row );
+#else
+  for (int i = 0; i < N; ++i) {
+    const float* b = in + i*M;
+    float* a = out + i*M;
+    float mx = scale*b[0];
+    for (int j = 1; j < M; ++j)
+      mx = std::max( mx, scale*b[j] );
+    float tt = 0;
+    for (int j = 0; j < M; ++j) {
+      a[j] = accuracy == EXP_ACCURATE ? expf( scale*b[j]-mx ) : fast_exp( scale*b[j]-mx );
+      tt += a[j];
+    }
+    const float inv = 1.0f / tt;
+    for (int j = 0; j < M; ++j)
+      a[j] *= inv;
+    if (next)
+      for (int j = 0; j < M; ++j)
+	next[i*M+j] = -unary[i*M+j];
+  }
+#endif
+}
+
+}  // namespace caffe
@@ -0,0 +1,250 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "caffe/util/feature_file.hpp"
+
+namespace caffe {
+
+namespace {
+
+const char kMagic[8] = { 'C', 'A', 'F', 'F', 'E', 'F', 'T', '1' };
+const size_t kHeaderSize = sizeof(kMagic) + 2 * sizeof(uint64_t);
+
+template <typename Dtype> uint32_t feature_file_type();
+template <> uint32_t feature_file_type<float>() { return FEATURE_FILE_FLOAT; }
+template <> uint32_t feature_file_type<double>() {
+  return FEATURE_FILE_DOUBLE;
+}
+
+size_t feature_file_type_size(uint32_t type) {
+  switch (type) {
+  case FEATURE_FILE_FLOAT:
+    return sizeof(float);
+  case FEATURE_FILE_DOUBLE:
+    return sizeof(double);
+  default:
+    LOG(FATAL) << "Unknown feature file type " << type;
+  }
+  return 0;
+}
+
+size_t shape_count(const vector<int>& shape) {
+  size_t count = 1;
+  for (int i = 0; i < shape.size(); ++i) {
+    count *= shape[i];
+  }
+  return count;
+}
+
+// Sequential reads from the mapped header and index, bounds checked.
+class IndexReader {
+ public:
+  IndexReader(const char* begin, const char* end, const string& filename)
+      : pos_(begin), end_(end), filename_(filename) {}
+  template <typename T>
+  T Get() {
+    T value;
+    GetBytes(&value, sizeof(T));
+    return value;
+  }
+  void GetBytes(void* dst, size_t size) {
+    CHECK_LE(size, static_cast<size_t>(end_ - pos_))
+        << "Truncated index in feature file " << filename_;
+    std::copy(pos_, pos_ + size, static_cast<char*>(dst));
+    pos_ += size;
+  }
+  // Reads a count of items of item_size bytes that must fit in the rest of
+  // the index, before anything is allocated for them.
+  uint32_t GetCount(size_t item_size) {
+    const uint32_t count = Get<uint32_t>();
+    CHECK_LE(count, static_cast<size_t>(end_ - pos_) / item_size)
+        << "Truncated index in feature file " << filename_;
+    return count;
+  }
+
+ private:
+  const char* pos_;
+  const char* end_;
+  const string filename_;
+};
+
+}  // namespace
+
+FeatureFileWriter::FeatureFileWriter(const string& filename)
+    : filename_(filename), data_end_(kHeaderSize), index_written_(false) {
+  file_ = fopen(filename_.c_str(), "wb");
+  CHECK(file_) << "Failed to create feature file " << filename_;
+  Flush();
+}
+
+FeatureFileWriter::~FeatureFileWriter() {
+  Flush();
+  CHECK_EQ(fclose(file_), 0) << "Failed to close feature file " << filename_;
+}
+
+void FeatureFileWriter::Write(const void* data, size_t size) {
+  CHECK_EQ(fwrite(data, 1, size, file_), size)
+      << "Failed to write feature file " << filename_;
+}
+
+template <typename Dtype>
+void FeatureFileWriter::Append(const string& name, const Blob<Dtype>& blob) {
+  const uint64_t offset = (data_end_ + kFeatureFileAlignment - 1) /
+      kFeatureFileAlignment * kFeatureFileAlignment;
+  if (index_written_ && !names_.empty()) {
+    // The index written by the last Flush is about to be overwritten: drop
+    // its records from the header first, so that a reader opening the file
+    // before the next Flush sees no record instead of a corrupt index.
+    const uint64_t num_records = 0;
+    CHECK_EQ(fseeko(file_, sizeof(kMagic), SEEK_SET), 0);
+    Write(&num_records, sizeof(num_records));
+    CHECK_EQ(fflush(file_), 0) << "Failed to write feature file " << filename_;
+  }
+  index_written_ = false;
+  CHECK_EQ(fseeko(file_, data_end_, SEEK_SET), 0);
+  const char padding[kFeatureFileAlignment] = { 0 };
+  Write(padding, offset - data_end_);
+  Write(blob.cpu_data(), blob.count() * sizeof(Dtype));
+  data_end_ = offset + blob.count() * sizeof(Dtype);
+  names_.push_back(name);
+  types_.push_back(feature_file_type<Dtype>());
+  shapes_.push_back(blob.shape());
+  offsets_.push_back(offset);
+}
+
+void FeatureFileWriter::Flush() {
+  CHECK_EQ(fseeko(file_, data_end_, SEEK_SET), 0);
+  for (int i = 0; i < names_.size(); ++i) {
+    const uint32_t name_size = names_[i].size();
+    Write(&name_size, sizeof(name_size));
+    Write(names_[i].data(), name_size);
+    Write(&types_[i], sizeof(types_[i]));
+    const uint32_t num_axes = shapes_[i].size();
+    Write(&num_axes, sizeof(num_axes));
+    for (int j = 0; j < num_axes; ++j) {
+      const int32_t dim = shapes_[i][j];
+      Write(&dim, sizeof(dim));
+    }
+    Write(&offsets_[i], sizeof(offsets_[i]));
+  }
+  // The header goes last, so that a partially written index is never used.
+  const uint64_t header[2] = { names_.size(), data_end_ };
+  CHECK_EQ(fseeko(file_, 0, SEEK_SET), 0);
+  Write(kMagic, sizeof(kMagic));
+  Write(header, sizeof(header));
+  CHECK_EQ(fflush(file_), 0) << "Failed to write feature file " << filename_;
+  index_written_ = true;
+}
+
+FeatureFile::FeatureFile(const string& filename)
+    : filename_(filename), map_(NULL), size_(0) {
+  const int fd = open(filename_.c_str(), O_RDONLY);
+  CHECK_GE(fd, 0) << "Failed to open feature file " << filename_;
+  struct stat st;
+  CHECK_EQ(fstat(fd, &st), 0) << "Failed to stat feature file " << filename_;
+  size_ = st.st_size;
+  CHECK_GE(size_, kHeaderSize) << "Not a feature file: " << filename_;
+  // Private and writable: blobs sharing the mapping may write to it.
+  void* map = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  CHECK(map != MAP_FAILED) << "Failed to map feature file " << filename_;
+  map_ = static_cast<char*>(map);
+  CHECK_EQ(memcmp(map_, kMagic, sizeof(kMagic)), 0)
+      << "Not a feature file: " << filename_;
+
+  IndexReader header(map_ + sizeof(kMagic), map_ + kHeaderSize, filename_);
+  const uint64_t num_records = header.Get<uint64_t>();
+  const uint64_t index_offset = header.Get<uint64_t>();
+  CHECK_LE(index_offset, size_) << "Corrupt feature file " << filename_;
+  IndexReader index(map_ + index_offset, map_ + size_, filename_);
+  for (uint64_t i = 0; i < num_records; ++i) {
+    string name(index.GetCount(sizeof(char)), '\0');
+    index.GetBytes(&name[0], name.size());
+    const uint32_t type = index.Get<uint32_t>();
+    vector<int> shape(index.GetCount(sizeof(int32_t)));
+    for (int j = 0; j < shape.size(); ++j) {
+      shape[j] = index.Get<int32_t>();
+    }
+    names_.push_back(name);
+    types_.push_back(type);
+    shapes_.push_back(shape);
+    offsets_.push_back(index.Get<uint64_t>());
+    CHECK_LE(offsets_.back() + RecordBytes(i), index_offset)
+        << "Corrupt feature file " << filename_;
+    index_[name] = i;
+  }
+}
+
+FeatureFile::~FeatureFile() {
+  if (map_) {
+    munmap(map_, size_);
+  }
+}
+
+int FeatureFile::Find(const string& name) const {
+  std::map<string, int>::const_iterator it = index_.find(name);
+  return it == index_.end() ? -1 : it->second;
+}
+
+size_t FeatureFile::RecordBytes(int i) const {
+  return shape_count(shapes_[i]) * feature_file_type_size(types_[i]);
+}
+
+template <typename Dtype>
+void FeatureFile::Read(int i, Blob<Dtype>* blob, bool zero_copy) {
+  CHECK_GE(i, 0);
+  CHECK_LT(i, num_records());
+  blob->Reshape(shapes_[i]);
+  if (zero_copy && types_[i] == feature_file_type<Dtype>()) {
+    // A fresh memory of the exact record size: the memory of blob may be
+    // larger, and would be synced to the GPU beyond the record.
+    Blob<Dtype> record(shapes_[i]);
+    record.set_cpu_data(reinterpret_cast<Dtype*>(map_ + offsets_[i]));
+    blob->ShareData(record);
+  } else {
+    Copy(i, blob->mutable_cpu_data());
+  }
+}
+
+template <typename Dtype>
+void FeatureFile::Copy(int i, Dtype* data) const {
+  CHECK_GE(i, 0);
+  CHECK_LT(i, num_records());
+  const size_t count = shape_count(shapes_[i]);
+  const char* record = map_ + offsets_[i];
+  switch (types_[i]) {
+  case FEATURE_FILE_FLOAT:
+    std::copy(reinterpret_cast<const float*>(record),
+        reinterpret_cast<const float*>(record) + count, data);
+    break;
+  case FEATURE_FILE_DOUBLE:
+    std::copy(reinterpret_cast<const double*>(record),
+        reinterpret_cast<const double*>(record) + count, data);
+    break;
+  default:
+    LOG(FATAL) << "Unknown feature file type " << types_[i];
+  }
+}
+
+void FeatureFile::WillNeed(int i) const {
+  const size_t page = sysconf(_SC_PAGESIZE);
+  const size_t begin = offsets_[i] / page * page;
+  madvise(map_ + begin, offsets_[i] + RecordBytes(i) - begin, MADV_WILLNEED);
+}
+
+template void FeatureFileWriter::Append(const string&, const Blob<float>&);
+template void FeatureFileWriter::Append(const string&, const Blob<double>&);
+template void FeatureFile::Read(int, Blob<float>*, bool);
+template void FeatureFile::Read(int, Blob<double>*, bool);
+template void FeatureFile::Copy(int, float*) const;
+template void FeatureFile::Copy(int, double*) const;
+
+}  // namespace caffe
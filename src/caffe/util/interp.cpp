@@ -4,12 +4,106 @@
 #include "caffe/util/interp.hpp"
 #include <algorithm>
 #include <cmath>
+#include <vector>
 
 namespace caffe {
 
+namespace {
+
+// Source coordinates and weights of the bi-linear interpolation along one
+// axis: output i reads input index[i] and index[i] + step[i] (step is 0 at
+// the last input pixel) with weights lambda0[i] and lambda1[i]. They only
+// depend on the sizes, so they are computed once per call instead of once
+// per output pixel and channel.
+template <typename Dtype>
+struct InterpAxis {
+  InterpAxis(const int size1, const int size2)
+      : index(size2), step(size2), lambda0(size2), lambda1(size2) {
+    const float ratio = (size2 > 1) ?
+        static_cast<float>(size1 - 1) / (size2 - 1) : 0.f;
+    for (int i2 = 0; i2 < size2; ++i2) {
+      const float i1r = ratio * i2;
+      const int i1 = i1r;
+      index[i2] = i1;
+      step[i2] = (i1 < size1 - 1) ? 1 : 0;
+      lambda1[i2] = i1r - i1;
+      lambda0[i2] = Dtype(1.) - lambda1[i2];
+    }
+  }
+  std::vector<int> index, step;
+  std::vector<Dtype> lambda0, lambda1;
+};
+
+// Horizontal pass of a planar input row into a row of width2 outputs.
+template <typename Dtype>
+inline void interp_row(const Dtype *row1, const InterpAxis<Dtype>& axis,
+    const int width2, Dtype *row2) {
+  const int* index = &axis.index[0];
+  const int* step = &axis.step[0];
+  const Dtype* lambda0 = &axis.lambda0[0];
+  const Dtype* lambda1 = &axis.lambda1[0];
+  for (int w2 = 0; w2 < width2; ++w2) {
+    const Dtype* pos1 = row1 + index[w2];
+    row2[w2] = lambda0[w2] * pos1[0] + lambda1[w2] * pos1[step[w2]];
+  }
+}
+
+// Rows [h2_begin, h2_end) of the planar interpolation of every channel.
+// Channel c of the input starts at data1 + c * plane_dim1 and of the output
+// at data2 + c * plane_dim2, where output row h2 is at (h2 - h2_begin) *
+// Width2.
+template <typename Dtype>
+void interp_planar_rows(const int channels, const Dtype *data1,
+    const int plane_dim1, const int Width1, const InterpAxis<Dtype>& rows,
+    const InterpAxis<Dtype>& cols, const int h2_begin, const int h2_end,
+    Dtype *data2, const int plane_dim2, const int Width2) {
+  const int width2 = cols.index.size();
+  // the horizontally interpolated input rows h1 and h1 + h1p
+  std::vector<Dtype> buffer(2 * width2);
+  for (int c = 0; c < channels; ++c) {
+    const Dtype* plane1 = data1 + c * plane_dim1;
+    Dtype* plane2 = data2 + c * plane_dim2;
+    Dtype* row0 = &buffer[0];
+    Dtype* row1 = &buffer[width2];
+    int cached0 = -1, cached1 = -1;
+    for (int h2 = h2_begin; h2 < h2_end; ++h2) {
+      const int h1 = rows.index[h2];
+      const int h1p = h1 + rows.step[h2];
+      if (cached0 != h1) {
+	if (cached1 == h1) {
+	  std::swap(row0, row1);
+	  std::swap(cached0, cached1);
+	} else {
+	  interp_row(plane1 + h1 * Width1, cols, width2, row0);
+	  cached0 = h1;
+	}
+      }
+      if (cached1 != h1p) {
+	interp_row(plane1 + h1p * Width1, cols, width2, row1);
+	cached1 = h1p;
+      }
+      const Dtype h0lambda = rows.lambda0[h2];
+      const Dtype h1lambda = rows.lambda1[h2];
+      Dtype* pos2 = plane2 + (h2 - h2_begin) * Width2;
+      for (int w2 = 0; w2 < width2; ++w2) {
+	pos2[w2] = h0lambda * row0[w2] + h1lambda * row1[w2];
+      }
+    }
+  }
+}
+
+}  // namespace
+
 // Bi-linear interpolation
 // IN : [channels height1 width1] cropped from a bigger [Height1 Width1] image
 // OUT: [channels height2 width2] cropped from a bigger [Height2 Width2] image
+//
+// The planar case is separable: every input row is interpolated
+// horizontally once into a row buffer, and the output rows blend two such
+// buffers with contiguous, vectorizable loops. Upsampling by a factor f
+// thus does the horizontal pass on 1/f of the output rows only. The sums
+// are evaluated in the same order as the direct formula, so the results do
+// not change.
 template <typename Dtype, bool packed>
 void caffe_cpu_interp2(const int channels,
     const Dtype *data1, const int x1, const int y1, const int height1, const int width1, const int Height1, const int Width1,
@@ -18,72 +112,82 @@ void caffe_cpu_interp2(const int channels,
   CHECK(Width1 >= width1 + x1 && Height1 >= height1 + y1 && Width2 >= width2 + x2 && Height2 >= height2 + y2);
   // special case: just copy
   if (height1 == height2 && width1 == width2) {
-    for (int h2 = 0; h2 < height2; ++h2) {
-      const int h1 = h2;
-      for (int w2 = 0; w2 < width2; ++w2) {
-	const int w1 = w2;
-	if (packed) {
-	  const Dtype* pos1 = &data1[channels * ((y1 + h1) * Width1 + (x1 + w1))];
-	  Dtype* pos2 = &data2[channels * ((y2 + h2) * Width2 + (x2 + w2))];
-	  for (int c = 0; c < channels; ++c) {
-	    pos2[0] = pos1[0];
-	    pos1++;
-	    pos2++;
-	  }
-	}
-	else {
-	  const Dtype* pos1 = &data1[(y1 + h1) * Width1 + (x1 + w1)];
-	  Dtype* pos2 = &data2[(y2 + h2) * Width2 + (x2 + w2)];
-	  for (int c = 0; c < channels; ++c) {
-	    pos2[0] = pos1[0];
-	    pos1 += Width1 * Height1;
-	    pos2 += Width2 * Height2;
-	  }
+    if (packed) {
+      for (int h2 = 0; h2 < height2; ++h2) {
+	std::copy(&data1[channels * ((y1 + h2) * Width1 + x1)],
+		  &data1[channels * ((y1 + h2) * Width1 + x1 + width1)],
+		  &data2[channels * ((y2 + h2) * Width2 + x2)]);
+      }
+    }
+    else {
+      for (int c = 0; c < channels; ++c) {
+	const Dtype* plane1 = &data1[c * Height1 * Width1];
+	Dtype* plane2 = &data2[c * Height2 * Width2];
+	for (int h2 = 0; h2 < height2; ++h2) {
+	  std::copy(&plane1[(y1 + h2) * Width1 + x1],
+		    &plane1[(y1 + h2) * Width1 + x1 + width1],
+		    &plane2[(y2 + h2) * Width2 + x2]);
 	}
       }
     }
     return;
   }
-  const float rheight = (height2 > 1) ? static_cast<float>(height1 - 1) / (height2 - 1) : 0.f;
-  const float rwidth = (width2 > 1) ? static_cast<float>(width1 - 1) / (width2 - 1) : 0.f;
-  for (int h2 = 0; h2 < height2; ++h2) {
-    const float h1r = rheight * h2;
-    const int h1 = h1r;
-    const int h1p = (h1 < height1 - 1) ? 1 : 0;
-    const Dtype h1lambda = h1r - h1;
-    const Dtype h0lambda = Dtype(1.) - h1lambda;
-    for (int w2 = 0; w2 < width2; ++w2) {
-      const float w1r = rwidth * w2;
-      const int w1 = w1r;
-      const int w1p = (w1 < width1 - 1) ? 1 : 0;
-      const Dtype w1lambda = w1r - w1;
-      const Dtype w0lambda = Dtype(1.) - w1lambda;
-      if (packed) {
+  const InterpAxis<Dtype> rows(height1, height2);
+  const InterpAxis<Dtype> cols(width1, width2);
+  if (packed) {
+    for (int h2 = 0; h2 < height2; ++h2) {
+      const int h1 = rows.index[h2];
+      const int h1p = rows.step[h2];
+      const Dtype h0lambda = rows.lambda0[h2];
+      const Dtype h1lambda = rows.lambda1[h2];
+      for (int w2 = 0; w2 < width2; ++w2) {
+	const int w1 = cols.index[w2];
+	const int w1p = cols.step[w2];
+	const Dtype w0lambda = cols.lambda0[w2];
+	const Dtype w1lambda = cols.lambda1[w2];
 	const Dtype* pos1 = &data1[channels * ((y1 + h1) * Width1 + (x1 + w1))];
+	const Dtype* pos1w = pos1 + channels * w1p;
+	const Dtype* pos1h = pos1 + channels * h1p * Width1;
+	const Dtype* pos1hw = pos1h + channels * w1p;
 	Dtype* pos2 = &data2[channels * ((y2 + h2) * Width2 + (x2 + w2))];
 	for (int c = 0; c < channels; ++c) {
-	  pos2[0] =
-	    h0lambda * (w0lambda * pos1[0]            + w1lambda * pos1[channels * w1p]) + 
-	    h1lambda * (w0lambda * pos1[channels * h1p * Width1] + w1lambda * pos1[channels * (h1p * Width1 + w1p)]);
-	  pos1++;
-	  pos2++;
-	}
-      }
-      else {
-	const Dtype* pos1 = &data1[(y1 + h1) * Width1 + (x1 + w1)];
-	Dtype* pos2 = &data2[(y2 + h2) * Width2 + (x2 + w2)];
-	for (int c = 0; c < channels; ++c) {
-	  pos2[0] =
-	    h0lambda * (w0lambda * pos1[0]            + w1lambda * pos1[w1p]) + 
-	    h1lambda * (w0lambda * pos1[h1p * Width1] + w1lambda * pos1[h1p * Width1 + w1p]);
-	  pos1 += Width1 * Height1;
-	  pos2 += Width2 * Height2;
+	  pos2[c] =
+	    h0lambda * (w0lambda * pos1[c]  + w1lambda * pos1w[c]) +
+	    h1lambda * (w0lambda * pos1h[c] + w1lambda * pos1hw[c]);
 	}
       }
     }
+    return;
   }
+  interp_planar_rows(channels, &data1[y1 * Width1 + x1], Height1 * Width1,
+      Width1, rows, cols, 0, height2, &data2[y2 * Width2 + x2],
+      Height2 * Width2, Width2);
 }
 
+template <typename Dtype>
+void caffe_cpu_interp2_rows(const int channels,
+    const Dtype *data1, const int x1, const int y1, const int height1, const int width1, const int Height1, const int Width1,
+    Dtype *data2, const int height2, const int width2, const int h2_begin, const int h2_end) {
+  CHECK(x1 >= 0 && y1 >= 0 && height1 > 0 && width1 > 0 && height2 > 0 && width2 > 0);
+  CHECK(Width1 >= width1 + x1 && Height1 >= height1 + y1);
+  CHECK(h2_begin >= 0 && h2_begin < h2_end && h2_end <= height2);
+  const int num_rows = h2_end - h2_begin;
+  // special case: just copy
+  if (height1 == height2 && width1 == width2) {
+    for (int c = 0; c < channels; ++c) {
+      for (int h2 = h2_begin; h2 < h2_end; ++h2) {
+	const Dtype* pos1 = &data1[(c * Height1 + y1 + h2) * Width1 + x1];
+	std::copy(pos1, pos1 + width1,
+		  &data2[(c * num_rows + h2 - h2_begin) * width2]);
+      }
+    }
+    return;
+  }
+  const InterpAxis<Dtype> rows(height1, height2);
+  const InterpAxis<Dtype> cols(width1, width2);
+  interp_planar_rows(channels, &data1[y1 * Width1 + x1], Height1 * Width1,
+      Width1, rows, cols, h2_begin, h2_end, data2, num_rows * width2, width2);
+}
 
 // Backward (adjoint) operation 1 <- 2 (accumulates)
 template <typename Dtype, bool packed>
@@ -94,69 +198,79 @@ void caffe_cpu_interp2_backward(const int channels,
   CHECK(Width1 >= width1 + x1 && Height1 >= height1 + y1 && Width2 >= width2 + x2 && Height2 >= height2 + y2);
   // special case: same-size matching grids
   if (height1 == height2 && width1 == width2) {
-    for (int h2 = 0; h2 < height2; ++h2) {
-      const int h1 = h2;
-      for (int w2 = 0; w2 < width2; ++w2) {
-	const int w1 = w2;
-	if (packed) {
-	  Dtype* pos1 = &data1[channels * ((y1 + h1) * Width1 + (x1 + w1))];
-	  const Dtype* pos2 = &data2[channels * ((y2 + h2) * Width2 + (x2 + w2))];
-	  for (int c = 0; c < channels; ++c) {
-	    pos1[0] += pos2[0];
-	    pos1++;
-	    pos2++;
-	  }
-	}
-	else {
-	  Dtype* pos1 = &data1[(y1 + h1) * Width1 + (x1 + w1)];
-	  const Dtype* pos2 = &data2[(y2 + h2) * Width2 + (x2 + w2)];
-	  for (int c = 0; c < channels; ++c) {
-	    pos1[0] += pos2[0];
-	    pos1 += Width1 * Height1;
-	    pos2 += Width2 * Height2;
-	  }
+    const int row_dim = packed ? channels * width1 : width1;
+    const int num_planes = packed ? 1 : channels;
+    for (int c = 0; c < num_planes; ++c) {
+      for (int h2 = 0; h2 < height2; ++h2) {
+	Dtype* pos1 = packed ?
+	    &data1[channels * ((y1 + h2) * Width1 + x1)] :
+	    &data1[(c * Height1 + y1 + h2) * Width1 + x1];
+	const Dtype* pos2 = packed ?
+	    &data2[channels * ((y2 + h2) * Width2 + x2)] :
+	    &data2[(c * Height2 + y2 + h2) * Width2 + x2];
+	for (int i = 0; i < row_dim; ++i) {
+	  pos1[i] += pos2[i];
 	}
       }
     }
     return;
   }
-  const float rheight = (height2 > 1) ? static_cast<float>(height1 - 1) / (height2 - 1) : 0.f;
-  const float rwidth = (width2 > 1) ? static_cast<float>(width1 - 1) / (width2 - 1) : 0.f;
-  for (int h2 = 0; h2 < height2; ++h2) {
-    const float h1r = rheight * h2;
-    const int h1 = h1r;
-    const int h1p = (h1 < height1 - 1) ? 1 : 0;
-    const Dtype h1lambda = h1r - h1;
-    const Dtype h0lambda = Dtype(1.) - h1lambda;
-    for (int w2 = 0; w2 < width2; ++w2) {
-      const float w1r = rwidth * w2;
-      const int w1 = w1r;
-      const int w1p = (w1 < width1 - 1) ? 1 : 0;
-      const Dtype w1lambda = w1r - w1;
-      const Dtype w0lambda = Dtype(1.) - w1lambda;
-      if (packed) {
+  const InterpAxis<Dtype> rows(height1, height2);
+  const InterpAxis<Dtype> cols(width1, width2);
+  if (packed) {
+    for (int h2 = 0; h2 < height2; ++h2) {
+      const int h1 = rows.index[h2];
+      const int h1p = rows.step[h2];
+      const Dtype h0lambda = rows.lambda0[h2];
+      const Dtype h1lambda = rows.lambda1[h2];
+      for (int w2 = 0; w2 < width2; ++w2) {
+	const int w1 = cols.index[w2];
+	const int w1p = cols.step[w2];
+	const Dtype w0lambda = cols.lambda0[w2];
+	const Dtype w1lambda = cols.lambda1[w2];
 	Dtype* pos1 = &data1[channels * ((y1 + h1) * Width1 + (x1 + w1))];
 	const Dtype* pos2 = &data2[channels * ((y2 + h2) * Width2 + (x2 + w2))];
 	for (int c = 0; c < channels; ++c) {
-	  pos1[0] += h0lambda * w0lambda * pos2[0];
-	  pos1[channels * w1p] += h0lambda * w1lambda * pos2[0];
-	  pos1[channels * h1p * Width1] += h1lambda * w0lambda * pos2[0];
-	  pos1[channels * (h1p * Width1 + w1p)] += h1lambda * w1lambda * pos2[0];
-	  pos1++;
-	  pos2++;
+	  pos1[c] += h0lambda * w0lambda * pos2[c];
+	  pos1[c + channels * w1p] += h0lambda * w1lambda * pos2[c];
+	  pos1[c + channels * h1p * Width1] += h1lambda * w0lambda * pos2[c];
+	  pos1[c + channels * (h1p * Width1 + w1p)] += h1lambda * w1lambda * pos2[c];
 	}
       }
-      else {
-	Dtype* pos1 = &data1[(y1 + h1) * Width1 + (x1 + w1)];
-	const Dtype* pos2 = &data2[(y2 + h2) * Width2 + (x2 + w2)];
-	for (int c = 0; c < channels; ++c) {
-	  pos1[0] += h0lambda * w0lambda * pos2[0];
-	  pos1[w1p] += h0lambda * w1lambda * pos2[0];
-	  pos1[h1p * Width1] += h1lambda * w0lambda * pos2[0];
-	  pos1[h1p * Width1 + w1p] += h1lambda * w1lambda * pos2[0];
-	  pos1 += Width1 * Height1;
-	  pos2 += Width2 * Height2;
-	}
+    }
+    return;
+  }
+  // Adjoint of the separable forward pass: the output rows are first
+  // accumulated into their two input rows, still at the output width, and
+  // each input row is then scattered horizontally once.
+  std::vector<Dtype> buffer(height1 * width2);
+  const int* index = &cols.index[0];
+  const int* step = &cols.step[0];
+  const Dtype* w0lambda = &cols.lambda0[0];
+  const Dtype* w1lambda = &cols.lambda1[0];
+  for (int c = 0; c < channels; ++c) {
+    Dtype* plane1 = &data1[c * Height1 * Width1 + y1 * Width1 + x1];
+    const Dtype* plane2 = &data2[c * Height2 * Width2 + y2 * Width2 + x2];
+    std::fill(buffer.begin(), buffer.end(), Dtype(0));
+    for (int h2 = 0; h2 < height2; ++h2) {
+      Dtype* row0 = &buffer[rows.index[h2] * width2];
+      Dtype* row1 = row0 + rows.step[h2] * width2;
+      const Dtype h0lambda = rows.lambda0[h2];
+      const Dtype h1lambda = rows.lambda1[h2];
+      const Dtype* pos2 = plane2 + h2 * Width2;
+      for (int w2 = 0; w2 < width2; ++w2) {
+	row0[w2] += h0lambda * pos2[w2];
+      }
+      for (int w2 = 0; w2 < width2; ++w2) {
+	row1[w2] += h1lambda * pos2[w2];
+      }
+    }
+    for (int h1 = 0; h1 < height1; ++h1) {
+      const Dtype* row = &buffer[h1 * width2];
+      Dtype* pos1 = plane1 + h1 * Width1;
+      for (int w2 = 0; w2 < width2; ++w2) {
+	pos1[index[w2]] += w0lambda[w2] * row[w2];
+	pos1[index[w2] + step[w2]] += w1lambda[w2] * row[w2];
       }
     }
   }
@@ -289,6 +403,9 @@ template void caffe_cpu_interp2<float,true>(const int, const float *, const int,
 template void caffe_cpu_interp2<double,false>(const int, const double *, const int, const int, const int, const int, const int, const int, double *, const int, const int, const int, const int, const int, const int);
 template void caffe_cpu_interp2<double,true>(const int, const double *, const int, const int, const int, const int, const int, const int, double *, const int, const int, const int, const int, const int, const int);
 
+template void caffe_cpu_interp2_rows<float>(const int, const float *, const int, const int, const int, const int, const int, const int, float *, const int, const int, const int, const int);
+template void caffe_cpu_interp2_rows<double>(const int, const double *, const int, const int, const int, const int, const int, const int, double *, const int, const int, const int, const int);
+
 template void caffe_cpu_interp2_backward<float,false>(const int, float *, const int, const int, const int, const int, const int, const int, const float *, const int, const int, const int, const int, const int, const int);
 template void caffe_cpu_interp2_backward<double,false>(const int, double *, const int, const int, const int, const int, const int, const int, const double *, const int, const int, const int, const int, const int, const int);
 
@@ -100,6 +100,33 @@ cv::Mat ReadImageToCVMat(const string& filename,
   return cv_img;
 }
 
+cv::Mat DecodeImageToCVMat(const string& buffer,
+    const int height, const int width, const bool is_color,
+    int* img_height, int* img_width, const bool seg) {
+  cv::Mat cv_img;
+  int cv_read_flag = (is_color ? CV_LOAD_IMAGE_COLOR :
+    CV_LOAD_IMAGE_GRAYSCALE);
+  std::vector<char> vec_data(buffer.c_str(), buffer.c_str() + buffer.size());
+  cv::Mat cv_img_origin = cv::imdecode(vec_data, cv_read_flag);
+  if (!cv_img_origin.data) {
+    LOG(ERROR) << "Could not decode image";
+    return cv_img_origin;
+  }
+  if (height > 0 && width > 0) {
+    cv::resize(cv_img_origin, cv_img, cv::Size(width, height), 0, 0,
+        seg ? cv::INTER_NEAREST : cv::INTER_LINEAR);
+  } else {
+    cv_img = cv_img_origin;
+  }
+  if (img_height != NULL) {
+    *img_height = cv_img.rows;
+  }
+  if (img_width != NULL) {
+    *img_width = cv_img.cols;
+  }
+  return cv_img;
+}
+
 cv::Mat ReadImageToCVMat(const string& filename,
     const int height, const int width) {
   return ReadImageToCVMat(filename, height, width, true);
@@ -152,6 +179,43 @@ bool ReadImageToDatum(const string& filename, const int label,
     return false;
   }
 }
+
+// Reads the whole content of a file.
+static bool ReadFileToString(const string& filename, string* buffer) {
+  fstream file(filename.c_str(), ios::in | ios::binary | ios::ate);
+  if (!file.is_open()) {
+    LOG(ERROR) << "Could not open or find file " << filename;
+    return false;
+  }
+  buffer->resize(file.tellg());
+  file.seekg(0, ios::beg);
+  file.read(&(*buffer)[0], buffer->size());
+  return file.good();
+}
+
+bool ReadSegPoseToDatum(const string& image_file, const string& seg_file,
+    const vector<float>& pose, SegPoseDatum* datum) {
+  datum->Clear();
+  if (!ReadFileToString(image_file, datum->mutable_image())) {
+    return false;
+  }
+  if (seg_file.size() && !ReadFileToString(seg_file,
+                                           datum->mutable_label())) {
+    return false;
+  }
+  int height, width;
+  cv::Mat cv_img = DecodeImageToCVMat(datum->image(), 0, 0, true, &height,
+                                      &width);
+  if (!cv_img.data) {
+    return false;
+  }
+  datum->set_height(height);
+  datum->set_width(width);
+  for (int i = 0; i < pose.size(); ++i) {
+    datum->add_pose(pose[i]);
+  }
+  return true;
+}
 #endif  // USE_OPENCV
 
 bool ReadFileToDatum(const string& filename, const int label,
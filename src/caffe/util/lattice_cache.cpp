@@ -0,0 +1,93 @@
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "caffe/util/lattice_cache.hpp"
+
+namespace caffe {
+
+class LatticeCache::sync {
+ public:
+  mutable boost::mutex mutex_;
+};
+
+bool LatticeCache::Key::operator<(const Key& other) const {
+  if (checksum != other.checksum) return checksum < other.checksum;
+  if (dim != other.dim) return dim < other.dim;
+  if (num_points != other.num_points) return num_points < other.num_points;
+  return weight < other.weight;
+}
+
+LatticeCache::LatticeCache(int capacity)
+    : capacity_(capacity), clock_(0), hits_(0), misses_(0),
+      sync_(new sync()) {
+  CHECK_GE(capacity_, 0);
+}
+
+shared_ptr<PairwisePotential> LatticeCache::Get(const Key& key,
+    const float* features) {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  std::map<Key, Entry>::iterator it = entries_.find(key);
+  if (it == entries_.end() || !std::equal(it->second.features.begin(),
+                                          it->second.features.end(),
+                                          features)) {
+    ++misses_;
+    return shared_ptr<PairwisePotential>();
+  }
+  ++hits_;
+  it->second.last_use = ++clock_;
+  return it->second.potential;
+}
+
+void LatticeCache::Put(const Key& key, const float* features,
+    const shared_ptr<PairwisePotential>& potential) {
+  if (capacity_ == 0) {
+    return;
+  }
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  if (entries_.find(key) == entries_.end() && entries_.size() >= capacity_) {
+    // evict the least recently used potential; it stays alive for as long
+    // as some inference context still holds it
+    std::map<Key, Entry>::iterator lru = entries_.begin();
+    for (std::map<Key, Entry>::iterator it = entries_.begin();
+         it != entries_.end(); ++it) {
+      if (it->second.last_use < lru->second.last_use) {
+        lru = it;
+      }
+    }
+    entries_.erase(lru);
+  }
+  Entry& entry = entries_[key];
+  entry.potential = potential;
+  entry.features.assign(features, features + key.dim * key.num_points);
+  entry.last_use = ++clock_;
+}
+
+uint64_t LatticeCache::Hash(const void* data, size_t size, uint64_t seed) {
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  uint64_t hash = seed;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+int LatticeCache::size() const {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  return entries_.size();
+}
+
+int LatticeCache::hits() const {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  return hits_;
+}
+
+int LatticeCache::misses() const {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  return misses_;
+}
+
+}  // namespace caffe
@@ -60,7 +60,9 @@ void ReadBlobFromMat(const char *fname, Blob<Dtype>* blob) {
 
 template <typename Dtype>
 void WriteBlobToMat(const char *fname, bool write_diff,
-    Blob<Dtype>* blob) {
+    Blob<Dtype>* blob, bool compress) {
+  const matio_compression compression =
+      compress ? MAT_COMPRESSION_ZLIB : MAT_COMPRESSION_NONE;
   mat_t *matfp;
   matfp = Mat_Create(fname, 0);
   CHECK(matfp) << "Error creating MAT file " << fname;
@@ -75,7 +77,7 @@ void WriteBlobToMat(const char *fname, bool write_diff,
     matvar = Mat_VarCreate("data", matio_class_map<Dtype>(), matio_type_map<Dtype>(),
 			   4, dims, blob->mutable_cpu_data(), 0);
     CHECK(matvar) << "Error creating 'data' variable";
-    CHECK_EQ(Mat_VarWrite(matfp, matvar, MAT_COMPRESSION_NONE), 0) 
+    CHECK_EQ(Mat_VarWrite(matfp, matvar, compression), 0) 
       << "Error saving array 'data' into MAT file " << fname;
     Mat_VarFree(matvar);
   }
@@ -84,7 +86,7 @@ void WriteBlobToMat(const char *fname, bool write_diff,
     matvar = Mat_VarCreate("diff", matio_class_map<Dtype>(), matio_type_map<Dtype>(),
 			   4, dims, blob->mutable_cpu_diff(), 0);
     CHECK(matvar) << "Error creating 'diff' variable";
-    CHECK_EQ(Mat_VarWrite(matfp, matvar, MAT_COMPRESSION_NONE), 0)
+    CHECK_EQ(Mat_VarWrite(matfp, matvar, compression), 0)
       << "Error saving array 'diff' into MAT file " << fname;
     Mat_VarFree(matvar);
   }
@@ -96,9 +98,13 @@ template void ReadBlobFromMat<double>(const char*, Blob<double>*);
 template void ReadBlobFromMat<int>(const char*, Blob<int>*);
 template void ReadBlobFromMat<unsigned int>(const char*, Blob<unsigned int>*);
 
-template void WriteBlobToMat<float>(const char*, bool, Blob<float>*);
-template void WriteBlobToMat<double>(const char*, bool, Blob<double>*);
-template void WriteBlobToMat<int>(const char*, bool, Blob<int>*);
-template void WriteBlobToMat<unsigned int>(const char*, bool, Blob<unsigned int>*);
+template void WriteBlobToMat<float>(const char*, bool, Blob<float>*,
+    bool);
+template void WriteBlobToMat<double>(const char*, bool, Blob<double>*,
+    bool);
+template void WriteBlobToMat<int>(const char*, bool, Blob<int>*,
+    bool);
+template void WriteBlobToMat<unsigned int>(const char*, bool, Blob<unsigned int>*,
+    bool);
 
 }
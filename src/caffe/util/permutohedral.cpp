@@ -1,11 +1,126 @@
 #include "caffe/util/permutohedral.hpp"
 
+#ifdef DISPATCH_PERMUTOHEDRAL
+# include <immintrin.h>
+#endif
+
+namespace caffe {
+
 #ifdef WIN32
 static float round( float v ) {
   return floor( v+0.5f );
 }
 #endif
 
+/************************************************/
+/***             Scratch Arena                ***/
+/************************************************/
+
+static char* new_block( size_t size ) {
+#ifdef SSE_PERMUTOHEDRAL
+  return (char*) _mm_malloc( size, 64 );
+#else
+  return (char*) malloc( size );
+#endif
+}
+
+static void delete_block( char* data ) {
+#ifdef SSE_PERMUTOHEDRAL
+  _mm_free( data );
+#else
+  free( data );
+#endif
+}
+
+LatticeArena::LatticeArena() {
+  memset( free_, 0, sizeof(free_) );
+}
+
+LatticeArena::~LatticeArena() {
+  for( size_t i=0; i<blocks_.size(); i++ )
+    delete_block( blocks_[i].data );
+}
+
+int LatticeArena::size_class( size_t size ) {
+  int c = MIN_CLASS;
+  while( ((size_t)1 << c) < size )
+    c++;
+  return c;
+}
+
+void* LatticeArena::allocate( size_t size ) {
+  const int c = size_class( size );
+  assert( c < NUM_CLASSES );
+  // Recycle a freed block of the same class
+  if (free_[c]) {
+    void* r = free_[c];
+    free_[c] = *(void**)r;
+    return r;
+  }
+  const size_t class_size = (size_t)1 << c;
+  if (blocks_.empty() || blocks_.back().used + class_size > blocks_.back().size) {
+    // Grow geometrically so that a new image size only costs a few blocks
+    size_t size = blocks_.empty() ? ((size_t)1 << 20) : 2*blocks_.back().size;
+    while( size < class_size )
+      size *= 2;
+    Block b;
+    b.data = new_block( size );
+    b.size = size;
+    b.used = 0;
+    blocks_.push_back( b );
+  }
+  Block& b = blocks_.back();
+  void* r = b.data + b.used;
+  b.used += class_size;
+  return r;
+}
+
+void LatticeArena::deallocate( void* ptr, size_t size ) {
+  if (!ptr) return;
+  const int c = size_class( size );
+  *(void**)ptr = free_[c];
+  free_[c] = ptr;
+}
+
+void LatticeArena::reset() {
+  memset( free_, 0, sizeof(free_) );
+  if (blocks_.size() > 1) {
+    // Merge all blocks into one large enough for everything used so far
+    size_t size = 0;
+    for( size_t i=0; i<blocks_.size(); i++ ){
+      size += blocks_[i].size;
+      delete_block( blocks_[i].data );
+    }
+    blocks_.resize( 1 );
+    blocks_[0].data = new_block( size );
+    blocks_[0].size = size;
+  }
+  if (!blocks_.empty())
+    blocks_[0].used = 0;
+}
+
+size_t LatticeArena::capacity() const {
+  size_t size = 0;
+  for( size_t i=0; i<blocks_.size(); i++ )
+    size += blocks_[i].size;
+  return size;
+}
+
+// Temporaries come from the arena when there is one and from the heap
+// otherwise
+template <typename T>
+static T* scratch_new( LatticeArena* arena, size_t n ) {
+  return arena ? (T*) arena->allocate( n*sizeof(T) ) : (T*) new_block( n*sizeof(T) );
+}
+
+template <typename T>
+static void scratch_delete( LatticeArena* arena, T* ptr, size_t n ) {
+  if (arena)
+    arena->deallocate( ptr, n*sizeof(T) );
+  else
+    delete_block( (char*) ptr );
+}
+
 /************************************************/
 /***                Hash Table                ***/
 /************************************************/
@@ -15,6 +130,7 @@ protected:
   size_t key_size_, filled_, capacity_;
   short * keys_;
   int * table_;
+  LatticeArena * arena_;
   void grow(){
     // Swap out the old memory
     short * old_keys = keys_;
@@ -22,8 +138,8 @@ protected:
     size_t old_capacity = capacity_;
     capacity_ *= 2;
     // Allocate the new memory
-    keys_ = new short[ (old_capacity+10)*key_size_ ];
-    table_ = new int[ capacity_ ];
+    keys_ = scratch_new<short>( arena_, (old_capacity+10)*key_size_ );
+    table_ = scratch_new<int>( arena_, capacity_ );
     memset( table_, -1, capacity_*sizeof(int) );
     memcpy( keys_, old_keys, filled_*key_size_*sizeof(short) );
 		
@@ -36,8 +152,8 @@ protected:
 	table_[h] = e;
       }
 		
-    delete [] old_keys;
-    delete [] old_table;
+    scratch_delete( arena_, old_keys, (old_capacity/2+10)*key_size_ );
+    scratch_delete( arena_, old_table, old_capacity );
   }
   size_t hash( const short * k ) {
     size_t r = 0;
@@ -48,14 +164,14 @@ protected:
     return r;
   }
  public:
-  explicit HashTable( int key_size, int n_elements ) : key_size_ ( key_size ), filled_(0), capacity_(2*n_elements) {
-    table_ = new int[ capacity_ ];
-    keys_ = new short[ (capacity_/2+10)*key_size_ ];
+  explicit HashTable( int key_size, int n_elements, LatticeArena * arena = NULL ) : key_size_ ( key_size ), filled_(0), capacity_(2*n_elements), arena_( arena ) {
+    table_ = scratch_new<int>( arena_, capacity_ );
+    keys_ = scratch_new<short>( arena_, (capacity_/2+10)*key_size_ );
     memset( table_, -1, capacity_*sizeof(int) );
   }
   ~HashTable() {
-    delete [] keys_;
-    delete [] table_;
+    scratch_delete( arena_, keys_, (capacity_/2+10)*key_size_ );
+    scratch_delete( arena_, table_, capacity_ );
   }
   int size() const {
     return (int)filled_;
@@ -112,12 +228,38 @@ Permutohedral::~Permutohedral() {
   if (blur_neighbors_) delete[] blur_neighbors_;
 }
 
-void Permutohedral::init(const float* feature, int feature_size, int N) {
+/************************************************/
+/***          Runtime ISA dispatch            ***/
+/************************************************/
+
+static Permutohedral::Isa max_isa = Permutohedral::ISA_AVX512;
+
+Permutohedral::Isa Permutohedral::supported_isa() {
+#ifdef DISPATCH_PERMUTOHEDRAL
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return ISA_AVX512;
+  if (__builtin_cpu_supports("avx2"))
+    return ISA_AVX2;
+#endif
+  return ISA_DEFAULT;
+}
+
+void Permutohedral::set_max_isa(Isa isa) {
+  max_isa = isa;
+}
+
+Permutohedral::Isa Permutohedral::isa() {
+  static const Isa supported = supported_isa();
+  return supported < max_isa ? supported : max_isa;
+}
+
+void Permutohedral::init(const float* feature, int feature_size, int N, LatticeArena* arena) {
 #ifdef SSE_PERMUTOHEDRAL
     // Compute the lattice coordinates for each feature [there is going to be a lot of magic here
     N_ = N;
     d_ = feature_size;
-    HashTable hash_table( d_, N_/**(d_+1)*/ );
+    HashTable hash_table( d_, N_/**(d_+1)*/, arena );
 		
     const int blocksize = sizeof(__m128) / sizeof(float);
     const __m128 invdplus1   = _mm_set1_ps( 1.0f / (d_+1) );
@@ -135,14 +277,14 @@ void Permutohedral::init(const float* feature, int feature_size, int N) {
     memset( barycentric_, 0, (d_+1)*(N_+16)*sizeof(float) );
 		
     // Allocate the local memory
-    __m128 * scale_factor = (__m128*) _mm_malloc( (d_  )*sizeof(__m128) , 16 );
-    __m128 * f            = (__m128*) _mm_malloc( (d_  )*sizeof(__m128) , 16 );
-    __m128 * elevated     = (__m128*) _mm_malloc( (d_+1)*sizeof(__m128) , 16 );
-    __m128 * rem0         = (__m128*) _mm_malloc( (d_+1)*sizeof(__m128) , 16 );
-    __m128 * rank         = (__m128*) _mm_malloc( (d_+1)*sizeof(__m128), 16 );
-    float * barycentric = new float[(d_+2)*blocksize];
-    short * canonical = new short[(d_+1)*(d_+1)];
-    short * key = new short[d_+1];
+    __m128 * scale_factor = scratch_new<__m128>( arena, d_   );
+    __m128 * f            = scratch_new<__m128>( arena, d_   );
+    __m128 * elevated     = scratch_new<__m128>( arena, d_+1 );
+    __m128 * rem0         = scratch_new<__m128>( arena, d_+1 );
+    __m128 * rank         = scratch_new<__m128>( arena, d_+1 );
+    float * barycentric = scratch_new<float>( arena, (d_+2)*blocksize );
+    short * canonical = scratch_new<short>( arena, (d_+1)*(d_+1) );
+    short * key = scratch_new<short>( arena, d_+1 );
 		
     // Compute the canonical simplex
     for( int i=0; i<=d_; i++ ){
@@ -251,14 +393,14 @@ void Permutohedral::init(const float* feature, int feature_size, int N) {
 	}
       }
     }
-    _mm_free( scale_factor );
-    _mm_free( f );
-    _mm_free( elevated );
-    _mm_free( rem0 );
-    _mm_free( rank );
-    delete [] barycentric;
-    delete [] canonical;
-    delete [] key;
+    scratch_delete( arena, scale_factor, d_   );
+    scratch_delete( arena, f,            d_   );
+    scratch_delete( arena, elevated,     d_+1 );
+    scratch_delete( arena, rem0,         d_+1 );
+    scratch_delete( arena, rank,         d_+1 );
+    scratch_delete( arena, barycentric, (d_+2)*blocksize );
+    scratch_delete( arena, canonical, (d_+1)*(d_+1) );
+    scratch_delete( arena, key, d_+1 );
 		
     // Reset the SSE rounding
 #ifndef __SSE4_1__
@@ -275,8 +417,8 @@ void Permutohedral::init(const float* feature, int feature_size, int N) {
     if(blur_neighbors_) delete[] blur_neighbors_;
     blur_neighbors_ = new Neighbors[ (d_+1)*M_ ];
 		
-    short * n1 = new short[d_+1];
-    short * n2 = new short[d_+1];
+    short * n1 = scratch_new<short>( arena, d_+1 );
+    short * n2 = scratch_new<short>( arena, d_+1 );
 		
     // For each of d+1 axes,
     for( int j = 0; j <= d_; j++ ){
@@ -293,13 +435,13 @@ void Permutohedral::init(const float* feature, int feature_size, int N) {
 	blur_neighbors_[j*M_+i].n2 = hash_table.find( n2 );
       }
     }
-    delete[] n1;
-    delete[] n2;
+    scratch_delete( arena, n1, d_+1 );
+    scratch_delete( arena, n2, d_+1 );
 #else
     // Compute the lattice coordinates for each feature [there is going to be a lot of magic here
     N_ = N;
     d_ = feature_size;
-    HashTable hash_table( d_, N_*(d_+1) );
+    HashTable hash_table( d_, N_*(d_+1), arena );
 
     // Allocate the class memory
     if (offset_) delete [] offset_;
@@ -308,13 +450,13 @@ void Permutohedral::init(const float* feature, int feature_size, int N) {
     barycentric_ = new float[ (d_+1)*N_ ];
 		
     // Allocate the local memory
-    float * scale_factor = new float[d_];
-    float * elevated = new float[d_+1];
-    float * rem0 = new float[d_+1];
-    float * barycentric = new float[d_+2];
-    short * rank = new short[d_+1];
-    short * canonical = new short[(d_+1)*(d_+1)];
-    short * key = new short[d_+1];
+    float * scale_factor = scratch_new<float>( arena, d_ );
+    float * elevated = scratch_new<float>( arena, d_+1 );
+    float * rem0 = scratch_new<float>( arena, d_+1 );
+    float * barycentric = scratch_new<float>( arena, d_+2 );
+    short * rank = scratch_new<short>( arena, d_+1 );
+    short * canonical = scratch_new<short>( arena, (d_+1)*(d_+1) );
+    short * key = scratch_new<short>( arena, d_+1 );
 		
     // Compute the canonical simplex
     for( int i=0; i<=d_; i++ ){
@@ -398,13 +540,13 @@ void Permutohedral::init(const float* feature, int feature_size, int N) {
 	barycentric_[ k*(d_+1)+remainder ] = barycentric[ remainder ];
       }
     }
-    delete [] scale_factor;
-    delete [] elevated;
-    delete [] rem0;
-    delete [] barycentric;
-    delete [] rank;
-    delete [] canonical;
-    delete [] key;
+    scratch_delete( arena, scale_factor, d_ );
+    scratch_delete( arena, elevated, d_+1 );
+    scratch_delete( arena, rem0, d_+1 );
+    scratch_delete( arena, barycentric, d_+2 );
+    scratch_delete( arena, rank, d_+1 );
+    scratch_delete( arena, canonical, (d_+1)*(d_+1) );
+    scratch_delete( arena, key, d_+1 );
 		
 		
     // Find the Neighbors of each lattice point
@@ -416,8 +558,8 @@ void Permutohedral::init(const float* feature, int feature_size, int N) {
     if(blur_neighbors_) delete[] blur_neighbors_;
     blur_neighbors_ = new Neighbors[ (d_+1)*M_ ];
 		
-    short * n1 = new short[d_+1];
-    short * n2 = new short[d_+1];
+    short * n1 = scratch_new<short>( arena, d_+1 );
+    short * n2 = scratch_new<short>( arena, d_+1 );
 		
     // For each of d+1 axes,
     for( int j = 0; j <= d_; j++ ){
@@ -434,8 +576,8 @@ void Permutohedral::init(const float* feature, int feature_size, int N) {
 	blur_neighbors_[j*M_+i].n2 = hash_table.find( n2 );
       }
     }
-    delete[] n1;
-    delete[] n2;
+    scratch_delete( arena, n1, d_+1 );
+    scratch_delete( arena, n2, d_+1 );
 #endif
 }
 
@@ -504,16 +646,188 @@ void Permutohedral::compute( __m128* out, const __m128* in, int value_size, int
   
 #endif
 
-void Permutohedral::compute(float* out, const float* in, int value_size, int in_offset, int out_offset, int in_size, int out_size) const {
+#ifdef DISPATCH_PERMUTOHEDRAL
+// The lattice values are stored with a row stride padded to whole vectors, so
+// splat/blur/slice only ever touch full aligned vectors. The rows of in/out
+// keep their natural stride value_size and use masked loads/stores for the
+// last partial vector, e.g. 20 labels are handled as 8+8+4 with AVX2 and as
+// 16+4 with AVX-512 instead of falling back to scalar code.
+template <typename Neighbors>
+__attribute__((target("avx2")))
+static void compute_avx2( float* out, const float* in, int value_size, const int* offset, const float* barycentric, const Neighbors* blur_neighbors, int d, int M, int in_offset, int out_offset, int in_size, int out_size, LatticeArena* arena ) {
+    const int nv = (value_size-1) / 8 + 1;
+    const __m256i tail = _mm256_cmpgt_epi32( _mm256_set1_epi32( value_size-(nv-1)*8 ), _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 ) );
+
+    // Shift all values by 1 such that -1 -> 0 (used for blurring)
+    __m256 * val        = scratch_new<__m256>( arena, nv );
+    __m256 * values     = scratch_new<__m256>( arena, (M+2)*nv );
+    __m256 * new_values = scratch_new<__m256>( arena, (M+2)*nv );
+
+    const __m256 Zero = _mm256_setzero_ps();
+    for( int i=0; i<(M+2)*nv; i++ )
+      values[i] = new_values[i] = Zero;
+
+    // Splatting
+    for( int i=0; i<in_size; i++ ){
+      const float * v = in + i*value_size;
+      for( int k=0; k<nv-1; k++ )
+	val[k] = _mm256_loadu_ps( v+k*8 );
+      val[nv-1] = _mm256_maskload_ps( v+(nv-1)*8, tail );
+      for( int j=0; j<=d; j++ ){
+	int o = offset[(in_offset+i)*(d+1)+j]+1;
+	__m256 w = _mm256_set1_ps( barycentric[(in_offset+i)*(d+1)+j] );
+	__m256 * dst = values + o*nv;
+	for( int k=0; k<nv; k++ )
+	  dst[k] = _mm256_add_ps( dst[k], _mm256_mul_ps( w, val[k] ) );
+      }
+    }
+    // Blurring
+    const __m256 half = _mm256_set1_ps( 0.5f );
+    for( int j=0; j<=d; j++ ){
+      for( int i=0; i<M; i++ ){
+	const __m256 * old_val = values + (i+1)*nv;
+	__m256 * new_val = new_values + (i+1)*nv;
+	const __m256 * n1_val = values + (blur_neighbors[j*M+i].n1+1)*nv;
+	const __m256 * n2_val = values + (blur_neighbors[j*M+i].n2+1)*nv;
+	for( int k=0; k<nv; k++ )
+	  new_val[k] = _mm256_add_ps( old_val[k], _mm256_mul_ps( half, _mm256_add_ps( n1_val[k], n2_val[k] ) ) );
+      }
+      __m256 * tmp = values;
+      values = new_values;
+      new_values = tmp;
+    }
+    // Alpha is a magic scaling constant (write Andrew if you really wanna understand this)
+    float alpha = 1.0f / (1+powf(2, -d));
+
+    // Slicing
+    for( int i=0; i<out_size; i++ ){
+      for( int k=0; k<nv; k++ )
+	val[k] = Zero;
+      for( int j=0; j<=d; j++ ){
+	int o = offset[(out_offset+i)*(d+1)+j]+1;
+	__m256 w = _mm256_set1_ps( barycentric[(out_offset+i)*(d+1)+j] * alpha );
+	const __m256 * src = values + o*nv;
+	for( int k=0; k<nv; k++ )
+	  val[k] = _mm256_add_ps( val[k], _mm256_mul_ps( w, src[k] ) );
+      }
+      float * v = out + i*value_size;
+      for( int k=0; k<nv-1; k++ )
+	_mm256_storeu_ps( v+k*8, val[k] );
+      _mm256_maskstore_ps( v+(nv-1)*8, tail, val[nv-1] );
+    }
+
+    scratch_delete( arena, val, nv );
+    scratch_delete( arena, values, (M+2)*nv );
+    scratch_delete( arena, new_values, (M+2)*nv );
+}
+
+template <typename Neighbors>
+__attribute__((target("avx512f")))
+static void compute_avx512( float* out, const float* in, int value_size, const int* offset, const float* barycentric, const Neighbors* blur_neighbors, int d, int M, int in_offset, int out_offset, int in_size, int out_size, LatticeArena* arena ) {
+    // Lattice rows are padded to a multiple of 8 floats only; a row of 20
+    // labels is one full vector plus one vector with 8 active lanes.
+    const int vs = ((value_size-1) / 8 + 1) * 8;
+    const int nv = (vs-1) / 16 + 1;
+    const __mmask16 row_tail = (vs % 16 == 0) ? 0xFFFF : 0x00FF;
+    const __mmask16 io_tail = (__mmask16)( (1u << (value_size-(nv-1)*16)) - 1 );
+
+    // Shift all values by 1 such that -1 -> 0 (used for blurring)
+    __m512 * val        = scratch_new<__m512>( arena, nv );
+    float * values      = scratch_new<float>( arena, (M+2)*vs );
+    float * new_values  = scratch_new<float>( arena, (M+2)*vs );
+
+    const __m512 Zero = _mm512_setzero_ps();
+    memset( values, 0, (M+2)*vs*sizeof(float) );
+    memset( new_values, 0, (M+2)*vs*sizeof(float) );
+
+    // Splatting
+    for( int i=0; i<in_size; i++ ){
+      const float * v = in + i*value_size;
+      for( int k=0; k<nv-1; k++ )
+	val[k] = _mm512_loadu_ps( v+k*16 );
+      val[nv-1] = _mm512_maskz_loadu_ps( io_tail, v+(nv-1)*16 );
+      for( int j=0; j<=d; j++ ){
+	int o = offset[(in_offset+i)*(d+1)+j]+1;
+	__m512 w = _mm512_set1_ps( barycentric[(in_offset+i)*(d+1)+j] );
+	float * dst = values + o*vs;
+	for( int k=0; k<nv-1; k++ )
+	  _mm512_storeu_ps( dst+k*16, _mm512_add_ps( _mm512_loadu_ps( dst+k*16 ), _mm512_mul_ps( w, val[k] ) ) );
+	float * last = dst+(nv-1)*16;
+	_mm512_mask_storeu_ps( last, row_tail, _mm512_add_ps( _mm512_maskz_loadu_ps( row_tail, last ), _mm512_mul_ps( w, val[nv-1] ) ) );
+      }
+    }
+    // Blurring
+    const __m512 half = _mm512_set1_ps( 0.5f );
+    for( int j=0; j<=d; j++ ){
+      for( int i=0; i<M; i++ ){
+	const float * old_val = values + (i+1)*vs;
+	float * new_val = new_values + (i+1)*vs;
+	const float * n1_val = values + (blur_neighbors[j*M+i].n1+1)*vs;
+	const float * n2_val = values + (blur_neighbors[j*M+i].n2+1)*vs;
+	for( int k=0; k<nv; k++ ){
+	  const __mmask16 m = k < nv-1 ? 0xFFFF : row_tail;
+	  __m512 n = _mm512_add_ps( _mm512_maskz_loadu_ps( m, n1_val+k*16 ), _mm512_maskz_loadu_ps( m, n2_val+k*16 ) );
+	  _mm512_mask_storeu_ps( new_val+k*16, m, _mm512_add_ps( _mm512_maskz_loadu_ps( m, old_val+k*16 ), _mm512_mul_ps( half, n ) ) );
+	}
+      }
+      float * tmp = values;
+      values = new_values;
+      new_values = tmp;
+    }
+    // Alpha is a magic scaling constant (write Andrew if you really wanna understand this)
+    float alpha = 1.0f / (1+powf(2, -d));
+
+    // Slicing
+    for( int i=0; i<out_size; i++ ){
+      for( int k=0; k<nv; k++ )
+	val[k] = Zero;
+      for( int j=0; j<=d; j++ ){
+	int o = offset[(out_offset+i)*(d+1)+j]+1;
+	__m512 w = _mm512_set1_ps( barycentric[(out_offset+i)*(d+1)+j] * alpha );
+	const float * src = values + o*vs;
+	for( int k=0; k<nv-1; k++ )
+	  val[k] = _mm512_add_ps( val[k], _mm512_mul_ps( w, _mm512_loadu_ps( src+k*16 ) ) );
+	val[nv-1] = _mm512_add_ps( val[nv-1], _mm512_mul_ps( w, _mm512_maskz_loadu_ps( row_tail, src+(nv-1)*16 ) ) );
+      }
+      float * v = out + i*value_size;
+      for( int k=0; k<nv-1; k++ )
+	_mm512_storeu_ps( v+k*16, val[k] );
+      _mm512_mask_storeu_ps( v+(nv-1)*16, io_tail, val[nv-1] );
+    }
+
+    scratch_delete( arena, val, nv );
+    scratch_delete( arena, values, (M+2)*vs );
+    scratch_delete( arena, new_values, (M+2)*vs );
+}
+#endif
+
+void Permutohedral::compute(float* out, const float* in, int value_size, int in_offset, int out_offset, int in_size, int out_size, LatticeArena* arena) const {
+#ifdef DISPATCH_PERMUTOHEDRAL
+    // Rows that fit in a single SSE register gain nothing from wider vectors
+    if (value_size > 4) {
+      const int in_n  = in_size  == -1 ? N_ -  in_offset : in_size;
+      const int out_n = out_size == -1 ? N_ - out_offset : out_size;
+      switch (isa()) {
+      case ISA_AVX512:
+	compute_avx512( out, in, value_size, offset_, barycentric_, blur_neighbors_, d_, M_, in_offset, out_offset, in_n, out_n, arena );
+	return;
+      case ISA_AVX2:
+	compute_avx2( out, in, value_size, offset_, barycentric_, blur_neighbors_, d_, M_, in_offset, out_offset, in_n, out_n, arena );
+	return;
+      default:
+	break;
+      }
+    }
+#endif
 #ifdef SSE_PERMUTOHEDRAL
     if ( in_size == -1)  in_size = N_ -  in_offset;
     if (out_size == -1) out_size = N_ - out_offset;
 		
     const int sse_value_size = (value_size-1)*sizeof(float) / sizeof(__m128) + 1;
     // Shift all values by 1 such that -1 -> 0 (used for blurring)
-    __m128 * sse_val    = (__m128*) _mm_malloc( sse_value_size*sizeof(__m128), 16 );
-    __m128 * values     = (__m128*) _mm_malloc( (M_+2)*sse_value_size*sizeof(__m128), 16 );
-    __m128 * new_values = (__m128*) _mm_malloc( (M_+2)*sse_value_size*sizeof(__m128), 16 );
+    __m128 * sse_val    = scratch_new<__m128>( arena, sse_value_size );
+    __m128 * values     = scratch_new<__m128>( arena, (M_+2)*sse_value_size );
+    __m128 * new_values = scratch_new<__m128>( arena, (M_+2)*sse_value_size );
 		
     __m128 Zero = _mm_set1_ps( 0 );
   
@@ -566,9 +880,9 @@ void Permutohedral::compute(float* out, const float* in, int value_size, int in_
       memcpy( out+i*value_size, sse_val, value_size*sizeof(float) );
     }
 		
-    _mm_free( sse_val );
-    _mm_free( values );
-    _mm_free( new_values );
+    scratch_delete( arena, sse_val, sse_value_size );
+    scratch_delete( arena, values, (M_+2)*sse_value_size );
+    scratch_delete( arena, new_values, (M_+2)*sse_value_size );
 
 #else
 
@@ -576,8 +890,8 @@ void Permutohedral::compute(float* out, const float* in, int value_size, int in_
     if (out_size == -1) out_size = N_ - out_offset;
 		
     // Shift all values by 1 such that -1 -> 0 (used for blurring)
-    float * values = new float[ (M_+2)*value_size ];
-    float * new_values = new float[ (M_+2)*value_size ];
+    float * values = scratch_new<float>( arena, (M_+2)*value_size );
+    float * new_values = scratch_new<float>( arena, (M_+2)*value_size );
 		
     for( int i=0; i<(M_+2)*value_size; i++ )
       values[i] = new_values[i] = 0;
@@ -623,9 +937,11 @@ void Permutohedral::compute(float* out, const float* in, int value_size, int in_
       }
     }
 		
-    delete[] values;
-    delete[] new_values;
+    scratch_delete( arena, values, (M_+2)*value_size );
+    scratch_delete( arena, new_values, (M_+2)*value_size );
 
 #endif
 
 }
+
+}  // namespace caffe
@@ -0,0 +1,100 @@
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <exception>
+
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+class ThreadPool::sync {
+ public:
+  boost::mutex mutex_;
+  boost::condition_variable work_;
+  boost::condition_variable done_;
+};
+
+int ThreadPool::ResolveNumThreads(int num_threads) {
+  if (num_threads > 0) {
+    return num_threads;
+  }
+  return std::max(1, static_cast<int>(boost::thread::hardware_concurrency()));
+}
+
+ThreadPool::ThreadPool(int num_threads)
+    : num_threads_(ResolveNumThreads(num_threads)), sync_(new sync()),
+      task_(NULL), num_tasks_(0), next_task_(0), remaining_(0),
+      stop_(false) {
+  // The calling thread is the first worker.
+  try {
+    for (int i = 1; i < num_threads_; ++i) {
+      workers_.push_back(shared_ptr<boost::thread>(
+          new boost::thread(&ThreadPool::WorkerEntry, this)));
+    }
+  } catch (std::exception& e) {
+    LOG(FATAL) << "Thread exception: " << e.what();
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    stop_ = true;
+  }
+  sync_->work_.notify_all();
+  for (int i = 0; i < workers_.size(); ++i) {
+    workers_[i]->join();
+  }
+}
+
+void ThreadPool::WorkerEntry() {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  while (true) {
+    while (!stop_ && next_task_ >= num_tasks_) {
+      sync_->work_.wait(lock);
+    }
+    if (stop_) {
+      return;
+    }
+    const int i = next_task_++;
+    lock.unlock();
+    (*task_)(i);
+    lock.lock();
+    if (--remaining_ == 0) {
+      sync_->done_.notify_all();
+    }
+  }
+}
+
+void ThreadPool::Run(int num_tasks, const boost::function<void(int)>& task) {
+  if (num_tasks <= 0) {
+    return;
+  }
+  if (workers_.empty() || num_tasks == 1) {
+    for (int i = 0; i < num_tasks; ++i) {
+      task(i);
+    }
+    return;
+  }
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  task_ = &task;
+  num_tasks_ = num_tasks;
+  next_task_ = 0;
+  remaining_ = num_tasks;
+  sync_->work_.notify_all();
+  while (next_task_ < num_tasks_) {
+    const int i = next_task_++;
+    lock.unlock();
+    task(i);
+    lock.lock();
+    --remaining_;
+  }
+  while (remaining_ > 0) {
+    sync_->done_.wait(lock);
+  }
+  task_ = NULL;
+  num_tasks_ = 0;
+  next_task_ = 0;
+}
+
+}  // namespace caffe
@@ -13,6 +13,8 @@ namespace bp = boost::python;
 
 #include "boost/algorithm/string.hpp"
 #include "caffe/caffe.hpp"
+#include "caffe/layers/base_data_layer.hpp"
+#include "caffe/util/async_writer.hpp"
 #include "caffe/util/signal_handler.h"
 
 using caffe::Blob;
@@ -277,6 +279,7 @@ int test() {
       }
     }
   }
+  FlushAsyncOutputs(caffe_net.layers());
   loss /= FLAGS_iterations;
   LOG(INFO) << "Loss: " << loss;
   for (int i = 0; i < test_score.size(); ++i) {
@@ -332,6 +335,15 @@ int time() {
   const vector<vector<Blob<float>*> >& top_vecs = caffe_net.top_vecs();
   const vector<vector<bool> >& bottom_need_backward =
       caffe_net.bottom_need_backward();
+  // Restart the prefetch telemetry after the warm up pass.
+  for (int i = 0; i < layers.size(); ++i) {
+    caffe::BasePrefetchingDataLayer<float>* data_layer =
+        dynamic_cast<caffe::BasePrefetchingDataLayer<float>*>(
+            layers[i].get());
+    if (data_layer) {
+      data_layer->ResetPrefetchStats();
+    }
+  }
   LOG(INFO) << "*** Benchmark begins ***";
   LOG(INFO) << "Testing for " << FLAGS_iterations << " iterations.";
   Timer total_timer;
@@ -374,6 +386,7 @@ int time() {
       "\tbackward: " << backward_time_per_layer[i] / 1000 /
       FLAGS_iterations << " ms.";
   }
+  caffe::LogPrefetchStats(layers, false);
   total_timer.Stop();
   LOG(INFO) << "Average Forward pass: " << forward_time / 1000 /
     FLAGS_iterations << " ms.";
@@ -0,0 +1,140 @@
+// This program packs a set of per-image feature files into a single feature
+// file (see caffe/util/feature_file.hpp), which FeatureReadLayer memory maps.
+// Usage:
+//   convert_features [FLAGS] ROOTFOLDER/ LISTFILE FEATURE_FILE
+//
+// where ROOTFOLDER is the root folder that holds the files listed, one per
+// line, in LISTFILE:
+//   2007_000033_blob_0.mat
+//   ....
+// The .mat files are read as written by MatWriteLayer, and the .bin files
+// as written by densecrf/my_script/SaveBinFile.m (int32 rows, cols and
+// channels, then the single precision data in column major order). The
+// records are named after the files, stripped of --strip characters and of
+// the "_blob_<i>" suffix of MatWriteLayer, so that they are named as by
+// FeatureWriteLayer: 2007_000033_blob_0.mat is packed as 2007_000033.
+
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/util/feature_file.hpp"
+#include "caffe/util/matio_io.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_string(format, "",
+    "The format {mat, bin} of the input files, by default their extension");
+DEFINE_int32(strip, 4,
+    "Number of characters stripped from the file names to name the records");
+
+// The record name of a listed file: stripped of strip characters, then of
+// the "_blob_<i>" suffix, if any.
+string RecordName(const string& filename, int strip) {
+  CHECK_GT(filename.size(), strip) << "Too much stripping";
+  string name = filename.substr(0, filename.size() - strip);
+  const size_t digits = name.find_last_not_of("0123456789");
+  const string suffix = "_blob_";
+  if (digits != string::npos && digits + 1 < name.size() &&
+      digits + 1 > suffix.size() &&
+      name.compare(digits + 1 - suffix.size(), suffix.size(), suffix) == 0) {
+    name.erase(digits + 1 - suffix.size());
+  }
+  return name;
+}
+
+// Reads a SaveBinFile.m file into a 1 x channels x rows x cols blob.
+void ReadBlobFromBin(const string& filename, Blob<float>* blob) {
+  std::ifstream infile(filename.c_str(), std::ios::binary);
+  CHECK(infile.good()) << "Failed to open " << filename;
+  infile.seekg(0, std::ios::end);
+  const int64_t file_size = infile.tellg();
+  infile.seekg(0, std::ios::beg);
+  int32_t dims[3];
+  infile.read(reinterpret_cast<char*>(dims), sizeof(dims));
+  CHECK(infile.good()) << "Truncated file " << filename;
+  const int rows = dims[0];
+  const int cols = dims[1];
+  const int channels = dims[2];
+  CHECK(rows > 0 && cols > 0 && channels > 0) << "Invalid dimensions "
+      << rows << " x " << cols << " x " << channels << " in " << filename;
+  const int64_t count = static_cast<int64_t>(rows) * cols * channels;
+  CHECK_EQ(file_size,
+      static_cast<int64_t>(sizeof(dims) + count * sizeof(float)))
+      << "The size of " << filename << " does not match its dimensions "
+      << rows << " x " << cols << " x " << channels;
+  vector<float> data(count);
+  infile.read(reinterpret_cast<char*>(&data[0]), data.size() * sizeof(float));
+  CHECK(infile.good()) << "Truncated file " << filename;
+  blob->Reshape(1, channels, rows, cols);
+  float* blob_data = blob->mutable_cpu_data();
+  for (int c = 0; c < channels; ++c) {
+    for (int h = 0; h < rows; ++h) {
+      for (int w = 0; w < cols; ++w) {
+        blob_data[(c * rows + h) * cols + w] = data[(c * cols + w) * rows + h];
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  // Print output to stderr (while still logging)
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Pack a set of .mat or .bin feature files into a\n"
+        "single memory mappable feature file.\n"
+        "Usage:\n"
+        "    convert_features [FLAGS] ROOTFOLDER/ LISTFILE FEATURE_FILE\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (argc < 4) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/convert_features");
+    return 1;
+  }
+  CHECK_GE(FLAGS_strip, 0) << "strip cannot be negative";
+
+  std::ifstream infile(argv[2]);
+  CHECK(infile.good()) << "Failed to open list file " << argv[2];
+  std::vector<std::string> lines;
+  std::string filename;
+  while (infile >> filename) {
+    lines.push_back(filename);
+  }
+  LOG(INFO) << "A total of " << lines.size() << " files.";
+
+  const string root_folder(argv[1]);
+  FeatureFileWriter writer(argv[3]);
+  Blob<float> blob;
+  for (int line_id = 0; line_id < lines.size(); ++line_id) {
+    const string& name = lines[line_id];
+    string format = FLAGS_format;
+    if (format.empty()) {
+      const size_t dot = name.rfind('.');
+      CHECK_NE(dot, string::npos) << "Unknown format of " << name;
+      format = name.substr(dot + 1);
+    }
+    const string path = root_folder + name;
+    if (format == "mat") {
+      ReadBlobFromMat(path.c_str(), &blob);
+    } else if (format == "bin") {
+      ReadBlobFromBin(path, &blob);
+    } else {
+      LOG(FATAL) << "Unknown format " << format << " of " << name;
+    }
+    writer.Append(RecordName(name, FLAGS_strip), blob);
+    if ((line_id + 1) % 1000 == 0) {
+      LOG(INFO) << "Processed " << line_id + 1 << " files.";
+    }
+  }
+  LOG(INFO) << "Wrote " << writer.num_records() << " records to " << argv[3];
+  return 0;
+}
@@ -0,0 +1,136 @@
+// This program packs the images, segmentations and poses read by the
+// ImageSegPoseData layer into a lmdb/leveldb of SegPoseDatum, to be read by
+// the SegPoseData layer.
+// Usage:
+//   convert_imageseg_pose [FLAGS] ROOTFOLDER/ LISTFILE POSEFILE DB_NAME
+//
+// where ROOTFOLDER is the root folder that holds all the images, LISTFILE
+// lists an image and optionally its segmentation per line, as in
+//   subfolder1/file1.jpg subfolder1/file1.png
+//   ....
+// and POSEFILE holds the 32 comma separated joint coordinates of the image
+// of the same line of LISTFILE.
+
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+#endif  // USE_OPENCV
+
+#include <algorithm>
+#include <fstream>  // NOLINT(readability/streams)
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "boost/scoped_ptr.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/db.hpp"
+#include "caffe/util/format.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/rng.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+using std::pair;
+using boost::scoped_ptr;
+
+DEFINE_bool(shuffle, false,
+    "Randomly shuffle the order of the samples");
+DEFINE_string(backend, "lmdb",
+        "The backend {lmdb, leveldb} for storing the result");
+
+int main(int argc, char** argv) {
+#ifdef USE_OPENCV
+  ::google::InitGoogleLogging(argv[0]);
+  // Print output to stderr (while still logging)
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Pack images with their segmentation and pose\n"
+        "into the leveldb/lmdb format read by the SegPoseData layer.\n"
+        "Usage:\n"
+        "    convert_imageseg_pose [FLAGS] ROOTFOLDER/ LISTFILE POSEFILE "
+        "DB_NAME\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (argc < 5) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0],
+                                       "tools/convert_imageseg_pose");
+    return 1;
+  }
+
+  std::ifstream infile(argv[2]);
+  std::ifstream pose_infile(argv[3]);
+  std::vector<pair<pair<string, string>, std::vector<float> > > lines;
+  string linestr, posestr;
+  while (std::getline(infile, linestr)) {
+    CHECK(std::getline(pose_infile, posestr))
+        << "Missing pose of " << linestr;
+    std::istringstream iss(linestr);
+    string imgfn, segfn;
+    iss >> imgfn >> segfn;
+    std::vector<float> pose;
+    std::istringstream pss(posestr);
+    string s;
+    while (std::getline(pss, s, ',')) {
+      pose.push_back(atof(s.c_str()));
+    }
+    CHECK_EQ(pose.size(), 32) << "number of pose gt should be 32";
+    lines.push_back(std::make_pair(std::make_pair(imgfn, segfn), pose));
+  }
+  if (FLAGS_shuffle) {
+    // randomly shuffle data
+    LOG(INFO) << "Shuffling data";
+    shuffle(lines.begin(), lines.end());
+  }
+  LOG(INFO) << "A total of " << lines.size() << " images.";
+
+  // Create new DB
+  scoped_ptr<db::DB> db(db::GetDB(FLAGS_backend));
+  db->Open(argv[4], db::NEW);
+  scoped_ptr<db::Transaction> txn(db->NewTransaction());
+
+  // Storing to db
+  std::string root_folder(argv[1]);
+  SegPoseDatum datum;
+  int count = 0;
+
+  for (int line_id = 0; line_id < lines.size(); ++line_id) {
+    const string& imgfn = lines[line_id].first.first;
+    const string& segfn = lines[line_id].first.second;
+    if (!ReadSegPoseToDatum(root_folder + imgfn,
+                            segfn.size() ? root_folder + segfn : segfn,
+                            lines[line_id].second, &datum)) {
+      LOG(ERROR) << "Could not pack " << imgfn;
+      continue;
+    }
+    // sequential
+    string key_str = caffe::format_int(line_id, 8) + "_" + imgfn;
+
+    // Put in db
+    string out;
+    CHECK(datum.SerializeToString(&out));
+    txn->Put(key_str, out);
+
+    if (++count % 1000 == 0) {
+      // Commit db
+      txn->Commit();
+      txn.reset(db->NewTransaction());
+      LOG(INFO) << "Processed " << count << " files.";
+    }
+  }
+  // write the last batch
+  if (count % 1000 != 0) {
+    txn->Commit();
+    LOG(INFO) << "Processed " << count << " files.";
+  }
+#else
+  LOG(FATAL) << "This tool requires OpenCV; compile with USE_OPENCV.";
+#endif  // USE_OPENCV
+  return 0;
+}
@@ -0,0 +1,253 @@
+// Micro-benchmarks for the building blocks of the DenseCRF mean-field
+// inference on synthetic, parsing sized inputs.
+// Usage:
+//    densecrf_benchmark [FLAGS]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "boost/algorithm/string.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layers/densecrf_layer.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/confusion_matrix.hpp"
+#include "caffe/util/densecrf_util.hpp"
+#include "caffe/util/math_functions.hpp"
+
+using caffe::Blob;
+using caffe::CPUTimer;
+using caffe::DenseCRFLayer;
+using caffe::EXP_ACCURATE;
+using caffe::EXP_LEGACY;
+using caffe::ExpAccuracy;
+using caffe::LayerParameter;
+using caffe::expAndNormalize;
+using std::string;
+using std::vector;
+
+DEFINE_string(benchmarks, "exp_normalize",
+    "Comma separated list of benchmarks to run: exp_normalize, downsample.");
+DEFINE_int32(height, 321, "Height of the synthetic score map.");
+DEFINE_int32(width, 321, "Width of the synthetic score map.");
+DEFINE_int32(labels, 20, "Number of labels (channels) of the score map.");
+DEFINE_int32(iterations, 10, "Number of mean-field iterations.");
+DEFINE_int32(repeat, 5, "Number of timed runs; the fastest one is reported.");
+DEFINE_string(downsample_factors, "1,2,4",
+    "Comma separated lattice_downsample values to compare; the first one "
+    "is the reference of the agreement mIoU.");
+DEFINE_int32(num_threads, 1, "DenseCRFParameter.num_threads of the layer.");
+
+// Softmax normalization of the messages, as run once per mean-field
+// iteration. The legacy path negates the unary in a separate pass as
+// StepInference used to; the fused paths do it while normalizing.
+void BenchmarkExpNormalize() {
+  const int num_pixel = FLAGS_height * FLAGS_width;
+  const int count = num_pixel * FLAGS_labels;
+  vector<float> unary(count), next(count), current(count);
+  caffe::caffe_rng_gaussian<float>(count, 0., 3., &unary[0]);
+
+  // exact softmax of the first step as reference
+  vector<float> exact(count);
+  for (int i = 0; i < num_pixel; ++i) {
+    const float* u = &unary[i * FLAGS_labels];
+    const float mx = -*std::min_element(u, u + FLAGS_labels);
+    double sum = 0;
+    for (int j = 0; j < FLAGS_labels; ++j) {
+      sum += std::exp(-u[j] - mx);
+    }
+    for (int j = 0; j < FLAGS_labels; ++j) {
+      exact[i * FLAGS_labels + j] = std::exp(-u[j] - mx) / sum;
+    }
+  }
+
+  const char* names[] = {"legacy", "fast", "accurate"};
+  LOG(INFO) << "exp_normalize: " << FLAGS_height << "x" << FLAGS_width
+            << "x" << FLAGS_labels << ", " << FLAGS_iterations
+            << " iterations";
+  float legacy_ms = 0;
+  for (int accuracy = EXP_LEGACY; accuracy <= EXP_ACCURATE; ++accuracy) {
+    const ExpAccuracy mode = static_cast<ExpAccuracy>(accuracy);
+    float best_ms = 0;
+    for (int r = 0; r < FLAGS_repeat; ++r) {
+      CPUTimer timer;
+      timer.Start();
+      for (int iter = 0; iter < FLAGS_iterations; ++iter) {
+        if (mode == EXP_LEGACY) {
+          for (int i = 0; i < count; ++i) {
+            next[i] = -unary[i];
+          }
+          expAndNormalize(&current[0], &next[0], 1.0, num_pixel,
+              FLAGS_labels, mode);
+        } else {
+          expAndNormalize(&current[0], &next[0], 1.0, num_pixel,
+              FLAGS_labels, mode, &next[0], &unary[0]);
+        }
+      }
+      timer.Stop();
+      if (r == 0 || timer.MilliSeconds() < best_ms) {
+        best_ms = timer.MilliSeconds();
+      }
+    }
+    if (mode == EXP_LEGACY) {
+      legacy_ms = best_ms;
+    }
+    // accuracy of one normalization from the unary
+    expAndNormalize(&current[0], &unary[0], -1.0, num_pixel, FLAGS_labels,
+        mode);
+    float max_error = 0;
+    for (int i = 0; i < count; ++i) {
+      max_error = std::max(max_error, std::fabs(current[i] - exact[i]));
+    }
+    LOG(INFO) << "  " << names[accuracy] << ": " << best_ms << " ms ("
+              << legacy_ms / best_ms << "x legacy), max abs error "
+              << max_error;
+  }
+}
+
+// Synthetic scene: discs of random labels over the background label, a
+// noisy color per label and a noisy score map favouring the true label.
+void MakeScene(Blob<float>* score, Blob<float>* dims, Blob<float>* image,
+    vector<int>* labels) {
+  const int height = FLAGS_height, width = FLAGS_width;
+  const int num_pixel = height * width;
+  score->Reshape(1, FLAGS_labels, height, width);
+  dims->Reshape(1, 2, 1, 1);
+  image->Reshape(1, 3, height, width);
+  dims->mutable_cpu_data()[0] = height;
+  dims->mutable_cpu_data()[1] = width;
+
+  labels->assign(num_pixel, 0);
+  const int num_disc = 2 * FLAGS_labels;
+  vector<float> disc(4 * num_disc);
+  caffe::caffe_rng_uniform<float>(disc.size(), 0., 1., &disc[0]);
+  for (int d = 0; d < num_disc; ++d) {
+    const float cy = disc[4 * d] * height, cx = disc[4 * d + 1] * width;
+    const float r = (0.05 + 0.15 * disc[4 * d + 2]) * std::min(height, width);
+    const int label = 1 + static_cast<int>(disc[4 * d + 3] *
+        (FLAGS_labels - 1)) % (FLAGS_labels - 1);
+    for (int h = std::max(0, static_cast<int>(cy - r));
+         h < std::min(height, static_cast<int>(cy + r) + 1); ++h) {
+      for (int w = std::max(0, static_cast<int>(cx - r));
+           w < std::min(width, static_cast<int>(cx + r) + 1); ++w) {
+        if ((h - cy) * (h - cy) + (w - cx) * (w - cx) <= r * r) {
+          (*labels)[h * width + w] = label;
+        }
+      }
+    }
+  }
+
+  vector<float> palette(3 * FLAGS_labels);
+  caffe::caffe_rng_uniform<float>(palette.size(), -100., 100., &palette[0]);
+  float* im = image->mutable_cpu_data();
+  caffe::caffe_rng_gaussian<float>(image->count(), 0., 10., im);
+  float* sc = score->mutable_cpu_data();
+  caffe::caffe_rng_gaussian<float>(score->count(), 0., 1.5, sc);
+  for (int i = 0; i < num_pixel; ++i) {
+    const int label = (*labels)[i];
+    for (int c = 0; c < 3; ++c) {
+      im[c * num_pixel + i] += palette[3 * label + c];
+    }
+    sc[label * num_pixel + i] += 2.;
+  }
+}
+
+// Mean-field inference of DenseCRFLayer with the pairwise filtering on a
+// downsampled grid: latency against the mIoU w.r.t. the ground truth and
+// w.r.t. the labeling of the reference factor.
+void BenchmarkDownsample() {
+  Blob<float> score, dims, image;
+  vector<int> labels;
+  MakeScene(&score, &dims, &image, &labels);
+  vector<Blob<float>*> bottom;
+  bottom.push_back(&score);
+  bottom.push_back(&dims);
+  bottom.push_back(&image);
+
+  vector<string> factors;
+  boost::split(factors, FLAGS_downsample_factors, boost::is_any_of(","));
+  const int num_pixel = FLAGS_height * FLAGS_width;
+  vector<int> reference;
+  LOG(INFO) << "downsample: " << FLAGS_height << "x" << FLAGS_width
+            << "x" << FLAGS_labels << ", " << FLAGS_iterations
+            << " iterations";
+  for (int f = 0; f < factors.size(); ++f) {
+    LayerParameter param;
+    caffe::DenseCRFParameter* crf_param = param.mutable_dense_crf_param();
+    crf_param->set_max_iter(FLAGS_iterations);
+    crf_param->set_num_threads(FLAGS_num_threads);
+    crf_param->set_lattice_downsample(atoi(factors[f].c_str()));
+    crf_param->add_pos_xy_std(3);
+    crf_param->add_pos_w(3);
+    crf_param->add_bi_xy_std(50);
+    crf_param->add_bi_rgb_std(10);
+    crf_param->add_bi_w(4);
+    DenseCRFLayer<float> layer(param);
+    Blob<float> top_blob;
+    vector<Blob<float>*> top(1, &top_blob);
+    layer.SetUp(bottom, top);
+
+    float best_ms = 0;
+    for (int r = 0; r < FLAGS_repeat; ++r) {
+      CPUTimer timer;
+      timer.Start();
+      layer.Forward(bottom, top);
+      timer.Stop();
+      if (r == 0 || timer.MilliSeconds() < best_ms) {
+        best_ms = timer.MilliSeconds();
+      }
+    }
+
+    vector<int> prediction(num_pixel, 0);
+    const float* prob = top_blob.cpu_data();
+    for (int c = 1; c < FLAGS_labels; ++c) {
+      for (int i = 0; i < num_pixel; ++i) {
+        if (prob[c * num_pixel + i] > prob[prediction[i] * num_pixel + i]) {
+          prediction[i] = c;
+        }
+      }
+    }
+    if (f == 0) {
+      reference = prediction;
+    }
+    ConfusionMatrix truth(FLAGS_labels), agreement(FLAGS_labels);
+    for (int i = 0; i < num_pixel; ++i) {
+      truth.accumulate(labels[i], prediction[i]);
+      agreement.accumulate(reference[i], prediction[i]);
+    }
+    LOG(INFO) << "  lattice_downsample " << factors[f] << ": " << best_ms
+              << " ms, mIoU " << truth.avgJaccard() << ", mIoU w.r.t. "
+              << "factor " << factors[0] << " " << agreement.avgJaccard();
+  }
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  FLAGS_alsologtostderr = 1;
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+  gflags::SetUsageMessage("Benchmark the DenseCRF inference kernels.\n"
+        "Usage:\n"
+        "    densecrf_benchmark [FLAGS]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  vector<string> benchmarks;
+  boost::split(benchmarks, FLAGS_benchmarks, boost::is_any_of(","));
+  for (int i = 0; i < benchmarks.size(); ++i) {
+    if (benchmarks[i] == "exp_normalize") {
+      BenchmarkExpNormalize();
+    } else if (benchmarks[i] == "downsample") {
+      BenchmarkDownsample();
+    } else {
+      LOG(FATAL) << "Unknown benchmark: " << benchmarks[i];
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,174 @@
+// Measures the memory bandwidth of the recursive filtering passes of
+// DomainTransformLayer on typical feature map sizes, against the original
+// one-row / one-column-at-a-time loops.
+// Usage:
+//    domain_transform_benchmark [FLAGS]
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "boost/algorithm/string.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layers/domain_transform_layer.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/math_functions.hpp"
+
+using caffe::Blob;
+using caffe::CPUTimer;
+using caffe::LayerParameter;
+using std::string;
+using std::vector;
+
+DEFINE_string(sizes, "65x65x21,129x129x21,257x257x21,321x321x20,513x513x21",
+    "Comma separated HxWxC feature map sizes.");
+DEFINE_int32(repeat, 5, "Number of timed runs; the fastest one is reported.");
+
+// Exposes the passes of the layer for a single channel.
+class DomainTransformPasses : public caffe::DomainTransformLayer<float> {
+ public:
+  DomainTransformPasses(const LayerParameter& param, int height, int width)
+      : caffe::DomainTransformLayer<float>(param) {
+    height_ = height;
+    width_ = width;
+  }
+
+  void Run(int pass, const float* weight, float* tmp, float* output) {
+    switch (pass) {
+      case 0:
+        HorizontalFilterLeftToRightForward(height_, width_, weight, tmp,
+                                           output);
+        break;
+      case 1:
+        HorizontalFilterRightToLeftForward(height_, width_, weight, tmp,
+                                           output);
+        break;
+      case 2:
+        VerticalFilterTopToBottomForward(height_, width_, weight, tmp,
+                                         output);
+        break;
+      case 3:
+        VerticalFilterBottomToTopForward(height_, width_, weight, tmp,
+                                         output);
+        break;
+    }
+  }
+};
+
+// The passes as originally written: rows (resp. columns) one at a time.
+void ReferencePass(int pass, int height, int width, const float* weight,
+    float* tmp, float* output) {
+  switch (pass) {
+    case 0:
+      for (int h = 0; h < height; ++h) {
+        for (int w = 1; w < width; ++w) {
+          int pos = h * width + w;
+          tmp[pos] = output[pos - 1] - output[pos];
+          output[pos] = output[pos] + weight[pos] * tmp[pos];
+        }
+      }
+      break;
+    case 1:
+      for (int h = 0; h < height; ++h) {
+        for (int w = width - 2; w >= 0; --w) {
+          int pos = h * width + w;
+          tmp[pos] = output[pos + 1] - output[pos];
+          output[pos] = output[pos] + weight[pos + 1] * tmp[pos];
+        }
+      }
+      break;
+    case 2:
+      for (int w = 0; w < width; ++w) {
+        for (int h = 1; h < height; ++h) {
+          int pos = h * width + w;
+          tmp[pos] = output[pos - width] - output[pos];
+          output[pos] = output[pos] + weight[pos] * tmp[pos];
+        }
+      }
+      break;
+    case 3:
+      for (int w = 0; w < width; ++w) {
+        for (int h = height - 2; h >= 0; --h) {
+          int pos = h * width + w;
+          tmp[pos] = output[pos + width] - output[pos];
+          output[pos] = output[pos] + weight[pos + width] * tmp[pos];
+        }
+      }
+      break;
+  }
+}
+
+void BenchmarkSize(int height, int width, int channels) {
+  const int spatial_dim = height * width;
+  Blob<float> data(1, channels, height, width);
+  Blob<float> tmp(1, channels, height, width);
+  Blob<float> weight(1, 1, height, width);
+  caffe::caffe_rng_uniform<float>(data.count(), -1, 1,
+                                  data.mutable_cpu_data());
+  caffe::caffe_rng_uniform<float>(weight.count(), 0, 1,
+                                  weight.mutable_cpu_data());
+  LayerParameter param;
+  DomainTransformPasses passes(param, height, width);
+
+  const char* names[] = {"left->right", "right->left", "top->bottom",
+                         "bottom->top"};
+  LOG(INFO) << height << "x" << width << "x" << channels << ":";
+  for (int pass = 0; pass < 4; ++pass) {
+    float best_ms[2] = {0, 0};
+    for (int impl = 0; impl < 2; ++impl) {
+      for (int r = 0; r < FLAGS_repeat; ++r) {
+        CPUTimer timer;
+        timer.Start();
+        for (int c = 0; c < channels; ++c) {
+          float* output = data.mutable_cpu_data() + c * spatial_dim;
+          float* res = tmp.mutable_cpu_data() + c * spatial_dim;
+          if (impl == 0) {
+            ReferencePass(pass, height, width, weight.cpu_data(), res,
+                          output);
+          } else {
+            passes.Run(pass, weight.cpu_data(), res, output);
+          }
+        }
+        timer.Stop();
+        if (r == 0 || timer.MicroSeconds() / 1000 < best_ms[impl]) {
+          best_ms[impl] = timer.MicroSeconds() / 1000;
+        }
+      }
+    }
+    // read weight, read and write output, write intermediate result
+    const double bytes = 4. * sizeof(float) * spatial_dim * channels;
+    char line[256];
+    snprintf(line, sizeof(line),
+             "  %-12s before %7.2f ms %6.2f GB/s, after %7.2f ms %6.2f GB/s",
+             names[pass], best_ms[0], bytes / best_ms[0] * 1e-6,
+             best_ms[1], bytes / best_ms[1] * 1e-6);
+    LOG(INFO) << line;
+  }
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  FLAGS_alsologtostderr = 1;
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+  gflags::SetUsageMessage("Benchmark the domain transform filtering passes.\n"
+        "Usage:\n"
+        "    domain_transform_benchmark [FLAGS]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  vector<string> sizes;
+  boost::split(sizes, FLAGS_sizes, boost::is_any_of(","));
+  for (int i = 0; i < sizes.size(); ++i) {
+    int height, width, channels;
+    CHECK_EQ(sscanf(sizes[i].c_str(), "%dx%dx%d", &height, &width,
+                    &channels), 3) << "Invalid size: " << sizes[i];
+    BenchmarkSize(height, width, channels);
+  }
+  return 0;
+}
@@ -0,0 +1,157 @@
+// Segments a list of images with a net run on several scales of every image,
+// fusing the scores of the scales, and saves the labelings as png images.
+// Usage:
+//    segment_multiscale [FLAGS] ROOTFOLDER/ LISTFILE OUTFOLDER/
+//
+// where LISTFILE lists the images relative to ROOTFOLDER, one per line. The
+// labeling of ROOTFOLDER/subfolder/image.jpg is saved to
+// OUTFOLDER/image.png.
+
+#include <cstdlib>
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "boost/algorithm/string.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#endif  // USE_OPENCV
+
+#include "caffe/blob.hpp"
+#include "caffe/multi_scale_net.hpp"
+#include "caffe/util/argmax.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+using std::string;
+using std::vector;
+
+DEFINE_string(model, "", "The deploy net prototxt, taking the image as input.");
+DEFINE_string(weights, "", "The trained weights of the net.");
+DEFINE_string(scales, "0.5,0.75,1", "Comma separated scales of the images.");
+DEFINE_string(fusion, "MAX", "Fusion of the scores of the scales: MAX, MEAN.");
+DEFINE_string(score_blob, "",
+    "The blob of the scores; the last output of the net by default.");
+DEFINE_double(batch_pad_ratio, 1.25, "MultiScaleParameter.batch_pad_ratio.");
+DEFINE_string(mean_values, "104.008,116.669,122.675",
+    "Comma separated BGR mean subtracted from the images.");
+DEFINE_int32(gpu, -1, "GPU device to run on; CPU if negative.");
+
+int main(int argc, char** argv) {
+#ifdef USE_OPENCV
+  ::google::InitGoogleLogging(argv[0]);
+  // Print output to stderr (while still logging)
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Segment images with a net run on several scales.\n"
+        "Usage:\n"
+        "    segment_multiscale [FLAGS] ROOTFOLDER/ LISTFILE OUTFOLDER/\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (argc < 4 || FLAGS_model.empty()) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/segment_multiscale");
+    return 1;
+  }
+  if (FLAGS_gpu >= 0) {
+    Caffe::SetDevice(FLAGS_gpu);
+    Caffe::set_mode(Caffe::GPU);
+  } else {
+    Caffe::set_mode(Caffe::CPU);
+  }
+
+  MultiScaleParameter param;
+  vector<string> fields;
+  boost::split(fields, FLAGS_scales, boost::is_any_of(","));
+  for (int i = 0; i < fields.size(); ++i) {
+    param.add_scale(atof(fields[i].c_str()));
+  }
+  MultiScaleParameter_Fusion fusion;
+  CHECK(MultiScaleParameter_Fusion_Parse(FLAGS_fusion, &fusion))
+      << "Unknown fusion " << FLAGS_fusion;
+  param.set_fusion(fusion);
+  param.set_score_blob(FLAGS_score_blob);
+  param.set_batch_pad_ratio(FLAGS_batch_pad_ratio);
+  vector<float> mean_values;
+  boost::split(fields, FLAGS_mean_values, boost::is_any_of(","));
+  for (int i = 0; i < fields.size(); ++i) {
+    mean_values.push_back(atof(fields[i].c_str()));
+  }
+
+  NetParameter net_param;
+  ReadNetParamsFromTextFileOrDie(FLAGS_model, &net_param);
+  MultiScaleNet<float> multi_scale_net(net_param, param);
+  if (!FLAGS_weights.empty()) {
+    multi_scale_net.net()->CopyTrainedLayersFrom(FLAGS_weights);
+  }
+
+  const string root_folder(argv[1]);
+  const string out_folder(argv[3]);
+  std::ifstream infile(argv[2]);
+  string filename;
+  Blob<float> image, scores;
+  vector<float> max_score;
+  vector<int> argmax;
+  CPUTimer timer;
+  double total_ms = 0;
+  int count = 0;
+  while (infile >> filename) {
+    cv::Mat cv_img = cv::imread(root_folder + filename, CV_LOAD_IMAGE_COLOR);
+    CHECK(cv_img.data) << "Could not load " << root_folder + filename;
+    const int height = cv_img.rows;
+    const int width = cv_img.cols;
+    CHECK_EQ(mean_values.size(), 3) << "Expecting a mean per BGR channel.";
+    image.Reshape(1, 3, height, width);
+    float* image_data = image.mutable_cpu_data();
+    for (int h = 0; h < height; ++h) {
+      const uchar* row = cv_img.ptr<uchar>(h);
+      for (int w = 0; w < width; ++w) {
+        for (int c = 0; c < 3; ++c) {
+          image_data[(c * height + h) * width + w] =
+              static_cast<float>(row[3 * w + c]) - mean_values[c];
+        }
+      }
+    }
+
+    timer.Start();
+    multi_scale_net.Forward(image, &scores);
+    timer.Stop();
+    total_ms += timer.MicroSeconds() / 1000;
+
+    // ties go to the larger label, as with ArgMaxLayer
+    const int spatial_dim = height * width;
+    max_score.resize(spatial_dim);
+    argmax.resize(spatial_dim);
+    caffe_cpu_channel_argmax(scores.channels(), spatial_dim, spatial_dim,
+        scores.cpu_data(), &max_score[0], &argmax[0]);
+    cv::Mat labels(height, width, CV_8UC1);
+    for (int h = 0; h < height; ++h) {
+      uchar* row = labels.ptr<uchar>(h);
+      for (int w = 0; w < width; ++w) {
+        row[w] = static_cast<uchar>(argmax[h * width + w]);
+      }
+    }
+    string basename = filename.substr(filename.find_last_of('/') + 1);
+    basename = basename.substr(0, basename.find_last_of('.'));
+    CHECK(cv::imwrite(out_folder + basename + ".png", labels))
+        << "Could not write " << out_folder + basename + ".png";
+    if (++count % 100 == 0) {
+      LOG(INFO) << "Segmented " << count << " images, "
+                << total_ms / count << " ms per image.";
+    }
+  }
+  LOG(INFO) << "Segmented " << count << " images with "
+            << multi_scale_net.num_forward() << " forward passes, "
+            << (count > 0 ? total_ms / count : 0) << " ms per image.";
+#else
+  LOG(FATAL) << "This tool requires OpenCV; compile with USE_OPENCV.";
+#endif  // USE_OPENCV
+  return 0;
+}
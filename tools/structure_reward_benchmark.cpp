@@ -0,0 +1,191 @@
+// Times the layers of the MaskCreate -> PoseEvaluate -> PoseError ->
+// RewardLoss chain of the structure-sensitive reward against the fused
+// StructureRewardLayer, with the memory of the blobs each one allocates.
+// Usage:
+//    structure_reward_benchmark [FLAGS]
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "boost/algorithm/string.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layers/mask_create_layer.hpp"
+#include "caffe/layers/pose_error_layer.hpp"
+#include "caffe/layers/pose_evaluate_layer.hpp"
+#include "caffe/layers/reward_loss_layer.hpp"
+#include "caffe/layers/structure_reward_layer.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/math_functions.hpp"
+
+using caffe::Blob;
+using caffe::CPUTimer;
+using caffe::Layer;
+using caffe::LayerParameter;
+using std::string;
+using std::vector;
+
+DEFINE_string(sizes, "41x41x20,321x321x20",
+    "Comma separated HxWxC score map sizes.");
+DEFINE_int32(batch_size, 10, "Number of images of the batch.");
+DEFINE_int32(repeat, 5, "Number of timed runs; the fastest one is reported.");
+DEFINE_int32(num_threads, 1,
+    "StructureRewardParameter.num_threads of the fused layer.");
+
+// Fastest forward and backward of a layer, in ms.
+void TimeLayer(Layer<float>* layer, const vector<Blob<float>*>& bottom,
+    const vector<Blob<float>*>& top, const vector<bool>& propagate_down,
+    float* forward_ms, float* backward_ms) {
+  for (int r = 0; r < FLAGS_repeat; ++r) {
+    CPUTimer timer;
+    timer.Start();
+    layer->Forward(bottom, top);
+    timer.Stop();
+    if (r == 0 || timer.MicroSeconds() / 1000 < *forward_ms) {
+      *forward_ms = timer.MicroSeconds() / 1000;
+    }
+    if (propagate_down.empty()) {
+      *backward_ms = 0;
+      continue;
+    }
+    timer.Start();
+    layer->Backward(top, propagate_down, bottom);
+    timer.Stop();
+    if (r == 0 || timer.MicroSeconds() / 1000 < *backward_ms) {
+      *backward_ms = timer.MicroSeconds() / 1000;
+    }
+  }
+}
+
+void Report(const string& name, float forward_ms, float backward_ms,
+    double bytes) {
+  char line[256];
+  snprintf(line, sizeof(line), "  %-24s forward %8.2f ms, backward %8.2f ms,"
+           " blobs %8.2f MB", name.c_str(), forward_ms, backward_ms,
+           bytes / (1 << 20));
+  LOG(INFO) << line;
+}
+
+void BenchmarkSize(int height, int width, int channels) {
+  const int num = FLAGS_batch_size;
+  Blob<float> score(num, channels, height, width);
+  Blob<float> label(num, 1, height, width);
+  caffe::caffe_rng_gaussian<float>(score.count(), 0., 1.,
+                                   score.mutable_cpu_data());
+  float* label_data = label.mutable_cpu_data();
+  for (int i = 0; i < label.count(); ++i) {
+    label_data[i] = caffe::caffe_rng_rand() % channels;
+  }
+  LOG(INFO) << num << "x" << channels << "x" << height << "x" << width
+            << ":";
+
+  // the chain, over the blobs it materializes
+  Blob<float> mask, pose, gt_pose, error, loss;
+  vector<Blob<float>*> bottom(1, &score), top(1, &mask);
+  float total_forward_ms = 0, total_backward_ms = 0;
+  double total_bytes = 0;
+  float forward_ms, backward_ms;
+
+  LayerParameter mask_param;
+  mask_param.mutable_mask_create_param()->set_num_cls(channels);
+  caffe::MaskCreateLayer<float> mask_layer(mask_param);
+  mask_layer.SetUp(bottom, top);
+  TimeLayer(&mask_layer, bottom, top, vector<bool>(1, true), &forward_ms,
+            &backward_ms);
+  // the top data and diff
+  Report("MaskCreate", forward_ms, backward_ms, 2. * mask.count() * 4);
+  total_forward_ms += forward_ms;
+  total_backward_ms += backward_ms;
+  total_bytes += 2. * mask.count() * 4;
+
+  LayerParameter pose_param;
+  caffe::PoseEvaluateLayer<float> pose_layer(pose_param);
+  caffe::PoseEvaluateLayer<float> gt_pose_layer(pose_param);
+  bottom[0] = &mask;
+  top[0] = &pose;
+  pose_layer.SetUp(bottom, top);
+  TimeLayer(&pose_layer, bottom, top, vector<bool>(), &forward_ms,
+            &backward_ms);
+  bottom[0] = &label;
+  top[0] = &gt_pose;
+  gt_pose_layer.SetUp(bottom, top);
+  float gt_forward_ms;
+  TimeLayer(&gt_pose_layer, bottom, top, vector<bool>(), &gt_forward_ms,
+            &backward_ms);
+  Report("PoseEvaluate x2", forward_ms + gt_forward_ms, 0,
+         (pose.count() + gt_pose.count()) * 4.);
+  total_forward_ms += forward_ms + gt_forward_ms;
+  total_bytes += (pose.count() + gt_pose.count()) * 4.;
+
+  LayerParameter error_param;
+  error_param.mutable_pose_error_param()->set_error_order(1);
+  caffe::PoseErrorLayer<float> error_layer(error_param);
+  bottom[0] = &pose;
+  bottom.push_back(&gt_pose);
+  top[0] = &error;
+  error_layer.SetUp(bottom, top);
+  TimeLayer(&error_layer, bottom, top, vector<bool>(), &forward_ms,
+            &backward_ms);
+  Report("PoseError", forward_ms, 0, error.count() * 4.);
+  total_forward_ms += forward_ms;
+  total_bytes += error.count() * 4.;
+
+  LayerParameter loss_param;
+  caffe::RewardLossLayer<float> loss_layer(loss_param);
+  bottom[0] = &error;
+  bottom[1] = &mask;
+  top[0] = &loss;
+  loss_layer.SetUp(bottom, top);
+  vector<bool> propagate_down(2, true);
+  propagate_down[0] = false;
+  TimeLayer(&loss_layer, bottom, top, propagate_down, &forward_ms,
+            &backward_ms);
+  Report("RewardLoss", forward_ms, backward_ms, loss.count() * 4.);
+  total_forward_ms += forward_ms;
+  total_backward_ms += backward_ms;
+  total_bytes += loss.count() * 4.;
+  Report("chain", total_forward_ms, total_backward_ms, total_bytes);
+
+  LayerParameter fused_param;
+  fused_param.mutable_structure_reward_param()->set_num_threads(
+      FLAGS_num_threads);
+  caffe::StructureRewardLayer<float> fused_layer(fused_param);
+  bottom[0] = &score;
+  bottom[1] = &label;
+  Blob<float> reward;
+  top[0] = &reward;
+  fused_layer.SetUp(bottom, top);
+  propagate_down[0] = true;
+  propagate_down[1] = false;
+  TimeLayer(&fused_layer, bottom, top, propagate_down, &forward_ms,
+            &backward_ms);
+  // the top and the int argmax map
+  Report("StructureReward", forward_ms, backward_ms,
+         reward.count() * 4. + mask.count() * 4.);
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  FLAGS_alsologtostderr = 1;
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+  gflags::SetUsageMessage("Benchmark the structure-sensitive reward layers.\n"
+        "Usage:\n"
+        "    structure_reward_benchmark [FLAGS]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  vector<string> sizes;
+  boost::split(sizes, FLAGS_sizes, boost::is_any_of(","));
+  for (int i = 0; i < sizes.size(); ++i) {
+    int height, width, channels;
+    CHECK_EQ(sscanf(sizes[i].c_str(), "%dx%dx%d", &height, &width,
+                    &channels), 3) << "Invalid size: " << sizes[i];
+    BenchmarkSize(height, width, channels);
+  }
+  return 0;
+}